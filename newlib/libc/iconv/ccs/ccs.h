@@ -154,5 +154,10 @@ typedef struct
 extern const iconv_ccs_t *
 _iconv_ccs[];
 
+/* All mappings of an 8 bit table, see ces/table.c */
+int
+_iconv_table_8bit_map (void *data, int direction, __uint16_t *ucs,
+                       unsigned char *ccs, int max);
+
 #endif /* __CCS_H__ */
 
@@ -282,6 +282,77 @@ _iconv_from_ucs_ces_handlers_table =
 };
 #endif /* ICONV_TO_UCS_CES_TABLE */
 
+/*
+ * _iconv_table_8bit_map - get all mappings of an 8 bit table.
+ *
+ * PARAMETERS:
+ *     void *data - table CES converter data, as returned by its init.
+ *     int direction - 0 for a "to UCS" table, 1 for a "from UCS" table.
+ *     __uint16_t *ucs - where to store the UCS codes.
+ *     unsigned char *ccs - where to store the corresponding CCS codes.
+ *     int max - size of the 'ucs' and 'ccs' arrays.
+ *
+ * DESCRIPTION:
+ *     Used by ucsconv.c to build the tables of its bulk conversions. A
+ *     "from UCS" table may map several UCS codes to the same CCS code.
+ *
+ * RETURN:
+ *     The number of mappings, -1 if the table isn't an 8 bit table or has
+ *     more than 'max' mappings.
+ */
+int
+_iconv_table_8bit_map (void *data,
+                              int direction,
+                              __uint16_t *ucs,
+                              unsigned char *ccs,
+                              int max)
+{
+  const iconv_ccs_desc_t *ccsp = (iconv_ccs_desc_t *)data;
+  const unsigned char *tblp = (const unsigned char *)ccsp->tbl;
+  int i, j, idx, n = 0;
+
+  if (ccsp->bits != TABLE_8BIT)
+    return -1;
+
+  if (direction == 0)
+    {
+      for (i = 0; i < 256; i++)
+        if (ccsp->tbl[i] != INVALC)
+          {
+            if (n == max)
+              return -1;
+            ucs[n] = ccsp->tbl[i];
+            ccs[n++] = (unsigned char)i;
+          }
+      return n;
+    }
+
+  /* See find_code_speed_8bit */
+  if (((ucs2_t *)tblp)[0] != INVALC)
+    {
+      if (n == max)
+        return -1;
+      ucs[n] = ((ucs2_t *)tblp)[0];
+      ccs[n++] = 0xFF;
+    }
+  for (i = 0; i < 256; i++)
+    {
+      idx = ((ucs2_t *)tblp)[1 + i];
+      if (idx == INVBLK)
+        continue;
+      for (j = 0; j < 256; j++)
+        if (tblp[idx + j] != 0xFF && (i << 8 | j) != INVALC
+            && (i << 8 | j) != ((ucs2_t *)tblp)[0])
+          {
+            if (n == max)
+              return -1;
+            ucs[n] = (ucs2_t)(i << 8 | j);
+            ccs[n++] = tblp[idx + j];
+          }
+    }
+  return n;
+}
+
 /*
  * Supplementary functions.
  */
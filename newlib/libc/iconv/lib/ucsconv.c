@@ -32,6 +32,24 @@
 #include "local.h"
 #include "conv.h"
 #include "ucsconv.h"
+#include "../ces/cesbi.h"
+#include "../ccs/ccs.h"
+
+/*
+ * Bulk conversions between 8 bit table encodings (KOI8-R, CP1252, ...)
+ * and UTF-8 or UCS-2 convert whole buffers in tight loops instead of
+ * calling two CES converters through UCS-4 for every character.
+ */
+#if !defined (PREFER_SIZE_OVER_SPEED) && !defined (__OPTIMIZE_SIZE__)
+#  if defined (ICONV_TO_UCS_CES_TABLE) \
+   && (defined (ICONV_FROM_UCS_CES_UTF_8) || defined (ICONV_FROM_UCS_CES_UCS_2))
+#    define ICONV_BULK_FROM_TABLE
+#  endif
+#  if defined (ICONV_FROM_UCS_CES_TABLE) \
+   && (defined (ICONV_TO_UCS_CES_UTF_8) || defined (ICONV_TO_UCS_CES_UCS_2))
+#    define ICONV_BULK_TO_TABLE
+#  endif
+#endif
 
 static int fake_data;
 
@@ -39,6 +57,21 @@ static int
 find_encoding_name (const char *searchee,
                             const char **names);
 
+#if defined (ICONV_BULK_FROM_TABLE) || defined (ICONV_BULK_TO_TABLE)
+static struct iconv_ucs_bulk *
+bulk_open (struct _reent *rptr,
+                  iconv_ucs_conversion_t *uc,
+                  const char *to,
+                  const char *from);
+
+static void
+bulk_convert (const struct iconv_ucs_bulk *b,
+                     const unsigned char **inbuf,
+                     size_t *inbytesleft,
+                     unsigned char **outbuf,
+                     size_t *outbytesleft);
+#endif
+
 
 /*
  * UCS-based conversion interface functions implementation.
@@ -109,6 +142,11 @@ ucs_based_conversion_open (struct _reent *rptr,
   else
     uc->from_ucs.data = (void *)&fake_data;
 
+#if defined (ICONV_BULK_FROM_TABLE) || defined (ICONV_BULK_TO_TABLE)
+  /* Failing to build the tables just leaves the conversion slower. */
+  uc->bulk = bulk_open (rptr, uc, to, from);
+#endif
+
   return uc;
 
 error:
@@ -135,6 +173,8 @@ ucs_based_conversion_close (struct _reent *rptr,
   if (uc->to_ucs.handlers->close != NULL)
     res |= uc->to_ucs.handlers->close (rptr, uc->to_ucs.data);
 
+  if (uc->bulk != NULL)
+    _free_r (rptr, (void *)uc->bulk);
   _free_r (rptr, (void *)data);
 
   return res;
@@ -159,8 +199,25 @@ ucs_based_conversion_convert (struct _reent *rptr,
     {
       register size_t bytes;
       register ucs4_t ch;
-      const unsigned char *inbuf_save = *inbuf;
-      size_t inbyteslef_save = *inbytesleft;
+      const unsigned char *inbuf_save;
+      size_t inbyteslef_save;
+
+#if defined (ICONV_BULK_FROM_TABLE) || defined (ICONV_BULK_TO_TABLE)
+      /*
+       * Convert as much as possible at once.  The bulk conversion stops
+       * before anything that needs special treatment, which is then
+       * handled below, one character at a time.
+       */
+      if (uc->bulk != NULL && !(flags & ICONV_DONT_SAVE_BIT))
+        {
+          bulk_convert (uc->bulk, inbuf, inbytesleft, outbuf, outbytesleft);
+          if (*inbytesleft == 0)
+            break;
+        }
+#endif
+
+      inbuf_save = *inbuf;
+      inbyteslef_save = *inbytesleft;
 
       if (*outbytesleft == 0)
         {
@@ -346,3 +403,424 @@ find_encoding_name (const char *searchee,
   return -1;
 }
 
+
+#if defined (ICONV_BULK_FROM_TABLE) || defined (ICONV_BULK_TO_TABLE)
+
+/* Bulk conversion types */
+#define BULK_FROM_TABLE     1 /* Table -> UTF-8 or UCS-2 */
+#define BULK_UTF_8_TO_TABLE 2
+#define BULK_UCS_2BE_TO_TABLE 3
+#define BULK_UCS_2LE_TO_TABLE 4
+
+/* Maximum number of "from UCS" mappings of an 8 bit table we handle */
+#define BULK_MAX_MAPPINGS 1024
+/* Maximum number of perfect hash slots */
+#define BULK_MAX_SLOTS 8192
+/* Maximum number of keys in a perfect hash bucket */
+#define BULK_MAX_BUCKET 16
+
+typedef struct
+{
+  ucs2_t ucs;
+  unsigned char ccs;
+} bulk_slot_t;
+
+/*
+ * iconv_ucs_bulk - tables of a bulk conversion.
+ *
+ * Table -> UTF-8 or UCS-2 conversions map every input byte through 'seq'.
+ *
+ * UTF-8 or UCS-2 -> table conversions map UCS codes < 0x100 through
+ * 'direct' and the others through a perfect hash: the key's bucket
+ * (ucs * mult1) >> bucket_shift gives a displacement which, added to
+ * (ucs * mult2) >> slot_shift, gives the only slot the key can be in.
+ */
+struct iconv_ucs_bulk
+{
+  int type;
+  /* Output bytes for every input byte, their number in seq[][3].  0 means
+     the byte needs special treatment. */
+  unsigned char seq[256][4];
+  /* CCS code of UCS codes < 0x100, -1 if none. */
+  short direct[256];
+  __uint32_t mult1;
+  __uint32_t mult2;
+  int bucket_shift;
+  int slot_shift;
+  __uint32_t mask;
+  ucs2_t *disp;
+  bulk_slot_t *slot;
+};
+
+static const __uint32_t bulk_multipliers[] =
+{
+  0x9E3779B1, 0x85EBCA77, 0xC2B2AE3D, 0x27D4EB2F,
+  0x165667B1, 0xD3A2646C, 0xFD7046C5, 0xB55A4F09
+};
+#define BULK_NMULTIPLIERS \
+  (sizeof (bulk_multipliers) / sizeof (bulk_multipliers[0]))
+
+static __inline int
+bulk_lookup (const struct iconv_ucs_bulk *b,
+                    __uint32_t c)
+{
+  const bulk_slot_t *sp;
+
+  if (c < 0x100)
+    return b->direct[c];
+  sp = &b->slot[((c * b->mult2 >> b->slot_shift)
+                 + b->disp[c * b->mult1 >> b->bucket_shift]) & b->mask];
+  return sp->ucs == c ? sp->ccs : -1;
+}
+
+/*
+ * bulk_place - find the displacements of all buckets with the current
+ * multipliers.  Largest buckets go first, while there is most room.
+ * Returns 0 if success, -1 if the multipliers don't work.
+ */
+static int
+bulk_place (struct iconv_ucs_bulk *b,
+                   const ucs2_t *ucs,
+                   const unsigned char *ccs,
+                   int n,
+                   int nbuckets)
+{
+  int i, j, k, size, bucket, maxsize = 0;
+  __uint32_t d, h[BULK_MAX_BUCKET];
+  int key[BULK_MAX_BUCKET];
+
+  /* Count the keys of every bucket in its displacement for now */
+  memset (b->disp, 0, nbuckets * sizeof (ucs2_t));
+  for (i = 0; i < n; i++)
+    if (++b->disp[ucs[i] * b->mult1 >> b->bucket_shift] > BULK_MAX_BUCKET)
+      return -1;
+    else if (b->disp[ucs[i] * b->mult1 >> b->bucket_shift] > maxsize)
+      maxsize = b->disp[ucs[i] * b->mult1 >> b->bucket_shift];
+
+  for (i = 0; i <= (int)b->mask; i++)
+    b->slot[i].ucs = INVALC;
+
+  for (size = maxsize; size > 0; size--)
+    for (bucket = 0; bucket < nbuckets; bucket++)
+      {
+        if (b->disp[bucket] != size)
+          continue;
+
+        for (i = k = 0; i < n; i++)
+          if ((ucs[i] * b->mult1 >> b->bucket_shift) == (__uint32_t)bucket)
+            {
+              key[k] = i;
+              h[k] = ucs[i] * b->mult2 >> b->slot_shift;
+              for (j = 0; j < k; j++)
+                if (h[j] == h[k])
+                  return -1;
+              k++;
+            }
+
+        for (d = 0; d <= b->mask; d++)
+          {
+            for (j = 0; j < k; j++)
+              if (b->slot[(h[j] + d) & b->mask].ucs != INVALC)
+                break;
+            if (j == k)
+              break;
+          }
+        if (d > b->mask)
+          return -1;
+
+        for (j = 0; j < k; j++)
+          {
+            b->slot[(h[j] + d) & b->mask].ucs = ucs[key[j]];
+            b->slot[(h[j] + d) & b->mask].ccs = ccs[key[j]];
+          }
+        /* Sizes are > BULK_MAX_BUCKET from here on, so it isn't seen
+           again. */
+        b->disp[bucket] = (ucs2_t)(d + BULK_MAX_BUCKET + 1);
+      }
+
+  for (bucket = 0; bucket < nbuckets; bucket++)
+    if (b->disp[bucket] != 0)
+      b->disp[bucket] -= BULK_MAX_BUCKET + 1;
+  return 0;
+}
+
+/*
+ * bulk_open - build the tables of a bulk conversion, if there is one for
+ * the encodings of 'uc'.
+ *
+ * RETURN:
+ *     The tables, or NULL if there's no bulk conversion or not enough
+ *     memory.
+ */
+static struct iconv_ucs_bulk *
+bulk_open (struct _reent *rptr,
+                  iconv_ucs_conversion_t *uc,
+                  const char *to,
+                  const char *from)
+{
+  struct iconv_ucs_bulk *b = NULL;
+  ucs2_t *ucs;
+  unsigned char *ccs;
+  int type, i, n, nhash, nslots, nbuckets, bits;
+  unsigned int m;
+
+  type = 0;
+#ifdef ICONV_BULK_FROM_TABLE
+  if (uc->to_ucs.handlers == &_iconv_to_ucs_ces_handlers_table
+      && (0
+#  ifdef ICONV_FROM_UCS_CES_UTF_8
+          || uc->from_ucs.handlers == &_iconv_from_ucs_ces_handlers_utf_8
+#  endif
+#  ifdef ICONV_FROM_UCS_CES_UCS_2
+          || uc->from_ucs.handlers == &_iconv_from_ucs_ces_handlers_ucs_2
+#  endif
+         ))
+    type = BULK_FROM_TABLE;
+#endif
+#ifdef ICONV_BULK_TO_TABLE
+  if (uc->from_ucs.handlers == &_iconv_from_ucs_ces_handlers_table)
+    {
+#  ifdef ICONV_TO_UCS_CES_UTF_8
+      if (uc->to_ucs.handlers == &_iconv_to_ucs_ces_handlers_utf_8)
+        type = BULK_UTF_8_TO_TABLE;
+#  endif
+#  ifdef ICONV_TO_UCS_CES_UCS_2
+      if (uc->to_ucs.handlers == &_iconv_to_ucs_ces_handlers_ucs_2)
+        type = strcmp (from, "ucs_2le") == 0 ? BULK_UCS_2LE_TO_TABLE
+                                             : BULK_UCS_2BE_TO_TABLE;
+#  endif
+    }
+#endif
+  if (type == 0)
+    return NULL;
+
+  ucs = (ucs2_t *)_malloc_r (rptr, BULK_MAX_MAPPINGS
+                                   * (sizeof (ucs2_t) + 1));
+  if (ucs == NULL)
+    return NULL;
+  ccs = (unsigned char *)(ucs + BULK_MAX_MAPPINGS);
+
+  if (type == BULK_FROM_TABLE)
+    {
+#ifdef ICONV_FROM_UCS_CES_UCS_2
+      int ucs_2 = uc->from_ucs.handlers == &_iconv_from_ucs_ces_handlers_ucs_2;
+      int le = ucs_2 && strcmp (to, "ucs_2le") == 0;
+#endif
+
+      n = _iconv_table_8bit_map (uc->to_ucs.data, 0, ucs, ccs,
+                                 BULK_MAX_MAPPINGS);
+      if (n < 0
+          || (b = (struct iconv_ucs_bulk *)
+                  _calloc_r (rptr, 1, sizeof (struct iconv_ucs_bulk))) == NULL)
+        goto out;
+      b->type = type;
+      for (i = 0; i < n; i++)
+        {
+          unsigned char *sq = b->seq[ccs[i]];
+          ucs2_t c = ucs[i];
+
+          /* Leave what UTF-8 and UCS-2 reject to the CES converters */
+          if ((c >= 0xD800 && c <= 0xDFFF) || c >= 0xFFFE)
+            continue;
+#ifdef ICONV_FROM_UCS_CES_UCS_2
+          if (ucs_2)
+            {
+              sq[le] = (unsigned char)(c >> 8);
+              sq[!le] = (unsigned char)c;
+              sq[3] = 2;
+              continue;
+            }
+#endif
+          if (c < 0x80)
+            {
+              sq[0] = (unsigned char)c;
+              sq[3] = 1;
+            }
+          else if (c < 0x800)
+            {
+              sq[0] = (unsigned char)(0xC0 | c >> 6);
+              sq[1] = (unsigned char)(0x80 | (c & 0x3F));
+              sq[3] = 2;
+            }
+          else
+            {
+              sq[0] = (unsigned char)(0xE0 | c >> 12);
+              sq[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+              sq[2] = (unsigned char)(0x80 | (c & 0x3F));
+              sq[3] = 3;
+            }
+        }
+      goto out;
+    }
+
+  n = _iconv_table_8bit_map (uc->from_ucs.data, 1, ucs, ccs,
+                             BULK_MAX_MAPPINGS);
+  if (n < 0)
+    goto out;
+
+  /* Codes < 0x100 are looked up directly, move them to the end */
+  for (i = nhash = 0; i < n; i++)
+    if (ucs[i] >= 0x100)
+      {
+        ucs2_t tu = ucs[nhash];
+        unsigned char tc = ccs[nhash];
+
+        ucs[nhash] = ucs[i];
+        ccs[nhash] = ccs[i];
+        ucs[i] = tu;
+        ccs[i] = tc;
+        nhash++;
+      }
+
+  for (bits = 4; (1 << bits) < 2 * nhash; bits++)
+    ;
+  for (; bits <= 13 && (1 << bits) <= BULK_MAX_SLOTS; bits++)
+    {
+      nslots = 1 << bits;
+      nbuckets = nslots / 4;
+      b = (struct iconv_ucs_bulk *)
+          _malloc_r (rptr, sizeof (struct iconv_ucs_bulk)
+                           + nbuckets * sizeof (ucs2_t)
+                           + nslots * sizeof (bulk_slot_t));
+      if (b == NULL)
+        goto out;
+      b->slot = (bulk_slot_t *)(b + 1);
+      b->disp = (ucs2_t *)(b->slot + nslots);
+      b->mask = nslots - 1;
+      b->slot_shift = 32 - bits;
+      b->bucket_shift = 32 - (bits - 2);
+
+      for (m = 0; m < BULK_NMULTIPLIERS; m++)
+        {
+          b->mult1 = bulk_multipliers[m];
+          b->mult2 = bulk_multipliers[(m + 1) % BULK_NMULTIPLIERS];
+          if (bulk_place (b, ucs, ccs, nhash, nbuckets) == 0)
+            break;
+        }
+      if (m < BULK_NMULTIPLIERS)
+        break;
+      _free_r (rptr, (void *)b);
+      b = NULL;
+    }
+  if (b == NULL)
+    goto out;
+
+  b->type = type;
+  for (i = 0; i < 256; i++)
+    b->direct[i] = -1;
+  for (i = nhash; i < n; i++)
+    b->direct[ucs[i]] = ccs[i];
+
+out:
+  _free_r (rptr, (void *)ucs);
+  return b;
+}
+
+/*
+ * bulk_convert - convert as much as possible of the input with the tables
+ * of a bulk conversion.
+ *
+ * DESCRIPTION:
+ *     Stops before the first character which is invalid, incomplete or not
+ *     representable, or doesn't fit into the output buffer.  The normal
+ *     conversion handles it exactly as before.  Updates the buffer
+ *     pointers and counts just as the normal conversion does.
+ */
+static void
+bulk_convert (const struct iconv_ucs_bulk *b,
+                     const unsigned char **inbuf,
+                     size_t *inbytesleft,
+                     unsigned char **outbuf,
+                     size_t *outbytesleft)
+{
+  const unsigned char *in = *inbuf;
+  const unsigned char *inend = in + *inbytesleft;
+  unsigned char *out = *outbuf;
+  unsigned char *outend = out + *outbytesleft;
+  __uint32_t c;
+  int code;
+
+  switch (b->type)
+    {
+    case BULK_FROM_TABLE:
+      while (in < inend)
+        {
+          const unsigned char *sq = b->seq[*in];
+
+          if (sq[3] == 1 && out < outend)
+            *out++ = sq[0];
+          else if (sq[3] == 0 || (size_t)(outend - out) < sq[3])
+            break;
+          else
+            {
+              out[0] = sq[0];
+              out[1] = sq[1];
+              if (sq[3] == 3)
+                out[2] = sq[2];
+              out += sq[3];
+            }
+          in++;
+        }
+      break;
+
+    case BULK_UTF_8_TO_TABLE:
+      while (in < inend && out < outend)
+        {
+          c = in[0];
+          if (c < 0x80)
+            {
+              if ((code = bulk_lookup (b, c)) < 0)
+                break;
+              in++;
+            }
+          else if (c >= 0xC2 && c < 0xE0)
+            {
+              if (inend - in < 2 || (in[1] & 0xC0) != 0x80)
+                break;
+              c = (c & 0x1F) << 6 | (in[1] & 0x3F);
+              if ((code = bulk_lookup (b, c)) < 0)
+                break;
+              in += 2;
+            }
+          else if (c >= 0xE0 && c < 0xF0)
+            {
+              if (inend - in < 3 || (in[1] & 0xC0) != 0x80
+                  || (in[2] & 0xC0) != 0x80)
+                break;
+              c = (c & 0x0F) << 12 | (in[1] & 0x3F) << 6 | (in[2] & 0x3F);
+              /* Overlong, surrogates, U'FFFE and U'FFFF */
+              if (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF) || c >= 0xFFFE
+                  || (code = bulk_lookup (b, c)) < 0)
+                break;
+              in += 3;
+            }
+          else
+            break;
+          *out++ = (unsigned char)code;
+        }
+      break;
+
+    case BULK_UCS_2BE_TO_TABLE:
+    case BULK_UCS_2LE_TO_TABLE:
+      while (inend - in >= 2 && out < outend)
+        {
+          if (b->type == BULK_UCS_2BE_TO_TABLE)
+            c = (__uint32_t)in[0] << 8 | in[1];
+          else
+            c = (__uint32_t)in[1] << 8 | in[0];
+          if ((c >= 0xD800 && c <= 0xDFFF) || c >= 0xFFFE
+              || (code = bulk_lookup (b, c)) < 0)
+            break;
+          *out++ = (unsigned char)code;
+          in += 2;
+        }
+      break;
+    }
+
+  *inbytesleft -= in - *inbuf;
+  *inbuf = in;
+  *outbytesleft -= out - *outbuf;
+  *outbuf = out;
+}
+
+#endif /* ICONV_BULK_FROM_TABLE || ICONV_BULK_TO_TABLE */
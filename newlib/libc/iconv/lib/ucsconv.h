@@ -276,6 +276,9 @@ typedef struct
 
   /* UCS -> destination encoding CES converter. */
   iconv_from_ucs_ces_desc_t from_ucs;
+
+  /* Tables for converting whole buffers at once, or NULL. */
+  struct iconv_ucs_bulk *bulk;
 } iconv_ucs_conversion_t;
 
 
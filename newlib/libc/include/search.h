@@ -33,7 +33,11 @@ typedef enum {
 typedef struct node {
 	char         *key;
 	struct node  *llink, *rlink;
+	signed char   balance;	/* AVL: height(rlink) - height(llink) */
 } node_t;
+
+/* More than the height of any AVL tree which fits into memory. */
+#define	_TSEARCH_MAXDEPTH	128
 #endif
 
 struct hsearch_data
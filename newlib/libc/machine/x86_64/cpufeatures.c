@@ -0,0 +1,100 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* CPU feature detection for the x86_64 string functions.  The features are
+   determined on the first call of one of the functions.  Concurrent callers
+   may all run the detection, but they all store the same values. */
+
+#include <stdint.h>
+#include "string-vec.h"
+
+int __x86_64_cpu_features;
+
+/* memcpy, memmove and memset use non-temporal stores from this size on.
+   Larger blocks would evict most of the last level cache anyway. */
+size_t __x86_64_nt_threshold;
+
+#define DEFAULT_LLC_SIZE (4 << 20)
+
+/* Same as cpuid in winsup/cygwin/cpuid.h. */
+static inline void
+cpuid (uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d, uint32_t ain,
+       uint32_t cin)
+{
+  __asm__ volatile ("cpuid"
+		    : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+		    : "a" (ain), "c" (cin));
+}
+
+/* Return the size of the largest data cache, or 0 if unknown. */
+static size_t
+llc_size (uint32_t max_leaf)
+{
+  uint32_t a, b, c, d;
+  size_t size = 0;
+
+  /* Intel: deterministic cache parameters. */
+  if (max_leaf >= 4)
+    for (uint32_t i = 0; i < 16; ++i)
+      {
+	size_t s;
+
+	cpuid (&a, &b, &c, &d, 4, i);
+	if (!(a & 0x1f))
+	  break;
+	if ((a & 0x1f) == 2)	/* Instruction cache. */
+	  continue;
+	/* Ways * partitions * line size * sets. */
+	s = (size_t) ((b >> 22) + 1) * (((b >> 12) & 0x3ff) + 1)
+	    * ((b & 0xfff) + 1) * (c + 1);
+	if (s > size)
+	  size = s;
+      }
+  /* AMD: L3, or L2 if there's no L3. */
+  if (!size)
+    {
+      cpuid (&a, &b, &c, &d, 0x80000000, 0);
+      if (a >= 0x80000006)
+	{
+	  cpuid (&a, &b, &c, &d, 0x80000006, 0);
+	  size = (size_t) (d >> 18) * (512 << 10);
+	  if (!size)
+	    size = (size_t) (c >> 16) << 10;
+	}
+    }
+  return size;
+}
+
+int
+__x86_64_cpu_init (void)
+{
+  uint32_t a, b, c, d, xcr0, xcr0_hi, max_leaf;
+  int features = X86_64_CPU_INIT;
+  size_t llc;
+
+  cpuid (&max_leaf, &b, &c, &d, 0, 0);
+  llc = llc_size (max_leaf);
+  __x86_64_nt_threshold = (llc ?: DEFAULT_LLC_SIZE) / 4 * 3;
+  if (max_leaf >= 7)
+    {
+      cpuid (&a, &b, &c, &d, 1, 0);
+      /* OSXSAVE and AVX, and the OS saves the XMM and YMM state. */
+      if ((c & (1 << 27)) && (c & (1 << 28)))
+	{
+	  __asm__ volatile ("xgetbv" : "=a" (xcr0), "=d" (xcr0_hi) : "c" (0));
+	  if ((xcr0 & 6) == 6)
+	    {
+	      cpuid (&a, &b, &c, &d, 7, 0);
+	      if (b & (1 << 5))
+		features |= X86_64_CPU_AVX2;
+	    }
+	}
+    }
+  /* Store the features last, other threads may use the threshold as soon as
+     they see them. */
+  __asm__ volatile ("" ::: "memory");
+  __x86_64_cpu_features = features;
+  return features;
+}
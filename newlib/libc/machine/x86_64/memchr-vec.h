@@ -0,0 +1,70 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memchr template, see string-vec.h.  Only whole aligned vectors are
+   loaded, the bytes outside the buffer are masked out. */
+
+static VEC_ATTR void *
+VEC_FUNC (memchr) (const void *src, int c, size_t n)
+{
+  const char *s = (const char *) src;
+  const char *p = (const char *) ((uintptr_t) s & -VEC_SIZE);
+  size_t off = s - p;
+  VEC vc = vset1 ((char) c);
+  uint32_t mask;
+
+  if (!n)
+    return NULL;
+  mask = vmask (veq (vload (p), vc)) >> off;
+  if (n <= VEC_SIZE - off)
+    {
+      if (n < 32)
+	mask &= (1U << n) - 1;
+      return mask ? (void *) (s + __builtin_ctz (mask)) : NULL;
+    }
+  if (mask)
+    return (void *) (s + __builtin_ctz (mask));
+  /* Count the remaining bytes rather than computing the end of the buffer,
+     which may wrap around if N is SIZE_MAX. */
+  n -= VEC_SIZE - off;
+  p += VEC_SIZE;
+  /* Two vectors at a time from here, aligned to their combined size, so a
+     search through a too large buffer never faults after the match. */
+  if ((uintptr_t) p & VEC_SIZE && n >= VEC_SIZE)
+    {
+      mask = vmask (veq (vload (p), vc));
+      if (mask)
+	return (void *) (p + __builtin_ctz (mask));
+      n -= VEC_SIZE;
+      p += VEC_SIZE;
+    }
+  for (; n >= 2 * VEC_SIZE; n -= 2 * VEC_SIZE, p += 2 * VEC_SIZE)
+    {
+      VEC a = veq (vload (p), vc);
+      VEC b = veq (vload (p + VEC_SIZE), vc);
+
+      if (vmask (vor (a, b)))
+	{
+	  mask = vmask (a);
+	  if (mask)
+	    return (void *) (p + __builtin_ctz (mask));
+	  return (void *) (p + VEC_SIZE + __builtin_ctz (vmask (b)));
+	}
+    }
+  for (; n; p += VEC_SIZE)
+    {
+      mask = vmask (veq (vload (p), vc));
+      if (n < VEC_SIZE)
+	{
+	  mask &= (1U << n) - 1;
+	  n = 0;
+	}
+      else
+	n -= VEC_SIZE;
+      if (mask)
+	return (void *) (p + __builtin_ctz (mask));
+    }
+  return NULL;
+}
@@ -0,0 +1,27 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memchr for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/memchr.c"
+#else
+#include <string.h>
+#define VEC_SIZE 16
+#include "string-vec.h"
+#include "memchr-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "memchr-vec.h"
+
+void *
+memchr (const void *s, int c, size_t n)
+{
+  if (__x86_64_has_avx2 ())
+    return memchr_avx2 (s, c, n);
+  return memchr_sse2 (s, c, n);
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memcmp template, see string-vec.h.  The last vector is compared with an
+   overlapping load ending at the end of the buffers, which is cheaper than
+   handling the remaining bytes one by one. */
+
+static VEC_ATTR int
+VEC_FUNC (memcmp) (const void *m1, const void *m2, size_t n)
+{
+  const unsigned char *x = (const unsigned char *) m1;
+  const unsigned char *y = (const unsigned char *) m2;
+  uint32_t mask;
+  size_t i;
+
+  if (n < VEC_SIZE)
+    {
+#if VEC_SIZE == 32
+      if (n >= 16)
+	{
+	  __m128i a, b;
+
+	  a = _mm_loadu_si128 ((const __m128i *) x);
+	  b = _mm_loadu_si128 ((const __m128i *) y);
+	  mask = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b)) ^ 0xffff;
+	  if (!mask)
+	    {
+	      x += n - 16;
+	      y += n - 16;
+	      a = _mm_loadu_si128 ((const __m128i *) x);
+	      b = _mm_loadu_si128 ((const __m128i *) y);
+	      mask = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b))
+		     ^ 0xffff;
+	      if (!mask)
+		return 0;
+	    }
+	  i = __builtin_ctz (mask);
+	  return x[i] - y[i];
+	}
+#endif
+      return memcmp_small (x, y, n);
+    }
+  for (i = 0; i + VEC_SIZE <= n; i += VEC_SIZE)
+    {
+      mask = vmask (veq (vloadu (x + i), vloadu (y + i))) ^ VEC_MASK;
+      if (mask)
+	{
+	  i += __builtin_ctz (mask);
+	  return x[i] - y[i];
+	}
+    }
+  if (i < n)
+    {
+      i = n - VEC_SIZE;
+      mask = vmask (veq (vloadu (x + i), vloadu (y + i))) ^ VEC_MASK;
+      if (mask)
+	{
+	  i += __builtin_ctz (mask);
+	  return x[i] - y[i];
+	}
+    }
+  return 0;
+}
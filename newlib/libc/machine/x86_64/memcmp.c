@@ -0,0 +1,63 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memcmp for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/memcmp.c"
+#else
+#include <string.h>
+#define VEC_SIZE 16
+#include "string-vec.h"
+
+/* Compare N < 16 bytes.  Loading the words big-endian makes their order
+   the order of the bytes. */
+static inline int
+memcmp_small (const unsigned char *x, const unsigned char *y, size_t n)
+{
+  if (n >= 8)
+    {
+      uint64_t a = __builtin_bswap64 (*(const __x86_64_u64 *) x);
+      uint64_t b = __builtin_bswap64 (*(const __x86_64_u64 *) y);
+
+      if (a == b)
+	{
+	  a = __builtin_bswap64 (*(const __x86_64_u64 *) (x + n - 8));
+	  b = __builtin_bswap64 (*(const __x86_64_u64 *) (y + n - 8));
+	}
+      return a == b ? 0 : a < b ? -1 : 1;
+    }
+  if (n >= 4)
+    {
+      uint32_t a = __builtin_bswap32 (*(const __x86_64_u32 *) x);
+      uint32_t b = __builtin_bswap32 (*(const __x86_64_u32 *) y);
+
+      if (a == b)
+	{
+	  a = __builtin_bswap32 (*(const __x86_64_u32 *) (x + n - 4));
+	  b = __builtin_bswap32 (*(const __x86_64_u32 *) (y + n - 4));
+	}
+      return a == b ? 0 : a < b ? -1 : 1;
+    }
+  for (; n; --n, ++x, ++y)
+    if (*x != *y)
+      return *x - *y;
+  return 0;
+}
+
+#include "memcmp-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "memcmp-vec.h"
+
+int
+memcmp (const void *m1, const void *m2, size_t n)
+{
+  if (__x86_64_has_avx2 ())
+    return memcmp_avx2 (m1, m2, n);
+  return memcmp_sse2 (m1, m2, n);
+}
+#endif
@@ -0,0 +1,157 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memmove template, see string-vec.h.  memcpy uses it as well.
+
+   The copy is done in size tiers:
+
+   - Up to four vectors are copied with overlapping loads and stores, all
+     loads before all stores.
+   - Otherwise the first and the last vector are loaded up front and stored
+     at the very end, and the part in between is copied with aligned
+     stores, four vectors at a time, in the direction which never
+     overwrites source bytes before reading them.
+   - Copies of at least __x86_64_nt_threshold bytes between buffers which
+     don't overlap use non-temporal stores, so they don't evict the whole
+     cache.  The threshold depends on the size of the last level cache. */
+
+#ifndef _X86_64_MEMMOVE_SMALL
+#define _X86_64_MEMMOVE_SMALL
+
+/* Copy N < 16 bytes.  All loads happen before the stores, so the buffers
+   may overlap. */
+static inline void
+memmove_small (char *d, const char *s, size_t n)
+{
+  if (n >= 8)
+    {
+      uint64_t a = *(const __x86_64_u64 *) s;
+      uint64_t b = *(const __x86_64_u64 *) (s + n - 8);
+
+      *(__x86_64_u64 *) d = a;
+      *(__x86_64_u64 *) (d + n - 8) = b;
+    }
+  else if (n >= 4)
+    {
+      uint32_t a = *(const __x86_64_u32 *) s;
+      uint32_t b = *(const __x86_64_u32 *) (s + n - 4);
+
+      *(__x86_64_u32 *) d = a;
+      *(__x86_64_u32 *) (d + n - 4) = b;
+    }
+  else if (n >= 2)
+    {
+      uint16_t a = *(const __x86_64_u16 *) s;
+      uint16_t b = *(const __x86_64_u16 *) (s + n - 2);
+
+      *(__x86_64_u16 *) d = a;
+      *(__x86_64_u16 *) (d + n - 2) = b;
+    }
+  else if (n)
+    *d = *s;
+}
+
+#endif
+
+static VEC_ATTR __inhibit_loop_to_libcall void *
+VEC_FUNC (memmove) (void *dst, const void *src, size_t n)
+{
+  char *d = (char *) dst;
+  const char *s = (const char *) src;
+  VEC head, tail;
+  char *p, *end;
+
+  if (n < VEC_SIZE)
+    {
+#if VEC_SIZE == 32
+      if (n >= 16)
+	{
+	  __m128i a = _mm_loadu_si128 ((const __m128i *) s);
+	  __m128i b = _mm_loadu_si128 ((const __m128i *) (s + n - 16));
+
+	  _mm_storeu_si128 ((__m128i *) d, a);
+	  _mm_storeu_si128 ((__m128i *) (d + n - 16), b);
+	  return dst;
+	}
+#endif
+      memmove_small (d, s, n);
+      return dst;
+    }
+  head = vloadu (s);
+  tail = vloadu (s + n - VEC_SIZE);
+  if (n <= 2 * VEC_SIZE)
+    ;
+  else if (n <= 4 * VEC_SIZE)
+    {
+      VEC a = vloadu (s + VEC_SIZE);
+      VEC b = vloadu (s + n - 2 * VEC_SIZE);
+
+      vstoreu (d + VEC_SIZE, a);
+      vstoreu (d + n - 2 * VEC_SIZE, b);
+    }
+  else if ((uintptr_t) d - (uintptr_t) s >= n)
+    {
+      /* Forward, DST is below SRC or they don't overlap.  The last vector
+	 from END on is TAIL. */
+      p = (char *) (((uintptr_t) d + VEC_SIZE) & -VEC_SIZE);
+      end = d + n - VEC_SIZE;
+      if (n >= __x86_64_nt_threshold && (uintptr_t) s - (uintptr_t) d >= n)
+	{
+	  for (; end - p >= 4 * VEC_SIZE; p += 4 * VEC_SIZE)
+	    {
+	      const char *q = s + (p - d);
+	      VEC a = vloadu (q);
+	      VEC b = vloadu (q + VEC_SIZE);
+	      VEC c = vloadu (q + 2 * VEC_SIZE);
+	      VEC e = vloadu (q + 3 * VEC_SIZE);
+
+	      vstream (p, a);
+	      vstream (p + VEC_SIZE, b);
+	      vstream (p + 2 * VEC_SIZE, c);
+	      vstream (p + 3 * VEC_SIZE, e);
+	    }
+	  _mm_sfence ();
+	}
+      for (; end - p >= 4 * VEC_SIZE; p += 4 * VEC_SIZE)
+	{
+	  const char *q = s + (p - d);
+	  VEC a = vloadu (q);
+	  VEC b = vloadu (q + VEC_SIZE);
+	  VEC c = vloadu (q + 2 * VEC_SIZE);
+	  VEC e = vloadu (q + 3 * VEC_SIZE);
+
+	  vstore (p, a);
+	  vstore (p + VEC_SIZE, b);
+	  vstore (p + 2 * VEC_SIZE, c);
+	  vstore (p + 3 * VEC_SIZE, e);
+	}
+      for (; p < end; p += VEC_SIZE)
+	vstore (p, vloadu (s + (p - d)));
+    }
+  else
+    {
+      /* Backward, DST is inside SRC.  The vectors are stored below P, the
+	 first vector up to D + VEC_SIZE is HEAD. */
+      p = (char *) ((uintptr_t) (d + n) & -VEC_SIZE);
+      for (; p - d > 4 * VEC_SIZE; p -= 4 * VEC_SIZE)
+	{
+	  const char *q = s + (p - d);
+	  VEC a = vloadu (q - VEC_SIZE);
+	  VEC b = vloadu (q - 2 * VEC_SIZE);
+	  VEC c = vloadu (q - 3 * VEC_SIZE);
+	  VEC e = vloadu (q - 4 * VEC_SIZE);
+
+	  vstore (p - VEC_SIZE, a);
+	  vstore (p - 2 * VEC_SIZE, b);
+	  vstore (p - 3 * VEC_SIZE, c);
+	  vstore (p - 4 * VEC_SIZE, e);
+	}
+      for (; p - d > VEC_SIZE; p -= VEC_SIZE)
+	vstore (p - VEC_SIZE, vloadu (s + (p - d) - VEC_SIZE));
+    }
+  vstoreu (d, head);
+  vstoreu (d + n - VEC_SIZE, tail);
+  return dst;
+}
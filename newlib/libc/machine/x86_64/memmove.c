@@ -0,0 +1,28 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memmove for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/memmove.c"
+#else
+#include <string.h>
+#include "../../string/local.h"
+#define VEC_SIZE 16
+#include "string-vec.h"
+#include "memmove-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "memmove-vec.h"
+
+void *
+memmove (void *dst, const void *src, size_t n)
+{
+  if (__x86_64_has_avx2 ())
+    return memmove_avx2 (dst, src, n);
+  return memmove_sse2 (dst, src, n);
+}
+#endif
@@ -0,0 +1,34 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memrchr template, see string-vec.h.  Only whole aligned vectors are
+   loaded, the bytes outside the buffer are masked out. */
+
+static VEC_ATTR void *
+VEC_FUNC (memrchr) (const void *src, int c, size_t n)
+{
+  const char *s = (const char *) src;
+  const char *last = s + n - 1;
+  const char *p = (const char *) ((uintptr_t) last & -VEC_SIZE);
+  VEC vc = vset1 ((char) c);
+  uint32_t mask;
+
+  if (!n)
+    return NULL;
+  /* Bits 0 to LAST - P.  2U << 31 is 0, so this works for a full mask. */
+  mask = vmask (veq (vload (p), vc)) & ((2U << (last - p)) - 1);
+  for (;;)
+    {
+      if (p <= s)
+	{
+	  mask &= ~0U << (s - p);
+	  return mask ? (void *) (p + 31 - __builtin_clz (mask)) : NULL;
+	}
+      if (mask)
+	return (void *) (p + 31 - __builtin_clz (mask));
+      p -= VEC_SIZE;
+      mask = vmask (veq (vload (p), vc));
+    }
+}
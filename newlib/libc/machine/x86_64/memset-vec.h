@@ -0,0 +1,94 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memset template, see string-vec.h.
+
+   Like memmove, memset works in size tiers: up to two vectors are set with
+   two overlapping stores, larger blocks with unaligned stores of the first
+   and last vector and aligned stores, four vectors at a time, in between.
+   Blocks of at least __x86_64_nt_threshold bytes are set with non-temporal
+   stores. */
+
+#ifndef _X86_64_MEMSET_SMALL
+#define _X86_64_MEMSET_SMALL
+
+/* Set N < 16 bytes with two overlapping stores. */
+static inline void
+memset_small (char *d, int c, size_t n)
+{
+  uint64_t v = 0x0101010101010101ULL * (unsigned char) c;
+
+  if (n >= 8)
+    {
+      *(__x86_64_u64 *) d = v;
+      *(__x86_64_u64 *) (d + n - 8) = v;
+    }
+  else if (n >= 4)
+    {
+      *(__x86_64_u32 *) d = (uint32_t) v;
+      *(__x86_64_u32 *) (d + n - 4) = (uint32_t) v;
+    }
+  else if (n >= 2)
+    {
+      *(__x86_64_u16 *) d = (uint16_t) v;
+      *(__x86_64_u16 *) (d + n - 2) = (uint16_t) v;
+    }
+  else if (n)
+    *d = (char) c;
+}
+
+#endif
+
+static VEC_ATTR __inhibit_loop_to_libcall void *
+VEC_FUNC (memset) (void *dst, int c, size_t n)
+{
+  char *d = (char *) dst;
+  char *p, *end;
+  VEC v;
+
+  if (n < VEC_SIZE)
+    {
+#if VEC_SIZE == 32
+      if (n >= 16)
+	{
+	  __m128i x = _mm_set1_epi8 ((char) c);
+
+	  _mm_storeu_si128 ((__m128i *) d, x);
+	  _mm_storeu_si128 ((__m128i *) (d + n - 16), x);
+	  return dst;
+	}
+#endif
+      memset_small (d, c, n);
+      return dst;
+    }
+  v = vset1 ((char) c);
+  vstoreu (d, v);
+  vstoreu (d + n - VEC_SIZE, v);
+  if (n <= 2 * VEC_SIZE)
+    return dst;
+  p = (char *) (((uintptr_t) d + VEC_SIZE) & -VEC_SIZE);
+  end = d + n - VEC_SIZE;
+  if (n >= __x86_64_nt_threshold)
+    {
+      for (; end - p >= 4 * VEC_SIZE; p += 4 * VEC_SIZE)
+	{
+	  vstream (p, v);
+	  vstream (p + VEC_SIZE, v);
+	  vstream (p + 2 * VEC_SIZE, v);
+	  vstream (p + 3 * VEC_SIZE, v);
+	}
+      _mm_sfence ();
+    }
+  for (; end - p >= 4 * VEC_SIZE; p += 4 * VEC_SIZE)
+    {
+      vstore (p, v);
+      vstore (p + VEC_SIZE, v);
+      vstore (p + 2 * VEC_SIZE, v);
+      vstore (p + 3 * VEC_SIZE, v);
+    }
+  for (; p < end; p += VEC_SIZE)
+    vstore (p, v);
+  return dst;
+}
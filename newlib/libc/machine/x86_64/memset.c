@@ -0,0 +1,28 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* memset for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/memset.c"
+#else
+#include <string.h>
+#include "../../string/local.h"
+#define VEC_SIZE 16
+#include "string-vec.h"
+#include "memset-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "memset-vec.h"
+
+void *
+memset (void *dst, int c, size_t n)
+{
+  if (__x86_64_has_avx2 ())
+    return memset_avx2 (dst, c, n);
+  return memset_sse2 (dst, c, n);
+}
+#endif
@@ -0,0 +1,40 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* rawmemchr template, see string-vec.h. */
+
+static VEC_ATTR void *
+VEC_FUNC (rawmemchr) (const void *src, int c)
+{
+  const char *s = (const char *) src;
+  const char *p = (const char *) ((uintptr_t) s & -VEC_SIZE);
+  VEC vc = vset1 ((char) c);
+  uint32_t mask;
+
+  mask = vmask (veq (vload (p), vc)) >> (s - p);
+  if (mask)
+    return (void *) (s + __builtin_ctz (mask));
+  p += VEC_SIZE;
+  if ((uintptr_t) p & VEC_SIZE)
+    {
+      mask = vmask (veq (vload (p), vc));
+      if (mask)
+	return (void *) (p + __builtin_ctz (mask));
+      p += VEC_SIZE;
+    }
+  for (;; p += 2 * VEC_SIZE)
+    {
+      VEC a = veq (vload (p), vc);
+      VEC b = veq (vload (p + VEC_SIZE), vc);
+
+      if (vmask (vor (a, b)))
+	{
+	  mask = vmask (a);
+	  if (mask)
+	    return (void *) (p + __builtin_ctz (mask));
+	  return (void *) (p + VEC_SIZE + __builtin_ctz (vmask (b)));
+	}
+    }
+}
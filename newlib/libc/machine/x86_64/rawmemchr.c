@@ -0,0 +1,27 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* rawmemchr for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/rawmemchr.c"
+#else
+#include <string.h>
+#define VEC_SIZE 16
+#include "string-vec.h"
+#include "rawmemchr-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "rawmemchr-vec.h"
+
+void *
+rawmemchr (const void *s, int c)
+{
+  if (__x86_64_has_avx2 ())
+    return rawmemchr_avx2 (s, c);
+  return rawmemchr_sse2 (s, c);
+}
+#endif
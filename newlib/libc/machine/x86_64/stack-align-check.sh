@@ -0,0 +1,19 @@
+#!/bin/sh
+# Fail if any of the given objects accesses a 256 bit vector on the stack
+# with an aligned move.  64 bit Windows only guarantees 16 byte stack
+# alignment, so such a move faults whenever GCC spills an AVX2 register.
+#
+# Usage: stack-align-check.sh OBJDUMP OBJECT...
+
+objdump="$1"
+shift
+
+$objdump -d "$@" > stack-align-check.lst || exit 1
+if grep -E 'vmov(dqa|dqa32|dqa64|aps|apd)[[:space:]].*(%ymm.*\(%r[sb]p\)|\(%r[sb]p\).*%ymm)' \
+     stack-align-check.lst >&2; then
+  echo "$0: aligned 256 bit stack access in $*" >&2
+  rm -f stack-align-check.lst
+  exit 1
+fi
+rm -f stack-align-check.lst
+exit 0
@@ -0,0 +1,55 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* strchr template, see string-vec.h.
+
+   A byte of V is either C or NUL if the minimum of V and V ^ C is zero. */
+
+static VEC_ATTR char *
+VEC_FUNC (strchr) (const char *s, int c)
+{
+  const char *p = (const char *) ((uintptr_t) s & -VEC_SIZE);
+  VEC zero = vzero ();
+  VEC vc = vset1 ((char) c);
+  VEC v;
+  uint32_t mask;
+
+  v = vload (p);
+  mask = vmask (veq (vmin (v, vxor (v, vc)), zero)) >> (s - p);
+  if (mask)
+    {
+      p = s + __builtin_ctz (mask);
+      return *p == (char) c ? (char *) p : NULL;
+    }
+  p += VEC_SIZE;
+  if ((uintptr_t) p & VEC_SIZE)
+    {
+      v = vload (p);
+      mask = vmask (veq (vmin (v, vxor (v, vc)), zero));
+      if (mask)
+	{
+	  p += __builtin_ctz (mask);
+	  return *p == (char) c ? (char *) p : NULL;
+	}
+      p += VEC_SIZE;
+    }
+  for (;; p += 2 * VEC_SIZE)
+    {
+      VEC a = vload (p);
+      VEC b = vload (p + VEC_SIZE);
+
+      a = vmin (a, vxor (a, vc));
+      b = vmin (b, vxor (b, vc));
+      if (vmask (veq (vmin (a, b), zero)))
+	{
+	  mask = vmask (veq (a, zero));
+	  if (mask)
+	    p += __builtin_ctz (mask);
+	  else
+	    p += VEC_SIZE + __builtin_ctz (vmask (veq (b, zero)));
+	  return *p == (char) c ? (char *) p : NULL;
+	}
+    }
+}
@@ -0,0 +1,27 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* strchr for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/strchr.c"
+#else
+#include <string.h>
+#define VEC_SIZE 16
+#include "string-vec.h"
+#include "strchr-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "strchr-vec.h"
+
+char *
+strchr (const char *s, int c)
+{
+  if (__x86_64_has_avx2 ())
+    return strchr_avx2 (s, c);
+  return strchr_sse2 (s, c);
+}
+#endif
@@ -0,0 +1,47 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* strcmp template, see string-vec.h.
+
+   The strings are compared with unaligned loads, unless one of them would
+   cross a page boundary, which might fault behind the end of the string.
+   Those VEC_SIZE bytes are compared one by one.
+
+   The comparison of two vectors A and B is zero where they differ, the
+   minimum of that and A is zero where they differ or A has a NUL. */
+
+#define STRCMP_PAGE_SIZE 4096
+
+static VEC_ATTR int
+VEC_FUNC (strcmp) (const char *s1, const char *s2)
+{
+  const unsigned char *x = (const unsigned char *) s1;
+  const unsigned char *y = (const unsigned char *) s2;
+  VEC zero = vzero ();
+  uint32_t mask;
+
+  for (;; x += VEC_SIZE, y += VEC_SIZE)
+    {
+      if (((uintptr_t) x & (STRCMP_PAGE_SIZE - 1)) > STRCMP_PAGE_SIZE - VEC_SIZE
+	  || ((uintptr_t) y & (STRCMP_PAGE_SIZE - 1))
+	     > STRCMP_PAGE_SIZE - VEC_SIZE)
+	{
+	  for (int i = 0; i < VEC_SIZE; ++i)
+	    if (x[i] != y[i] || !x[i])
+	      return x[i] - y[i];
+	  continue;
+	}
+
+      VEC a = vloadu (x);
+      VEC b = vloadu (y);
+
+      mask = vmask (veq (vmin (a, veq (a, b)), zero));
+      if (mask)
+	{
+	  unsigned i = __builtin_ctz (mask);
+	  return x[i] - y[i];
+	}
+    }
+}
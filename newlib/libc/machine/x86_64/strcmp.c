@@ -0,0 +1,27 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* strcmp for x86_64, see string-vec.h. */
+
+#if defined (__OPTIMIZE_SIZE__) || defined (PREFER_SIZE_OVER_SPEED)
+# include "../../string/strcmp.c"
+#else
+#include <string.h>
+#define VEC_SIZE 16
+#include "string-vec.h"
+#include "strcmp-vec.h"
+#undef VEC_SIZE
+#define VEC_SIZE 32
+#include "string-vec.h"
+#include "strcmp-vec.h"
+
+int
+strcmp (const char *s1, const char *s2)
+{
+  if (__x86_64_has_avx2 ())
+    return strcmp_avx2 (s1, s2);
+  return strcmp_sse2 (s1, s2);
+}
+#endif
@@ -0,0 +1,111 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* Vector primitives for the x86_64 string functions.
+
+   Every function comes in an SSE2 and an AVX2 flavour, generated from the
+   same template, FUNC-vec.h.  FUNC.c includes this file and the template
+   once with VEC_SIZE defined to 16 and once with VEC_SIZE defined to 32,
+   and picks one of the two at runtime.  SSE2 is always available on
+   x86_64, AVX2 is used if both the CPU and the OS support it.
+
+   Aligned loads never cross a page boundary, so the functions looking for
+   a terminating byte may read the whole aligned vector containing it.  The
+   functions with an explicit length only use unaligned loads within the
+   buffers.
+
+   64 bit Windows only aligns the stack to 16 bytes, but GCC spills 256 bit
+   registers with vmovdqa (GCC PR 54412), certainly with -O0 and -Og.  These
+   files are therefore built with -Wa,-muse-unaligned-vector-move, and
+   stack-align-check.sh fails the build if an aligned 256 bit stack access
+   makes it into an object anyway. */
+
+#ifndef _X86_64_STRING_VEC_H
+#define _X86_64_STRING_VEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#define X86_64_CPU_INIT		1	/* __x86_64_cpu_features is valid. */
+#define X86_64_CPU_AVX2		2
+
+extern int __x86_64_cpu_features;
+extern size_t __x86_64_nt_threshold;
+extern int __x86_64_cpu_init (void);
+
+static inline int
+__x86_64_has_avx2 (void)
+{
+  int features = __x86_64_cpu_features;
+
+  if (!features)
+    features = __x86_64_cpu_init ();
+  return features & X86_64_CPU_AVX2;
+}
+
+/* Unaligned scalar access. */
+typedef uint64_t __x86_64_u64 __attribute__ ((aligned (1), may_alias));
+typedef uint32_t __x86_64_u32 __attribute__ ((aligned (1), may_alias));
+typedef uint16_t __x86_64_u16 __attribute__ ((aligned (1), may_alias));
+
+#endif /* _X86_64_STRING_VEC_H */
+
+#ifdef VEC_SIZE
+#undef VEC
+#undef VEC_ATTR
+#undef VEC_FUNC
+#undef VEC_MASK
+#undef vload
+#undef vloadu
+#undef vstore
+#undef vstoreu
+#undef vstream
+#undef vset1
+#undef vzero
+#undef veq
+#undef vmin
+#undef vor
+#undef vxor
+#undef vmask
+
+#if VEC_SIZE == 16
+# define VEC		__m128i
+# define VEC_ATTR
+# define VEC_FUNC(name)	name##_sse2
+# define VEC_MASK	0xffffU
+# define vload(p)	_mm_load_si128 ((const __m128i *) (p))
+# define vloadu(p)	_mm_loadu_si128 ((const __m128i *) (p))
+# define vstore(p, v)	_mm_store_si128 ((__m128i *) (p), (v))
+# define vstoreu(p, v)	_mm_storeu_si128 ((__m128i *) (p), (v))
+# define vstream(p, v)	_mm_stream_si128 ((__m128i *) (p), (v))
+# define vset1(c)	_mm_set1_epi8 (c)
+# define vzero()	_mm_setzero_si128 ()
+# define veq(a, b)	_mm_cmpeq_epi8 ((a), (b))
+# define vmin(a, b)	_mm_min_epu8 ((a), (b))
+# define vor(a, b)	_mm_or_si128 ((a), (b))
+# define vxor(a, b)	_mm_xor_si128 ((a), (b))
+# define vmask(v)	((uint32_t) _mm_movemask_epi8 (v))
+#elif VEC_SIZE == 32
+# define VEC		__m256i
+# define VEC_ATTR	__attribute__ ((target ("avx2")))
+# define VEC_FUNC(name)	name##_avx2
+# define VEC_MASK	0xffffffffU
+# define vload(p)	_mm256_load_si256 ((const __m256i *) (p))
+# define vloadu(p)	_mm256_loadu_si256 ((const __m256i *) (p))
+# define vstore(p, v)	_mm256_store_si256 ((__m256i *) (p), (v))
+# define vstoreu(p, v)	_mm256_storeu_si256 ((__m256i *) (p), (v))
+# define vstream(p, v)	_mm256_stream_si256 ((__m256i *) (p), (v))
+# define vset1(c)	_mm256_set1_epi8 (c)
+# define vzero()	_mm256_setzero_si256 ()
+# define veq(a, b)	_mm256_cmpeq_epi8 ((a), (b))
+# define vmin(a, b)	_mm256_min_epu8 ((a), (b))
+# define vor(a, b)	_mm256_or_si256 ((a), (b))
+# define vxor(a, b)	_mm256_xor_si256 ((a), (b))
+# define vmask(v)	((uint32_t) _mm256_movemask_epi8 (v))
+#else
+# error VEC_SIZE must be 16 or 32
+#endif
+#endif /* VEC_SIZE */
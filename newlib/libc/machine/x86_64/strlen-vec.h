@@ -0,0 +1,42 @@
+/*
+ ** This file is distributed WITHOUT ANY WARRANTY; without even the implied
+ ** warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* strlen template, see string-vec.h. */
+
+static VEC_ATTR size_t
+VEC_FUNC (strlen) (const char *s)
+{
+  const char *p = (const char *) ((uintptr_t) s & -VEC_SIZE);
+  VEC zero = vzero ();
+  uint32_t mask;
+
+  mask = vmask (veq (vload (p), zero)) >> (s - p);
+  if (mask)
+    return __builtin_ctz (mask);
+  p += VEC_SIZE;
+  if ((uintptr_t) p & VEC_SIZE)
+    {
+      mask = vmask (veq (vload (p), zero));
+      if (mask)
+	return p - s + __builtin_ctz (mask);
+      p += VEC_SIZE;
+    }
+  /* Two vectors at a time.  Their minimum has a zero byte if either of them
+     has one. */
+  for (;; p += 2 * VEC_SIZE)
+    {
+      VEC a = vload (p);
+      VEC b = vload (p + VEC_SIZE);
+
+      if (vmask (veq (vmin (a, b), zero)))
+	{
+	  mask = vmask (veq (a, zero));
+	  if (mask)
+	    return p - s + __builtin_ctz (mask);
+	  mask = vmask (veq (b, zero));
+	  return p + VEC_SIZE - s + __builtin_ctz (mask);
+	}
+    }
+}
@@ -235,6 +235,20 @@ int eflags;
 	if (g->moffset > -1)
 		start = ((dp - g->moffset) < start) ? start : dp - g->moffset;
 
+	/* every match starts with the prefix, so skip to the first one */
+	if (g->prefix != NULL) {
+		for (; (dp = memchr(start, g->prefix[0], stop - start)) != NULL;
+		    start = dp + 1)
+			if (stop - dp >= g->plen &&
+			    memcmp(dp, g->prefix, (size_t)g->plen) == 0)
+				break;
+		if (dp == NULL) {
+			STATETEARDOWN(m);
+			return(REG_NOMATCH);
+		}
+		start = dp;
+	}
+
 	/* this loop does only one repetition except for backrefs */
 	for (;;) {
 		endp = fast(m, start, stop, gf, gl);
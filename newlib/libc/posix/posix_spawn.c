@@ -254,6 +254,118 @@ process_file_actions(const posix_spawn_file_actions_t fa)
 	return (0);
 }
 
+#ifdef __CYGWIN__
+/*
+ * vfork is a full fork on Cygwin, so start the new process directly, see
+ * __posix_spawn_native in winsup/cygwin/spawn.cc.  Returns ENOSYS if that
+ * can't do what the attributes ask for.
+ */
+extern int __posix_spawn_native(pid_t *, const char *, int, const int *,
+	int, int, short, pid_t, const sigset_t *, const sigset_t *,
+	char * const [], char * const []);
+
+static int
+cygwin_posix_spawn(pid_t *pid, const char *path,
+	const posix_spawn_file_actions_t *fa,
+	const posix_spawnattr_t *sa,
+	char * const argv[], char * const envp[], int use_env_path)
+{
+	posix_spawn_file_actions_entry_t *fae;
+	int *fdactions = NULL;
+	int n = 0, i = 0, maxfd = -1, fd, cttyfd = -1, error = 0;
+
+	/* Scheduling and dropping privileges are left to the child */
+	if (sa != NULL && (((*sa)->sa_flags &
+	    (POSIX_SPAWN_SETSCHEDPARAM | POSIX_SPAWN_SETSCHEDULER)) ||
+	    (((*sa)->sa_flags & POSIX_SPAWN_RESETIDS) &&
+	    (geteuid() != getuid() || getegid() != getgid()))))
+		return (ENOSYS);
+
+	if (fa != NULL) {
+		STAILQ_FOREACH(fae, &(*fa)->fa_list, fae_list) {
+			n++;
+			if (fae->fae_fildes > maxfd)
+				maxfd = fae->fae_fildes;
+			if (fae->fae_action == FAE_DUP2 &&
+			    fae->fae_newfildes > maxfd)
+				maxfd = fae->fae_newfildes;
+		}
+	}
+	if (n > 0) {
+		fdactions = malloc(2 * n * sizeof(int));
+		if (fdactions == NULL)
+			return (errno);
+	}
+
+	/*
+	 * Pass the file actions as pairs of fds: dup2 for opens and dup2,
+	 * -1 as the second one for close.  Open the files right now,
+	 * close-on-exec and above all fds the actions use.  Not as our
+	 * controlling tty, the child makes the first tty opened without
+	 * O_NOCTTY its own instead, as the open would have done there.
+	 */
+	if (fa != NULL) {
+		STAILQ_FOREACH(fae, &(*fa)->fa_list, fae_list) {
+			switch (fae->fae_action) {
+			case FAE_OPEN:
+				fd = _open(fae->fae_path,
+				    fae->fae_oflag | O_CLOEXEC | O_NOCTTY,
+				    fae->fae_mode);
+				if (fd >= 0 && fd <= maxfd) {
+					error = _fcntl(fd, F_DUPFD_CLOEXEC,
+					    maxfd + 1);
+					_close(fd);
+					fd = error;
+					error = 0;
+				}
+				if (fd < 0) {
+					error = errno;
+					goto out;
+				}
+				if (cttyfd < 0 && !(fae->fae_oflag & O_NOCTTY) &&
+				    isatty(fd))
+					cttyfd = fd;
+				fdactions[2 * i] = fd;
+				fdactions[2 * i + 1] = fae->fae_fildes;
+				break;
+			case FAE_DUP2:
+				fdactions[2 * i] = fae->fae_fildes;
+				fdactions[2 * i + 1] = fae->fae_newfildes;
+				break;
+			case FAE_CLOSE:
+				fdactions[2 * i] = fae->fae_fildes;
+				fdactions[2 * i + 1] = -1;
+				break;
+			}
+			i++;
+		}
+	}
+
+	error = __posix_spawn_native(pid, path, use_env_path, fdactions, n,
+	    cttyfd, sa != NULL ? (*sa)->sa_flags : 0,
+	    sa != NULL ? (*sa)->sa_pgroup : 0,
+	    sa != NULL ? &(*sa)->sa_sigmask : NULL,
+	    sa != NULL ? &(*sa)->sa_sigdefault : NULL,
+	    argv, envp);
+
+out:
+	/* Close the files opened above, the first i entries */
+	if (fa != NULL) {
+		n = i;
+		i = 0;
+		STAILQ_FOREACH(fae, &(*fa)->fa_list, fae_list) {
+			if (i >= n)
+				break;
+			if (fae->fae_action == FAE_OPEN)
+				_close(fdactions[2 * i]);
+			i++;
+		}
+	}
+	free(fdactions);
+	return (error);
+}
+#endif /* __CYGWIN__ */
+
 static int
 do_posix_spawn(pid_t *pid, const char *path,
 	const posix_spawn_file_actions_t *fa,
@@ -263,6 +375,14 @@ do_posix_spawn(pid_t *pid, const char *path,
 	pid_t p;
 	volatile int error = 0;
 
+#ifdef __CYGWIN__
+	error = cygwin_posix_spawn(pid, path, fa, sa, argv, envp,
+	    use_env_path);
+	if (error != ENOSYS)
+		return (error);
+	error = 0;
+#endif
+
 	p = vfork();
 	switch (p) {
 	case -1:
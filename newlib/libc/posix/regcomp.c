@@ -121,6 +121,7 @@ static void dofwd(struct parse *p, sopno pos, sop value);
 static void enlarge(struct parse *p, sopno size);
 static void stripsnug(struct parse *p, struct re_guts *g);
 static void findmust(struct parse *p, struct re_guts *g);
+static void findprefix(struct parse *p, struct re_guts *g);
 static int altoffset(sop *scan, int offset, int mccs);
 static void computejumps(struct parse *p, struct re_guts *g);
 static void computematchjumps(struct parse *p, struct re_guts *g);
@@ -248,6 +249,8 @@ int cflags;
 	g->charjump = NULL;
 	g->matchjump = NULL;
 	g->mlen = 0;
+	g->prefix = NULL;
+	g->plen = 0;
 	g->nsub = 0;
 	g->ncategories = 1;	/* category 0 is "everything else" */
 	g->categories = &g->catspace[-(CHAR_MIN)];
@@ -270,6 +273,7 @@ int cflags;
 	categorize(p, g);
 	stripsnug(p, g);
 	findmust(p, g);
+	findprefix(p, g);
 	/* only use Boyer-Moore algorithm if the pattern is bigger
 	 * than three characters
 	 */
@@ -1844,6 +1848,48 @@ struct re_guts *g;
 	*cp++ = '\0';		/* just on general principles */
 }
 
+/*
+ - findprefix - fill in prefix and plen with the literal string every match
+ - starts with
+ == static void findprefix(struct parse *p, struct re_guts *g);
+ *
+ * regexec() skips to the places where it occurs.  Parens and anchors don't
+ * match anything, and the body of a + loop is matched at least once, so we
+ * look through those.
+ */
+static void
+findprefix(p, g)
+struct parse *p;
+struct re_guts *g;
+{
+	sop *scan;
+	sop s;
+	char buf[256];
+	int len = 0;
+
+	if (p->error != 0)
+		return;
+
+	for (scan = g->strip + 1; len < sizeof(buf); scan++) {
+		s = *scan;
+		if (OP(s) == OCHAR)
+			buf[len++] = (char)OPND(s);
+		else if (OP(s) != OLPAREN && OP(s) != ORPAREN &&
+		    OP(s) != OPLUS_ && OP(s) != OBOL && OP(s) != OEOL &&
+		    OP(s) != OBOW && OP(s) != OEOW)
+			break;
+	}
+	if (len == 0)
+		return;
+
+	g->prefix = malloc(len + 1);
+	if (g->prefix == NULL)		/* just forget it */
+		return;
+	memcpy(g->prefix, buf, len);
+	g->prefix[len] = '\0';
+	g->plen = len;
+}
+
 /*
  - altoffset - choose biggest offset among multiple choices
  == static int altoffset(sop *scan, int offset, int mccs);
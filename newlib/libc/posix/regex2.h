@@ -161,6 +161,8 @@ struct re_guts {
 	int *charjump;		/* Boyer-Moore char jump table */
 	int *matchjump;		/* Boyer-Moore match jump table */
 	int mlen;		/* length of must */
+	char *prefix;		/* every match starts with this string */
+	int plen;		/* length of prefix */
 	size_t nsub;		/* copy of re_nsub */
 	int backrefs;		/* does it use back references? */
 	sopno nplus;		/* how deep does it nest +s? */
@@ -76,6 +76,8 @@ regex_t *preg;
 		free((char *)g->setbits);
 	if (g->must != NULL)
 		free(g->must);
+	if (g->prefix != NULL)
+		free(g->prefix);
 	if (g->charjump != NULL)
 		free(&g->charjump[CHAR_MIN]);
 	if (g->matchjump != NULL)
@@ -52,8 +52,12 @@ _reclaim_reent (struct _reent *ptr)
 #endif
       if (_REENT_MP_FREELIST(ptr))
 	{
+	  /* The Bigints Balloc allocated together with the freelists end
+	     where the entry after the last freelist points to. */
+	  char *seed = (char *) _REENT_MP_FREELIST(ptr);
+	  char *seed_end = (char *) _REENT_MP_FREELIST(ptr)[_Kmax + 1];
 	  int i;
-	  for (i = 0; i < _Kmax; i++) 
+	  for (i = 0; i <= _Kmax; i++) 
 	    {
 	      struct _Bigint *thisone, *nextone;
 	
@@ -62,14 +66,18 @@ _reclaim_reent (struct _reent *ptr)
 		{
 		  thisone = nextone;
 		  nextone = nextone->_next;
-		  _free_r (ptr, thisone);
+		  if ((char *) thisone < seed || (char *) thisone >= seed_end)
+		    _free_r (ptr, thisone);
 		}
 	    }    
+	  /* So may be the result of dtoa, which isn't on a freelist. */
+	  if (_REENT_MP_RESULT(ptr)
+	      && ((char *) _REENT_MP_RESULT(ptr) < seed
+		  || (char *) _REENT_MP_RESULT(ptr) >= seed_end))
+	    _free_r (ptr, _REENT_MP_RESULT(ptr));
 
 	  _free_r (ptr, _REENT_MP_FREELIST(ptr));
 	}
-      if (_REENT_MP_RESULT(ptr))
-	_free_r (ptr, _REENT_MP_RESULT(ptr));
 #ifdef _REENT_SMALL
       }
 #endif
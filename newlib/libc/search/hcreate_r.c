@@ -49,40 +49,190 @@ __RCSID("$NetBSD: hcreate.c,v 1.2 2001/02/19 21:26:04 ross Exp $");
 #endif
 
 #include <sys/types.h>
-#include <sys/queue.h>
 #include <errno.h>
 #include <search.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 /*
- * DO NOT MAKE THIS STRUCTURE LARGER THAN 32 BYTES (4 ptrs on 64-bit
- * ptr machine) without adjusting MAX_BUCKETS_LG2 below.
+ * The table is an open addressing hash table in the style of Google's
+ * Swiss tables.  Besides the array of slots there's an array of control
+ * bytes, one per slot, which is 0x80 for an empty slot, or the low 7 bits
+ * of the hash of the key in the slot.  The slots are probed in groups of
+ * GROUP_WIDTH, whose control bytes are loaded as one word and compared
+ * with the hash bits all at once, so usually only the slot holding the
+ * key has to be looked at.  Since hsearch can't delete entries, there are
+ * no tombstones, and the first group with an empty slot ends a search.
+ *
+ * The table doubles in size whenever it gets more than 7/8 full, so nel
+ * is only a hint.  hsearch returns pointers to the entries, which must
+ * stay valid, so the slots only point to the entries, which are allocated
+ * in blocks that are never moved.
+ */
+#define	GROUP_WIDTH	8
+#define	CTRL_EMPTY	0x80
+#define	MIN_SLOTS	16
+
+/*
+ * max * (sizeof slot pointer + control byte) must fit into size_t.
  */
+#define	MAX_SLOTS_LG2	(sizeof (size_t) * 8 - 1 - 4)
+#define	MAX_SLOTS	((size_t)1 << MAX_SLOTS_LG2)
+
+#define	LSBS	0x0101010101010101ULL
+#define	MSBS	0x8080808080808080ULL
+
 struct internal_entry {
-	SLIST_ENTRY(internal_entry) link;
 	ENTRY ent;
+	__uint64_t hash;
+};
+
+struct entry_block {
+	struct entry_block *next;
+	struct internal_entry entries[1];
 };
-SLIST_HEAD(internal_head, internal_entry);
 
-#define	MIN_BUCKETS_LG2	4
-#define	MIN_BUCKETS	(1 << MIN_BUCKETS_LG2)
+/* The table, struct hsearch_data's htable points to it. */
+struct internal_head {
+	size_t mask;			/* Number of slots - 1. */
+	size_t growth_left;		/* Entries until the next resize. */
+	struct internal_entry **slots;
+	unsigned char *ctrl;
+	struct entry_block *blocks;	/* Where the entries live. */
+	struct internal_entry *next_entry;
+	size_t entries_left;		/* In the first block. */
+	size_t nentries;
+};
+
+/* FNV-1a, which also finds the end of the key, with a final mix. */
+static __uint64_t
+hash_key(const char *key)
+{
+	__uint64_t h = 0xcbf29ce484222325ULL;
+	const unsigned char *p;
+
+	for (p = (const unsigned char *)key; *p; p++)
+		h = (h ^ *p) * 0x100000001b3ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/* The control bytes of a group, the first one in the lowest byte. */
+static inline __uint64_t
+load_group(const unsigned char *ctrl)
+{
+	__uint64_t g;
+
+	memcpy(&g, ctrl, sizeof g);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	g = __builtin_bswap64(g);
+#endif
+	return g;
+}
 
 /*
- * max * sizeof internal_entry must fit into size_t.
- * assumes internal_entry is <= 32 (2^5) bytes.
+ * The high bit of every byte of G equal to H2.  A byte 0x01 above an
+ * equal one may be reported too, which costs a compare of the hash.
  */
-#define	MAX_BUCKETS_LG2	(sizeof (size_t) * 8 - 1 - 5)
-#define	MAX_BUCKETS	((size_t)1 << MAX_BUCKETS_LG2)
+static inline __uint64_t
+match_group(__uint64_t g, unsigned int h2)
+{
+	__uint64_t x = g ^ (LSBS * h2);
+
+	return (x - LSBS) & ~x & MSBS;
+}
+
+#define	match_empty(g)		((g) & MSBS)
+#define	match_index(m)		((size_t)__builtin_ctzll(m) / 8)
 
-/* Default hash function, from db/hash/hash_func.c */
-extern __uint32_t (*__default_hash)(const void *, size_t);
+/* The first empty slot for HASH. */
+static size_t
+find_empty(const struct internal_head *t, __uint64_t hash)
+{
+	size_t gmask = t->mask / GROUP_WIDTH, g = (hash >> 7) & gmask;
+	size_t step = 0;
+	__uint64_t m;
+
+	while ((m = match_empty(load_group(t->ctrl + g * GROUP_WIDTH))) == 0)
+		g = (g + ++step) & gmask;
+	return g * GROUP_WIDTH + match_index(m);
+}
+
+static struct internal_head *
+alloc_table(size_t nslots)
+{
+	struct internal_head *t;
+
+	t = malloc(sizeof *t + nslots * (sizeof t->slots[0] + 1));
+	if (t == NULL)
+		return NULL;
+	t->mask = nslots - 1;
+	t->growth_left = nslots - nslots / 8;
+	t->slots = (struct internal_entry **)(t + 1);
+	t->ctrl = (unsigned char *)(t->slots + nslots);
+	memset(t->ctrl, CTRL_EMPTY, nslots);
+	t->blocks = NULL;
+	t->next_entry = NULL;
+	t->entries_left = 0;
+	t->nentries = 0;
+	return t;
+}
+
+/* Double the number of slots of the table in HTAB. */
+static int
+grow_table(struct hsearch_data *htab)
+{
+	struct internal_head *old = htab->htable, *t;
+	size_t i, j;
+
+	if (old->mask + 1 >= MAX_SLOTS || !(t = alloc_table(2 * (old->mask + 1))))
+		return 0;
+	for (i = 0; i <= old->mask; i++)
+		if (old->ctrl[i] != CTRL_EMPTY) {
+			j = find_empty(t, old->slots[i]->hash);
+			t->ctrl[j] = old->ctrl[i];
+			t->slots[j] = old->slots[i];
+		}
+	t->growth_left -= old->nentries;
+	t->blocks = old->blocks;
+	t->next_entry = old->next_entry;
+	t->entries_left = old->entries_left;
+	t->nentries = old->nentries;
+	free(old);
+	htab->htable = t;
+	htab->htablesize = t->mask + 1;
+	return 1;
+}
+
+/* A new entry, in a block about as large as all of the previous ones. */
+static struct internal_entry *
+alloc_entry(struct internal_head *t)
+{
+	struct entry_block *b;
+	size_t n;
+
+	if (t->entries_left == 0) {
+		n = t->nentries < MIN_SLOTS ? MIN_SLOTS : t->nentries;
+		b = malloc(sizeof *b + (n - 1) * sizeof b->entries[0]);
+		if (b == NULL)
+			return NULL;
+		b->next = t->blocks;
+		t->blocks = b;
+		t->next_entry = b->entries;
+		t->entries_left = n;
+	}
+	t->entries_left--;
+	t->nentries++;
+	return t->next_entry++;
+}
 
 int
 hcreate_r(size_t nel, struct hsearch_data *htab)
 {
-	size_t idx;
-	unsigned int p2;
+	size_t nslots;
 
 	/* Make sure this this isn't called when a table already exists. */
 	if (htab->htable != NULL) {
@@ -90,32 +240,22 @@ hcreate_r(size_t nel, struct hsearch_data *htab)
 		return 0;
 	}
 
-	/* If nel is too small, make it min sized. */
-	if (nel < MIN_BUCKETS)
-		nel = MIN_BUCKETS;
-
-	/* If it's too large, cap it. */
-	if (nel > MAX_BUCKETS)
-		nel = MAX_BUCKETS;
+	/*
+	 * Room for nel entries at 7/8 load, rounded up to a power of two,
+	 * but at least MIN_SLOTS and at most MAX_SLOTS.
+	 */
+	if (nel > MAX_SLOTS / 8 * 7)
+		nel = MAX_SLOTS / 8 * 7;
+	for (nslots = MIN_SLOTS; nslots - nslots / 8 < nel; nslots <<= 1)
+		;
 
-	/* If it's is not a power of two in size, round up. */
-	if ((nel & (nel - 1)) != 0) {
-		for (p2 = 0; nel != 0; p2++)
-			nel >>= 1;
-		nel = 1 << p2;
-	}
-	
 	/* Allocate the table. */
-	htab->htablesize = nel;
-	htab->htable = malloc(htab->htablesize * sizeof htab->htable[0]);
+	htab->htable = alloc_table(nslots);
 	if (htab->htable == NULL) {
 		errno = ENOMEM;
 		return 0;
 	}
-
-	/* Initialize it. */
-	for (idx = 0; idx < htab->htablesize; idx++)
-		SLIST_INIT(&(htab->htable[idx]));
+	htab->htablesize = nslots;
 
 	return 1;
 }
@@ -123,67 +263,74 @@ hcreate_r(size_t nel, struct hsearch_data *htab)
 void
 hdestroy_r(struct hsearch_data *htab)
 {
-#if 0
-	struct internal_entry *ie;
-	size_t idx;
-#endif
-	if (htab->htable == NULL)
+	struct internal_head *t = htab->htable;
+	struct entry_block *b;
+
+	if (t == NULL)
 		return;
 
-#if 0
-	for (idx = 0; idx < htab->htablesize; idx++) {
-		while (!SLIST_EMPTY(&(htab->htable[idx]))) {
-			ie = SLIST_FIRST(&(htab->htable[idx]));
-			SLIST_REMOVE_HEAD(&(htab->htable[idx]), link);
-                        free(ie->ent.key);
-			free(ie);
-		}
+	/* The keys belong to the caller. */
+	while ((b = t->blocks) != NULL) {
+		t->blocks = b->next;
+		free(b);
 	}
-#endif
-	free(htab->htable);
+	free(t);
 	htab->htable = NULL;
 }
 
 int
 hsearch_r(ENTRY item, ACTION action, ENTRY **retval, struct hsearch_data *htab)
 {
-	struct internal_head *head;
+	struct internal_head *t = htab->htable;
 	struct internal_entry *ie;
-	__uint32_t hashval;
-	size_t len;
+	__uint64_t hash, g, m;
+	unsigned int h2;
+	size_t gmask, gi, i, step;
 
-	len = strlen(item.key);
-	hashval = (*__default_hash)(item.key, len);
+	hash = hash_key(item.key);
+	h2 = hash & 0x7f;
 
-        head = &(htab->htable[hashval & (htab->htablesize - 1)]);
-	ie = SLIST_FIRST(head);
-	while (ie != NULL) {
-		if (strcmp(ie->ent.key, item.key) == 0)
+	gmask = t->mask / GROUP_WIDTH;
+	gi = (hash >> 7) & gmask;
+	for (step = 0;; gi = (gi + ++step) & gmask) {
+		g = load_group(t->ctrl + gi * GROUP_WIDTH);
+		for (m = match_group(g, h2); m != 0; m &= m - 1) {
+			ie = t->slots[gi * GROUP_WIDTH + match_index(m)];
+			if (ie->hash == hash && strcmp(ie->ent.key, item.key) == 0) {
+				*retval = &ie->ent;
+				return 1;
+			}
+		}
+		if (match_empty(g) != 0)
 			break;
-		ie = SLIST_NEXT(ie, link);
 	}
 
-	if (ie != NULL)
-          {
-            *retval = &ie->ent;
-            return 1;
-          }
-	else if (action == FIND)
-          {
-            *retval = NULL;
-            return 0;
-          }
-
-	ie = malloc(sizeof *ie);
+	if (action == FIND) {
+		*retval = NULL;
+		return 0;
+	}
+
+	if (t->growth_left == 0) {
+		if (!grow_table(htab))
+			goto nomem;
+		t = htab->htable;
+	}
+	ie = alloc_entry(t);
 	if (ie == NULL)
-          {
-            *retval = NULL;
-            return 0;
-          }
+		goto nomem;
 	ie->ent.key = item.key;
 	ie->ent.data = item.data;
+	ie->hash = hash;
 
-	SLIST_INSERT_HEAD(head, ie, link);
-        *retval = &ie->ent;
+	i = find_empty(t, hash);
+	t->ctrl[i] = h2;
+	t->slots[i] = ie;
+	t->growth_left--;
+	*retval = &ie->ent;
 	return 1;
+
+nomem:
+	errno = ENOMEM;
+	*retval = NULL;
+	return 0;
 }
@@ -65,6 +65,7 @@ PORTABILITY
 #include <_ansi.h>
 #include <sys/cdefs.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #ifndef __GNUC__
 #define inline
@@ -77,14 +78,64 @@ typedef int		 cmp_t(const void *, const void *, void *);
 #else
 typedef int		 cmp_t(const void *, const void *);
 #endif
-static inline char	*med3 (char *, char *, char *, cmp_t *, void *);
-static inline void	 swapfunc (char *, char *, int, int);
-
-#define min(a, b)	(a) < (b) ? a : b
 
 /*
- * Qsort routine from Bentley & McIlroy's "Engineering a Sort Function".
+ * Pattern-defeating quicksort, after Orson Peters' pdqsort: introsort
+ * with median of three or pseudomedian of nine pivots, block partitioning
+ * as in Edelkamp and Weiss' BlockQuicksort, insertion sort for already
+ * sorted runs, a separate partitioning step for runs of equal elements,
+ * and a heapsort fallback once too many partitions were unbalanced.  It
+ * takes O(n log n) time in the worst case, and O(n) for sorted, reversed
+ * and equal inputs.
+ *
+ * The pivot is never copied out of the array, it's kept in the first
+ * element of the range being partitioned instead.  So the comparison
+ * function only ever sees pointers into the array.
+ *
+ * Every scan is bounded by the range it works on, rather than relying on
+ * an element which the comparison function must stop it at.  A comparison
+ * function which isn't a consistent order gets an unspecified order of the
+ * elements, but no reads or writes outside of the array.
  */
+#define INSERTION_SORT_THRESHOLD	24
+#define NINTHER_THRESHOLD		128
+#define PARTIAL_INSERTION_SORT_LIMIT	8
+#define BLOCK_SIZE			64
+
+/* How to swap two elements. */
+enum { SWAP_4, SWAP_8, SWAP_16, SWAP_LONGS, SWAP_BYTES };
+
+struct sort_ctx {
+	size_t es;
+	int swaptype;
+	cmp_t *cmp;
+	void *thunk;
+};
+
+#if defined(I_AM_QSORT_R)
+#define	LESS(c, x, y) ((c)->cmp((c)->thunk, (x), (y)) < 0)
+#elif defined(I_AM_GNU_QSORT_R)
+#define	LESS(c, x, y) ((c)->cmp((x), (y), (c)->thunk) < 0)
+#else
+#define	LESS(c, x, y) ((c)->cmp((x), (y)) < 0)
+#endif
+
+static inline int
+swapinit (const void *a, size_t es)
+{
+	uintptr_t align = (uintptr_t) a | es;
+
+	if (es == 4 && align % 4 == 0)
+		return SWAP_4;
+	if (es == 8 && align % 8 == 0)
+		return SWAP_8;
+	if (es == 16 && align % 8 == 0)
+		return SWAP_16;
+	if (align % sizeof (long) == 0)
+		return SWAP_LONGS;
+	return SWAP_BYTES;
+}
+
 #define swapcode(TYPE, parmi, parmj, n) { 		\
 	long i = (n) / sizeof (TYPE); 			\
 	TYPE *pi = (TYPE *) (parmi); 		\
@@ -96,70 +147,366 @@ static inline void	 swapfunc (char *, char *, int, int);
         } while (--i > 0);				\
 }
 
-#define SWAPINIT(a, es) swaptype = ((char *)a - (char *)0) % sizeof(long) || \
-	es % sizeof(long) ? 2 : es == sizeof(long)? 0 : 1;
+static inline void
+swap (const struct sort_ctx *c, char *a, char *b)
+{
+	switch (c->swaptype) {
+	case SWAP_4: {
+		uint32_t t = *(uint32_t *) a;
+		*(uint32_t *) a = *(uint32_t *) b;
+		*(uint32_t *) b = t;
+		break;
+	}
+	case SWAP_8: {
+		uint64_t t = *(uint64_t *) a;
+		*(uint64_t *) a = *(uint64_t *) b;
+		*(uint64_t *) b = t;
+		break;
+	}
+	case SWAP_16: {
+		uint64_t t0 = ((uint64_t *) a)[0], t1 = ((uint64_t *) a)[1];
+		((uint64_t *) a)[0] = ((uint64_t *) b)[0];
+		((uint64_t *) a)[1] = ((uint64_t *) b)[1];
+		((uint64_t *) b)[0] = t0;
+		((uint64_t *) b)[1] = t1;
+		break;
+	}
+	case SWAP_LONGS:
+		swapcode(long, a, b, c->es)
+		break;
+	default:
+		swapcode(char, a, b, c->es)
+		break;
+	}
+}
 
 static inline void
-swapfunc (char *a,
-	char *b,
-	int n,
-	int swaptype)
+sort2 (const struct sort_ctx *c, char *a, char *b)
 {
-	if(swaptype <= 1)
-		swapcode(long, a, b, n)
-	else
-		swapcode(char, a, b, n)
+	if (LESS(c, b, a))
+		swap(c, a, b);
 }
 
-#define swap(a, b)					\
-	if (swaptype == 0) {				\
-		long t = *(long *)(a);			\
-		*(long *)(a) = *(long *)(b);		\
-		*(long *)(b) = t;			\
-	} else						\
-		swapfunc(a, b, es, swaptype)
+static inline void
+sort3 (const struct sort_ctx *c, char *a, char *b, char *d)
+{
+	sort2(c, a, b);
+	sort2(c, b, d);
+	sort2(c, a, b);
+}
 
-#define vecswap(a, b, n) 	if ((n) > 0) swapfunc(a, b, n, swaptype)
+/* Insertion sort N elements at A. */
+static void
+insertion_sort (const struct sort_ctx *c, char *a, size_t n)
+{
+	size_t es = c->es;
+	char *pm, *pl, *end = a + n * es;
 
-#if defined(I_AM_QSORT_R)
-#define	CMP(t, x, y) (cmp((t), (x), (y)))
-#elif defined(I_AM_GNU_QSORT_R)
-#define	CMP(t, x, y) (cmp((x), (y), (t)))
-#else
-#define	CMP(t, x, y) (cmp((x), (y)))
-#endif
+	for (pm = a + es; pm < end; pm += es)
+		for (pl = pm; pl > a && LESS(c, pl, pl - es); pl -= es)
+			swap(c, pl, pl - es);
+}
 
-static inline char *
-med3 (char *a,
-	char *b,
-	char *c,
-	cmp_t *cmp,
-	void *thunk
-#if !defined(I_AM_QSORT_R) && !defined(I_AM_GNU_QSORT_R)
-__unused
-#endif
-)
+/*
+ * Like insertion_sort, but give up and return 0 as soon as more than
+ * PARTIAL_INSERTION_SORT_LIMIT elements had to be moved.
+ */
+static int
+partial_insertion_sort (const struct sort_ctx *c, char *a, size_t n)
 {
-	return CMP(thunk, a, b) < 0 ?
-	       (CMP(thunk, b, c) < 0 ? b : (CMP(thunk, a, c) < 0 ? c : a ))
-              :(CMP(thunk, b, c) > 0 ? b : (CMP(thunk, a, c) < 0 ? a : c ));
+	size_t es = c->es, moved = 0;
+	char *pm, *pl, *end = a + n * es;
+
+	for (pm = a + es; pm < end; pm += es) {
+		for (pl = pm; pl > a && LESS(c, pl, pl - es); pl -= es)
+			swap(c, pl, pl - es);
+		moved += (pm - pl) / es;
+		if (moved > PARTIAL_INSERTION_SORT_LIMIT)
+			return 0;
+	}
+	return 1;
+}
+
+static void
+sift_down (const struct sort_ctx *c, char *a, size_t root, size_t n)
+{
+	size_t es = c->es, child;
+
+	while ((child = 2 * root + 1) < n) {
+		if (child + 1 < n && LESS(c, a + child * es, a + (child + 1) * es))
+			child++;
+		if (!LESS(c, a + root * es, a + child * es))
+			return;
+		swap(c, a + root * es, a + child * es);
+		root = child;
+	}
+}
+
+static void
+heap_sort (const struct sort_ctx *c, char *a, size_t n)
+{
+	size_t i;
+
+	for (i = n / 2; i-- > 0; )
+		sift_down(c, a, i, n);
+	for (i = n; --i > 0; ) {
+		swap(c, a, a + i * c->es);
+		sift_down(c, a, 0, i);
+	}
 }
 
 /*
- * Classical function call recursion wastes a lot of stack space. Each
- * recursion level requires a full stack frame comprising all local variables
- * and additional space as dictated by the processor calling convention.
- *
- * This implementation instead stores the variables that are unique for each
- * recursion level in a parameter stack array, and uses iteration to emulate
- * recursion. Function call recursion is not used until the array is full.
+ * Partition the N > 2 elements at A around the pivot A[0] into elements
+ * less than the pivot, the pivot, and elements not less than the pivot.
+ * Return the final position of
+ * the pivot, and in *PARTITIONED whether no elements had to be moved.
  *
- * To ensure the stack consumption isn't worsened by this design, the size of
- * the parameter stack array is chosen to be similar to the stack frame
- * excluding the array. Each function call recursion level can handle this
- * number of iterative recursion levels.
+ * The elements are compared in blocks of BLOCK_SIZE from either end
+ * first, and the offsets of the misplaced ones are recorded, without
+ * branching on the comparison results.  Then the recorded ones are
+ * swapped.
+ */
+static char *
+partition_right (const struct sort_ctx *c, char *a, size_t n,
+		 int *partitioned)
+{
+	size_t es = c->es;
+	char *first = a, *last = a + n * es, *it;
+	unsigned char offsets_l[BLOCK_SIZE], offsets_r[BLOCK_SIZE];
+	size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+	size_t l_size, r_size, unknown, num, i;
+
+	/* Skip the elements already on the right side. */
+	while ((first += es) < last && LESS(c, first, a))
+		;
+	while (first < last && !LESS(c, last -= es, a))
+		;
+	/* The scans may have crossed by one element. */
+	if ((*partitioned = first >= last) != 0) {
+		swap(c, a, first - es);
+		return first - es;
+	}
+	swap(c, first, last);
+	first += es;
+
+	/* [first, last) is left to partition. */
+	while ((size_t) (last - first) > 2 * BLOCK_SIZE * es) {
+		if (num_l == 0) {
+			start_l = 0;
+			for (i = 0, it = first; i < BLOCK_SIZE; it += es) {
+				offsets_l[num_l] = i++;
+				num_l += !LESS(c, it, a);
+			}
+		}
+		if (num_r == 0) {
+			start_r = 0;
+			for (i = 0, it = last; i < BLOCK_SIZE; ) {
+				offsets_r[num_r] = ++i;
+				num_r += LESS(c, it -= es, a);
+			}
+		}
+		num = num_l < num_r ? num_l : num_r;
+		for (i = 0; i < num; i++)
+			swap(c, first + offsets_l[start_l + i] * es,
+			     last - offsets_r[start_r + i] * es);
+		num_l -= num;
+		num_r -= num;
+		start_l += num;
+		start_r += num;
+		if (num_l == 0)
+			first += BLOCK_SIZE * es;
+		if (num_r == 0)
+			last -= BLOCK_SIZE * es;
+	}
+
+	/* Less than two blocks left, one of which may be half done. */
+	unknown = (last - first) / es - ((num_l || num_r) ? BLOCK_SIZE : 0);
+	if (num_r) {
+		l_size = unknown;
+		r_size = BLOCK_SIZE;
+	} else if (num_l) {
+		l_size = BLOCK_SIZE;
+		r_size = unknown;
+	} else {
+		l_size = unknown / 2;
+		r_size = unknown - l_size;
+	}
+	if (unknown && num_l == 0) {
+		start_l = 0;
+		for (i = 0, it = first; i < l_size; it += es) {
+			offsets_l[num_l] = i++;
+			num_l += !LESS(c, it, a);
+		}
+	}
+	if (unknown && num_r == 0) {
+		start_r = 0;
+		for (i = 0, it = last; i < r_size; ) {
+			offsets_r[num_r] = ++i;
+			num_r += LESS(c, it -= es, a);
+		}
+	}
+	num = num_l < num_r ? num_l : num_r;
+	for (i = 0; i < num; i++)
+		swap(c, first + offsets_l[start_l + i] * es,
+		     last - offsets_r[start_r + i] * es);
+	num_l -= num;
+	num_r -= num;
+	start_l += num;
+	start_r += num;
+	if (num_l == 0)
+		first += l_size * es;
+	if (num_r == 0)
+		last -= r_size * es;
+
+	/* Move the rest of the misplaced elements of one side to the end. */
+	if (num_l) {
+		while (num_l--)
+			swap(c, first + offsets_l[start_l + num_l] * es,
+			     last -= es);
+		first = last;
+	}
+	if (num_r) {
+		while (num_r--) {
+			swap(c, last - offsets_r[start_r + num_r] * es, first);
+			first += es;
+		}
+		last = first;
+	}
+
+	swap(c, a, first - es);
+	return first - es;
+}
+
+/*
+ * Partition the N elements at A around the pivot A[0] into the pivot and
+ * elements equal to it, and elements greater than the pivot.  Used when
+ * the element before A is equal to the pivot, that is, there's a run of
+ * equal elements, which is done after this.  Return the final position of
+ * the pivot.
  */
-#define PARAMETER_STACK_LEVELS 8u
+static char *
+partition_left (const struct sort_ctx *c, char *a, size_t n)
+{
+	size_t es = c->es;
+	char *first = a, *last = a + n * es, *end = last;
+
+	while ((last -= es) > a && LESS(c, a, last))
+		;
+	while ((first += es) < end && !LESS(c, a, first))
+		;
+	while (first < last) {
+		swap(c, first, last);
+		while ((last -= es) > a && LESS(c, a, last))
+			;
+		while ((first += es) < end && !LESS(c, a, first))
+			;
+	}
+	swap(c, a, last);
+	return last;
+}
+
+/*
+ * Sort the N elements at A.  BAD_ALLOWED is the number of unbalanced
+ * partitions left until falling back to heapsort.  LEFTMOST is zero if
+ * the element before A is known to be not greater than any of them.
+ */
+static void
+pdqsort (const struct sort_ctx *c, char *a, size_t n, int bad_allowed,
+	 int leftmost)
+{
+	size_t es = c->es, l_size, r_size, q;
+	char *mid, *end, *pivot;
+	int partitioned;
+
+	for (;;) {
+		if (n < INSERTION_SORT_THRESHOLD) {
+			insertion_sort(c, a, n);
+			return;
+		}
+
+		/* Move the median of three or pseudomedian of nine to a[0]. */
+		mid = a + (n / 2) * es;
+		end = a + n * es;
+		if (n > NINTHER_THRESHOLD) {
+			sort3(c, a, mid, end - es);
+			sort3(c, a + es, mid - es, end - 2 * es);
+			sort3(c, a + 2 * es, mid + es, end - 3 * es);
+			sort3(c, mid - es, mid, mid + es);
+			swap(c, a, mid);
+		} else
+			sort3(c, mid, a, end - es);
+
+		/*
+		 * If the element before is equal to the pivot, so are all
+		 * the elements not greater than the pivot.  Put them to the
+		 * left and don't sort them any further.
+		 */
+		if (!leftmost && !LESS(c, a - es, a)) {
+			pivot = partition_left(c, a, n);
+			a = pivot + es;
+			n = (end - a) / es;
+			continue;
+		}
+
+		pivot = partition_right(c, a, n, &partitioned);
+		l_size = (pivot - a) / es;
+		r_size = n - l_size - 1;
+
+		if (l_size < n / 8 || r_size < n / 8) {
+			/* Unbalanced.  Shuffle some elements to break patterns. */
+			if (--bad_allowed == 0) {
+				heap_sort(c, a, n);
+				return;
+			}
+			if (l_size >= INSERTION_SORT_THRESHOLD) {
+				q = l_size / 4;
+				swap(c, a, a + q * es);
+				swap(c, pivot - es, pivot - q * es);
+				if (l_size > NINTHER_THRESHOLD) {
+					swap(c, a + es, a + (q + 1) * es);
+					swap(c, a + 2 * es, a + (q + 2) * es);
+					swap(c, pivot - 2 * es,
+					     pivot - (q + 1) * es);
+					swap(c, pivot - 3 * es,
+					     pivot - (q + 2) * es);
+				}
+			}
+			if (r_size >= INSERTION_SORT_THRESHOLD) {
+				q = r_size / 4;
+				swap(c, pivot + es, pivot + (q + 1) * es);
+				swap(c, end - es, end - q * es);
+				if (r_size > NINTHER_THRESHOLD) {
+					swap(c, pivot + 2 * es,
+					     pivot + (q + 2) * es);
+					swap(c, pivot + 3 * es,
+					     pivot + (q + 3) * es);
+					swap(c, end - 2 * es,
+					     end - (q + 1) * es);
+					swap(c, end - 3 * es,
+					     end - (q + 2) * es);
+				}
+			}
+		} else if (partitioned
+			   && partial_insertion_sort(c, a, l_size)
+			   && partial_insertion_sort(c, pivot + es, r_size))
+			/* Probably sorted already, and now it is. */
+			return;
+
+		/*
+		 * Recurse into the smaller part and iterate on the larger
+		 * one, so the recursion depth is at most log2(n).
+		 */
+		if (l_size < r_size) {
+			pdqsort(c, a, l_size, bad_allowed, leftmost);
+			a = pivot + es;
+			n = r_size;
+			leftmost = 0;
+		} else {
+			pdqsort(c, pivot + es, r_size, bad_allowed, 0);
+			n = l_size;
+		}
+	}
+}
 
 #if defined(I_AM_QSORT_R)
 void
@@ -176,7 +523,6 @@ qsort_r (void *a,
 	cmp_t *cmp,
 	void *thunk)
 #else
-#define thunk NULL
 void
 qsort (void *a,
 	size_t n,
@@ -184,162 +530,20 @@ qsort (void *a,
 	cmp_t *cmp)
 #endif
 {
-	char *pa, *pb, *pc, *pd, *pl, *pm, *pn;
-	size_t d, r;
-	int cmp_result;
-	int swaptype, swap_cnt;
-	size_t recursion_level = 0;
-	struct { void *a; size_t n; } parameter_stack[PARAMETER_STACK_LEVELS];
-
-	SWAPINIT(a, es);
-loop:	swap_cnt = 0;
-	if (n < 7) {
-		/* Short arrays are insertion sorted. */
-		for (pm = (char *) a + es; pm < (char *) a + n * es; pm += es)
-			for (pl = pm; pl > (char *) a && CMP(thunk, pl - es, pl) > 0;
-			     pl -= es)
-				swap(pl, pl - es);
-		goto pop;
-	}
+	struct sort_ctx c;
+	int bad_allowed = 0;
 
-	/* Select a pivot element, move it to the left. */
-	pm = (char *) a + (n / 2) * es;
-	if (n > 7) {
-		pl = a;
-		pn = (char *) a + (n - 1) * es;
-		if (n > 40) {
-			d = (n / 8) * es;
-			pl = med3(pl, pl + d, pl + 2 * d, cmp, thunk);
-			pm = med3(pm - d, pm, pm + d, cmp, thunk);
-			pn = med3(pn - 2 * d, pn - d, pn, cmp, thunk);
-		}
-		pm = med3(pl, pm, pn, cmp, thunk);
-	}
-	swap(a, pm);
-
-	/*
-	 * Sort the array relative the pivot in four ranges as follows:
-	 * { elems == pivot, elems < pivot, elems > pivot, elems == pivot }
-	 */
-	pa = pb = (char *) a + es;
-	pc = pd = (char *) a + (n - 1) * es;
-	for (;;) {
-		/* Scan left to right stopping at first element > pivot. */
-		while (pb <= pc && (cmp_result = CMP(thunk, pb, a)) <= 0) {
-			/* Move elements == pivot to the left (to pa) */
-			if (cmp_result == 0) {
-				swap_cnt = 1;
-				swap(pa, pb);
-				pa += es;
-			}
-			pb += es;
-		}
-		/* Scan right to left stopping at first element < pivot. */
-		while (pb <= pc && (cmp_result = CMP(thunk, pc, a)) >= 0) {
-			/* Move elements == pivot to the right (to pd) */
-			if (cmp_result == 0) {
-				swap_cnt = 1;
-				swap(pc, pd);
-				pd -= es;
-			}
-			pc -= es;
-		}
-		if (pb > pc)
-			break;
-		/* The scan has found two elements to swap with each other. */
-		swap(pb, pc);
-		swap_cnt = 1;
-		pb += es;
-		pc -= es;
-	}
-	if (swap_cnt == 0) {  /* Switch to insertion sort */
-		for (pm = (char *) a + es; pm < (char *) a + n * es; pm += es)
-			for (pl = pm; pl > (char *) a && CMP(thunk, pl - es, pl) > 0;
-			     pl -= es)
-				swap(pl, pl - es);
-		goto pop;
-	}
-
-	/*
-	 * Rearrange the array in three parts sorted like this:
-	 * { elements < pivot, elements == pivot, elements > pivot }
-	 */
-	pn = (char *) a + n * es;
-	r = min(pa - (char *)a, pb - pa);
-	vecswap(a, pb - r, r);
-	r = min(pd - pc, pn - pd - es);
-	vecswap(pb, pn - r, r);
-	d = pb - pa; /* d = Size of left part. */
-	r = pd - pc; /* r = Size of right part. */
-	pn -= r;     /* pn = Base of right part. */
-
-	/*
-	 * Check which of the left and right parts are larger.
-	 * Set (a, n)  to (base, size) of the larger part.
-	 * Set (pa, r) to (base, size) of the smaller part.
-	 */
-	if (r > d) { /* Right part is the larger part */
-		pa = a;
-		a = pn;
-		n = r;
-		r = d;
-	}
-	else { /* Left part is the larger part, or both are equal. */
-		pa = pn;
-		n = d;
-	}
-
-	/*
-	 * The left and right parts each need further sorting if they
-	 * contain two elements or more. If both need sorting we use
-	 * recursion to sort the smaller part and save the larger part
-	 * to be sorted by iteration after the recursion.
-	 * Using recursion only for the smaller part guarantees a
-	 * recursion depth that is bounded to be less than (log2(n)).
-	 */
-	if (r > es) {  /* Smaller part > 1 element. Both parts need sorting. */
-		if (recursion_level < PARAMETER_STACK_LEVELS) {
-			/*
-			 * The smaller part needs to be recursively sorted
-			 * before the larger part is sorted. To avoid function
-			 * call recursion the parameters for the larger part
-			 * are pushed on the parameter_stack array. The smaller
-			 * part is sorted using iteration and the larger part
-			 * will be sorted when the parameter_stack is popped
-			 * after the smaller part has been sorted.
-			 */
-			parameter_stack[recursion_level].a = a;
-			parameter_stack[recursion_level].n = n / es;
-			recursion_level++;
-			a = pa;
-			n = r / es;
-			goto loop;
-		}
-		else {
-			/*
-			 * The parameter_stack array is full. The smaller part
-			 * is sorted using function call recursion. The larger
-			 * part will be sorted after the function call returns.
-			 */
-#if defined(I_AM_QSORT_R)
-			__bsd_qsort_r(pa, r / es, es, thunk, cmp);
-#elif defined(I_AM_GNU_QSORT_R)
-			qsort_r(pa, r / es, es, cmp, thunk);
+	if (n < 2 || es == 0)
+		return;
+	c.es = es;
+	c.swaptype = swapinit(a, es);
+	c.cmp = cmp;
+#if defined(I_AM_QSORT_R) || defined(I_AM_GNU_QSORT_R)
+	c.thunk = thunk;
 #else
-			qsort(pa, r / es, es, cmp);
+	c.thunk = NULL;
 #endif
-		}
-	}
-	if (n > es) {  /* The larger part needs sorting. Iterate to sort.  */
-		n = n / es;
-		goto loop;
-	}
-	/* Both left and right parts are one element or less - level done. */
-pop:
-	if (recursion_level != 0) {
-		recursion_level--;
-		a = parameter_stack[recursion_level].a;
-		n = parameter_stack[recursion_level].n;
-		goto loop;
-	}
+	while (n >> bad_allowed)
+		bad_allowed++;
+	pdqsort(&c, a, n, bad_allowed, 1);
 }
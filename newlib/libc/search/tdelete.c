@@ -23,44 +23,132 @@ __RCSID("$NetBSD: tdelete.c,v 1.2 1999/09/16 11:45:37 lukem Exp $");
 #include <search.h>
 #include <stdlib.h>
 
+/*
+ * Rotate the subtree at *LINK, which is out of balance after a deletion.
+ * Return whether it got lower.
+ */
+static int
+rebalance(node_t **link)
+{
+	node_t *n = *link, *c, *g;
+
+	if (n->balance == 2) {
+		c = n->rlink;
+		if (c->balance >= 0) {			/* single left */
+			n->rlink = c->llink;
+			c->llink = n;
+			*link = c;
+			if (c->balance == 0) {
+				n->balance = 1;
+				c->balance = -1;
+				return 0;
+			}
+			n->balance = c->balance = 0;
+			return 1;
+		}
+		g = c->llink;				/* double, right-left */
+		c->llink = g->rlink;
+		g->rlink = c;
+		n->rlink = g->llink;
+		g->llink = n;
+		n->balance = (g->balance > 0) ? -1 : 0;
+		c->balance = (g->balance < 0) ? 1 : 0;
+	} else {
+		c = n->llink;
+		if (c->balance <= 0) {			/* single right */
+			n->llink = c->rlink;
+			c->rlink = n;
+			*link = c;
+			if (c->balance == 0) {
+				n->balance = -1;
+				c->balance = 1;
+				return 0;
+			}
+			n->balance = c->balance = 0;
+			return 1;
+		}
+		g = c->rlink;				/* double, left-right */
+		c->rlink = g->llink;
+		g->llink = c;
+		n->llink = g->rlink;
+		g->rlink = n;
+		n->balance = (g->balance < 0) ? 1 : 0;
+		c->balance = (g->balance > 0) ? -1 : 0;
+	}
+	g->balance = 0;
+	*link = g;
+	return 1;
+}
 
-/* delete node with given key */
+/*
+ * delete node with given key
+ *
+ * The nodes aren't moved, if the deleted one has two children, its
+ * successor takes its place.  Then the tree is rebalanced on the way
+ * back up.
+ */
 void *
 tdelete (const void *__restrict vkey,	/* key to be deleted */
 	void      **__restrict vrootp,	/* address of the root of tree */
 	int       (*compar)(const void *, const void *))
 {
 	node_t **rootp = (node_t **)vrootp;
-	node_t *p, *q, *r;
-	int  cmp;
+	node_t **links[_TSEARCH_MAXDEPTH];	/* path from the root */
+	signed char dirs[_TSEARCH_MAXDEPTH];	/* -1 left, 1 right */
+	node_t *p, *q, *n;
+	int  cmp, depth = 0, found;
 
 	if (rootp == NULL || (p = *rootp) == NULL)
 		return NULL;
 
 	while ((cmp = (*compar)(vkey, (*rootp)->key)) != 0) {
 		p = *rootp;
+		links[depth] = rootp;
+		dirs[depth++] = (cmp < 0) ? -1 : 1;
 		rootp = (cmp < 0) ?
 		    &(*rootp)->llink :		/* follow llink branch */
 		    &(*rootp)->rlink;		/* follow rlink branch */
 		if (*rootp == NULL)
 			return NULL;		/* key not found */
 	}
-	r = (*rootp)->rlink;			/* D1: */
-	if ((q = (*rootp)->llink) == NULL)	/* Left NULL? */
-		q = r;
-	else if (r != NULL) {			/* Right link is NULL? */
-		if (r->llink == NULL) {		/* D2: Find successor */
-			r->llink = q;
-			q = r;
-		} else {			/* D3: Find NULL link */
-			for (q = r->llink; q->llink != NULL; q = r->llink)
-				r = q;
-			r->llink = q->rlink;
-			q->llink = (*rootp)->llink;
-			q->rlink = (*rootp)->rlink;
+	q = *rootp;
+	found = depth;
+
+	if (q->llink == NULL || q->rlink == NULL)
+		*rootp = (q->llink != NULL) ? q->llink : q->rlink;
+	else {
+		/* Unlink the successor, the leftmost node on the right. */
+		node_t **link = &q->rlink;
+
+		links[depth] = rootp;
+		dirs[depth++] = 1;
+		while ((*link)->llink != NULL) {
+			links[depth] = link;
+			dirs[depth++] = -1;
+			link = &(*link)->llink;
 		}
+		n = *link;
+		*link = n->rlink;
+		/* And put it in place of Q. */
+		n->llink = q->llink;
+		n->rlink = q->rlink;
+		n->balance = q->balance;
+		*rootp = n;
+		/* The path went through Q's rlink, which now is N's. */
+		if (depth > found + 1)
+			links[found + 1] = &n->rlink;
+	}
+	free(q);				/* D4: Free node */
+
+	/* The subtree below links[depth - 1] got lower on side dirs. */
+	while (depth > 0) {
+		n = *links[--depth];
+		n->balance -= dirs[depth];
+		if (n->balance == 1 || n->balance == -1)
+			break;			/* as high as before */
+		if (n->balance != 0 && !rebalance(links[depth]))
+			break;
 	}
-	free(*rootp);				/* D4: Free node */
-	*rootp = q;				/* link parent to new node */
-	return p;
+	/* The parent, or something not NULL when the root was deleted. */
+	return found ? p : (void *)rootp;
 }
@@ -23,14 +23,22 @@ __RCSID("$NetBSD: tsearch.c,v 1.3 1999/09/16 11:45:37 lukem Exp $");
 #include <search.h>
 #include <stdlib.h>
 
+/*
+ * The tree is kept AVL balanced, so that it doesn't degenerate into a
+ * list when the keys are inserted in order.  The links and the order of
+ * the nodes are as before, so tfind and twalk don't need to know.
+ */
+
 /* find or insert datum into search tree */
 void *
 tsearch (const void *vkey,		/* key to be located */
 	void **vrootp,		/* address of tree root */
 	int (*compar)(const void *, const void *))
 {
-	node_t *q;
+	node_t *q, *n, *c, *g;
 	node_t **rootp = (node_t **)vrootp;
+	node_t **links[_TSEARCH_MAXDEPTH];	/* path from the root */
+	int depth = 0;
 
 	if (rootp == NULL)
 		return NULL;
@@ -41,17 +49,69 @@ tsearch (const void *vkey,		/* key to be located */
 		if ((r = (*compar)(vkey, (*rootp)->key)) == 0)	/* T2: */
 			return *rootp;		/* we found it! */
 
+		links[depth++] = rootp;
 		rootp = (r < 0) ?
 		    &(*rootp)->llink :		/* T3: follow left branch */
 		    &(*rootp)->rlink;		/* T4: follow right branch */
 	}
 
 	q = malloc(sizeof(node_t));		/* T5: key not found */
-	if (q != 0) {				/* make new node */
-		*rootp = q;			/* link new node to old */
-		/* LINTED const castaway ok */
-		q->key = (void *)vkey;		/* initialize new node */
-		q->llink = q->rlink = NULL;
+	if (q == 0)
+		return NULL;
+	*rootp = q;				/* link new node to old */
+	/* LINTED const castaway ok */
+	q->key = (void *)vkey;			/* initialize new node */
+	q->llink = q->rlink = NULL;
+	q->balance = 0;
+
+	/*
+	 * Walk back up, the subtree below N got one higher.  Stop at the
+	 * first node which is balanced now, or rotate at the first one which
+	 * is out of balance, which makes its subtree as high as before.
+	 */
+	for (c = q; depth > 0; c = n) {
+		n = *links[--depth];
+		n->balance += (c == n->llink) ? -1 : 1;
+		if (n->balance == 0)
+			break;
+		if (n->balance == 1 || n->balance == -1)
+			continue;
+		if (n->balance == -2) {
+			if (c->balance < 0) {		/* single right */
+				n->llink = c->rlink;
+				c->rlink = n;
+				n->balance = c->balance = 0;
+				*links[depth] = c;
+			} else {			/* double, left-right */
+				g = c->rlink;
+				c->rlink = g->llink;
+				g->llink = c;
+				n->llink = g->rlink;
+				g->rlink = n;
+				n->balance = (g->balance < 0) ? 1 : 0;
+				c->balance = (g->balance > 0) ? -1 : 0;
+				g->balance = 0;
+				*links[depth] = g;
+			}
+		} else {
+			if (c->balance > 0) {		/* single left */
+				n->rlink = c->llink;
+				c->llink = n;
+				n->balance = c->balance = 0;
+				*links[depth] = c;
+			} else {			/* double, right-left */
+				g = c->llink;
+				c->llink = g->rlink;
+				g->rlink = c;
+				n->rlink = g->llink;
+				g->llink = n;
+				n->balance = (g->balance > 0) ? -1 : 0;
+				c->balance = (g->balance < 0) ? 1 : 0;
+				g->balance = 0;
+				*links[depth] = g;
+			}
+		}
+		break;
 	}
 	return q;
 }
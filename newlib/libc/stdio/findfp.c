@@ -117,28 +117,110 @@ stderr_init(FILE *ptr)
   std (ptr, __SRW | __SNBF, 2);
 }
 
-struct glue_with_file {
-  struct _glue glue;
-  FILE file;
-};
-
 struct _glue *
 __sfmoreglue (struct _reent *d,
        register int n)
 {
-  struct glue_with_file *g;
+  struct glue_block *g;
 
-  g = (struct glue_with_file *)
+  g = (struct glue_block *)
     _malloc_r (d, sizeof (*g) + (n - 1) * sizeof (FILE));
   if (g == NULL)
     return NULL;
   g->glue._next = NULL;
   g->glue._niobs = n;
-  g->glue._iobs = &g->file;
-  memset (&g->file, 0, n * sizeof (FILE));
+  g->glue._iobs = g->file;
+  g->nopen = 0;
+  memset (g->file, 0, n * sizeof (FILE));
   return &g->glue;
 }
 
+/*
+ * The glue blocks after the first one, sorted by address so that
+ * __sfp_release can find the block of a FILE, the last one, and a stack
+ * of the free FILEs in them, so that __sfp doesn't have to search the
+ * whole list.  All protected by the sfp lock.  FILEs which didn't fit
+ * onto the stack because realloc failed are counted in sfp_lost, and
+ * picked up again by scanning all blocks once the stack is empty.
+ */
+static struct glue_block **sfp_blocks;
+static int sfp_nblocks, sfp_blocks_size;
+static FILE **sfp_free;
+static int sfp_nfree, sfp_free_size, sfp_lost;
+static struct _glue *sfp_last;
+
+static void
+sfp_push_free (struct _reent *d, FILE *fp)
+{
+  if (sfp_nfree == sfp_free_size)
+    {
+      int size = sfp_free_size ? 2 * sfp_free_size : 64;
+      FILE **n = (FILE **) _realloc_r (d, sfp_free, size * sizeof (FILE *));
+
+      if (!n)
+	{
+	  sfp_lost++;
+	  return;
+	}
+      sfp_free = n;
+      sfp_free_size = size;
+    }
+  sfp_free[sfp_nfree++] = fp;
+}
+
+static struct glue_block *
+sfp_block (FILE *fp)
+{
+  int lo = 0, hi = sfp_nblocks;
+
+  while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      struct glue_block *g = sfp_blocks[mid];
+
+      if (fp < g->file)
+	hi = mid;
+      else if (fp >= g->file + g->glue._niobs)
+	lo = mid + 1;
+      else
+	return g;
+    }
+  return NULL;
+}
+
+/* Add a glue block for N more FILEs to the end of the list and all but
+   its first FILE to the free list.  Return the first FILE. */
+static FILE *
+sfp_grow (struct _reent *d, int n)
+{
+  struct glue_block *g;
+  int i;
+
+  if (sfp_nblocks == sfp_blocks_size)
+    {
+      int size = sfp_blocks_size ? 2 * sfp_blocks_size : 16;
+      struct glue_block **b = (struct glue_block **)
+	_realloc_r (d, sfp_blocks, size * sizeof (struct glue_block *));
+
+      if (!b)
+	return NULL;
+      sfp_blocks = b;
+      sfp_blocks_size = size;
+    }
+  g = (struct glue_block *) __sfmoreglue (d, n);
+  if (!g)
+    return NULL;
+  for (i = sfp_nblocks; i > 0 && sfp_blocks[i - 1] > g; i--)
+    sfp_blocks[i] = sfp_blocks[i - 1];
+  sfp_blocks[i] = g;
+  sfp_nblocks++;
+  for (i = n; --i > 0; )
+    sfp_push_free (d, &g->file[i]);
+  sfp_last->_next = &g->glue;
+  sfp_last = &g->glue;
+  return g->file;
+}
+
 /*
  * Find a free FILE for fopen et al.
  */
@@ -149,25 +231,49 @@ __sfp (struct _reent *d)
   FILE *fp;
   int n;
   struct _glue *g;
+  struct glue_block *gb;
 
   _newlib_sfp_lock_start ();
 
   if (!_GLOBAL_REENT->__sdidinit)
     __sinit (_GLOBAL_REENT);
-  for (g = &_GLOBAL_REENT->__sglue;; g = g->_next)
+  /* The standard streams. */
+  g = &_GLOBAL_REENT->__sglue;
+  for (fp = g->_iobs, n = g->_niobs; --n >= 0; fp++)
+    if (fp->_flags == 0)
+      goto found;
+  if (!sfp_last)
+    sfp_last = g;
+  if (sfp_lost && !sfp_nfree)
     {
-      for (fp = g->_iobs, n = g->_niobs; --n >= 0; fp++)
-	if (fp->_flags == 0)
-	  goto found;
-      if (g->_next == NULL &&
-	  (g->_next = __sfmoreglue (d, NDYNAMIC)) == NULL)
-	break;
+      /* Find the FILEs we lost track of. */
+      sfp_lost = 0;
+      for (g = g->_next; g; g = g->_next)
+	for (fp = g->_iobs + g->_niobs, n = g->_niobs; --n >= 0; )
+	  if ((--fp)->_flags == 0)
+	    sfp_push_free (d, fp);
+    }
+  while (sfp_nfree)
+    {
+      fp = sfp_free[--sfp_nfree];
+      if (fp->_flags == 0)
+	goto found;
+    }
+  n = sfp_last->_niobs * 2;
+  if (sfp_last == &_GLOBAL_REENT->__sglue || n < NDYNAMIC)
+    n = NDYNAMIC;
+  else if (n > NDYNAMIC_MAX)
+    n = NDYNAMIC_MAX;
+  if (!(fp = sfp_grow (d, n)))
+    {
+      _newlib_sfp_lock_exit ();
+      d->_errno = ENOMEM;
+      return NULL;
     }
-  _newlib_sfp_lock_exit ();
-  d->_errno = ENOMEM;
-  return NULL;
 
 found:
+  if ((gb = sfp_block (fp)))
+    gb->nopen++;
   fp->_file = -1;		/* no file */
   fp->_flags = 1;		/* reserve this slot; caller sets real flags */
   fp->_flags2 = 0;
@@ -192,6 +298,23 @@ found:
   return fp;
 }
 
+/*
+ * Mark FP free for reuse by __sfp.  Called with the sfp lock held.
+ */
+
+void
+__sfp_release (FILE *fp)
+{
+  struct glue_block *g;
+
+  fp->_flags = 0;
+  if ((g = sfp_block (fp)))
+    {
+      g->nopen--;
+      sfp_push_free (_GLOBAL_REENT, fp);
+    }
+}
+
 /*
  * exit() calls _cleanup() through *__cleanup, set whenever we
  * open or buffer a file.  This chicanery is done so that programs
@@ -286,7 +286,7 @@ _fmemopen_r (struct _reent *ptr,
       == NULL)
     {
       _newlib_sfp_lock_start ();
-      fp->_flags = 0;		/* release */
+      __sfp_release (fp);	/* release */
 #ifndef __SINGLE_THREAD__
       __lock_close_recursive (fp->_lock);
 #endif
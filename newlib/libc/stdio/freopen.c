@@ -204,7 +204,7 @@ _freopen_r (struct _reent *ptr,
   if (f < 0)
     {				/* did not get it after all */
       __sfp_lock_acquire ();
-      fp->_flags = 0;		/* set it free */
+      __sfp_release (fp);	/* set it free */
       ptr->_errno = e;		/* restore in case _close clobbered */
       if (!(oflags2 & __SNLK))
 	_funlockfile (fp);
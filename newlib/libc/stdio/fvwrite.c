@@ -42,6 +42,10 @@
  *
  * This routine is large and unsightly, but most of the ugliness due
  * to the three different kinds of output buffering is handled here.
+ *
+ * The caller holds the stream lock, so everything in here uses the
+ * unlocked variants, and one fprintf or fwrite takes the lock just once
+ * however many buffers it fills or flushes.
  */
 
 int
@@ -74,7 +78,7 @@ __sfvwrite_r (struct _reent *ptr,
           GETIOV (;);
           while (len > 0)
             {
-              if (putc (*p, fp) == EOF)
+              if (__sputc_r (ptr, *p, fp) == EOF)
                 return EOF;
               p++;
               len--;
@@ -186,7 +190,7 @@ __sfvwrite_r (struct _reent *ptr,
 	      COPY (w);
 	      fp->_w -= w;
 	      fp->_p += w;
-	      if (fp->_w == 0 && _fflush_r (ptr, fp))
+	      if (fp->_w == 0 && __sflush_r (ptr, fp))
 		goto err;
 	    }
 	  else
@@ -229,7 +233,7 @@ __sfvwrite_r (struct _reent *ptr,
 	      COPY (w);
 	      /* fp->_w -= w; */
 	      fp->_p += w;
-	      if (_fflush_r (ptr, fp))
+	      if (__sflush_r (ptr, fp))
 		goto err;
 	    }
 	  else if (s >= (w = fp->_bf._size))
@@ -248,7 +252,7 @@ __sfvwrite_r (struct _reent *ptr,
 	  if ((nldist -= w) == 0)
 	    {
 	      /* copied the newline: flush and forget */
-	      if (_fflush_r (ptr, fp))
+	      if (__sflush_r (ptr, fp))
 		goto err;
 	      nlknown = 0;
 	    }
@@ -42,11 +42,15 @@ _fwalk (struct _reent *ptr,
    *
    * Avoid locking this list while walking it or else you will
    * introduce a potential deadlock in [at least] refill.c.
+   *
+   * Skip the glue blocks without any open FILEs.  A FILE being opened
+   * right now may be missed, but that's just as well without skipping.
    */
   for (g = &ptr->__sglue; g != NULL; g = g->_next)
-    for (fp = g->_iobs, n = g->_niobs; --n >= 0; fp++)
-      if (fp->_flags != 0 && fp->_flags != 1 && fp->_file != -1)
-	ret |= (*function) (fp);
+    if (g == &ptr->__sglue || ((struct glue_block *) g)->nopen)
+      for (fp = g->_iobs, n = g->_niobs; --n >= 0; fp++)
+	if (fp->_flags != 0 && fp->_flags != 1 && fp->_file != -1)
+	  ret |= (*function) (fp);
 
   return ret;
 }
@@ -68,11 +72,15 @@ _fwalk_reent (struct _reent *ptr,
    *
    * Avoid locking this list while walking it or else you will
    * introduce a potential deadlock in [at least] refill.c.
+   *
+   * Skip the glue blocks without any open FILEs.  A FILE being opened
+   * right now may be missed, but that's just as well without skipping.
    */
   for (g = &ptr->__sglue; g != NULL; g = g->_next)
-    for (fp = g->_iobs, n = g->_niobs; --n >= 0; fp++)
-      if (fp->_flags != 0 && fp->_flags != 1 && fp->_file != -1)
-	ret |= (*reent_function) (ptr, fp);
+    if (g == &ptr->__sglue || ((struct glue_block *) g)->nopen)
+      for (fp = g->_iobs, n = g->_niobs; --n >= 0; fp++)
+	if (fp->_flags != 0 && fp->_flags != 1 && fp->_file != -1)
+	  ret |= (*reent_function) (ptr, fp);
 
   return ret;
 }
@@ -60,6 +60,20 @@
 #define _STDIO_WITH_THREAD_CANCELLATION_SUPPORT
 #endif
 
+/* Stream locks are only needed once a process has more than one thread.
+   Cygwin sets __isthreaded in every new thread but its own internal ones,
+   before the thread runs any code of its own, and never clears it again.
+   So it can only change from 0 to 1 while the one and only thread is
+   creating another one.  The critical section macros below sample it
+   once, so that a stream callback creating the first thread doesn't
+   unbalance the lock. */
+#ifdef __CYGWIN__
+extern int __isthreaded;
+# define _STDIO_THREADED()	(__isthreaded)
+#else
+# define _STDIO_THREADED()	1
+#endif
+
 #if defined(__SINGLE_THREAD__) || defined(__IMPL_UNLOCKED__)
 
 # define _newlib_flockfile_start(_fp)
@@ -72,25 +86,30 @@
 #elif defined(_STDIO_WITH_THREAD_CANCELLATION_SUPPORT)
 #include <pthread.h>
 
-/* Start a stream oriented critical section: */
+/* Start a stream oriented critical section.  Nothing to do as long as the
+   process has only one thread: */
 # define _newlib_flockfile_start(_fp) \
 	{ \
-	  int __oldfpcancel; \
-	  pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &__oldfpcancel); \
-	  if (!(_fp->_flags2 & __SNLK)) \
+	  int __oldfpcancel = 0; \
+	  int __fpthreaded = _STDIO_THREADED (); \
+	  if (__fpthreaded) \
+	    pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &__oldfpcancel); \
+	  if (__fpthreaded && !(_fp->_flags2 & __SNLK)) \
 	    _flockfile (_fp)
 
 /* Exit from a stream oriented critical section prematurely: */
 # define _newlib_flockfile_exit(_fp) \
-	  if (!(_fp->_flags2 & __SNLK)) \
+	  if (__fpthreaded && !(_fp->_flags2 & __SNLK)) \
 	    _funlockfile (_fp); \
-	  pthread_setcancelstate (__oldfpcancel, &__oldfpcancel);
+	  if (__fpthreaded) \
+	    pthread_setcancelstate (__oldfpcancel, &__oldfpcancel);
 
 /* End a stream oriented critical section: */
 # define _newlib_flockfile_end(_fp) \
-	  if (!(_fp->_flags2 & __SNLK)) \
+	  if (__fpthreaded && !(_fp->_flags2 & __SNLK)) \
 	    _funlockfile (_fp); \
-	  pthread_setcancelstate (__oldfpcancel, &__oldfpcancel); \
+	  if (__fpthreaded) \
+	    pthread_setcancelstate (__oldfpcancel, &__oldfpcancel); \
 	}
 
 /* Start a stream list oriented critical section: */
@@ -115,15 +134,16 @@
 
 # define _newlib_flockfile_start(_fp) \
 	{ \
-		if (!(_fp->_flags2 & __SNLK)) \
+		int __fpthreaded = _STDIO_THREADED (); \
+		if (__fpthreaded && !(_fp->_flags2 & __SNLK)) \
 		  _flockfile (_fp)
 
 # define _newlib_flockfile_exit(_fp) \
-		if (!(_fp->_flags2 & __SNLK)) \
+		if (__fpthreaded && !(_fp->_flags2 & __SNLK)) \
 		  _funlockfile(_fp); \
 
 # define _newlib_flockfile_end(_fp) \
-		if (!(_fp->_flags2 & __SNLK)) \
+		if (__fpthreaded && !(_fp->_flags2 & __SNLK)) \
 		  _funlockfile(_fp); \
 	}
 
@@ -186,6 +206,7 @@ extern int    __swhatbuf_r (struct _reent *, FILE *, size_t *, int *);
 extern int    _fwalk (struct _reent *, int (*)(FILE *));
 extern int    _fwalk_reent (struct _reent *, int (*)(struct _reent *, FILE *));
 struct _glue * __sfmoreglue (struct _reent *,int n);
+extern void   __sfp_release (FILE *);
 extern int __submore (struct _reent *, FILE *);
 
 #ifdef __LARGE64_FILES
@@ -290,6 +311,16 @@ char *_llicvt (char *, long long, char);
 #define CVT_BUF_SIZE 128
 
 #define	NDYNAMIC 4	/* add four more whenever necessary */
+#define	NDYNAMIC_MAX 128 /* ... and twice as many as last time, up to this */
+
+/* The glue blocks allocated by __sfmoreglue.  Only the _glue part is
+   visible outside of stdio, and that part is all that's allowed in the
+   first glue block, the one in struct _reent. */
+struct glue_block {
+  struct _glue glue;
+  int nopen;		/* number of FILEs not free, see __sfp_release */
+  FILE file[1];
+};
 
 #ifdef __SINGLE_THREAD__
 #define __sfp_lock_acquire()
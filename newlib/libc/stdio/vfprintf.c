@@ -499,6 +499,8 @@ __sbprintf (struct _reent *rptr,
 # define MAXEXPLEN		7
 # define DEFPREC		6
 
+extern int __dtoa_fast (double, int, int, char *, int *, char **);
+
 # ifdef _NO_LONGDBL
 
 extern char *_dtoa_r (struct _reent *, double, int,
@@ -1307,6 +1309,10 @@ reswitch:	switch (ch) {
 
 			flags |= FPT;
 
+# ifdef _WANT_IO_C99_FORMATS
+			if (ch != 'a' && ch != 'A')
+# endif
+				cp = buf;
 			cp = cvt (data, _fpvalue, prec, flags, &softsign,
 				  &expt, ch, &ndig, cp);
 
@@ -1870,7 +1876,17 @@ cvt(struct _reent *data, _PRINTF_FLOAT_TYPE value, int ndigits, int flags,
 		mode = 2;		/* ndigits significant digits */
 	}
 
-	digits = _DTOA_R (data, value, mode, ndigits, decpt, &dsgn, &rve);
+	/* Try without bignums first, the digits fit into BUF. */
+# ifdef _NO_LONGDBL
+	if (__dtoa_fast (value, mode, ndigits, buf, decpt, &rve))
+# else
+	if ((double) value == value
+	    && __dtoa_fast ((double) value, mode, ndigits, buf, decpt, &rve))
+# endif
+		digits = buf;
+	else
+		digits = _DTOA_R (data, value, mode, ndigits, decpt, &dsgn,
+				  &rve);
 
 	if ((ch != 'g' && ch != 'G') || flags & ALT) {	/* Print trailing zeros */
 		bp = digits + ndigits;
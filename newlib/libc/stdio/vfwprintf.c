@@ -225,6 +225,8 @@ __sbwprintf (struct _reent *rptr,
 # define MAXEXPLEN		7
 # define DEFPREC		6
 
+extern int __dtoa_fast (double, int, int, char *, int *, char **);
+
 # ifdef _NO_LONGDBL
 
 extern char *_dtoa_r (struct _reent *, double, int,
@@ -1627,12 +1629,23 @@ wcvt(struct _reent *data, _PRINTF_FLOAT_TYPE value, int ndigits, int flags,
 	}
 
 	{
-	  char *digits, *bp, *rve;
+	  char *digits, *bp, *rve, fast_buf[20];
 #ifndef _MB_CAPABLE
 	  int i;
 #endif
 
-	  digits = _DTOA_R (data, value, mode, ndigits, decpt, &dsgn, &rve);
+	  /* Try without bignums first. */
+# ifdef _NO_LONGDBL
+	  if (__dtoa_fast (value, mode, ndigits, fast_buf, decpt, &rve))
+# else
+	  if ((double) value == value
+	      && __dtoa_fast ((double) value, mode, ndigits, fast_buf, decpt,
+			      &rve))
+# endif
+		digits = fast_buf;
+	  else
+		digits = _DTOA_R (data, value, mode, ndigits, decpt, &dsgn,
+				  &rve);
 
 	  if ((ch != L'g' && ch != L'G') || flags & ALT) {	/* Print trailing zeros */
 		bp = digits + ndigits;
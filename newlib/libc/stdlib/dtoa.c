@@ -284,6 +284,28 @@ _dtoa_r (struct _reent *ptr,
       return s;
     }
 
+  if (mode == 2 || mode == 3)
+    {
+      /* Most of the time, a few significant digits can be computed
+	 without bignums. */
+      char buf[20];
+
+      if (__dtoa_fast (d.d, mode, ndigits, buf, decpt, &s))
+	{
+	  /* Leave room for the suppressed trailing zeros, as below. */
+	  for (i = 0, j = sizeof (__ULong);
+	       sizeof (_Bigint) - sizeof (__ULong) + j <= 18; j <<= 1)
+	    i++;
+	  _REENT_MP_RESULT_K(ptr) = i;
+	  _REENT_MP_RESULT(ptr) = eBalloc (ptr, i);
+	  s0 = (char *) _REENT_MP_RESULT(ptr);
+	  memcpy (s0, buf, s - buf + 1);
+	  if (rve)
+	    *rve = s0 + (s - buf);
+	  return s0;
+	}
+    }
+
   b = d2b (ptr, d.d, &be, &bbits);
 #ifdef Sudden_Underflow
   i = (int) (word0 (d) >> Exp_shift1 & (Exp_mask >> Exp_shift1));
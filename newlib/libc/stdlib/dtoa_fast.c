@@ -0,0 +1,171 @@
+/* Fast path for _dtoa_r modes 2 and 3, as used by printf's %e, %f and %g
+   and by ecvt, fcvt and gcvt.
+
+   For up to 17 significant digits, the digits of d * 10^q are computed
+   with a 64 x 128 bit multiplication by a power of five from the table in
+   fast_pow5.c.  The integer part of the product and enough of its fraction
+   to round correctly are exact, unless the fraction is within the error
+   of the table entry of a rounding boundary.  Then, as for more digits,
+   the caller has to use the bignum algorithm in dtoa.c.  Since both round
+   the exact binary value half to even, the result is always the same.
+
+   This file has no dependencies on the rest of newlib, so that the host
+   tests in winsup/testsuite/host can use it directly. */
+
+#include <sys/types.h>
+#include <math.h>
+#include "fast_pow5.h"
+
+#if !defined (_DOUBLE_IS_32BITS) && !defined (PREFER_SIZE_OVER_SPEED) \
+    && !defined (__OPTIMIZE_SIZE__)
+
+#define FAST_DTOA_MAX	17
+
+static const __uint64_t fast_tens[FAST_DTOA_MAX + 1] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL
+};
+
+static __uint64_t
+double_bits (double d)
+{
+  union
+  {
+    double d;
+    __uint64_t u;
+    __uint32_t w[2];
+  } x;
+
+  x.d = d;
+#ifdef __IEEE_BYTES_LITTLE_ENDIAN
+  /* Little endian words in big endian order. */
+  return (__uint64_t) x.w[0] << 32 | x.w[1];
+#else
+  return x.u;
+#endif
+}
+
+/* Like _dtoa_r (d, mode, ndigits, decpt, &sign, rve) for positive D and
+   mode 2 or 3, but store the digits in BUF, which must have room for
+   FAST_DTOA_MAX + 1 chars.  Return 0 if the digits can't be computed this
+   way. */
+int
+__dtoa_fast (double d, int mode, int ndigits, char *buf, int *decpt,
+	     char **rve)
+{
+  __uint64_t bits = double_bits (d), m, r0, r1, r2, lo, fh, half, dig;
+  const __uint64_t *p5;
+  int be, e, k, n, q, t, up, tries;
+  char *s;
+
+  if (mode != 2 && mode != 3)
+    return 0;
+  be = (bits >> 52) & 0x7ff;
+  m = bits & (((__uint64_t) 1 << 52) - 1);
+  if (be == 0x7ff || (bits >> 63))
+    return 0;
+  if (be)
+    {
+      m |= (__uint64_t) 1 << 52;
+      e = be - 1075;
+    }
+  else if (m)
+    e = -1074;
+  else
+    return 0;
+  /* d = m * 2^e with the top bit of m set, so 2^(e + 63) <= d, and
+     floor (log10 (d)) is k or k + 1. */
+  t = __builtin_clzll (m);
+  m <<= t;
+  e -= t;
+  k = ((e + 63) * 78913) >> 18;
+
+  for (tries = 0; tries < 2; tries++)
+    {
+      n = mode == 2 ? (ndigits > 0 ? ndigits : 1) : ndigits + k + 1;
+      if (n < 1 || n > FAST_DTOA_MAX)
+	return 0;
+      q = n - 1 - k;
+      if (q < FAST_POW10_MIN || q > FAST_POW10_MAX)
+	return 0;
+
+      /* d * 10^q = m * 5^q * 2^(e + q) = (r2:r1:r0) * 2^-(128 + t). */
+      p5 = __fast_pow5[q - FAST_POW10_MIN];
+      r1 = fast_mul128 (m, p5[1], &r0);
+      r2 = fast_mul128 (m, p5[0], &lo);
+      r1 += lo;
+      r2 += r1 < lo;
+      t = 127 - e - q - FAST_LOG2_POW5 (q) - 128;
+      if (t < 1 || t > 63)
+	return 0;
+      dig = r2 >> t;
+      if (dig < fast_tens[n - 1])
+	k--;
+      else if (dig >= fast_tens[n])
+	k++;
+      else
+	break;
+    }
+  if (tries == 2)
+    return 0;
+
+  /* Round half to even, using the fraction fh:r1:r0. */
+  fh = r2 & ((((__uint64_t) 1) << t) - 1);
+  half = (__uint64_t) 1 << (t - 1);
+  if (q >= 0 && q <= 55)
+    {
+      /* The table entry is exact, and so is the fraction. */
+      if (fh != half)
+	up = fh > half;
+      else
+	up = r1 || r0 || (dig & 1);
+    }
+  else
+    {
+      /* The table entry and thus the product is off by less than m, so
+	 fh:r1 is off by at most one either way, one more for ignoring r0.
+	 Give up if that could make a difference for rounding, or for the
+	 integer part. */
+      if ((fh == half && r1 <= 2) || (fh == half - 1 && r1 >= ~(__uint64_t) 2)
+	  || (fh == 0 && r1 <= 2)
+	  || (fh == half * 2 - 1 && r1 >= ~(__uint64_t) 2))
+	return 0;
+      up = fh >= half;
+    }
+  dig += up;
+  if (dig == fast_tens[n])
+    {
+      dig = fast_tens[n - 1];
+      k++;
+    }
+
+  /* The digits, without trailing zeros. */
+  while (dig % 10 == 0)
+    {
+      dig /= 10;
+      n--;
+    }
+  s = buf + n;
+  *s = '\0';
+  do
+    *--s = '0' + dig % 10;
+  while (dig /= 10);
+  *decpt = k + 1;
+  if (rve)
+    *rve = buf + n;
+  return 1;
+}
+
+#else
+
+int
+__dtoa_fast (double d, int mode, int ndigits, char *buf, int *decpt,
+	     char **rve)
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,41 @@
+/* Powers of five with 128 bits precision for the fast paths of strtod
+   and dtoa, see strtod_fast.h and dtoa_fast.h.
+
+   This file has no dependencies on the rest of newlib, so that the host
+   tests in winsup/testsuite/host can use it directly. */
+
+#ifndef _FAST_POW5_H_
+#define _FAST_POW5_H_
+
+#define FAST_POW10_MIN	-342
+#define FAST_POW10_MAX	308
+
+/* The 128 most significant bits of 5^q for FAST_POW10_MIN <= q <=
+   FAST_POW10_MAX, normalized so the top bit is set.  For negative q, the
+   reciprocal is rounded up.  The values are exact for 0 <= q <= 55. */
+extern const __uint64_t __fast_pow5[FAST_POW10_MAX - FAST_POW10_MIN + 1][2];
+
+/* floor (log2 (5^q)) for FAST_POW10_MIN <= q <= FAST_POW10_MAX. */
+#define FAST_LOG2_POW5(q)	((((152170 + 65536) * (q)) >> 16) - (q))
+
+/* Return the high 64 bits of A * B and store the low ones in *LO. */
+static inline __uint64_t
+fast_mul128 (__uint64_t a, __uint64_t b, __uint64_t *lo)
+{
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 r = (unsigned __int128) a * b;
+
+  *lo = (__uint64_t) r;
+  return (__uint64_t) (r >> 64);
+#else
+  __uint64_t al = (__uint32_t) a, ah = a >> 32;
+  __uint64_t bl = (__uint32_t) b, bh = b >> 32;
+  __uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+  __uint64_t mid = (ll >> 32) + (__uint32_t) lh + (__uint32_t) hl;
+
+  *lo = (mid << 32) | (__uint32_t) ll;
+  return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+
+#endif /* _FAST_POW5_H_ */
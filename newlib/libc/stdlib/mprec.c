@@ -93,6 +93,66 @@
 #define _Kmax 15
 */
 
+#ifdef MPREC_STATS
+/* Calls of Balloc, and how many of them had to allocate memory, for
+   cygwin_internal (CW_MPREC_STATS).  Only for tuning: the counters aren't
+   updated atomically, so they can be off with several threads. */
+__uint64_t __mprec_balloc_count;
+__uint64_t __mprec_heap_count;
+#define	STATS(s)	((void)(s))
+#else
+#define	STATS(s)	((void)0)
+#endif
+
+#if !defined(PREFER_SIZE_OVER_SPEED) && !defined(__OPTIMIZE_SIZE__)
+/* The first time a thread needs a Bigint, mprec_seed[k] Bigints for small
+   k are allocated together with the freelists and put on them.  That's
+   enough for converting the usual doubles, so _dtoa_r, _strtod_r and
+   _ldtoa_r don't call malloc at all after that, and the first conversion
+   calls it once.  The freelists have one more entry after the ones for
+   k = 0 ... _Kmax, which points to the end of the seeded Bigints, so
+   _reclaim_reent knows not to free them one by one. */
+static const unsigned char mprec_seed[] = { 8, 8, 6, 4 };
+#define MPREC_SEED_KMAX	((int) sizeof mprec_seed - 1)
+#else
+static const unsigned char mprec_seed[] = { 0 };
+#define MPREC_SEED_KMAX	-1
+#endif
+
+/* The size of a Bigint for K, rounded up to keep the next one aligned. */
+#define BIGINT_SIZE(k) \
+  ((sizeof (_Bigint) + ((1 << (k)) - 1) * sizeof (__ULong) \
+    + sizeof (_Bigint *) - 1) & ~(sizeof (_Bigint *) - 1))
+
+static int
+seed_freelist (struct _reent *ptr)
+{
+  size_t size = (_Kmax + 2) * sizeof (_Bigint *);
+  _Bigint **freelist, *b;
+  char *p;
+  int k, i;
+
+  for (k = 0; k <= MPREC_SEED_KMAX; k++)
+    size += mprec_seed[k] * BIGINT_SIZE (k);
+  STATS (++__mprec_heap_count);
+  freelist = (_Bigint **) _calloc_r (ptr, 1, size);
+  if (freelist == NULL)
+    return 0;
+  p = (char *) (freelist + _Kmax + 2);
+  for (k = 0; k <= MPREC_SEED_KMAX; k++)
+    for (i = 0; i < mprec_seed[k]; i++, p += BIGINT_SIZE (k))
+      {
+	b = (_Bigint *) p;
+	b->_k = k;
+	b->_maxwds = 1 << k;
+	b->_next = freelist[k];
+	freelist[k] = b;
+      }
+  freelist[_Kmax + 1] = (_Bigint *) p;
+  _REENT_MP_FREELIST(ptr) = freelist;
+  return 1;
+}
+
 _Bigint *
 Balloc (struct _reent *ptr, int k)
 {
@@ -100,17 +160,9 @@ Balloc (struct _reent *ptr, int k)
   _Bigint *rv ;
 
   _REENT_CHECK_MP(ptr);
-  if (_REENT_MP_FREELIST(ptr) == NULL)
-    {
-      /* Allocate a list of pointers to the mprec objects */
-      _REENT_MP_FREELIST(ptr) = (struct _Bigint **) _calloc_r (ptr, 
-						      sizeof (struct _Bigint *),
-						      _Kmax + 1);
-      if (_REENT_MP_FREELIST(ptr) == NULL)
-	{
-	  return NULL;
-	}
-    }
+  STATS (++__mprec_balloc_count);
+  if (_REENT_MP_FREELIST(ptr) == NULL && !seed_freelist (ptr))
+    return NULL;
 
   if ((rv = _REENT_MP_FREELIST(ptr)[k]) != 0)
     {
@@ -120,6 +172,7 @@ Balloc (struct _reent *ptr, int k)
     {
       x = 1 << k;
       /* Allocate an mprec Bigint and stick in in the freelist */
+      STATS (++__mprec_heap_count);
       rv = (_Bigint *) _calloc_r (ptr,
 				  1,
 				  sizeof (_Bigint) +
@@ -382,6 +382,8 @@ __ULong		any_on (_Bigint *b, int k);
 void		copybits (__ULong *c, int n, _Bigint *b);
 double		_strtod_l (struct _reent *ptr, const char *__restrict s00,
 			   char **__restrict se, locale_t loc);
+int		__dtoa_fast (double d, int mode, int ndigits, char *buf,
+			     int *decpt, char **rve);
 #if defined (_HAVE_LONG_DOUBLE) && !defined (_LDBL_EQ_DBL)
 int		_strtorx_l (struct _reent *, const char *, char **, int,
 			    void *, locale_t);
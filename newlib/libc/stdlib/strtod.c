@@ -139,6 +139,15 @@ THIS SOFTWARE.
 #include "gdtoa.h"
 #include "../locale/setlocale.h"
 
+/* The Eisel-Lemire fast path needs IEEE doubles and round to nearest,
+   and can't raise the inexact flag. */
+#if defined (IEEE_Arith) && !defined (_DOUBLE_IS_32BITS) \
+    && !defined (Honor_FLT_ROUNDS) && !defined (SET_INEXACT) \
+    && !defined (PREFER_SIZE_OVER_SPEED) && !defined (__OPTIMIZE_SIZE__)
+#define Fast_Path
+#include "strtod_fast.h"
+#endif
+
 /* #ifndef NO_FENV_H */
 /* #include <fenv.h> */
 /* #endif */
@@ -554,6 +563,20 @@ _strtod_l (struct _reent *ptr, const char *__restrict s00, char **__restrict se,
 			}
 #endif
 		}
+#ifdef Fast_Path
+	/* Too many digits or too large an exponent for the simple cases
+	 * above.  Try Eisel-Lemire before resorting to bignums.
+	 */
+	if (Flt_Rounds == 1) {
+		__uint64_t bits;
+
+		if (_strtod_fast (s0, nd0, nd, dec_len, e, &bits)) {
+			dword0(rv) = (__ULong)(bits >> 32);
+			dword1(rv) = (__ULong)bits;
+			goto ret;
+			}
+		}
+#endif
 	e1 += nd - k;
 
 #ifdef IEEE_Arith
@@ -0,0 +1,104 @@
+/* Fast path for strtod: the Eisel-Lemire algorithm.
+
+   Converts a decimal significand of at most 19 digits times a power of ten
+   to the nearest double, using a 64 x 128 bit multiplication with a
+   truncated power of five from a table, see
+
+     Daniel Lemire, "Number Parsing at a Gigabyte per Second",
+     Software: Practice and Experience 51(8), 2021.
+
+   The result is correctly rounded unless the product is too close to a
+   halfway point to decide, in which case the caller has to fall back to
+   the exact bignum algorithm in strtod.c.  Subnormal results, overflow
+   and underflow are left to the exact algorithm as well, so that errno is
+   handled in one place.
+
+   This file has no dependencies on the rest of newlib, so that the host
+   tests in winsup/testsuite/host can include it directly. */
+
+#include "fast_pow5.h"
+
+/* Convert W * 10^Q to a double and store its bits in *BITS.  W must not
+   be zero.  Return 0 if the result can't be determined this way. */
+static int
+fast_w10q (__uint64_t w, int q, __uint64_t *bits)
+{
+  const __uint64_t *p5;
+  __uint64_t hi, lo, hi2, lo2, m;
+  int lz, upper, e2;
+
+  if (q < FAST_POW10_MIN || q > FAST_POW10_MAX)
+    return 0;
+  lz = __builtin_clzll (w);
+  w <<= lz;
+
+  /* We need 55 good bits: 52 mantissa bits, the implicit one, the
+     rounding bit and the bit the product may shift by.  Only if the low
+     9 bits of the upper half are all ones can the truncation of the table
+     entry matter, so only then multiply with the low half as well. */
+  p5 = __fast_pow5[q - FAST_POW10_MIN];
+  hi = fast_mul128 (w, p5[0], &lo);
+  if ((hi & 0x1ff) == 0x1ff)
+    {
+      hi2 = fast_mul128 (w, p5[1], &lo2);
+      lo += hi2;
+      if (lo < hi2)
+	hi++;
+      /* Still ambiguous, unless 5^q fits into the table entry exactly. */
+      if (lo == ~(__uint64_t) 0 && (q < -27 || q > 55))
+	return 0;
+    }
+
+  upper = hi >> 63;
+  m = hi >> (upper + 9);
+  /* floor (log2 (10^q)) + 63 is the exponent of the product, plus the
+     bias of 1023 and the normalization shift. */
+  e2 = FAST_LOG2_POW5 (q) + q + 63 + upper - lz + 1023;
+  if (e2 <= 0)
+    return 0;
+
+  /* Exactly halfway between two doubles: this can only happen when the
+     product is exact, which needs -4 <= q <= 23.  Round to even. */
+  if (lo <= 1 && q >= -4 && q <= 23 && (m & 3) == 1
+      && (m << (upper + 9)) == hi)
+    m &= ~(__uint64_t) 1;
+
+  m += m & 1;
+  m >>= 1;
+  if (m >= (__uint64_t) 2 << 52)
+    {
+      m = (__uint64_t) 1 << 52;
+      e2++;
+    }
+  if (e2 >= 0x7ff)
+    return 0;
+  *bits = (m & (((__uint64_t) 1 << 52) - 1)) | ((__uint64_t) e2 << 52);
+  return 1;
+}
+
+/* The number in strtod.c's terms: ND significant digits starting at S0,
+   with a decimal point of DEC_LEN chars after the first ND0 of them,
+   times 10^E.  Digits beyond the 19th are truncated, the result is only
+   used if rounding the truncated significand and its successor gives the
+   same double. */
+static int
+_strtod_fast (const char *s0, int nd0, int nd, int dec_len, int e,
+	      __uint64_t *bits)
+{
+  __uint64_t w = 0, bits1;
+  int i, n = nd < 19 ? nd : 19;
+  const char *s = s0;
+
+  for (i = 0; i < n; i++, s++)
+    {
+      if (i == nd0)
+	s += dec_len;
+      w = 10 * w + (*s - '0');
+    }
+  e += nd - n;
+  if (!fast_w10q (w, e, bits))
+    return 0;
+  if (n < nd && (!fast_w10q (w + 1, e, &bits1) || bits1 != *bits))
+    return 0;
+  return 1;
+}
@@ -0,0 +1,291 @@
+/*
+ * Test conversions between single-byte table encodings and UTF-8 or UCS-2,
+ * which convert whole buffers at once.
+ *
+ * Every byte of the encoding must survive the way to UTF-8, UCS-2BE and
+ * UCS-2LE and back, give the same result as the conversion through UCS-4
+ * if that is linked in, and the same result with any size of the output
+ * buffer.  Invalid and unrepresentable characters and short buffers must be
+ * reported as before, with the buffer pointers right before the character
+ * in question.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iconv.h>
+#include <errno.h>
+#include <newlib.h>
+#include "check.h"
+
+#if defined(_ICONV_ENABLED) \
+ && defined(_ICONV_FROM_ENCODING_UTF_8) && defined(_ICONV_TO_ENCODING_UTF_8) \
+ && ((defined(_ICONV_FROM_ENCODING_KOI8_R) && defined(_ICONV_TO_ENCODING_KOI8_R)) \
+  || (defined(_ICONV_FROM_ENCODING_WIN_1252) && defined(_ICONV_TO_ENCODING_WIN_1252)) \
+  || (defined(_ICONV_FROM_ENCODING_ISO_8859_5) && defined(_ICONV_TO_ENCODING_ISO_8859_5)))
+
+#if defined(_ICONV_FROM_ENCODING_UCS_2BE) && defined(_ICONV_TO_ENCODING_UCS_2BE) \
+ && defined(_ICONV_FROM_ENCODING_UCS_2LE) && defined(_ICONV_TO_ENCODING_UCS_2LE)
+#define HAVE_UCS_2
+#endif
+#if defined(_ICONV_FROM_ENCODING_UCS_4BE) && defined(_ICONV_TO_ENCODING_UCS_4BE)
+#define HAVE_UCS_4
+#endif
+
+static const char *charsets[] =
+{
+#if defined(_ICONV_FROM_ENCODING_KOI8_R) && defined(_ICONV_TO_ENCODING_KOI8_R)
+    "KOI8-R",
+#endif
+#if defined(_ICONV_FROM_ENCODING_WIN_1252) && defined(_ICONV_TO_ENCODING_WIN_1252)
+    "CP1252",
+#endif
+#if defined(_ICONV_FROM_ENCODING_ISO_8859_5) && defined(_ICONV_TO_ENCODING_ISO_8859_5)
+    "ISO-8859-5",
+#endif
+};
+#define NCHARSETS (sizeof(charsets) / sizeof(charsets[0]))
+
+#define BUFLEN 4096
+
+static char *in, *out, *out2, *back;
+
+/*
+ * Convert N bytes from IB with CD into OB, with OBLEN bytes of output buffer
+ * at a time, which must be room for at least one character.  Returns the
+ * number of output bytes, or -1 with errno set on an error other than E2BIG.
+ */
+static long
+convert(iconv_t cd, const char *ib, size_t n, char *ob, size_t oblen)
+{
+    char *ip = (char *)ib, *op = ob;
+    size_t inleft = n, outleft;
+
+    while (inleft > 0)
+    {
+        outleft = oblen;
+        if (iconv(cd, &ip, &inleft, &op, &outleft) == (size_t)-1)
+        {
+            if (errno != E2BIG)
+                return -1;
+            /* Only the next character may be missing */
+            CHECK(outleft < 3 && outleft < oblen);
+        }
+    }
+    return op - ob;
+}
+
+static long
+convert_names(const char *to, const char *from, const char *ib, size_t n,
+              char *ob)
+{
+    iconv_t cd = iconv_open(to, from);
+    long len;
+
+    CHECK(cd != (iconv_t)-1);
+    len = convert(cd, ib, n, ob, BUFLEN);
+    CHECK(iconv_close(cd) != -1);
+    return len;
+}
+
+/* Find the bytes CS can convert, put them into IN, return their number */
+static int
+valid_bytes(const char *cs, unsigned char *valid)
+{
+    iconv_t cd = iconv_open("UTF-8", cs);
+    char c, u[8], *ip, *op;
+    size_t il, ol;
+    int i, n = 0;
+
+    CHECK(cd != (iconv_t)-1);
+    for (i = 0; i < 256; i++)
+    {
+        c = (char)i;
+        ip = &c;
+        op = u;
+        il = 1;
+        ol = sizeof(u);
+        if (iconv(cd, &ip, &il, &op, &ol) == (size_t)-1)
+        {
+            CHECK(errno == EILSEQ && ip == &c && op == u && il == 1);
+            valid[i] = 0;
+        }
+        else
+        {
+            CHECK(il == 0 && ol < sizeof(u));
+            valid[i] = 1;
+            in[n++] = c;
+        }
+    }
+    CHECK(iconv_close(cd) != -1);
+    return n;
+}
+
+static void
+check_roundtrip(const char *cs, const char *via, const char *ib, size_t n)
+{
+    long len, len2;
+    size_t oblen;
+
+    len = convert_names(via, cs, ib, n, out);
+    CHECK(len > 0);
+    CHECK(convert_names(cs, via, out, len, back) == (long)n);
+    CHECK(memcmp(back, ib, n) == 0);
+
+    /* Same result with any output buffer size */
+    for (oblen = 3; oblen <= 9; oblen++)
+    {
+        iconv_t cd = iconv_open(via, cs);
+
+        CHECK(cd != (iconv_t)-1);
+        len2 = convert(cd, ib, n, out2, oblen);
+        CHECK(len2 == len && memcmp(out, out2, len) == 0);
+        CHECK(iconv_close(cd) != -1);
+        cd = iconv_open(cs, via);
+        CHECK(cd != (iconv_t)-1);
+        CHECK(convert(cd, out, len, back, oblen) == (long)n);
+        CHECK(memcmp(back, ib, n) == 0);
+        CHECK(iconv_close(cd) != -1);
+    }
+}
+
+#ifdef HAVE_UCS_4
+/* Compare with the conversion through UCS-4, which is done as before */
+static void
+check_ucs_4(const char *cs, const char *ib, size_t n)
+{
+    long len, len4;
+    size_t i, j = 0;
+    unsigned long c;
+
+    len = convert_names("UTF-8", cs, ib, n, out);
+    len4 = convert_names("UCS-4BE", cs, ib, n, out2);
+    CHECK(len4 == (long)n * 4);
+    for (i = 0; i < n; i++)
+    {
+        c = (unsigned long)(unsigned char)out2[4 * i] << 24
+            | (unsigned long)(unsigned char)out2[4 * i + 1] << 16
+            | (unsigned long)(unsigned char)out2[4 * i + 2] << 8
+            | (unsigned char)out2[4 * i + 3];
+        CHECK(c < 0x10000);
+        if (c < 0x80)
+        {
+            CHECK((unsigned char)out[j++] == c);
+        }
+        else if (c < 0x800)
+        {
+            CHECK((unsigned char)out[j++] == (0xc0 | c >> 6));
+            CHECK((unsigned char)out[j++] == (0x80 | (c & 0x3f)));
+        }
+        else
+        {
+            CHECK((unsigned char)out[j++] == (0xe0 | c >> 12));
+            CHECK((unsigned char)out[j++] == (0x80 | ((c >> 6) & 0x3f)));
+            CHECK((unsigned char)out[j++] == (0x80 | (c & 0x3f)));
+        }
+    }
+    CHECK((long)j == len);
+}
+#endif
+
+static void
+check_errors(const char *cs, const unsigned char *valid)
+{
+    iconv_t cd;
+    char *ip, *op;
+    size_t il, ol;
+    int i;
+
+    /* A byte without mapping in the middle */
+    for (i = 0; i < 256 && valid[i]; i++)
+        ;
+    if (i < 256)
+    {
+        char buf[] = "abc?def";
+
+        buf[3] = (char)i;
+        cd = iconv_open("UTF-8", cs);
+        ip = buf;
+        il = 7;
+        op = out;
+        ol = BUFLEN;
+        CHECK(iconv(cd, &ip, &il, &op, &ol) == (size_t)-1 && errno == EILSEQ);
+        CHECK(ip == buf + 3 && il == 4 && op == out + 3);
+        CHECK(iconv_close(cd) != -1);
+    }
+
+    /* Invalid and incomplete UTF-8 */
+    cd = iconv_open(cs, "UTF-8");
+    ip = "abc\xc0\x80";
+    il = 5;
+    op = out;
+    ol = BUFLEN;
+    CHECK(iconv(cd, &ip, &il, &op, &ol) == (size_t)-1 && errno == EILSEQ);
+    CHECK(il == 2 && op == out + 3 && memcmp(out, "abc", 3) == 0);
+    ip = "abc\xe2\x82";
+    il = 5;
+    op = out;
+    ol = BUFLEN;
+    CHECK(iconv(cd, &ip, &il, &op, &ol) == (size_t)-1 && errno == EINVAL);
+    CHECK(il == 2 && op == out + 3);
+
+    /* Not representable: U+4E2D is replaced and counted */
+    ip = "ab\xe4\xb8\xad" "cd";
+    il = 7;
+    op = out;
+    ol = BUFLEN;
+    CHECK(iconv(cd, &ip, &il, &op, &ol) == 1);
+    CHECK(il == 0 && op == out + 5 && memcmp(out, "ab?cd", 5) == 0);
+
+    /* Output buffer too small */
+    ip = "abcdef";
+    il = 6;
+    op = out;
+    ol = 4;
+    CHECK(iconv(cd, &ip, &il, &op, &ol) == (size_t)-1 && errno == E2BIG);
+    CHECK(il == 2 && ol == 0 && op == out + 4);
+    CHECK(iconv_close(cd) != -1);
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned char valid[256];
+    size_t nvalid;
+    unsigned int cs;
+
+    puts("single-byte iconv test");
+
+    in = malloc(BUFLEN);
+    out = malloc(4 * BUFLEN);
+    out2 = malloc(4 * BUFLEN);
+    back = malloc(BUFLEN);
+    CHECK(in != NULL && out != NULL && out2 != NULL && back != NULL);
+
+    for (cs = 0; cs < NCHARSETS; cs++)
+    {
+        nvalid = valid_bytes(charsets[cs], valid);
+        CHECK(nvalid > 128);
+
+        check_roundtrip(charsets[cs], "UTF-8", in, nvalid);
+#ifdef HAVE_UCS_2
+        check_roundtrip(charsets[cs], "UCS-2BE", in, nvalid);
+        check_roundtrip(charsets[cs], "UCS-2LE", in, nvalid);
+#endif
+#ifdef HAVE_UCS_4
+        check_ucs_4(charsets[cs], in, nvalid);
+#endif
+        check_errors(charsets[cs], valid);
+        printf("%s passed\n", charsets[cs]);
+    }
+
+    exit(0);
+}
+
+#else
+int
+main(int argc, char **argv)
+{
+    puts("None of KOI8-R, CP1252 and ISO-8859-5 or no UTF-8, SKIP test");
+    exit(0);
+}
+#endif
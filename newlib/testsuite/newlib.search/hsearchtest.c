@@ -31,6 +31,9 @@
 
 /*
  * Test program for hsearch() et al.
+ *
+ * Also checks that tables grow beyond the nel given to hcreate_r(), with
+ * the pointers returned earlier still valid.
  */
 
 #include <sys/cdefs.h>
@@ -47,6 +50,8 @@ __COPYRIGHT(
 #include <stdio.h>
 #include <string.h>
 
+#define	NKEYS	2000
+
 #define	TEST(e)	((e) ? (void)0 : testfail(__FILE__, __LINE__, #e))
 
 static void
@@ -58,6 +63,72 @@ testfail(const char *file, unsigned long line, const char *expression)
 	exit(1);
 }
 
+/*
+ * Enter NKEYS keys into a table created for NEL of them, look them all up,
+ * and some which aren't there.
+ */
+static void
+growtest(size_t nel)
+{
+	struct hsearch_data htab;
+	ENTRY e, *ep, *first = NULL;
+	char **keys, miss[32];
+	long i;
+
+	keys = malloc(NKEYS * sizeof keys[0]);
+	TEST(keys != NULL);
+	for (i = 0; i < NKEYS; i++) {
+		keys[i] = malloc(16);
+		TEST(keys[i] != NULL);
+		snprintf(keys[i], 16, "key%ld", i * 7919 % NKEYS);
+	}
+
+	memset(&htab, 0, sizeof htab);
+	TEST(hcreate_r(nel, &htab));
+	TEST(!hcreate_r(nel, &htab));	/* Exists already. */
+
+	for (i = 0; i < NKEYS; i++) {
+		e.key = keys[i];
+		e.data = (void *)i;
+		TEST(hsearch_r(e, ENTER, &ep, &htab));
+		TEST(ep->key == keys[i] && (long)ep->data == i);
+		if (i == 0)
+			first = ep;
+	}
+	/* Entered before the table grew, and still the same. */
+	TEST(first->key == keys[0] && (long)first->data == 0);
+
+	for (i = 0; i < NKEYS; i++) {
+		char buf[16];
+
+		/* A copy, so the key has to be compared. */
+		strcpy(buf, keys[i]);
+		e.key = buf;
+		TEST(hsearch_r(e, FIND, &ep, &htab));
+		TEST(ep->key == keys[i] && (long)ep->data == i);
+	}
+
+	for (i = 0; i < NKEYS; i++) {
+		snprintf(miss, sizeof miss, "key%ld", NKEYS + i);
+		e.key = miss;
+		TEST(!hsearch_r(e, FIND, &ep, &htab));
+		TEST(ep == NULL);
+	}
+
+	/* Entering an existing key finds it. */
+	e.key = keys[1];
+	e.data = (void *)12345L;
+	TEST(hsearch_r(e, ENTER, &ep, &htab));
+	TEST(ep->key == keys[1] && (long)ep->data == 1);
+
+	hdestroy_r(&htab);
+	TEST(htab.htable == NULL);
+
+	for (i = 0; i < NKEYS; i++)
+		free(keys[i]);
+	free(keys);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -121,5 +192,8 @@ main(int argc, char *argv[])
 
 	hdestroy();
 
+	growtest(16);
+	growtest(NKEYS);
+
 	exit(0);
 }
@@ -0,0 +1,174 @@
+/*
+ * Test program for tsearch() et al.
+ *
+ * Inserts and deletes keys in sorted, reversed and random order, checks
+ * the results against a plain array, that twalk() visits the nodes in
+ * order and that the tree stays balanced.
+ *
+ * Public domain.
+ */
+
+#include <search.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define	NKEYS	100000
+
+#define	TEST(e)	((e) ? (void)0 : testfail(__FILE__, __LINE__, #e))
+
+static void
+testfail(const char *file, unsigned long line, const char *expression)
+{
+
+	fprintf(stderr, "TEST FAILED: %s: file %s, line %ld\n",
+	    expression, file, line);
+	exit(1);
+}
+
+static int *vals, *keys;
+static char *present;
+static long nwalked, maxlevel, nfreed;
+static int last;
+
+static int
+compar(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+walk(const void *node, VISIT v, int level)
+{
+	int k = **(int *const *)node;
+
+	if (level > maxlevel)
+		maxlevel = level;
+	if (v == postorder || v == leaf) {
+		TEST(nwalked == 0 || k > last);
+		TEST(present[k]);
+		last = k;
+		nwalked++;
+	}
+}
+
+static void
+freekey(void *key)
+{
+	TEST(present[*(int *)key]);
+	nfreed++;
+}
+
+/*
+ * Fill keys with 0 ... N-1 in ORDER: 0 sorted, 1 reversed, 2 random.  The
+ * tree holds pointers into vals, which stay the same.
+ */
+static void
+makekeys(long n, int order)
+{
+	long i, j;
+	int t;
+
+	for (i = 0; i < n; i++)
+		keys[i] = (order == 1) ? n - 1 - i : i;
+	if (order == 2)
+		for (i = n - 1; i > 0; i--) {
+			j = random() % (i + 1);
+			t = keys[i];
+			keys[i] = keys[j];
+			keys[j] = t;
+		}
+}
+
+/* Walk the tree, which must have N nodes, and be balanced. */
+static void
+checktree(void *root, long n)
+{
+	long lg, m;
+
+	nwalked = maxlevel = 0;
+	twalk(root, walk);
+	TEST(nwalked == n);
+	/* The height of an AVL tree is less than 1.45 log2(n + 2). */
+	for (lg = 1, m = n + 2; m > 1; m /= 2)
+		lg++;
+	TEST(maxlevel + 1 < 1.45 * lg);
+}
+
+static void
+checkorder(long n, int order)
+{
+	void *root = NULL, **np;
+	long i, count = 0;
+	int k, *nodekey;
+
+	makekeys(n, order);
+	memset(present, 0, n);
+	for (i = 0; i < n; i++) {
+		np = tsearch(&vals[keys[i]], &root, compar);
+		TEST(np != NULL && *np == &vals[keys[i]]);
+		present[keys[i]] = 1;
+		count++;
+		/* Entering it again finds the same node. */
+		TEST(tsearch(&keys[i], &root, compar) == np);
+	}
+	checktree(root, count);
+
+	/* The node of key 0 must stay where it is while others go. */
+	k = 0;
+	np = tfind(&k, &root, compar);
+	TEST(np != NULL && **(int **)np == 0);
+	nodekey = *np;
+
+	/* Delete every other key, in another order. */
+	makekeys(n, 2);
+	for (i = 0; i < n; i += 2) {
+		k = keys[i];
+		if (k == 0)
+			continue;
+		TEST(tdelete(&k, &root, compar) != NULL);
+		TEST(tdelete(&k, &root, compar) == NULL);
+		present[k] = 0;
+		count--;
+		if (i % 1024 == 0)
+			checktree(root, count);
+	}
+	checktree(root, count);
+	TEST(*np == nodekey);
+	for (k = 0; k < n; k++)
+		TEST((tfind(&k, &root, compar) != NULL) == present[k]);
+
+	nfreed = 0;
+	tdestroy(root, freekey);
+	TEST(nfreed == count);
+}
+
+int
+main(int argc, char *argv[])
+{
+	void *root = NULL;
+	long n;
+	int order, k = 0;
+
+	vals = malloc(NKEYS * sizeof vals[0]);
+	keys = malloc(NKEYS * sizeof keys[0]);
+	present = malloc(NKEYS);
+	TEST(vals != NULL && keys != NULL && present != NULL);
+	for (n = 0; n < NKEYS; n++)
+		vals[n] = n;
+
+	/* An empty tree. */
+	TEST(tfind(&k, &root, compar) == NULL);
+	TEST(tdelete(&k, &root, compar) == NULL);
+	TEST(tsearch(&k, NULL, compar) == NULL);
+	twalk(root, walk);
+	tdestroy(root, freekey);
+
+	for (n = 1; n <= NKEYS; n = (n < 10) ? n + 1 : n * 10)
+		for (order = 0; order < 3; order++)
+			checkorder(n, order);
+
+	exit(0);
+}
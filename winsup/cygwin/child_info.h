@@ -133,6 +133,12 @@ public:
   char **envp;
   HANDLE myself_pinfo;
   sigset_t sigmask;
+  /* posix_spawn: signals to reset to SIG_DFL, fds to move, and the tty
+     to make the controlling tty, see child_info_spawn::handle_spawn. */
+  sigset_t sigdefault;
+  int nfdmoves;
+  int *fdmoves;
+  int ctty_fd;
   int nchildren;
   cchildren children[0];
   static cygheap_exec_info *alloc ();
@@ -140,6 +146,20 @@ public:
   void reattach_children (HANDLE);
 };
 
+/* What posix_spawn wants done for the new process, see
+   __posix_spawn_native. */
+struct spawn_actions
+{
+  short flags;		/* POSIX_SPAWN_* */
+  pid_t pgroup;
+  sigset_t sigmask;
+  sigset_t sigdefault;
+  int nfdmoves;
+  int *fdmoves;		/* Pairs of fds, move the first to the second in the
+			   child, or close the first if the second is -1. */
+  int ctty_fd;		/* A tty opened without O_NOCTTY, or -1. */
+};
+
 class child_info_spawn: public child_info
 {
   HANDLE hExeced;
@@ -189,7 +209,7 @@ public:
   bool has_execed_cygwin () const { return iscygwin () && has_execed (); }
   operator HANDLE& () {return hExeced;}
   int __reg3 worker (const char *, const char *const *, const char *const [], int,
-	      int = -1, int = -1);;
+	      int = -1, int = -1, const spawn_actions * = NULL);
 };
 
 extern child_info_spawn ch_spawn;
@@ -22,6 +22,13 @@ int __reg1 dlmalloc_trim (size_t);
 int __reg2 dlmallopt (int p, int v);
 void dlmalloc_stats ();
 
+typedef void *mspace;
+mspace create_mspace_with_base (void *, size_t, int);
+size_t mspace_set_footprint_limit (mspace, size_t);
+void *mspace_malloc (mspace, size_t);
+void mspace_free (mspace, void *);
+void *mspace_realloc (mspace, void *, size_t);
+
 #ifdef __x86_64__
 #define MALLOC_ALIGNMENT ((size_t)16U)
 #endif
@@ -33,12 +40,19 @@ void *mmap64 (void *, size_t, int, int, int, off_t);
 # define mmap mmap64
 # define MALLOC_FAILURE_ACTION	__set_ENOMEM ()
 # define USE_DL_PREFIX 1
+# define MSPACES 1
 
 #elif defined (__INSIDE_CYGWIN__)
 
 # define __malloc_lock() mallock.acquire ()
 # define __malloc_unlock() mallock.release ()
 extern muto mallock;
+struct malloc_magazine;
+void malloc_magazine_release (struct malloc_magazine *);
+void malloc_fixup_after_fork ();
+bool malloc_lock_all ();
+void malloc_unlock_all ();
+void malloc_set_arenas (const char *);
 
 #endif
 
@@ -15,6 +15,7 @@ details. */
 #include "cygheap.h"
 #include "sigproc.h"
 #include "exception.h"
+#include "cygmalloc.h"
 
 /* Two calls to get the stack right... */
 void
@@ -139,6 +140,12 @@ _cygtls::remove (DWORD wait)
   free_local (hostent_buf);
   /* Free temporary TLS path buffers. */
   locals.pathbufs.destroy ();
+  /* Return the blocks cached by malloc. */
+  if (mallocmag)
+    {
+      malloc_magazine_release (mallocmag);
+      mallocmag = NULL;
+    }
   /* Close timer handle. */
   if (locals.cw_timer)
     NtClose (locals.cw_timer);
@@ -208,6 +208,7 @@ public:
   __tlsstack_t *stackptr;
   __tlsstack_t stack[TLS_STACK_SIZE];
   unsigned initialized;
+  struct malloc_magazine *mallocmag;
 
   /*gentls_offsets*/
   void init_thread (void *, DWORD (*) (void *, void *));
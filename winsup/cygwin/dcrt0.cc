@@ -698,6 +698,34 @@ child_info_spawn::handle_spawn ()
     cygheap->fdtab.move_fd (__stdin, 0);
   if (__stdout >= 0)
     cygheap->fdtab.move_fd (__stdout, 1);
+  /* posix_spawn's file actions, boiled down to closes and moves by the
+     parent.  The fds to move are above all others, and unique. */
+  for (int i = 0; i < moreinfo->nfdmoves; i++)
+    {
+      int from = moreinfo->fdmoves[2 * i];
+      int to = moreinfo->fdmoves[2 * i + 1];
+
+      if (to < 0)
+	close (from);
+      else if (!cygheap->fdtab.not_open (from))
+	{
+	  if (!cygheap->fdtab.not_open (to))
+	    close (to);
+	  cygheap->fdtab.move_fd (from, to);
+	  set_std_handle (to);
+	}
+    }
+  /* The parent opened the files with O_NOCTTY.  Do what open would have
+     done with the tty here, see the O_NOCTTY kludge in open. */
+  if (moreinfo->ctty_fd >= 0
+      && (moreinfo->ctty_fd <= 2 || myself->ctty == -2))
+    {
+      cygheap_fdget cfd (moreinfo->ctty_fd, false, false);
+
+      if (cfd >= 0 && (cfd->get_major () == DEV_PTYS_MAJOR
+		       || cfd->get_major () == DEV_CONS_MAJOR))
+	myself->set_ctty ((fhandler_termios *) (fhandler_base *) cfd, 0);
+    }
   cygheap->user.groups.clear_supp ();
 
   /* If we're execing we may have "inherited" a list of children forked by the
@@ -718,6 +746,10 @@ child_info_spawn::handle_spawn ()
     }
 
   signal_fixup_after_exec ();
+  /* posix_spawn's POSIX_SPAWN_SETSIGDEF */
+  for (int i = 1; i < _NSIG; i++)
+    if (sigismember (&moreinfo->sigdefault, i))
+      global_sigs[i].sa_handler = SIG_DFL;
   fixup_lockf_after_exec (type == _CH_EXEC);
 }
 
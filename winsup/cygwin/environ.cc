@@ -29,6 +29,7 @@ details. */
 #include "child_info.h"
 #include "shared_info.h"
 #include "ntdll.h"
+#include "cygmalloc.h"
 
 /* If this is not NULL, it points to memory allocated by us. */
 static char **lastenviron;
@@ -115,6 +116,8 @@ static struct parse_thing
   {"error_start", {func: error_start_init}, isfunc, NULL, {{0}, {0}}},
   {"export", {&export_settings}, setbool, NULL, {{false}, {true}}},
   {"glob", {func: glob_init}, isfunc, NULL, {{0}, {s: "normal"}}},
+  {"malloc_arenas", {func: malloc_set_arenas}, isfunc, NULL,
+   {{0}, {s: "auto"}}},
   {"pipe_byte", {&pipe_byte}, setbool, NULL, {{false}, {true}}},
   {"proc_retry", {func: set_proc_retry}, isfunc, NULL, {{0}, {5}}},
   {"reset_com", {&reset_com}, setbool, NULL, {{false}, {true}}},
@@ -492,6 +495,174 @@ posify_maybe (char **here, const char *value, char *outenv)
   free (src);
 }
 
+/* An open addressing hash index over the environment, so looking up a
+   name doesn't have to compare it against every single environment string.
+
+   The index is only a cache of the environment array.  It remembers which
+   array it indexes and keeps a copy of the pointers in it.  setenv, putenv
+   and unsetenv keep it up to date.  If the application assigns a new array
+   to environ, the lookup notices it from the pointer alone.  If it changes
+   the pointers in the array behind our back, a lookup either finds the
+   indexed pointer replaced, or, if the name isn't in the index, finds the
+   array different from the copy.  In both cases the index is rebuilt from
+   the array.  What isn't noticed is the name of a string passed to putenv
+   being changed in place, or a pointer replaced behind our back by one to
+   a duplicate of a name further down in the array.  In the latter case the
+   lookup returns the later one. */
+class env_index
+{
+  struct slot
+  {
+    char *entry;	/* Environment string, NULL if the slot is unused. */
+    uint32_t hash;
+    int offset;		/* Index of entry in the environment array. */
+  };
+  slot *slots;
+  uint32_t mask;	/* Number of slots - 1. */
+  char **env;		/* The indexed environment array. */
+  char **copy;		/* Copy of the pointers in env, including the NULL. */
+  int count;		/* Number of strings in env. */
+  int copy_size;
+  bool valid;
+
+  bool same_name (const char *entry, const char *name, int len)
+  {
+    return !strncmp (entry, name, len) && entry[len] == '=';
+  }
+  void insert (char *entry, int len, uint32_t h, int offset)
+  {
+    uint32_t i;
+
+    for (i = h & mask; slots[i].entry; i = (i + 1) & mask)
+      if (slots[i].hash == h && same_name (slots[i].entry, entry, len))
+	return;		/* The first one wins, like in a linear scan. */
+    slots[i].entry = entry;
+    slots[i].hash = h;
+    slots[i].offset = offset;
+  }
+  bool reserve_copy (int size)
+  {
+    if (size <= copy_size)
+      return true;
+    size = size * 3 / 2 + 16;
+    char **newcopy = (char **) realloc (copy, size * sizeof *copy);
+    if (!newcopy)
+      return false;
+    copy = newcopy;
+    copy_size = size;
+    return true;
+  }
+
+public:
+  enum { found, absent, stale };
+
+  /* FNV-1a over the name, i.e. up to the first '='. */
+  static uint32_t hash (const char *name, int &len)
+  {
+    uint32_t h = 2166136261U;
+    const char *c;
+
+    for (c = name; *c && *c != '='; ++c)
+      h = (h ^ (unsigned char) *c) * 16777619U;
+    len = c - name;
+    return h;
+  }
+  void invalidate () { valid = false; }
+  bool rebuild (char **cur)
+  {
+    uint32_t size = 32;
+    int n;
+
+    valid = false;
+    for (n = 0; cur[n]; ++n)
+      continue;
+    if (!reserve_copy (n + 1))
+      return false;
+    memcpy (copy, cur, (n + 1) * sizeof *copy);
+    while (size < 2 * (uint32_t) n)
+      size <<= 1;
+    if (!slots || size != mask + 1)
+      {
+	free (slots);
+	if (!(slots = (slot *) malloc (size * sizeof *slots)))
+	  return false;
+	mask = size - 1;
+      }
+    memset (slots, 0, size * sizeof *slots);
+    for (int i = 0; i < n; ++i)
+      {
+	int len;
+	uint32_t h = hash (cur[i], len);
+	insert (cur[i], len, h, i);
+      }
+    env = cur;
+    count = n;
+    return valid = true;
+  }
+  int find (char **cur, const char *name, int len, uint32_t h, int *offset,
+	    char *&val)
+  {
+    if (!valid || cur != env)
+      return stale;
+    for (uint32_t i = h & mask; slots[i].entry; i = (i + 1) & mask)
+      if (slots[i].hash == h)
+	{
+	  /* Check the array before touching the string, which might not
+	     exist anymore if the application replaced it. */
+	  if (env[slots[i].offset] != slots[i].entry)
+	    return stale;
+	  if (same_name (slots[i].entry, name, len))
+	    {
+	      *offset = slots[i].offset;
+	      val = slots[i].entry + len + 1;
+	      return found;
+	    }
+	}
+    for (int i = 0; i <= count; ++i)
+      if (env[i] != copy[i])
+	return stale;
+    return absent;
+  }
+  /* The string at OFFSET has been replaced by one with the same name. */
+  void replaced (int offset)
+  {
+    int len;
+
+    if (!valid || offset >= count)
+      return;
+    uint32_t h = hash (env[offset], len);
+    for (uint32_t i = h & mask; slots[i].entry; i = (i + 1) & mask)
+      if (slots[i].offset == offset)
+	{
+	  slots[i].entry = copy[offset] = env[offset];
+	  return;
+	}
+    valid = false;
+  }
+  /* A new string has been appended to the array, which might have been
+     moved by realloc. */
+  void appended (char **cur, int offset)
+  {
+    int len;
+
+    if (!valid || offset != count)
+      valid = false;
+    else if (2 * (uint32_t) (count + 1) > mask + 1 || !reserve_copy (count + 2))
+      rebuild (cur);
+    else
+      {
+	env = cur;
+	copy[count] = cur[count];
+	copy[++count] = NULL;
+	uint32_t h = hash (cur[offset], len);
+	insert (cur[offset], len, h, offset);
+      }
+  }
+};
+
+static env_index envindex;
+static NO_COPY SRWLOCK envindex_lock;
+
 /* Returns pointer to value associated with name, if any, else NULL.
   Sets offset to be the offset of the name/value combination in the
   environment array, for use by setenv(3) and unsetenv(3).
@@ -500,28 +671,35 @@ posify_maybe (char **here, const char *value, char *outenv)
 static char *
 my_findenv (const char *name, int *offset)
 {
-  register int len;
-  register char **p;
-  const char *c;
+  char **env = cur_environ ();
+  char *val = NULL;
+  int len, res;
+  uint32_t h;
 
-  if (cur_environ () == NULL)
+  if (env == NULL)
     return NULL;
 
-  c = name;
-  len = 0;
-  while (*c && *c != '=')
+  h = env_index::hash (name, len);
+  AcquireSRWLockShared (&envindex_lock);
+  res = envindex.find (env, name, len, h, offset, val);
+  ReleaseSRWLockShared (&envindex_lock);
+  if (res == env_index::stale)
     {
-      c++;
-      len++;
+      AcquireSRWLockExclusive (&envindex_lock);
+      if (envindex.rebuild (env))
+	res = envindex.find (env, name, len, h, offset, val);
+      ReleaseSRWLockExclusive (&envindex_lock);
     }
+  if (res != env_index::stale)
+    return val;
 
-  for (p = cur_environ (); *p; ++p)
-    if (!strncmp (*p, name, len))
-      if (*(c = *p + len) == '=')
-	{
-	  *offset = p - cur_environ ();
-	  return (char *) (++c);
-	}
+  /* Out of memory building the index.  Scan the environment. */
+  for (char **p = env; *p; ++p)
+    if (!strncmp (*p, name, len) && (*p)[len] == '=')
+      {
+	*offset = p - env;
+	return *p + len + 1;
+      }
   return NULL;
 }
 
@@ -604,6 +782,7 @@ _addenv (const char *name, const char *value, int overwrite)
   char *p;
 
   unsigned int valuelen = strlen (value);
+  bool append = false;
   if ((p = my_findenv (name, &offset)))
     {				/* Already exists. */
       if (!overwrite)		/* Ok to overwrite? */
@@ -645,6 +824,7 @@ _addenv (const char *name, const char *value, int overwrite)
 
       __cygwin_environ[offset + 1] = NULL;	/* NULL terminate. */
       update_envptrs ();	/* Update any local copies of 'environ'. */
+      append = true;
     }
 
   char *envhere;
@@ -669,6 +849,13 @@ _addenv (const char *name, const char *value, int overwrite)
       strcpy (envhere + namelen + 1, value);
     }
 
+  AcquireSRWLockExclusive (&envindex_lock);
+  if (append)
+    envindex.appended (cur_environ (), offset);
+  else
+    envindex.replaced (offset);
+  ReleaseSRWLockExclusive (&envindex_lock);
+
   /* Update cygwin's cache, if appropriate */
   win_env *spenv;
   if ((spenv = getwinenv (envhere)))
@@ -724,8 +911,8 @@ setenv (const char *name, const char *value, int overwrite)
 extern "C" int
 unsetenv (const char *name)
 {
-  register char **e;
-  int offset;
+  char **env, **src, **dst;
+  int len;
 
   __try
     {
@@ -735,11 +922,21 @@ unsetenv (const char *name)
 	  __leave;
 	}
 
-      while (my_findenv (name, &offset))	/* if set multiple times */
-	/* Move up the rest of the array */
-	for (e = cur_environ () + offset; ; e++)
-	  if (!(*e = *(e + 1)))
-	    break;
+      if (!(env = cur_environ ()))
+	return 0;
+      /* Remove all occurrences, if set multiple times, and move up the rest
+	 of the array in a single pass. */
+      len = strlen (name);
+      for (src = dst = env; *src; ++src)
+	if (strncmp (*src, name, len) || (*src)[len] != '=')
+	  *dst++ = *src;
+      *dst = NULL;
+      if (dst != src)
+	{
+	  AcquireSRWLockExclusive (&envindex_lock);
+	  envindex.invalidate ();
+	  ReleaseSRWLockExclusive (&envindex_lock);
+	}
 
       return 0;
     }
@@ -759,6 +956,10 @@ clearenv (void)
 	  free (lastenviron);
 	  lastenviron = NULL;
 	}
+      /* The next array may be allocated at the same address. */
+      AcquireSRWLockExclusive (&envindex_lock);
+      envindex.invalidate ();
+      ReleaseSRWLockExclusive (&envindex_lock);
       __cygwin_environ = NULL;
       update_envptrs ();
       return 0;
@@ -1065,22 +1266,110 @@ spenv::retrieve (bool no_envblock, const char *const env)
   return getwinenveq (name, namelen, HEAP_1_STR);
 }
 
-static inline int
-raise_envblock (int new_tl, PWCHAR &envblock, PWCHAR &s)
+#define SPENVS_SIZE (sizeof (spenvs) / sizeof (spenvs[0]))
+
+/* The environment block created by the last build_env call.  Spawning the
+   same program over and over again, e.g. from make or a shell script,
+   usually passes the same environment each time, so the next build_env
+   call can just copy the block instead of sorting and converting all
+   strings again.
+
+   Besides the strings passed to the child, the block depends on the mount
+   table, the cwd (relative paths in PATH), the charset and MSYS_NO_PATHCONV
+   in our own environment, so these are part of the key.  The strings are
+   always compared, not just the pointers, since strings added with putenv
+   may have been changed in place.  That's still much cheaper than building
+   the block.  Path conversions also depend on symlinks, so as with the
+   path_conv cache, the block expires after ENVBLOCK_TTL milliseconds. */
+
+#define ENVBLOCK_TTL	1000
+
+class envblock_cache
 {
-  int tl = new_tl + 100;
-  PWCHAR new_envblock =
-	    (PWCHAR) realloc (envblock, (2 + tl) * sizeof (WCHAR));
-  /* If realloc moves the block, move `s' with it. */
-  if (new_envblock != envblock)
-    {
-      s += new_envblock - envblock;
-      envblock = new_envblock;
-    }
-  return tl;
-}
+  char *key;		/* The strings passed to the child, concatenated. */
+  size_t keylen;
+  unsigned mount_gen;
+  mbtowc_p f_mbtowc;
+  bool no_envblock;
+  bool keep_posix;
+  bool no_pathconv;
+  char *cwd;
+  PWCHAR block;
+  size_t blocklen;	/* In WCHARs. */
+  ULONGLONG created;
+
+  bool same_strings (char **strs, size_t n)
+  {
+    const char *k = key, *kend = key + keylen;
 
-#define SPENVS_SIZE (sizeof (spenvs) / sizeof (spenvs[0]))
+    for (size_t i = 0; i < n; ++i)
+      {
+	size_t len = strlen (strs[i]) + 1;
+	if (len > (size_t) (kend - k) || memcmp (k, strs[i], len))
+	  return false;
+	k += len;
+      }
+    return k == kend;
+  }
+  void clear ()
+  {
+    free (key);
+    free (cwd);
+    free (block);
+    key = cwd = NULL;
+    block = NULL;
+  }
+
+public:
+  PWCHAR lookup (char **strs, size_t n,
+		 bool in_no_envblock, bool in_keep_posix, const char *in_cwd)
+  {
+    if (!block
+	|| GetTickCount64 () - created > ENVBLOCK_TTL
+	|| mount_gen != mount_table->generation
+	|| f_mbtowc != __MBTOWC
+	|| no_envblock != in_no_envblock
+	|| keep_posix != in_keep_posix
+	|| no_pathconv != !!getenv ("MSYS_NO_PATHCONV")
+	|| strcmp (cwd, in_cwd)
+	|| !same_strings (strs, n))
+      return NULL;
+    PWCHAR ret = (PWCHAR) malloc (blocklen * sizeof (WCHAR));
+    if (ret)
+      memcpy (ret, block, blocklen * sizeof (WCHAR));
+    return ret;
+  }
+  void store (char **strs, size_t n,
+	      bool in_no_envblock, bool in_keep_posix, const char *in_cwd,
+	      PWCHAR in_block, size_t in_blocklen)
+  {
+    clear ();
+    keylen = 0;
+    for (size_t i = 0; i < n; ++i)
+      keylen += strlen (strs[i]) + 1;
+    if (!(key = (char *) malloc (keylen))
+	|| !(cwd = strdup (in_cwd))
+	|| !(block = (PWCHAR) malloc (in_blocklen * sizeof (WCHAR))))
+      {
+	clear ();
+	return;
+      }
+    char *k = key;
+    for (size_t i = 0; i < n; ++i)
+      k = stpcpy (k, strs[i]) + 1;
+    memcpy (block, in_block, in_blocklen * sizeof (WCHAR));
+    blocklen = in_blocklen;
+    mount_gen = mount_table->generation;
+    f_mbtowc = __MBTOWC;
+    no_envblock = in_no_envblock;
+    keep_posix = in_keep_posix;
+    no_pathconv = !!getenv ("MSYS_NO_PATHCONV");
+    created = GetTickCount64 ();
+  }
+};
+
+static envblock_cache last_envblock;
+static NO_COPY SRWLOCK last_envblock_lock;
 
 int
 env_compare (const void *key, const void *memb)
@@ -1196,16 +1485,20 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
   int tl = 0;
   char **pass_dstp;
 #ifdef __MSYS__
-  char *msys2_env_conv_excl_env = NULL;
-  size_t msys2_env_conv_excl_count = 0;
+  arg_heuristic_batch env_conv;
 #endif
   char **pass_env = (char **) alloca (sizeof (char *)
 				      * (n + winnum + SPENVS_SIZE + 1));
+  /* The "special" entries are collected separately and merged into the
+     sorted pass_env later. */
+  char *pass_spenv[SPENVS_SIZE];
+  size_t pass_spenvc = 0;
   /* Iterate over input list, generating a new environment list and refreshing
      "special" entries, if necessary. */
   for (srcp = envp, dstp = newenv, pass_dstp = pass_env; *srcp; srcp++)
     {
       bool calc_tl = !no_envblock;
+      bool is_spenv = false;
 #ifdef __MSYS__
       if (!keep_posix)
       {
@@ -1221,11 +1514,7 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
 	        goto next1;
 	  }
 	else if (ascii_strncasematch(*srcp, "MSYS2_ENV_CONV_EXCL=", 20))
-	  {
-	    msys2_env_conv_excl_env = (char*)alloca (strlen(&(*srcp)[20])+1);
-	    strcpy (msys2_env_conv_excl_env, &(*srcp)[20]);
-	    msys2_env_conv_excl_count = string_split_delimited (msys2_env_conv_excl_env, ';');
-	  }
+	  env_conv.set_exclusions (*srcp + 20);
       }
 #endif
       /* Look for entries that require special attention */
@@ -1237,6 +1526,7 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
 	      goto next1;
 	    if (spenvs[i].add_if_exists)
 	      calc_tl = true;
+	    is_spenv = true;
 	    goto  next0;
 	  }
 
@@ -1246,7 +1536,10 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
     next0:
       if (calc_tl)
 	{
-	  *pass_dstp++ = *dstp;
+	  if (is_spenv)
+	    pass_spenv[pass_spenvc++] = *dstp;
+	  else
+	    *pass_dstp++ = *dstp;
 	  tl += strlen (*dstp) + 1;
 	}
       dstp++;
@@ -1263,7 +1556,7 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
 	*dstp = spenvs[i].retrieve (false);
 	if (*dstp && *dstp != env_dontadd)
 	  {
-	    *pass_dstp++ = *dstp;
+	    pass_spenv[pass_spenvc++] = *dstp;
 	    tl += strlen (*dstp) + 1;
 	    /* Eliminate from winenv. */
 	    if (winenv)
@@ -1301,6 +1594,9 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
   assert ((size_t) envc <= (n + winnum + SPENVS_SIZE));
   *dstp = NULL;			/* Terminate */
 
+  size_t pass_plainc = pass_dstp - pass_env;
+  for (size_t i = 0; i < pass_spenvc; ++i)
+    *pass_dstp++ = pass_spenv[i];
   size_t pass_envc = pass_dstp - pass_env;
   if (!pass_envc)
     envblock = NULL;
@@ -1308,24 +1604,72 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
     {
       *pass_dstp = NULL;
       debug_printf ("env count %ld, bytes %d", pass_envc, tl);
-      win_env temp;
-      temp.reset ();
 
-      /* Windows programs expect the environment block to be sorted.  */
-      qsort (pass_env, pass_envc, sizeof (char *), env_sort);
+      tmp_pathbuf tp;
+      char *cwd = cygheap->cwd.get (tp.c_get ());
+      bool cacheable = !new_token && cwd;
+      char **key_env = NULL;
 
-      /* Create an environment block suitable for passing to CreateProcess.  */
-      PWCHAR s;
-      envblock = (PWCHAR) malloc ((2 + tl) * sizeof (WCHAR));
-      int new_tl = 0;
+      envblock = NULL;
+      if (cacheable)
+	{
+	  AcquireSRWLockExclusive (&last_envblock_lock);
+	  envblock = last_envblock.lookup (pass_env, pass_envc,
+					   no_envblock, keep_posix, cwd);
+	  ReleaseSRWLockExclusive (&last_envblock_lock);
+	  if (envblock)
+	    {
+	      debug_printf ("reusing environment block");
+	      goto out;
+	    }
+	  /* pass_env gets sorted below, the cache key is in the original
+	     order. */
+	  key_env = (char **) alloca (pass_envc * sizeof (char *));
+	  memcpy (key_env, pass_env, pass_envc * sizeof (char *));
+	}
+
+      /* Windows programs expect the environment block to be sorted.  Only
+	 sort the entries from envp and merge the few special entries into
+	 the result. */
+      qsort (pass_env, pass_plainc, sizeof (char *), env_sort);
+      for (size_t i = pass_plainc; i < pass_envc; ++i)
+	{
+	  char *ins = pass_env[i];
+	  size_t lo = 0, hi = i;
+
+	  while (lo < hi)
+	    {
+	      size_t mid = (lo + hi) / 2;
+	      if (strcmp (pass_env[mid], ins) <= 0)
+		lo = mid + 1;
+	      else
+		hi = mid;
+	    }
+	  memmove (pass_env + lo + 1, pass_env + lo, (i - lo) * sizeof (char *));
+	  pass_env[lo] = ins;
+	}
+
+      /* First pass: Find the string to put into the block for each entry,
+	 and compute the exact size of the block. */
+      const char **block_str = (const char **) alloca (pass_envc
+							* sizeof (char *));
+      size_t *block_len = (size_t *) alloca (pass_envc * sizeof (size_t));
+      char **owned = (char **) alloca (pass_envc * sizeof (char *));
+      size_t nowned = 0;
+      size_t total = 1;		/* The trailing null character. */
       bool saw_PATH = false;
-      for (srcp = pass_env, s = envblock; *srcp; srcp++)
+      win_env temp;
+      temp.reset ();
+
+      for (size_t i = 0; i < pass_envc; ++i)
 	{
+	  const char *var = pass_env[i];
 	  const char *p;
 	  win_env *conv;
-	  len = strcspn (*srcp, "=") + 1;
-	  const char *rest = *srcp + len;
+	  len = strcspn (var, "=") + 1;
+	  const char *rest = var + len;
 
+	  block_str[i] = NULL;
 	  /* Check for a bad entry.  This is necessary to get rid of empty
 	     strings, induced by putenv and changing the string afterwards.
 	     Note that this doesn't stop invalid strings without '=' in it
@@ -1335,66 +1679,86 @@ build_env (const char * const *envp, PWCHAR &envblock, int &envc,
 	    continue;
 
 	  /* See if this entry requires posix->win32 conversion. */
-	  conv = !*rest ? NULL : getwinenv (*srcp, rest, &temp);
+	  conv = !*rest ? NULL : getwinenv (var, rest, &temp);
 	  if (conv)
 	    {
 	      p = conv->native;	/* Use win32 path */
 	      /* Does PATH exist in the environment? */
-	      if (**srcp == 'P')
+	      if (*var == 'P')
 		{
 		  /* And is it non-empty? */
 		  if (!conv->native || !conv->native[0])
 		    continue;
 		  saw_PATH = true;
 		}
+	      /* The next getwinenv call reuses temp, so keep its buffer. */
+	      if (conv == &temp)
+		{
+		  owned[nowned++] = temp.native;
+		  temp.native = NULL;
+		}
 	    }
 #ifdef __MSYS__
 	  else if (!keep_posix && *rest) {
-	    char *win_arg = arg_heuristic_with_exclusions
-		   (*srcp, msys2_env_conv_excl_env, msys2_env_conv_excl_count);
-	    debug_printf("WIN32_PATH is %s", win_arg);
-	    p = cstrdup1(win_arg);
-	    if (win_arg != *srcp)
-	      free (win_arg);
+	    p = env_conv.convert (var);
+	    debug_printf("WIN32_PATH is %s", p);
 	  }
 #endif
 	  else
-	    p = *srcp;		/* Don't worry about it */
-
-	  len = sys_mbstowcs (NULL, 0, p);
-	  new_tl += len;	/* Keep running total of block length so far */
-
-	  /* See if we need to increase the size of the block. */
-	  if (new_tl > tl)
-	    tl = raise_envblock (new_tl, envblock, s);
-
-	  len = sys_mbstowcs (s, len, p);
+	    p = var;		/* Don't worry about it */
 
-	  /* See if environment variable is "special" in a Windows sense.
-	     Under NT, the current directories for visited drives are stored
-	     as =C:=\bar.  Cygwin converts the '=' to '!' for hopefully obvious
-	     reasons.  We need to convert it back when building the envblock */
-	  if (s[0] == L'!' && (iswdrive (s + 1) || (s[1] == L':' && s[2] == L':'))
-	      && s[3] == L'=')
-	    *s = L'=';
-	  s += len + 1;
+	  block_str[i] = p;
+	  block_len[i] = sys_mbstowcs (NULL, 0, p);
+	  total += block_len[i];
 	}
       /* If PATH doesn't exist in the environment, add a PATH with just
 	 Cygwin's bin dir to the Windows env to allow loading system DLLs
 	 during execve. */
       if (!saw_PATH)
+	total += 5 + cygheap->installation_dir.Length / sizeof (WCHAR) + 1;
+
+      /* Second pass: Create an environment block suitable for passing to
+	 CreateProcess.  */
+      envblock = (PWCHAR) malloc (total * sizeof (WCHAR));
+      if (envblock)
 	{
-	  new_tl += cygheap->installation_dir.Length / sizeof (WCHAR) + 5 + 1;
-	  if (new_tl > tl)
-	    tl = raise_envblock (new_tl, envblock, s);
-	  s = wcpcpy (wcpcpy (s, L"PATH="),
-		      cygheap->installation_dir.Buffer) + 1;
+	  PWCHAR s = envblock;
+
+	  for (size_t i = 0; i < pass_envc; ++i)
+	    {
+	      if (!block_str[i])
+		continue;
+	      len = sys_mbstowcs (s, block_len[i], block_str[i]);
+
+	      /* See if environment variable is "special" in a Windows sense.
+		 Under NT, the current directories for visited drives are
+		 stored as =C:=\bar.  Cygwin converts the '=' to '!' for
+		 hopefully obvious reasons.  We need to convert it back when
+		 building the envblock */
+	      if (s[0] == L'!'
+		  && (iswdrive (s + 1) || (s[1] == L':' && s[2] == L':'))
+		  && s[3] == L'=')
+		*s = L'=';
+	      s += len + 1;
+	    }
+	  if (!saw_PATH)
+	    s = wcpcpy (wcpcpy (s, L"PATH="),
+			cygheap->installation_dir.Buffer) + 1;
+	  *s = L'\0';			/* Two null bytes at the end */
+	  assert ((size_t) (s - envblock) == total - 1);
+	  if (cacheable)
+	    {
+	      AcquireSRWLockExclusive (&last_envblock_lock);
+	      last_envblock.store (key_env, pass_envc, no_envblock,
+				   keep_posix, cwd, envblock, total);
+	      ReleaseSRWLockExclusive (&last_envblock_lock);
+	    }
 	}
-      *s = L'\0';			/* Two null bytes at the end */
-      assert ((s - envblock) <= tl);	/* Detect if we somehow ran over end
-					   of buffer */
+      while (nowned > 0)
+	free (owned[--nowned]);
     }
 
+out:
   debug_printf ("envp %p, envc %d", newenv, envc);
   return newenv;
 }
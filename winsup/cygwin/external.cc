@@ -30,6 +30,11 @@ details. */
 #include <wchar.h>
 #include <iptypes.h>
 
+#ifdef MPREC_STATS
+/* Balloc counters, newlib/libc/stdlib/mprec.c. */
+extern "C" uint64_t __mprec_balloc_count, __mprec_heap_count;
+#endif
+
 child_info *get_cygwin_startup_info ();
 static void exit_process (UINT, bool) __attribute__((noreturn));
 
@@ -724,6 +729,30 @@ cygwin_internal (cygwin_getinfo_types t, ...)
 	}
 	break;
 
+      case CW_PATH_CONV_CACHE_STATS:
+	{
+	  uint64_t *hits = va_arg (arg, uint64_t *);
+	  uint64_t *misses = va_arg (arg, uint64_t *);
+	  path_conv_cache_stats (hits, misses);
+	  res = 0;
+	}
+	break;
+
+      case CW_MPREC_STATS:
+#ifdef MPREC_STATS
+	{
+	  uint64_t *ballocs = va_arg (arg, uint64_t *);
+	  uint64_t *mallocs = va_arg (arg, uint64_t *);
+	  *ballocs = __mprec_balloc_count;
+	  *mallocs = __mprec_heap_count;
+	  res = 0;
+	}
+#else
+	/* Only with newlib and Cygwin built with -DMPREC_STATS. */
+	set_errno (ENOSYS);
+#endif
+	break;
+
       default:
 	set_errno (ENOSYS);
     }
@@ -847,6 +847,8 @@ fhandler_disk_file::fchmod (mode_t mode)
 out:
   if (oret)
     close_fs ();
+  /* The cached DOS attributes are outdated now. */
+  flush_path_conv_cache ();
 
   return ret;
 }
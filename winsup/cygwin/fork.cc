@@ -217,6 +217,7 @@ frok::child (volatile char * volatile here)
 
   ForceCloseHandle1 (fork_info->forker_finished, forker_finished);
 
+  malloc_fixup_after_fork ();
   pthread::atforkchild ();
   cygbench ("fork-child");
   ld_preload ();
@@ -326,7 +327,7 @@ frok::parent (volatile char * volatile stack_here)
   si.lpReserved2 = (LPBYTE) &ch;
   si.cbReserved2 = sizeof (ch);
 
-  bool locked = __malloc_lock ();
+  bool locked = malloc_lock_all ();
 
   /* Remove impersonation */
   cygheap->user.deimpersonate ();
@@ -479,7 +480,7 @@ frok::parent (volatile char * volatile stack_here)
 		   impure, impure_beg, impure_end,
 		   NULL);
 
-  __malloc_unlock ();
+  malloc_unlock_all ();
   locked = false;
   if (!rc)
     {
@@ -564,7 +565,7 @@ cleanup:
   if (fix_impersonation)
     cygheap->user.reimpersonate ();
   if (locked)
-    __malloc_unlock ();
+    malloc_unlock_all ();
 
   /* Remember to de-allocate the fd table. */
   if (hchild)
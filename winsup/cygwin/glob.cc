@@ -106,6 +106,9 @@ __FBSDID("$FreeBSD: src/lib/libc/gen/glob.c,v 1.28 2010/05/12 17:44:00 gordon Ex
 
 #define CCHAR(c)	(ignore_case_with_glob ? towlower (CHAR (c)) : CHAR (c))
 #define Cchar(c)	(ignore_case_with_glob ? towlower (c) : (c))
+#else
+#define CCHAR(c)	CHAR (c)
+#define Cchar(c)	(c)
 #endif
 
 #undef MAXPATHLEN
@@ -135,6 +138,7 @@ __FBSDID("$FreeBSD: src/lib/libc/gen/glob.c,v 1.28 2010/05/12 17:44:00 gordon Ex
 #define	M_PROTECT	0x4000000000ULL
 #define	M_MASK		0xffffffffffULL
 #define	M_CHAR		0x00ffffffffULL
+#define	M_SETSHIFT	40
 
 typedef uint_fast64_t Char;
 
@@ -160,6 +164,18 @@ typedef char Char;
 #define	M_SET		META('[')
 #define	ismeta(c)	(((c)&M_QUOTE) != 0)
 
+/*
+ * The bits of M_SET above M_MASK hold the distance to a map of the ASCII
+ * characters the set has been checked against, behind the end of the
+ * compiled pattern.  See globsetmaps().
+ */
+#ifdef M_SETSHIFT
+#define	M_SETMAP(c)	((c) >> M_SETSHIFT)
+#else
+#define	M_SETMAP(c)	0
+#endif
+#define	SETMAPLEN	4	/* 128 bits checked, 128 bits matched */
+
 
 static int	 compare(const void *, const void *);
 static int	 g_Ctoc(const Char *, char *, size_t);
@@ -172,14 +188,16 @@ static Char	*g_strcat(Char *, const Char *);
 static int	 g_stat(Char *, struct stat *, glob_t *);
 static int	 glob0(const Char *, glob_t *, size_t *);
 static int	 glob1(Char *, glob_t *, size_t *);
-static int	 glob2(Char *, Char *, Char *, Char *, glob_t *, size_t *);
+static int	 glob2(Char *, Char *, Char *, Char *, int, glob_t *, size_t *);
 static int	 glob3(Char *, Char *, Char *, Char *, Char *, glob_t *, size_t *);
 static int	 globextend(const Char *, glob_t *, size_t *);
 static const Char *
 		 globtilde(const Char *, Char *, size_t, glob_t *);
 static int	 globexp1(const Char *, glob_t *, size_t *);
 static int	 globexp2(const Char *, const Char *, glob_t *, int *, size_t *);
+static void	 globsetmaps(Char *, Char *, Char *);
 static int	 match(Char *, Char *, Char *);
+static int	 matchset(Char *, Char, Char **);
 #ifdef DEBUG
 static void	 qprintf(const char *, Char *);
 #endif
@@ -513,6 +531,8 @@ glob0(const Char *pattern, glob_t *pglob, size_t *limit)
 	*bufnext = EOS;
 #ifdef DEBUG
 	qprintf("glob0:", patbuf);
+#else
+	globsetmaps(patbuf, bufnext, patbuf + MAXPATHLEN);
 #endif
 
 	if ((err = glob1(patbuf, pglob, limit)) != 0)
@@ -553,17 +573,22 @@ glob1(Char *pattern, glob_t *pglob, size_t *limit)
 	if (*pattern == EOS)
 		return(0);
 	return(glob2(pathbuf, pathbuf, pathbuf + MAXPATHLEN - 1,
-	    pattern, pglob, limit));
+	    pattern, DT_UNKNOWN, pglob, limit));
 }
 
 /*
  * The functions glob2 and glob3 are mutually recursive; there is one level
  * of recursion for each segment in the pattern that contains one or more
  * meta characters.
+ *
+ * dtype is the d_type of the name glob3 has just read into pathbuf, or
+ * DT_UNKNOWN.  If the pattern ends there, the name isn't lstat'ed again;
+ * only GLOB_MARK still stats symlinks to see whether they point to a
+ * directory.
  */
 static int
 glob2(Char *pathbuf, Char *pathend, Char *pathend_last, Char *pattern,
-      glob_t *pglob, size_t *limit)
+      int dtype, glob_t *pglob, size_t *limit)
 {
 	struct stat sb;
 	Char *p, *q;
@@ -576,7 +601,9 @@ glob2(Char *pathbuf, Char *pathend, Char *pathend_last, Char *pattern,
 	for (anymeta = 0;;) {
 		if (*pattern == EOS) {		/* End of pattern? */
 			*pathend = EOS;
-			if (g_lstat(pathbuf, &sb, pglob))
+			if (dtype != DT_UNKNOWN)
+				sb.st_mode = DTTOIF(dtype);
+			else if (g_lstat(pathbuf, &sb, pglob))
 				return(0);
 
 			if (((pglob->gl_flags & GLOB_MARK) &&
@@ -605,6 +632,7 @@ glob2(Char *pathbuf, Char *pathend, Char *pathend_last, Char *pattern,
 		}
 
 		if (!anymeta) {		/* No expansion, do next segment. */
+			dtype = DT_UNKNOWN;
 			pathend = q;
 			pattern = p;
 			while (*pattern == SEP) {
@@ -626,7 +654,7 @@ glob3(Char *pathbuf, Char *pathend, Char *pathend_last,
 {
 	struct dirent *dp;
 	DIR *dirp;
-	int err;
+	int err, dtype;
 	char buf[MAXPATHLEN];
 
 	/*
@@ -645,7 +673,12 @@ glob3(Char *pathbuf, Char *pathend, Char *pathend_last,
 	errno = 0;
 
 	if ((dirp = g_opendir(pathbuf, pglob)) == NULL) {
-		/* TODO: don't call for ENOENT or ENOTDIR? */
+		/*
+		 * A name which isn't a directory just doesn't match, the
+		 * same as when glob3 skips it by d_type.
+		 */
+		if (errno == ENOTDIR)
+			return(0);
 		if (pglob->gl_errfunc) {
 			if (g_Ctoc(pathbuf, buf, sizeof(buf)))
 				return (GLOB_ABORTED);
@@ -673,12 +706,26 @@ glob3(Char *pathbuf, Char *pathend, Char *pathend_last,
 		/* Initial DOT must be matched literally. */
 		if (dp->d_name[0] == DOT && *pattern != DOT)
 			continue;
+		/*
+		 * Only trust d_type from our own readdir; gl_readdir may
+		 * not fill it in.  A name which is neither a directory nor
+		 * a symlink can't have more segments after it.
+		 */
+		dtype = (pglob->gl_flags & GLOB_ALTDIRFUNC) ?
+		    DT_UNKNOWN : dp->d_type;
+		if (*restpattern != EOS && dtype != DT_UNKNOWN &&
+		    dtype != DT_DIR && dtype != DT_LNK)
+			continue;
 		memset(&mbs, 0, sizeof(mbs));
 		dc = pathend;
 		sc = dp->d_name;
 		while (dc < pathend_last) {
-			clen = mbrtowc(&wc, sc, MB_LEN_MAX, &mbs);
-			if (clen == (size_t)-1 || clen == (size_t)-2) {
+			/* ASCII is the same in all charsets. */
+			if (!(*sc & 0x80)) {
+				wc = *sc;
+				clen = 1;
+			} else if ((clen = mbrtowc(&wc, sc, MB_LEN_MAX, &mbs))
+			    == (size_t)-1 || clen == (size_t)-2) {
 				wc = *sc;
 				clen = 1;
 				memset(&mbs, 0, sizeof(mbs));
@@ -692,7 +739,7 @@ glob3(Char *pathbuf, Char *pathend, Char *pathend_last,
 			continue;
 		}
 		err = glob2(pathbuf, --dc, pathend_last, restpattern,
-		    pglob, limit);
+		    dtype, pglob, limit);
 		if (err)
 			break;
 	}
@@ -766,58 +813,127 @@ globextend(const Char *path, glob_t *pglob, size_t *limit)
 	return(copy == NULL ? GLOB_NOSPACE : 0);
 }
 
+#ifndef DEBUG
+/*
+ * Give each set in the compiled pattern a map of the ASCII characters,
+ * as far as there is room behind the pattern.  match() fills it in as it
+ * meets the characters, so each one is only compared with the ranges of
+ * the set, in collation order, once per pattern and not for every name.
+ */
+static void
+globsetmaps(Char *pattern, Char *patend, Char *bufend)
+{
+	Char *map;
+	int i;
+
+	for (map = patend + 1; pattern < patend; pattern++) {
+		if (*pattern != M_SET)
+			continue;
+		if (bufend - map < SETMAPLEN)
+			break;
+		for (i = 0; i < SETMAPLEN; i++)
+			map[i] = 0;
+		*pattern |= (Char)(map - pattern) << M_SETSHIFT;
+		map += SETMAPLEN;
+	}
+}
+#endif
+
 /*
- * pattern matching function for filenames.  Each occurrence of the *
- * pattern causes a recursion level.
+ * pattern matching function for filenames.  When the rest of the pattern
+ * doesn't match, the last * takes one more character of the name and the
+ * rest is tried again.  Earlier *s needn't be tried again, so this takes
+ * no recursion and never more than length of name times length of pattern.
  */
 static int
 match(Char *name, Char *pat, Char *patend)
 {
-	int ok, negate_range;
-	Char c, k;
-
-	while (pat < patend) {
-		c = *pat++;
-		switch (c & M_MASK) {
-		case M_ALL:
-			if (pat == patend)
-				return(1);
-			do
-			    if (match(name, pat, patend))
-				    return(1);
-			while (*name++ != EOS);
+	Char c, k, *nextn, *nextp;
+
+	nextn = nextp = NULL;
+	for (;;) {
+		while (pat < patend) {
+			c = *pat++;
+			switch (c & M_MASK) {
+			case M_ALL:
+				if (pat == patend)
+					return(1);
+				if (*name == EOS)
+					return(0);
+				nextn = name + 1;
+				nextp = pat - 1;
+				break;
+			case M_ONE:
+				if (*name++ == EOS)
+					goto fail;
+				break;
+			case M_SET:
+				if ((k = *name++) == EOS ||
+				    !matchset(pat, k, &pat))
+					goto fail;
+				break;
+			default:
+				if (Cchar(*name++) != Cchar(c))
+					goto fail;
+				break;
+			}
+		}
+		if (*name == EOS)
+			return(1);
+fail:
+		if (nextn == NULL)
 			return(0);
-		case M_ONE:
-			if (*name++ == EOS)
-				return(0);
-			break;
-		case M_SET:
-			ok = 0;
-			if ((k = *name++) == EOS)
-				return(0);
-			if ((negate_range = ((*pat & M_MASK) == M_NOT)) != EOS)
-				++pat;
-			while (((c = *pat++) & M_MASK) != M_END)
-				if ((*pat & M_MASK) == M_RNG) {
-					if (__collate_load_error ?
-					    CCHAR(c) <= CCHAR(k) && CCHAR(k) <= CCHAR(pat[1]) :
-					       __collate_range_cmp(CCHAR(c), CCHAR(k)) <= 0
-					    && __collate_range_cmp(CCHAR(k), CCHAR(pat[1])) <= 0
-					   )
-						ok = 1;
-					pat += 2;
-				} else if (c == k)
-					ok = 1;
-			if (ok == negate_range)
-				return(0);
-			break;
-		default:
-			if (Cchar(*name++) != Cchar(c))
-				return(0);
-			break;
+		name = nextn;
+		pat = nextp;
+	}
+	/* NOTREACHED */
+}
+
+/*
+ * Match k against the set at pat, after the M_SET, and set *end to the
+ * pattern after the set's M_END.  ASCII characters are looked up in the
+ * set's map and entered there once they have been compared.
+ */
+static int
+matchset(Char *pat, Char k, Char **end)
+{
+	int ok, negate_range;
+	Char c, bit, *map;
+
+	map = NULL;
+	bit = 0;
+	if (k < 128 && M_SETMAP(pat[-1]) != 0) {
+		map = pat - 1 + M_SETMAP(pat[-1]) + k / 64;
+		bit = (Char)1 << k % 64;
+		if (map[0] & bit) {
+			while ((*pat++ & M_MASK) != M_END)
+				continue;
+			*end = pat;
+			return((map[2] & bit) != 0);
 		}
 	}
-	return(*name == EOS);
+	ok = 0;
+	if ((negate_range = ((*pat & M_MASK) == M_NOT)) != EOS)
+		++pat;
+	while (((c = *pat++) & M_MASK) != M_END)
+		if ((*pat & M_MASK) == M_RNG) {
+			if (__collate_load_error ?
+			    CCHAR(c) <= CCHAR(k) && CCHAR(k) <= CCHAR(pat[1]) :
+			       __collate_range_cmp(CCHAR(c), CCHAR(k)) <= 0
+			    && __collate_range_cmp(CCHAR(k), CCHAR(pat[1])) <= 0
+			   )
+				ok = 1;
+			pat += 2;
+		} else if (c == k)
+			ok = 1;
+	*end = pat;
+	ok = ok != negate_range;
+	if (map != NULL) {
+		map[0] |= bit;
+		if (ok)
+			map[2] |= bit;
+	}
+	return(ok);
 }
 
 /* Free allocated data belonging to a glob_t structure. */
@@ -931,10 +1047,17 @@ static int
 g_Ctoc(const Char *str, char *buf, size_t len)
 {
 	mbstate_t mbs;
-	size_t clen;
+	size_t clen, mb_cur_max;
 
 	memset(&mbs, 0, sizeof(mbs));
-	while (len >= (size_t) MB_CUR_MAX) {
+	mb_cur_max = MB_CUR_MAX;
+	while (len >= mb_cur_max) {
+		if (*str < 0x80) {	/* ASCII is the same in all charsets. */
+			if ((*buf++ = *str++) == EOS)
+				return (0);
+			len--;
+			continue;
+		}
 		clen = wcrtomb(buf, *str, &mbs);
 		if (clen == (size_t)-1)
 			return (1);
@@ -166,6 +166,8 @@ typedef enum
     CW_CYGHEAP_PROFTHR_ALL,
     CW_WINPID_TO_CYGWIN_PID,
     CW_MAX_CYGWIN_PID,
+    CW_PATH_CONV_CACHE_STATS,
+    CW_MPREC_STATS,
   } cygwin_getinfo_types;
 
 #define CW_LOCK_PINFO CW_LOCK_PINFO
@@ -230,6 +232,8 @@ typedef enum
 #define CW_CYGHEAP_PROFTHR_ALL CW_CYGHEAP_PROFTHR_ALL
 #define CW_WINPID_TO_CYGWIN_PID CW_WINPID_TO_CYGWIN_PID
 #define CW_MAX_CYGWIN_PID CW_MAX_CYGWIN_PID
+#define CW_PATH_CONV_CACHE_STATS CW_PATH_CONV_CACHE_STATS
+#define CW_MPREC_STATS CW_MPREC_STATS
 
 /* Token type for CW_SET_EXTERNAL_TOKEN */
 enum
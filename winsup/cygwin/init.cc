@@ -67,6 +67,25 @@ munge_threadfunc ()
     }
 }
 
+/* Note that the process is threaded, for arc4random and stdio, which skip
+   locking until then.  pthread_wrapper does the same for pthreads, but
+   threads made with CreateThread, by Windows' thread pools, or by other
+   DLLs can call into Cygwin as well.  Only our own cygthreads are known
+   not to use stdio.  This runs in the new thread before its start routine,
+   so the flag is set before the thread can touch a stream. */
+static void
+note_new_thread ()
+{
+  PVOID threadfunc = NULL;
+
+  NtQueryInformationThread (NtCurrentThread (),
+			    ThreadQuerySetWin32StartAddress,
+			    &threadfunc, sizeof threadfunc, NULL);
+  if (threadfunc != (PVOID) cygthread::stub
+      && threadfunc != (PVOID) cygthread::simplestub)
+    __isthreaded = 1;
+}
+
 void dll_crt0_0 ();
 
 /* Non-static fake variable so GCC doesn't second-guess if we *really*
@@ -85,6 +104,9 @@ dll_entry (HANDLE h, DWORD reason, void *static_load)
 
       cygwin_hmodule = (HMODULE) h;
       dynamically_loaded = (static_load == NULL);
+      /* We don't get to see the threads which exist already. */
+      if (dynamically_loaded)
+	__isthreaded = 1;
 
       /* Starting with adding the POSIX-1.2008 per-thread locale functionality,
 	 we need an initalized _REENT area even for the functions called from
@@ -105,6 +127,7 @@ dll_entry (HANDLE h, DWORD reason, void *static_load)
 	shared_destroy ();
       break;
     case DLL_THREAD_ATTACH:
+      note_new_thread ();
       if (dll_finished_loading)
 	munge_threadfunc ();
       break;
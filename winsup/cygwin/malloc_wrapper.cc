@@ -14,9 +14,15 @@ details. */
 #include "dtable.h"
 #include "perprocess.h"
 #include "miscfuncs.h"
+#include "cygtls.h"
 #include "cygmalloc.h"
 #include <malloc.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/param.h>
 extern "C" struct mallinfo dlmallinfo ();
+extern "C" struct mallinfo mspace_mallinfo (mspace);
+extern "C" void *mmap64 (void *, size_t, int, int, int, off_t);
 
 /* we provide these stubs to call into a user's
    provided malloc if there is one - otherwise
@@ -27,6 +33,384 @@ extern "C" struct mallinfo dlmallinfo ();
 static bool use_internal = true;
 static bool internal_malloc_determined;
 
+/* Arena mode.
+
+   By default, all blocks which don't fit into a magazine come from the
+   main dlmalloc heap under mallock.  With the malloc_arenas option, threads
+   are assigned round-robin to a small number of dlmalloc mspaces instead,
+   each protected by its own lock, so threads allocating larger blocks or
+   refilling their magazines don't all contend for mallock.
+
+   All arenas are carved out of a single MAP_NORESERVE region, ARENA_SIZE
+   bytes per arena, which is only committed as dlmalloc touches it.  The
+   footprint limit keeps an mspace from growing beyond its part of the
+   region, and from mmapping large chunks separately, so the arena owning a
+   block follows from its address, and free and realloc can route every
+   block back to its arena without any lookup.
+   If an arena is exhausted, requests fall back to the main heap, as do
+   memalign and friends, and all threads which set up their magazine before
+   the option has been parsed.
+
+   fork holds mallock and all arena locks while copying the heap and the
+   mmapped regions, so the arenas are consistent in the child. */
+
+#define MAX_ARENAS	16
+#ifdef __x86_64__
+#define ARENA_SIZE	((size_t) 1 << 30)
+#else
+#define ARENA_SIZE	((size_t) 64 << 20)
+#endif
+
+static unsigned narenas;	/* Requested number of arenas. */
+static char *arena_base;	/* Start of the region, NULL until needed. */
+static size_t arena_span;	/* narenas * ARENA_SIZE, once reserved. */
+static mspace arenas[MAX_ARENAS];
+static unsigned next_arena;
+static NO_COPY muto arena_lock[MAX_ARENAS];
+
+/* Set the number of arenas from the malloc_arenas option.  Without a
+   value, use one arena per CPU. */
+void
+malloc_set_arenas (const char *buf)
+{
+  unsigned n;
+
+  /* Too late, the arenas are already in use. */
+  if (arena_base)
+    return;
+  if (!buf || !*buf)
+    n = 0;
+  else if (isdigit (*buf))
+    n = strtoul (buf, NULL, 0);
+  else
+    n = wincap.cpu_count ();
+  narenas = n > MAX_ARENAS ? MAX_ARENAS : n;
+}
+
+/* Return the arena the next thread should use, or -1 for the main heap.
+   Called with mallock held. */
+static int
+arena_assign ()
+{
+  if (!narenas)
+    return -1;
+  if (!arena_base)
+    {
+      void *base = mmap64 (NULL, narenas * ARENA_SIZE, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (base == MAP_FAILED)
+	{
+	  malloc_printf ("can't reserve %u arenas", narenas);
+	  narenas = 0;
+	  return -1;
+	}
+      arena_base = (char *) base;
+      arena_span = narenas * ARENA_SIZE;
+    }
+
+  int a = next_arena++ % narenas;
+  if (!arenas[a])
+    {
+      arenas[a] = create_mspace_with_base (arena_base + a * ARENA_SIZE,
+					   ARENA_SIZE, 0);
+      if (!arenas[a])
+	return -1;
+      mspace_set_footprint_limit (arenas[a], ARENA_SIZE);
+    }
+  return a;
+}
+
+/* Return the arena P belongs to, or -1 if it's from the main heap. */
+static inline int
+arena_of (const void *p)
+{
+  size_t off = (const char *) p - arena_base;
+
+  return off < arena_span ? (int) (off / ARENA_SIZE) : -1;
+}
+
+static inline void
+heap_lock (int a)
+{
+  if (a < 0)
+    __malloc_lock ();
+  else
+    arena_lock[a].acquire ();
+}
+
+static inline void
+heap_unlock (int a)
+{
+  if (a < 0)
+    __malloc_unlock ();
+  else
+    arena_lock[a].release ();
+}
+
+/* Lock or unlock the whole heap for fork. */
+bool
+malloc_lock_all ()
+{
+  bool ret = __malloc_lock ();
+  for (unsigned a = 0; a < MAX_ARENAS; ++a)
+    if (arenas[a])
+      arena_lock[a].acquire ();
+  return ret;
+}
+
+void
+malloc_unlock_all ()
+{
+  for (unsigned a = MAX_ARENAS; a-- > 0; )
+    if (arenas[a])
+      arena_lock[a].release ();
+  __malloc_unlock ();
+}
+
+/* Per-thread magazines.
+
+   Small blocks are cached per thread in "magazines", one per size class,
+   so most malloc and free calls don't have to take a lock at all.  An
+   empty magazine is refilled from the heap, a full one is flushed back,
+   MAG_BATCH blocks at a time.
+
+   The size classes are the dlmalloc chunk sizes from MAG_MIN_CHUNK up to
+   MAG_MAX_CHUNK, so a block freed into a magazine satisfies every request
+   served from that magazine.  Blocks cached in a magazine are in use as far
+   as dlmalloc is concerned, so mallinfo and malloc_stats count them as
+   allocated.
+
+   The magazine of a thread hangs off its _cygtls and is only ever touched
+   by the thread itself, except for the list of all magazines, which is
+   protected by mallock.  The blocks are returned to the heap when the
+   thread exits.  fork holds mallock while copying the heap, so the child
+   inherits a consistent list and a consistent magazine of the forking
+   thread.  The magazines of all other threads may have been in the middle
+   of an operation, so the child just drops them, together with the blocks
+   they cache. */
+
+#ifdef MALLOC_ALIGNMENT
+#define MAG_ALIGN	MALLOC_ALIGNMENT
+#else
+#define MAG_ALIGN	(2 * sizeof (size_t))
+#endif
+/* Same as CHUNK_OVERHEAD and MIN_CHUNK_SIZE in malloc.cc. */
+#define MAG_OVERHEAD	sizeof (size_t)
+#define MAG_MIN_CHUNK	((4 * sizeof (size_t) + MAG_ALIGN - 1) & ~(MAG_ALIGN - 1))
+#define MAG_CLASSES	16
+#define MAG_MAX_CHUNK	(MAG_MIN_CHUNK + (MAG_CLASSES - 1) * MAG_ALIGN)
+#define MAG_SIZE	32	/* Max. number of blocks per class. */
+#define MAG_BATCH	(MAG_SIZE / 2)
+
+struct malloc_magazine
+{
+  malloc_magazine *next;
+  malloc_magazine *prev;
+  int arena;		/* Arena of the thread, -1 for the main heap. */
+  struct
+  {
+    unsigned count;
+    void *blocks[MAG_SIZE];
+  } cls[MAG_CLASSES];
+};
+
+/* List of the magazines of all threads, protected by mallock. */
+static malloc_magazine *magazines;
+
+static malloc_magazine *
+mag_get ()
+{
+  /* Threads which haven't been set up by Cygwin yet, or are exiting,
+     use the main heap directly. */
+  if (!_my_tls.isinitialized ())
+    return NULL;
+  if (_my_tls.mallocmag)
+    return _my_tls.mallocmag;
+
+  __malloc_lock ();
+  malloc_magazine *mag = (malloc_magazine *) dlcalloc (1, sizeof *mag);
+  if (mag)
+    {
+      mag->arena = arena_assign ();
+      if ((mag->next = magazines))
+	magazines->prev = mag;
+      magazines = mag;
+    }
+  __malloc_unlock ();
+  return _my_tls.mallocmag = mag;
+}
+
+/* Return the arena of the calling thread, or -1 for the main heap. */
+static inline int
+my_arena ()
+{
+  malloc_magazine *mag;
+
+  return narenas && (mag = mag_get ()) ? mag->arena : -1;
+}
+
+/* Allocate from the arena A, or from the main heap if A is -1 or the
+   arena is exhausted. */
+static void *
+heap_malloc (int a, size_t size)
+{
+  void *res = NULL;
+
+  if (a >= 0)
+    {
+      save_errno save;
+
+      arena_lock[a].acquire ();
+      res = mspace_malloc (arenas[a], size);
+      arena_lock[a].release ();
+    }
+  if (!res)
+    {
+      __malloc_lock ();
+      res = dlmalloc (size);
+      __malloc_unlock ();
+    }
+  return res;
+}
+
+/* Return the N blocks in BLOCKS to the heaps they belong to. */
+static void
+heap_free (void **blocks, unsigned n)
+{
+  int locked = -2;
+
+  for (unsigned i = 0; i < n; ++i)
+    {
+      int a = arena_of (blocks[i]);
+
+      if (a != locked)
+	{
+	  if (locked != -2)
+	    heap_unlock (locked);
+	  heap_lock (locked = a);
+	}
+      if (a < 0)
+	dlfree (blocks[i]);
+      else
+	mspace_free (arenas[a], blocks[i]);
+    }
+  if (locked != -2)
+    heap_unlock (locked);
+}
+
+/* Return the first N blocks of class CLS to the heap. */
+static void
+mag_flush (malloc_magazine *mag, unsigned cls, unsigned n)
+{
+  unsigned count = mag->cls[cls].count;
+  void **blocks = mag->cls[cls].blocks;
+
+  heap_free (blocks, n);
+  memmove (blocks, blocks + n, (count - n) * sizeof *blocks);
+  mag->cls[cls].count = count - n;
+}
+
+/* Return a block of at least SIZE bytes from the magazine, or NULL if the
+   request has to go to the heap directly. */
+static inline void *
+mag_malloc (size_t size)
+{
+  malloc_magazine *mag;
+
+  if (size > MAG_MAX_CHUNK - MAG_OVERHEAD || !(mag = mag_get ()))
+    return NULL;
+
+  size_t chunk = (size + MAG_OVERHEAD + MAG_ALIGN - 1) & ~(MAG_ALIGN - 1);
+  if (chunk < MAG_MIN_CHUNK)
+    chunk = MAG_MIN_CHUNK;
+  unsigned cls = (chunk - MAG_MIN_CHUNK) / MAG_ALIGN;
+  unsigned count = mag->cls[cls].count;
+
+  if (!count)
+    {
+      void **blocks = mag->cls[cls].blocks;
+      int a = mag->arena;
+      save_errno save;
+
+      heap_lock (a);
+      while (count < MAG_BATCH
+	     && (blocks[count] = a < 0 ? dlmalloc (chunk - MAG_OVERHEAD)
+				       : mspace_malloc (arenas[a],
+							chunk - MAG_OVERHEAD)))
+	++count;
+      heap_unlock (a);
+      if (!count)
+	return NULL;
+    }
+  mag->cls[cls].count = --count;
+  return mag->cls[cls].blocks[count];
+}
+
+/* Put P into the magazine.  Return false if it has to be returned to the
+   heap directly. */
+static inline bool
+mag_free (void *p)
+{
+  malloc_magazine *mag;
+
+  if (!p)
+    return true;
+  /* dlmalloc_usable_size only looks at the size and the in-use bit of the
+     chunk, which don't change while the caller owns it. */
+  size_t chunk = dlmalloc_usable_size (p) + MAG_OVERHEAD;
+  if (chunk < MAG_MIN_CHUNK || chunk > MAG_MAX_CHUNK || !(mag = mag_get ()))
+    return false;
+
+  unsigned cls = (chunk - MAG_MIN_CHUNK) / MAG_ALIGN;
+  if (mag->cls[cls].count == MAG_SIZE)
+    mag_flush (mag, cls, MAG_BATCH);
+  mag->cls[cls].blocks[mag->cls[cls].count++] = p;
+  return true;
+}
+
+/* Return all blocks in MAG to the heap. */
+static void
+mag_flush_all (malloc_magazine *mag)
+{
+  for (unsigned cls = 0; cls < MAG_CLASSES; ++cls)
+    mag_flush (mag, cls, mag->cls[cls].count);
+}
+
+/* Called from _cygtls::remove when a thread exits. */
+void
+malloc_magazine_release (malloc_magazine *mag)
+{
+  mag_flush_all (mag);
+  __malloc_lock ();
+  if (mag->next)
+    mag->next->prev = mag->prev;
+  if (mag->prev)
+    mag->prev->next = mag->next;
+  else
+    magazines = mag->next;
+  dlfree (mag);
+  __malloc_unlock ();
+}
+
+/* Called in the child of a fork.  Only the forking thread exists here, so
+   drop all other magazines, without touching the blocks they contain. */
+void
+malloc_fixup_after_fork ()
+{
+  malloc_magazine *mine = _my_tls.mallocmag;
+
+  __malloc_lock ();
+  for (malloc_magazine *mag = magazines, *next; mag; mag = next)
+    {
+      next = mag->next;
+      if (mag != mine)
+	dlfree (mag);
+    }
+  if ((magazines = mine))
+    mine->next = mine->prev = NULL;
+  __malloc_unlock ();
+}
+
 /* These routines are used by the application if it
    doesn't provide its own malloc. */
 
@@ -36,12 +420,8 @@ free (void *p)
   malloc_printf ("(%p), called by %p", p, caller_return_address ());
   if (!use_internal)
     user_data->free (p);
-  else
-    {
-      __malloc_lock ();
-      dlfree (p);
-      __malloc_unlock ();
-    }
+  else if (!mag_free (p))
+    heap_free (&p, 1);
 }
 
 extern "C" void *
@@ -50,12 +430,8 @@ malloc (size_t size)
   void *res;
   if (!use_internal)
     res = user_data->malloc (size);
-  else
-    {
-      __malloc_lock ();
-      res = dlmalloc (size);
-      __malloc_unlock ();
-    }
+  else if (!(res = mag_malloc (size)))
+    res = heap_malloc (my_arena (), size);
   malloc_printf ("(%ld) = %p, called by %p", size, res,
 					     caller_return_address ());
   return res;
@@ -65,14 +441,40 @@ extern "C" void *
 realloc (void *p, size_t size)
 {
   void *res;
+  int a;
   if (!use_internal)
     res = user_data->realloc (p, size);
-  else
+  else if (!p)
+    res = malloc (size);
+  else if ((a = arena_of (p)) < 0)
     {
       __malloc_lock ();
       res = dlrealloc (p, size);
       __malloc_unlock ();
     }
+  else
+    {
+      {
+	save_errno save;
+
+	arena_lock[a].acquire ();
+	res = mspace_realloc (arenas[a], p, size);
+	arena_lock[a].release ();
+      }
+      /* The arena is exhausted, move the block to the main heap. */
+      if (!res && size)
+	{
+	  __malloc_lock ();
+	  res = dlmalloc (size);
+	  __malloc_unlock ();
+	  if (res)
+	    {
+	      size_t old = dlmalloc_usable_size (p);
+	      memcpy (res, p, old < size ? old : size);
+	      free (p);
+	    }
+	}
+    }
   malloc_printf ("(%p, %ld) = %p, called by %p", p, size, res,
 						 caller_return_address ());
   return res;
@@ -93,8 +495,20 @@ extern "C" void *
 calloc (size_t nmemb, size_t size)
 {
   void *res;
+  size_t bytes;
+  int a;
   if (!use_internal)
     res = user_data->calloc (nmemb, size);
+  else if (__builtin_mul_overflow (nmemb, size, &bytes))
+    {
+      set_errno (ENOMEM);
+      res = NULL;
+    }
+  else if ((res = mag_malloc (bytes)))
+    memset (res, 0, bytes);
+  else if ((a = my_arena ()) >= 0
+	   && (res = heap_malloc (a, bytes)))
+    memset (res, 0, bytes);
   else
     {
       __malloc_lock ();
@@ -193,6 +607,10 @@ malloc_trim (size_t pad)
     }
   else
     {
+      /* Give the blocks cached by this thread back first.  The arenas
+	 can't shrink, they never give memory back to the system anyway. */
+      if (_my_tls.isinitialized () && _my_tls.mallocmag)
+	mag_flush_all (_my_tls.mallocmag);
       __malloc_lock ();
       res = dlmalloc_trim (pad);
       __malloc_unlock ();
@@ -220,17 +638,82 @@ mallopt (int p, int v)
   return res;
 }
 
+/* Return the statistics of arena A.  The parts of the arena which have
+   never been touched are neither in use nor taken from the system yet, so
+   they don't count. */
+static struct mallinfo
+arena_mallinfo (int a)
+{
+  char *base = arena_base + a * ARENA_SIZE;
+  size_t untouched = 0;
+  MEMORY_BASIC_INFORMATION mbi;
+  struct mallinfo m;
+
+  arena_lock[a].acquire ();
+  m = mspace_mallinfo (arenas[a]);
+  arena_lock[a].release ();
+  for (char *addr = base; addr < base + ARENA_SIZE; addr += mbi.RegionSize)
+    {
+      if (!VirtualQuery (addr, &mbi, sizeof mbi))
+	break;
+      if (mbi.State != MEM_COMMIT)
+	untouched += MIN (mbi.RegionSize, (size_t) (base + ARENA_SIZE - addr));
+    }
+  m.arena -= MIN (m.arena, untouched);
+  m.usmblks -= MIN (m.usmblks, untouched);
+  m.fordblks -= MIN (m.fordblks, untouched);
+  m.keepcost -= MIN (m.keepcost, untouched);
+  return m;
+}
+
+/* Return the statistics of the main heap and all arenas. */
+static struct mallinfo
+mallinfo_all ()
+{
+  struct mallinfo m;
+
+  __malloc_lock ();
+  m = dlmallinfo ();
+  __malloc_unlock ();
+  for (unsigned a = 0; a < MAX_ARENAS; ++a)
+    if (arenas[a])
+      {
+	struct mallinfo am = arena_mallinfo (a);
+
+	m.arena += am.arena;
+	m.ordblks += am.ordblks;
+	m.hblks += am.hblks;
+	m.hblkhd += am.hblkhd;
+	m.usmblks += am.usmblks;
+	m.uordblks += am.uordblks;
+	m.fordblks += am.fordblks;
+	m.keepcost += am.keepcost;
+      }
+  return m;
+}
+
 extern "C" void
 malloc_stats ()
 {
   if (!use_internal)
     set_errno (ENOSYS);
-  else
+  else if (!arena_base)
     {
       __malloc_lock ();
       dlmalloc_stats ();
       __malloc_unlock ();
     }
+  else
+    {
+      /* Same format as dlmalloc_stats. */
+      struct mallinfo m = mallinfo_all ();
+      fprintf (stderr, "max system bytes = %10lu\n",
+	       (unsigned long) m.usmblks);
+      fprintf (stderr, "system bytes     = %10lu\n",
+	       (unsigned long) (m.arena + m.hblkhd));
+      fprintf (stderr, "in use bytes     = %10lu\n",
+	       (unsigned long) m.uordblks);
+    }
 }
 
 extern "C" struct mallinfo
@@ -243,11 +726,7 @@ mallinfo ()
       set_errno (ENOSYS);
     }
   else
-    {
-      __malloc_lock ();
-      m = dlmallinfo ();
-      __malloc_unlock ();
-    }
+    m = mallinfo_all ();
 
   return m;
 }
@@ -275,6 +754,8 @@ void
 malloc_init ()
 {
   mallock.init ("mallock");
+  for (unsigned a = 0; a < MAX_ARENAS; ++a)
+    arena_lock[a].init ("arena_lock");
 
   /* Check if malloc is provided by application. If so, redirect all
      calls to malloc/free/realloc to application provided. This may
@@ -663,34 +663,56 @@ mount_info::conv_to_win32_path (const char *src_path, char *dst, device& dev,
 
   int chroot_pathlen;
   chroot_pathlen = 0;
-  /* Check the mount table for prefix matches. */
-  for (i = 0; i < nmounts; i++)
+  if (!cygheap->root.exists ())
     {
-      const char *path;
-      int len;
-
-      mi = mount + shortest_native_sorted[i];
-      debug_printf (" mount[%d] .. checking %s -> %s ", i, mi->posix_path, mi->native_path);
-
-      if (!cygheap->root.exists ()
-	  || (mi->posix_pathlen == 1 && mi->posix_path[0] == '/'))
+      /* Only check the mount points found in the prefix tree, in the
+	 same order as the loop below. */
+      uint64_t cand = posix_trie.lookup (src_path, mount->posix_path,
+					 sizeof *mount);
+      for (i = nmounts; cand; cand &= cand - 1)
 	{
-	  path = mi->posix_path;
-	  len = mi->posix_pathlen;
-	}
-      else if (cygheap->root.posix_ok (mi->posix_path))
-	{
-	  path = cygheap->root.unchroot (mi->posix_path);
-	  chroot_pathlen = len = strlen (path);
+	  int rank = __builtin_ctzll (cand);
+
+	  mi = mount + shortest_native_sorted[rank];
+	  if (path_prefix_p (mi->posix_path, src_path, mi->posix_pathlen,
+			     mi->flags & MOUNT_NOPOSIX))
+	    {
+	      i = rank;
+	      break;
+	    }
 	}
-      else
+    }
+  else
+    {
+      /* In a chroot, check the mount table for prefix matches of the
+	 unchrooted mount points. */
+      for (i = 0; i < nmounts; i++)
 	{
-	  chroot_pathlen = 0;
-	  continue;
-	}
+	  const char *path;
+	  int len;
 
-      if (path_prefix_p (path, src_path, len, mi->flags & MOUNT_NOPOSIX))
-	break;
+	  mi = mount + shortest_native_sorted[i];
+	  debug_printf (" mount[%d] .. checking %s -> %s ", i, mi->posix_path, mi->native_path);
+
+	  if (mi->posix_pathlen == 1 && mi->posix_path[0] == '/')
+	    {
+	      path = mi->posix_path;
+	      len = mi->posix_pathlen;
+	    }
+	  else if (cygheap->root.posix_ok (mi->posix_path))
+	    {
+	      path = cygheap->root.unchroot (mi->posix_path);
+	      chroot_pathlen = len = strlen (path);
+	    }
+	  else
+	    {
+	      chroot_pathlen = 0;
+	      continue;
+	    }
+
+	  if (path_prefix_p (path, src_path, len, mi->flags & MOUNT_NOPOSIX))
+	    break;
+	}
     }
 
   if (i < nmounts)
@@ -900,8 +922,13 @@ mount_info::conv_to_posix_path (const char *src_path, char *posix_path,
     }
 
   int pathbuflen = tail - pathbuf;
-  for (int i = 0; i < nmounts; ++i)
+  /* Only check the mount points found in the prefix tree. */
+  for (uint64_t cand = native_trie.lookup (pathbuf, mount->native_path,
+					   sizeof *mount);
+       cand;
+       cand &= cand - 1)
     {
+      int i = __builtin_ctzll (cand);
       mount_item &mi = mount[longest_posix_sorted[i]];
       debug_printf (" mount[%d] .. checking %s -> %s ", i, mi.posix_path, mi.native_path);
       if (!path_prefix_p (mi.native_path, pathbuf, mi.native_pathlen,
@@ -1249,6 +1276,7 @@ mount_info::write_cygdrive_info (const char *cygdrive_prefix, unsigned flags)
   slashify (cygdrive_prefix, cygdrive, 1);
   cygdrive_flags = flags & ~MOUNT_SYSTEM;
   cygdrive_len = strlen (cygdrive);
+  generation++;
 
   return 0;
 }
@@ -1494,6 +1522,20 @@ mount_info::sort ()
       mount_item *mi = mount + longest_posix_sorted[i];
       debug_printf ("longest_posix_sorted[%d] %12s       %12s", i, mi->native_path, mi->posix_path);
   }
+  posix_trie.init ();
+  native_trie.init ();
+  for (int i = 0; i < nmounts; i++)
+    {
+      mount_item *mi = mount + shortest_native_sorted[i];
+      posix_trie.insert (shortest_native_sorted[i], i, mi->posix_pathlen,
+			 mi->flags & MOUNT_NOPOSIX, mount->posix_path,
+			 sizeof *mount);
+      mi = mount + longest_posix_sorted[i];
+      native_trie.insert (longest_posix_sorted[i], i, mi->native_pathlen,
+			  mi->flags & MOUNT_NOPOSIX, mount->native_path,
+			  sizeof *mount);
+    }
+  generation++;
 }
 
 /* Add an entry to the mount table.
@@ -9,6 +9,8 @@ details. */
 #ifndef _MOUNT_H
 #define _MOUNT_H
 
+#include "mount_trie.h"
+
 #define __CCP_APP_SLASH	0x10000000	/* Internal flag for conv_to_posix_path.
 					   always append slash, even if path
 					   is "X:\\" only. */
@@ -157,6 +159,9 @@ class mount_item
    What we need is to have a more dynamic allocation scheme, but the current
    scheme should be satisfactory for a long while yet.  */
 #define MAX_MOUNTS 64
+#if MAX_MOUNTS > MOUNT_TRIE_MAX_KEYS
+#error MAX_MOUNTS exceeds the capacity of mount_trie
+#endif
 
 class reg_key;
 struct device;
@@ -179,11 +184,19 @@ class mount_info
   char cygdrive[CYG_MAX_PATH];
   size_t cygdrive_len;
   unsigned cygdrive_flags;
+  /* Bumped on every change to the table or the cygdrive prefix, so that
+     per-process caches of converted paths notice changes made by other
+     processes sharing this table. */
+  unsigned generation;
  private:
   int posix_sorted[MAX_MOUNTS];
   int native_sorted[MAX_MOUNTS];
   int longest_posix_sorted[MAX_MOUNTS];
   int shortest_native_sorted[MAX_MOUNTS];
+  /* Prefix trees over the POSIX paths in shortest_native_sorted order,
+     and over the native paths in longest_posix_sorted order. */
+  mount_trie posix_trie;
+  mount_trie native_trie;
 
  public:
   void init (bool);
@@ -0,0 +1,196 @@
+/* mount_trie.h: prefix tree over mount table paths.
+
+This file is part of Cygwin.
+
+This software is a copyrighted work licensed under the terms of the
+Cygwin license.  Please consult the file "CYGWIN_LICENSE" for
+details. */
+
+#ifndef _MOUNT_TRIE_H
+#define _MOUNT_TRIE_H
+
+/* This file doesn't depend on anything else in Cygwin, so the lookup logic
+   can be tested and benchmarked on any host.  See
+   winsup/testsuite/host/mount_trie.cc. */
+
+#include <stdint.h>
+#include <string.h>
+
+/* A radix tree over the POSIX or the native paths of the mount table, used
+   to find all mount points which are a path prefix of a given path without
+   comparing the path against every single mount point.
+
+   The tree doesn't store any strings.  The edge labels point into the keys,
+   which are passed in as base pointer plus stride, so the tree can live in
+   the shared mount_info without dangling pointers.
+
+   Every key is identified by its rank, a number < 64 giving its position in
+   the order in which the caller wants to check the mount points.  lookup
+   returns a bitmask of the ranks of all candidate keys.  Comparison folds
+   ASCII case, so the candidates are a superset of the real matches, and
+   the caller has to verify the candidates with path_prefix_p, taking the
+   case sensitivity of the mount point into account.  Since non-ASCII
+   characters may match case-insensitively in a multibyte charset without
+   being equal bytewise, case-insensitive keys containing non-ASCII chars
+   are always returned as candidates, and if the path contains non-ASCII
+   chars, all keys longer than the ASCII part are returned as well. */
+
+#define MOUNT_TRIE_MAX_KEYS 64
+#define MOUNT_TRIE_MAX_NODES (2 * MOUNT_TRIE_MAX_KEYS + 1)
+
+class mount_trie
+{
+  struct node
+  {
+    uint64_t mask;	/* Ranks of the keys ending here. */
+    uint64_t below;	/* Ranks of the keys ending here or in a subtree. */
+    int16_t child;	/* First child, -1 if none. */
+    int16_t sibling;	/* Next sibling, -1 if none. */
+    int16_t key;	/* Index of the key providing the edge label. */
+    uint16_t off;	/* Offset of the edge label in the key. */
+    uint16_t len;	/* Length of the edge label. */
+  };
+  node nodes[MOUNT_TRIE_MAX_NODES];
+  int nnodes;
+  uint64_t always;	/* Ranks of keys which can't be handled by the tree. */
+
+  static unsigned char fold (unsigned char c)
+  {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+  }
+  static bool isdirsep (char c) { return c == '/' || c == '\\'; }
+  static const char *key_str (const void *base, size_t stride, int key)
+  {
+    return (const char *) base + key * stride;
+  }
+  const char *label (const node &n, const void *base, size_t stride) const
+  {
+    return key_str (base, stride, n.key) + n.off;
+  }
+  int new_node (int key, int off, int len)
+  {
+    node &n = nodes[nnodes];
+    n.mask = n.below = 0;
+    n.child = n.sibling = -1;
+    n.key = key;
+    n.off = off;
+    n.len = len;
+    return nnodes++;
+  }
+  /* Find the child of node n whose label starts with c. */
+  int find_child (int n, unsigned char c, const void *base,
+		  size_t stride) const
+  {
+    for (int ch = nodes[n].child; ch >= 0; ch = nodes[ch].sibling)
+      if (fold (*label (nodes[ch], base, stride)) == c)
+	return ch;
+    return -1;
+  }
+
+public:
+  void init ()
+  {
+    nnodes = 0;
+    always = 0;
+    new_node (0, 0, 0);
+  }
+
+  /* Add key number KEY with rank RANK.  The key string is the first LEN
+     bytes of the string at BASE + KEY * STRIDE.  As in path_prefix_p, a
+     trailing dirsep is ignored. */
+  void insert (int key, int rank, int len, bool caseinsensitive,
+	       const void *base, size_t stride)
+  {
+    const char *str = key_str (base, stride, key);
+    uint64_t bit = (uint64_t) 1 << rank;
+    int n = 0, pos = 0;
+
+    if (len > 0 && isdirsep (str[len - 1]))
+      --len;
+    if (caseinsensitive)
+      for (int i = 0; i < len; ++i)
+	if ((unsigned char) str[i] >= 0x80)
+	  {
+	    always |= bit;
+	    return;
+	  }
+    while (true)
+      {
+	nodes[n].below |= bit;
+	if (pos == len)
+	  {
+	    nodes[n].mask |= bit;
+	    return;
+	  }
+	int ch = find_child (n, fold (str[pos]), base, stride);
+	if (ch < 0)
+	  {
+	    ch = new_node (key, pos, len - pos);
+	    nodes[ch].mask = nodes[ch].below = bit;
+	    nodes[ch].sibling = nodes[n].child;
+	    nodes[n].child = ch;
+	    return;
+	  }
+	const char *lbl = label (nodes[ch], base, stride);
+	int l = 1;
+	while (l < nodes[ch].len && pos + l < len
+	       && fold (lbl[l]) == fold (str[pos + l]))
+	  ++l;
+	if (l < nodes[ch].len)
+	  {
+	    /* Split the edge.  The new node takes the place of ch in the
+	       sibling list of n. */
+	    int mid = new_node (nodes[ch].key, nodes[ch].off, l);
+	    nodes[mid].below = nodes[ch].below;
+	    nodes[mid].child = ch;
+	    nodes[mid].sibling = nodes[ch].sibling;
+	    nodes[ch].sibling = -1;
+	    nodes[ch].off += l;
+	    nodes[ch].len -= l;
+	    int16_t *link = &nodes[n].child;
+	    while (*link != ch)
+	      link = &nodes[*link].sibling;
+	    *link = mid;
+	    ch = mid;
+	  }
+	n = ch;
+	pos += l;
+      }
+  }
+
+  /* Return the ranks of all keys which might be a path prefix of PATH. */
+  uint64_t lookup (const char *path, const void *base, size_t stride) const
+  {
+    uint64_t ret = always;
+    int n = 0, pos = 0;
+
+    /* The empty key, i.e. "/", matches like in path_prefix_p. */
+    if (nodes[0].mask && isdirsep (path[0]) && !isdirsep (path[1]))
+      ret |= nodes[0].mask;
+    while (path[pos])
+      {
+	if ((unsigned char) path[pos] >= 0x80)
+	  return ret | (nodes[n].below & ~nodes[n].mask);
+	int ch = find_child (n, fold (path[pos]), base, stride);
+	if (ch < 0)
+	  break;
+	const char *lbl = label (nodes[ch], base, stride);
+	for (int l = 1; l < nodes[ch].len; ++l)
+	  {
+	    if ((unsigned char) path[pos + l] >= 0x80)
+	      return ret | nodes[ch].below;
+	    if (fold (lbl[l]) != fold (path[pos + l]))
+	      return ret;
+	  }
+	n = ch;
+	pos += nodes[ch].len;
+	if (nodes[n].mask
+	    && (isdirsep (path[pos]) || !path[pos]
+		|| lbl[nodes[n].len - 1] == ':'))
+	  ret |= nodes[n].mask;
+      }
+    return ret;
+  }
+};
+
+#endif /*_MOUNT_TRIE_H*/
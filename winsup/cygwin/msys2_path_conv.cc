@@ -136,6 +136,7 @@
   
 */
 
+#ifndef MSYS2_PATH_CONV_STANDALONE
 #include "winsup.h"
 #include "miscfuncs.h"
 #include <ctype.h>
@@ -157,6 +158,15 @@
 #include <ntdll.h>
 #include <wchar.h>
 #include <wctype.h>
+#else
+// Built outside of the DLL, e.g. for winsup/testsuite/host.  The caller
+// provides posix_to_win32_path.
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#define debug_printf(...) do {} while (0)
+#define system_printf(...) fprintf(stderr, __VA_ARGS__)
+#endif
 
 #include "msys2_path_conv.h"
 
@@ -174,7 +184,6 @@ typedef enum PATH_TYPE_E {
 } path_type;
 
 int is_special_posix_path(const char* from, const char* to, char** dst, const char* dstend);
-void posix_to_win32_path(const char* from, const char* to, char** dst, const char* dstend);
 
 
 path_type find_path_start_and_type(const char** src, int recurse, const char* end);
@@ -260,36 +269,29 @@ void sub_convert(const char** from, const char** to, char** dst, const char* dst
     }
 }
 
-const char* convert(char *dst, size_t dstlen, const char *src) {
-    if (dst == NULL || dstlen == 0 || src == NULL) {
-        return dst;
-    }
-
-    int need_convert = false;
+int may_need_convert(const char *src) {
     for (const char* it = src; *it != '\0'; ++it) {
         if (*it == '\\' || *it == '/') {
-            need_convert = true;
-            break;
+            return true;
         }
         if (isspace(*it)) {
-            need_convert = false;
-            break;
+            return false;
         }
     }
+    return false;
+}
 
-    char* dstit = dst;
-    char* dstend = dst + dstlen;
-    if (!need_convert) {
-        copy_to_dst(src, NULL, &dstit, dstend);
-        *dstit = '\0';
+const char* convert(char *dst, size_t dstlen, const char *src) {
+    if (dst == NULL || dstlen == 0 || src == NULL) {
         return dst;
     }
-    *dstend = '\0';
-
-    const char* srcit = src;
-    const char* srcbeg = src;
 
+    // A single pass over the source decides whether there is anything to
+    // convert at all (a slash before the first whitespace), tracks the
+    // quoting state and finds the end of the string.
+    int need_convert = -1;
     int in_string = false;
+    const char* srcit = src;
 
     for (; *srcit != '\0'; ++srcit) {
         if (*srcit == '\'' || *srcit == '"') {
@@ -300,28 +302,34 @@ const char* convert(char *dst, size_t dstlen, const char *src) {
             } else {
                 in_string = *srcit;
             }
-            continue;
+        } else if (need_convert < 0) {
+            if (*srcit == '\\' || *srcit == '/') {
+                need_convert = true;
+            } else if (isspace(*srcit)) {
+                break;
+            }
         }
     }
 
-    sub_convert(&srcbeg, &srcit, &dstit, dstend, &in_string);
-    if (!*srcit) {
-      *dstit = '\0';
-      return dst;
+    // Skip path mangling when environment indicates it.
+    if (need_convert != true || getenv("MSYS_NO_PATHCONV")) {
+        size_t len = strnlen(src, dstlen);
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+        return dst;
     }
-    srcbeg = srcit + 1;
-    for (; *srcit != '\0'; ++srcit) {
-      continue;
+
+    char* dstit = dst;
+    char* dstend = dst + dstlen;
+    *dstend = '\0';
+
+    const char* srcbeg = src;
+    sub_convert(&srcbeg, &srcit, &dstit, dstend, &in_string);
+    if (*srcit) {
+        copy_to_dst(srcit + 1, NULL, &dstit, dstend);
     }
-    copy_to_dst(srcbeg, srcit, &dstit, dstend);
     *dstit = '\0';
 
-    /*if (dstit - dst < 2) {
-        dstit = dst;
-        copy_to_dst(src, NULL, &dstit, dstend);
-        *dstit = '\0';
-    }*/
-
     return dst;
 }
 
@@ -348,21 +356,14 @@ skip_p2w:
         return NONE;
     }
 
-    /*
-     * Skip path mangling when environment indicates it.
-     */
-    const char *no_pathconv = getenv ("MSYS_NO_PATHCONV");
-
-    if (no_pathconv)
-      goto skip_p2w;
-
     /*
      * Prevent Git's :file.txt and :/message syntax from beeing modified.
      */
     if (*it == ':')
         goto skip_p2w;
 
-    while (it != end && *it) {
+    // When recursing, the whole range has been checked already.
+    while (!recurse && it != end && *it) {
         switch (*it) {
         case '`':
         case '\'':
@@ -679,11 +680,12 @@ int is_special_posix_path(const char* from, const char* to, char** dst, const ch
     return false;
 }
 
+#ifndef MSYS2_PATH_CONV_STANDALONE
 void posix_to_win32_path(const char* from, const char* to, char** dst, const char* dstend) {
     if ( from != to ) {
         tmp_pathbuf tp;
         char *one_path = tp.c_get();
-        strncpy(one_path, from, to-from);
+        memcpy(one_path, from, to-from);
         one_path[to-from] = '\0';
 
         path_conv conv (one_path, PC_KEEP_FINAL_SLASH);
@@ -692,12 +694,12 @@ void posix_to_win32_path(const char* from, const char* to, char** dst, const cha
           set_errno(conv.error);
           copy_to_dst(one_path, NULL, dst, dstend);
         } else {
-          char* win32_path = tp.c_get();
-          stpcpy (win32_path, conv.get_win32 ());
+          const char* win32_path = conv.get_win32 ();
           for (; (*win32_path != '\0') && (*dst != dstend); ++win32_path, ++(*dst)) {
              **dst = (*win32_path == '\\') ? '/' : *win32_path;
           }
         }
     }
 }
+#endif
 
@@ -143,5 +143,14 @@
 
 const char* convert(char *dst, size_t dstlen, const char *src);
 
+// Cheap pre-scan: returns false if convert would copy src unchanged
+// because there is no slash or backslash before the first whitespace.
+int may_need_convert(const char *src);
+
+// Convert the POSIX path [from, to) to a Windows path with forward slashes
+// and append it to *dst, not writing beyond dstend.  Defined in the DLL;
+// standalone builds (MSYS2_PATH_CONV_STANDALONE) have to provide it.
+void posix_to_win32_path(const char* from, const char* to, char** dst, const char* dstend);
+
 #endif /* end of include guard: PATH_CONV_H_DB4IQBH3 */
 
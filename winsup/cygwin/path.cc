@@ -586,6 +586,263 @@ getfileattr (const char *path, bool caseinsensitive) /* path has to be always ab
   return INVALID_FILE_ATTRIBUTES;
 }
 
+/* Per-process cache of path_conv::check results.  Build tools stat the
+   same files over and over again, and every single call walks the path
+   through normalize_posix_path, the mount table and symlink_info::check.
+
+   Only existing plain filesystem objects are cached, so a file created
+   after a failed lookup is always found.  The cache only holds the result
+   of the resolution, the native path, mount and fs_info.  A hit fetches
+   the file attributes again, so a file deleted or replaced by a directory
+   or a reparse point by another process is noticed right away and the
+   path is resolved from scratch.  The cache is flushed when the cwd, the
+   chroot or the path charset changes and whenever this process changes
+   the filesystem namespace.  Changes to the mount table are noted via the
+   mount table generation.  Symlinks created in the middle of a cached
+   path by other processes can't be noticed cheaply, so entries expire
+   after PCC_TTL milliseconds.
+
+   A cache hit never returns a handle, not even with PC_KEEP_HANDLE.  The
+   callers have to cope with that anyway, since symlink_info::check doesn't
+   keep a handle in all cases either.
+
+   The slot table and the entries live on the cygheap with HEAP_1_* types,
+   so they are inherited on fork, but dropped on exec. */
+
+#define PCC_SIZE	16384	/* Number of slots, must be a power of two. */
+#define PCC_FS_CNT	32	/* Number of distinct fs_info's. */
+#define PCC_TTL		1000	/* Lifetime of an entry in ms. */
+/* Attributes which decide how an object is resolved. */
+#define PCC_ATTR_MASK	(FILE_ATTRIBUTE_DIRECTORY \
+			 | FILE_ATTRIBUTE_REPARSE_POINT \
+			 | FILE_ATTRIBUTE_SYSTEM)
+
+class path_conv_cache
+{
+  static muto pcc_lock;
+  struct pcc_entry
+  {
+    uint32_t hash;
+    uint32_t opt;
+    const suffix_info *suffixes;
+    ULONGLONG stamp;
+    unsigned gen;
+    unsigned mount_gen;
+    DWORD fileattr;
+    ULONG caseinsensitive;
+    uint32_t mount_flags;
+    uint32_t path_flags;
+    uint16_t fs_idx;
+    uint16_t path_off;		/* Offsets into data. */
+    uint16_t posix_off;		/* 0 if no posix path. */
+    int16_t suffix;		/* Offset into path, -1 if none. */
+    char data[0];		/* src, path, posix path. */
+  };
+  pcc_entry **slot;
+  fs_info fsi[PCC_FS_CNT];
+  uint32_t fsi_cnt;
+  unsigned gen;
+  uint64_t hits;
+  uint64_t misses;
+
+  static uint32_t genhash (const char *, uint32_t);
+  int fs_idx (const fs_info &);
+
+public:
+  path_conv_cache () : slot (NULL), fsi_cnt (0), gen (0), hits (0), misses (0)
+  { pcc_lock.init ("pcc_lock"); }
+  bool search (const char *, uint32_t, const suffix_info *, path_conv &,
+	       unsigned &);
+  void add (const char *, uint32_t, const suffix_info *, unsigned,
+	    path_conv &);
+  void flush ();
+  void stats (uint64_t *, uint64_t *);
+};
+
+static path_conv_cache pc_cache;
+muto NO_COPY path_conv_cache::pcc_lock;
+
+uint32_t
+path_conv_cache::genhash (const char *src, uint32_t opt)
+{
+  uint32_t hash = opt;
+  while (*src)
+    hash = (unsigned char) *src++ + (hash << 6) + (hash << 16) - hash;
+  return hash;
+}
+
+/* Most entries share the fs_info of only a handful of volumes, so store
+   every distinct fs_info just once. */
+int
+path_conv_cache::fs_idx (const fs_info &fs)
+{
+  uint32_t i;
+
+  for (i = 0; i < fsi_cnt; ++i)
+    if (!memcmp (&fsi[i], &fs, sizeof fs))
+      return i;
+  if (fsi_cnt >= PCC_FS_CNT)
+    return -1;
+  fsi[fsi_cnt] = fs;
+  return fsi_cnt++;
+}
+
+bool
+path_conv_cache::search (const char *src, uint32_t opt,
+			 const suffix_info *suffixes, path_conv &pc,
+			 unsigned &cur_gen)
+{
+  uint32_t hash = genhash (src, opt);
+  pcc_entry *e, *stale = NULL;
+  DWORD fileattr = INVALID_FILE_ATTRIBUTES;
+  bool ret = false;
+
+  pcc_lock.acquire ();
+  cur_gen = gen;
+  if (!slot || !(e = slot[hash & (PCC_SIZE - 1)]))
+    /* nothing */;
+  else if (e->gen != gen || e->mount_gen != mount_table->generation
+	   || GetTickCount64 () - e->stamp > PCC_TTL)
+    {
+      cfree (e);
+      slot[hash & (PCC_SIZE - 1)] = NULL;
+    }
+  else if (e->hash == hash && e->opt == opt && e->suffixes == suffixes
+	   && !strcmp (e->data, src))
+    {
+      pc.free_strings ();
+      pc.close_conv_handle ();
+      pc.set_path (e->data + e->path_off);
+      if (e->posix_off)
+	pc.set_posix (e->data + e->posix_off);
+      pc.suffix = e->suffix >= 0 ? pc.path + e->suffix : NULL;
+      pc.caseinsensitive = e->caseinsensitive;
+      pc.mount_flags = e->mount_flags;
+      pc.path_flags = e->path_flags;
+      pc.symlink_length = 0;
+      pc.fs = fsi[e->fs_idx];
+      pc.dev = *fs_dev;
+      pc.error = 0;
+      fileattr = e->fileattr;
+      stale = e;
+      ret = true;
+    }
+  pcc_lock.release ();
+  /* Check that the object is still there and still the same kind of
+     object, without holding the lock. */
+  if (ret)
+    {
+      pc.fileattr = getfileattr (pc.path, pc.caseinsensitive);
+      if (pc.fileattr == INVALID_FILE_ATTRIBUTES
+	  || ((pc.fileattr ^ fileattr) & PCC_ATTR_MASK))
+	{
+	  pc.fileattr = INVALID_FILE_ATTRIBUTES;
+	  ret = false;
+	}
+      else
+	stale = NULL;
+    }
+  pcc_lock.acquire ();
+  /* A stale entry has to go, unless it's already been replaced. */
+  if (stale && slot[hash & (PCC_SIZE - 1)] == stale)
+    {
+      cfree (stale);
+      slot[hash & (PCC_SIZE - 1)] = NULL;
+    }
+  if (ret)
+    ++hits;
+  else
+    ++misses;
+  pcc_lock.release ();
+  return ret;
+}
+
+void
+path_conv_cache::add (const char *src, uint32_t opt,
+		      const suffix_info *suffixes, unsigned old_gen,
+		      path_conv &pc)
+{
+  uint32_t hash = genhash (src, opt);
+  size_t srclen = strlen (src) + 1;
+  size_t pathlen = strlen (pc.path) + 1;
+  size_t posixlen = pc.posix_path ? strlen (pc.posix_path) + 1 : 0;
+  pcc_entry *e;
+  int idx;
+
+  /* Only cache paths of sane length, the offsets are 16 bit. */
+  if (srclen + pathlen + posixlen > 32768)
+    return;
+  pcc_lock.acquire ();
+  /* Don't add the result if the cache has been flushed while we were
+     busy, it might have been computed from outdated information. */
+  if (old_gen != gen)
+    /* nothing */;
+  else if (!slot
+	   && !(slot = (pcc_entry **) ccalloc (HEAP_1_BUF, PCC_SIZE,
+					       sizeof *slot)))
+    /* nothing */;
+  else if ((idx = fs_idx (pc.fs)) >= 0
+	   && (e = (pcc_entry *) cmalloc (HEAP_1_STR, sizeof *e + srclen
+							 + pathlen
+							 + posixlen)))
+    {
+      e->hash = hash;
+      e->opt = opt;
+      e->suffixes = suffixes;
+      e->stamp = GetTickCount64 ();
+      e->gen = gen;
+      e->mount_gen = mount_table->generation;
+      e->fileattr = pc.fileattr;
+      e->caseinsensitive = pc.caseinsensitive;
+      e->mount_flags = pc.mount_flags;
+      e->path_flags = pc.path_flags;
+      e->fs_idx = idx;
+      e->path_off = srclen;
+      e->posix_off = posixlen ? srclen + pathlen : 0;
+      e->suffix = pc.suffix ? pc.suffix - pc.path : -1;
+      memcpy (e->data, src, srclen);
+      memcpy (e->data + e->path_off, pc.path, pathlen);
+      if (posixlen)
+	memcpy (e->data + e->posix_off, pc.posix_path, posixlen);
+      if (slot[hash & (PCC_SIZE - 1)])
+	cfree (slot[hash & (PCC_SIZE - 1)]);
+      slot[hash & (PCC_SIZE - 1)] = e;
+    }
+  pcc_lock.release ();
+}
+
+/* Entries of older generations are dropped lazily in search. */
+void
+path_conv_cache::flush ()
+{
+  pcc_lock.acquire ();
+  ++gen;
+  pcc_lock.release ();
+}
+
+void
+path_conv_cache::stats (uint64_t *hitp, uint64_t *missp)
+{
+  pcc_lock.acquire ();
+  if (hitp)
+    *hitp = hits;
+  if (missp)
+    *missp = misses;
+  pcc_lock.release ();
+}
+
+void
+flush_path_conv_cache ()
+{
+  pc_cache.flush ();
+}
+
+void
+path_conv_cache_stats (uint64_t *hits, uint64_t *misses)
+{
+  pc_cache.stats (hits, misses);
+}
+
 /* Convert an arbitrary path SRC to a pure Win32 path, suitable for
    passing to Win32 API routines.
 
@@ -634,20 +891,15 @@ path_conv::check (const char *src, unsigned opt,
   bool add_ext = false;
   bool is_relpath;
   char *tail, *path_end;
-
-#if 0
-  static path_conv last_path_conv;
-  static char last_src[CYG_MAX_PATH];
-
-  if (*last_src && strcmp (last_src, src) == 0)
-    {
-      *this = last_path_conv;
-      return;
-    }
-#endif
+  const char *in_src = src;
+  unsigned in_opt = opt;
+  unsigned pcc_gen;
 
   __try
     {
+      if (pc_cache.search (in_src, in_opt, suffixes, *this, pcc_gen))
+	return;
+
       int loop = 0;
       mount_flags = 0;
       path_flags = 0;
@@ -1253,13 +1505,11 @@ path_conv::check (const char *src, unsigned opt,
 	  set_posix (path_copy);
 	}
 
-#if 0
-      if (!error)
-	{
-	  last_path_conv = *this;
-	  strcpy (last_src, src);
-	}
-#endif
+      if (!error && exists () && !issymlink ()
+	  && !memcmp (&dev, fs_dev, sizeof dev)
+	  && !(in_opt & PC_SYM_CONTENTS)
+	  && !(path_flags & (PATH_SOCKET | PATH_RESOLVE_PROCFD)))
+	pc_cache.add (in_src, in_opt, suffixes, pcc_gen, *this);
     }
   __except (NO_ERROR)
     {
@@ -3868,6 +4118,121 @@ arg_heuristic (char const * const arg)
 }
 
 
+arg_heuristic_batch::arg_heuristic_batch (const char *exclusions)
+: excl_buf (NULL), excl (NULL), excl_all (false),
+  no_pathconv (!!getenv ("MSYS_NO_PATHCONV")), chunks (NULL), used (0)
+{
+  set_exclusions (exclusions);
+}
+
+arg_heuristic_batch::~arg_heuristic_batch ()
+{
+  free (excl_buf);
+  free (excl);
+  while (chunks)
+    {
+      chunk *next = chunks->next;
+      free (chunks);
+      chunks = next;
+    }
+}
+
+/* EXCLUSIONS is a ';' separated list of prefixes, as in MSYS2_ARG_CONV_EXCL
+   and MSYS2_ENV_CONV_EXCL.  The prefixes are bucketed by their first byte,
+   so checking an argument only compares the prefixes starting with the
+   same byte. */
+void
+arg_heuristic_batch::set_exclusions (const char *exclusions)
+{
+  size_t count = 0;
+  char *e;
+
+  free (excl_buf);
+  free (excl);
+  excl_buf = NULL;
+  excl = NULL;
+  excl_all = false;
+  memset (excl_idx, 0, sizeof excl_idx);
+  if (!exclusions || !(excl_buf = strdup (exclusions)))
+    return;
+  count = string_split_delimited (excl_buf, ';');
+  if (!(excl = (excl_entry *) malloc (count * sizeof *excl)))
+    return;
+  /* Count the prefixes per first byte, turn the counts into start indices,
+     then fill in the prefixes. */
+  e = excl_buf;
+  for (size_t i = 0; i < count; ++i, e += strlen (e) + 1)
+    if (!strcmp (e, "*"))
+      excl_all = true;
+    else if (*e)
+      ++excl_idx[(unsigned char) *e + 1];
+  for (int c = 1; c < 257; ++c)
+    excl_idx[c] += excl_idx[c - 1];
+  uint16_t next[256];
+  memcpy (next, excl_idx, sizeof next);
+  e = excl_buf;
+  for (size_t i = 0; i < count; ++i, e += strlen (e) + 1)
+    if (*e && strcmp (e, "*"))
+      {
+	excl_entry &ent = excl[next[(unsigned char) *e]++];
+	ent.str = e;
+	ent.len = strlen (e);
+      }
+}
+
+bool
+arg_heuristic_batch::excluded (const char *arg) const
+{
+  unsigned char c = *arg;
+
+  if (excl_all)
+    return true;
+  for (int i = excl_idx[c]; i < excl_idx[c + 1]; ++i)
+    if (!strncmp (arg, excl[i].str, excl[i].len))
+      return true;
+  return false;
+}
+
+const char *
+arg_heuristic_batch::convert (const char *arg)
+{
+  if (!arg || !*arg || no_pathconv || !may_need_convert (arg)
+      || excluded (arg))
+    return arg;
+
+  /* Leave enough room for at least 16 path elements, as in
+     arg_heuristic_with_exclusions. */
+  size_t arglen = strlen (arg);
+  size_t len = arglen + 16 * MAX_PATH;
+  if (!chunks || chunks->size - used < len)
+    {
+      size_t size = MAX (len, 65536 - sizeof (chunk));
+      chunk *c = (chunk *) malloc (sizeof (chunk) + size);
+      if (!c)
+	{
+	  debug_printf ("out of memory converting %s", arg);
+	  return arg;
+	}
+      c->next = chunks;
+      c->size = size;
+      chunks = c;
+      used = 0;
+    }
+  char *buf = chunks->data + used;
+  ::convert (buf, len - 1, arg);
+  debug_printf ("convert()'ed: %s (length %ld)\n.....->: %s", arg, arglen, buf);
+  if (!strcmp (arg, buf))
+    return arg;
+  /* Windows doesn't like empty entries in PATH env. variables (;;) */
+  char *in, *out;
+  for (in = out = buf; *in; ++in)
+    if (*in != ';' || out == buf || out[-1] != ';')
+      *out++ = *in;
+  *out = '\0';
+  used += out - buf + 1;
+  return buf;
+}
+
 /******************** Exported Path Routines *********************/
 
 /* Cover functions to the path conversion routines.
@@ -5247,6 +5612,8 @@ cwdstuff::set (path_conv *nat_cwd, const char *posix_cwd)
     }
   posix = (char *) crealloc_abort (posix, strlen (posix_cwd) + 1);
   stpcpy (posix, posix_cwd);
+  /* Cached results of relative paths are invalid now. */
+  flush_path_conv_cache ();
 
   cwd_lock.release ();
   return 0;
@@ -5282,6 +5649,8 @@ cwdstuff::reset_posix (wchar_t *w_cwd)
   size_t len = sys_wcstombs_path (NULL, (size_t) -1, w_cwd);
   posix = (char *) crealloc_abort (posix, len + 1);
   sys_wcstombs_path (posix, len + 1, w_cwd);
+  /* The charset changed, so the cached path conversions are wrong. */
+  flush_path_conv_cache ();
 }
 
 char *
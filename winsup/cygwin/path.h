@@ -151,6 +151,8 @@ class path_conv
   void add_ext_from_sym (symlink_info&);
   char *modifiable_path () {return (char *) path;}
 
+  friend class path_conv_cache;
+
  public:
   int error;
   device dev;
@@ -448,3 +450,42 @@ int normalize_posix_path (const char *, char *, char *&);
 PUNICODE_STRING __reg3 get_nt_native_path (const char *, UNICODE_STRING&, bool);
 
 int __reg3 symlink_worker (const char *, path_conv &, bool);
+
+void flush_path_conv_cache ();
+void path_conv_cache_stats (uint64_t *, uint64_t *);
+
+/* Converts all arguments or environment strings passed to a non-msys child
+   process the same way as arg_heuristic_with_exclusions, but parses the
+   exclusion list only once and converts all strings into a few large
+   chunks of memory, instead of allocating memory per string. */
+class arg_heuristic_batch
+{
+  struct excl_entry
+  {
+    const char *str;
+    size_t len;
+  };
+  char *excl_buf;		/* Copy of the exclusion list, split at ';'. */
+  excl_entry *excl;		/* Exclusions, sorted by their first byte. */
+  uint16_t excl_idx[257];	/* Index of the first exclusion per byte. */
+  bool excl_all;		/* Exclusion list contains "*". */
+  bool no_pathconv;		/* MSYS_NO_PATHCONV is set. */
+  struct chunk
+  {
+    chunk *next;
+    size_t size;
+    char data[0];
+  };
+  chunk *chunks;		/* Most recently allocated chunk first. */
+  size_t used;			/* Bytes used in the first chunk. */
+
+  bool excluded (const char *arg) const;
+
+public:
+  arg_heuristic_batch (const char *exclusions = NULL);
+  ~arg_heuristic_batch ();
+  void set_exclusions (const char *exclusions);
+  /* Return ARG itself if it doesn't change, otherwise the converted string,
+     which stays valid as long as the object exists. */
+  const char *convert (const char *arg);
+};
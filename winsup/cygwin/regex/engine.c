@@ -53,6 +53,8 @@ __FBSDID("$FreeBSD: src/lib/libc/regex/engine.c,v 1.23 2009/09/16 06:32:23 dds E
 #define	print	sprint
 #define	at	sat
 #define	match	smat
+#define	dfasmall	1	/* see dfaflags() */
+#define	dfamb	0
 #endif
 #ifdef LNAMES
 #define	matcher	lmatcher
@@ -64,6 +66,8 @@ __FBSDID("$FreeBSD: src/lib/libc/regex/engine.c,v 1.23 2009/09/16 06:32:23 dds E
 #define	print	lprint
 #define	at	lat
 #define	match	lmat
+#define	dfasmall	0
+#define	dfamb	0
 #endif
 #ifdef MNAMES
 #define	matcher	mmatcher
@@ -75,6 +79,8 @@ __FBSDID("$FreeBSD: src/lib/libc/regex/engine.c,v 1.23 2009/09/16 06:32:23 dds E
 #define	print	mprint
 #define	at	mat
 #define	match	mmat
+#define	dfasmall	0
+#define	dfamb	1	/* the DFA only knows UTF-8 */
 #endif
 
 /* another structure passed up and down to avoid zillions of parameters */
@@ -93,6 +99,7 @@ struct match {
 	states tmp;		/* temporary */
 	states empty;		/* empty set of states */
 	mbstate_t mbs;		/* multibyte conversion state */
+	int utf8;		/* the charset is UTF-8 */
 };
 
 /* ========= begin header generated by ./mkh ========= */
@@ -107,6 +114,9 @@ static const char *backref(struct match *m, const char *start, const char *stop,
 static const char *fast(struct match *m, const char *start, const char *stop, sopno startst, sopno stopst);
 static const char *slow(struct match *m, const char *start, const char *stop, sopno startst, sopno stopst);
 static states step(struct re_guts *g, sopno start, sopno stop, states bef, wint_t ch, states aft);
+#ifndef NODFA
+static int dfafast(struct re_guts *g, int eflags, int small, int utf8, const char *beginp, const char *endp, const char *start, const char *stop, const char **coldpp, const char **matchpp);
+#endif
 #define MAX_RECURSION	100
 #define	BOL	(OUT-1)
 #define	EOL	(BOL-1)
@@ -165,6 +175,8 @@ matcher(struct re_guts *g,
 	const sopno gl = g->laststate;
 	const char *start;
 	const char *stop;
+	const char *cand = NULL;	/* the rarest literal */
+	const char *lp;
 	/* Boyer-Moore algorithms variables */
 	const char *pp;
 	int cj, mj;
@@ -185,6 +197,18 @@ matcher(struct re_guts *g,
 	}
 	if (stop < start)
 		return(REG_INVARG);
+	STATS(g->stats.calls++);
+
+	/* every match contains the literals, look for the rarest first */
+	for (i = 0; i < g->nlits; i++) {
+		lp = findlit(&g->lits[i], start, stop);
+		if (lp == NULL) {
+			STATS(g->stats.rejected++);
+			return(REG_NOMATCH);
+		}
+		if (i == 0)
+			cand = lp;
+	}
 
 	/* prescreening; this does wonders for this rather slow code */
 	if (g->must != NULL) {
@@ -245,6 +269,7 @@ matcher(struct re_guts *g,
 	SETUP(m->empty);
 	CLEAR(m->empty);
 	ZAPSTATE(&m->mbs);
+	m->utf8 = ISUTF8();
 
 	/* Adjust start according to moffset, to speed things up */
 #ifndef MNAMES
@@ -253,11 +278,34 @@ matcher(struct re_guts *g,
 	if (g->moffset > -1)
 		start = ((dp - g->moffset) < start) ? start : dp - g->moffset;
 #endif
+	/* no match spans lines, nor is one in a line without the literal */
+	if (g->oneline && cand != NULL && cand > start) {
+		lp = memrchr(start, '\n', cand - start);
+		if (lp != NULL) {
+			STATS(g->stats.windows++);
+			STATS(g->stats.skipped += lp + 1 - start);
+			start = lp + 1;
+		}
+	}
+	/* every match starts with the prefix, so skip to the first one */
+	if (g->prefix != NULL) {
+		start = memmem(start, stop - start, g->prefix, g->plen);
+		if (start == NULL) {
+			STATETEARDOWN(m);
+			return(REG_NOMATCH);
+		}
+	}
 	SP("mloop", m->st, *start);
 
 	/* this loop does only one repetition except for backrefs */
 	for (;;) {
+#ifdef NODFA
 		endp = fast(m, start, stop, gf, gl);
+#else
+		if ((dfamb && !m->utf8) || !dfafast(g, eflags, dfasmall,
+		    m->utf8, m->beginp, m->endp, start, stop, &m->coldp, &endp))
+			endp = fast(m, start, stop, gf, gl);
+#endif
 		if (endp == NULL) {		/* a miss */
 			if (m->pmatch != NULL)
 				free((char *)m->pmatch);
@@ -802,6 +850,8 @@ fast(	struct match *m,
 	coldp = NULL;
 	if (start == m->beginp)
 		c = OUT;
+	else if (m->utf8)
+		c = xprevwc(m->beginp, start, BADCHAR);
 	else {
 		/*
 		 * XXX Wrong if the previous character was multi-byte.
@@ -907,6 +957,8 @@ slow(	struct match *m,
 	matchp = NULL;
 	if (start == m->beginp)
 		c = OUT;
+	else if (m->utf8)
+		c = xprevwc(m->beginp, start, BADCHAR);
 	else {
 		/*
 		 * XXX Wrong if the previous character was multi-byte.
@@ -1103,6 +1155,562 @@ step(struct re_guts *g,
 	return(aft);
 }
 
+#if defined(LNAMES) && !defined(NODFA)
+/*
+ * The lazy DFA.  fast() computes the set of states after each character
+ * with step(), which walks the whole strip.  dfafast() computes the same
+ * sets, but it remembers each one, and which one follows it after each
+ * byte, so most characters only cost a table lookup.  The sets are built
+ * with lstep() no matter which matcher calls it, see dfaflags() for the
+ * one difference that makes.  The end of the string is stepped through
+ * by hand, it only happens once.
+ *
+ * In a UTF-8 locale mmatcher() uses it too, on bytes all the same.  A
+ * state can be partway through a character then, it keeps the bytes seen
+ * so far, and the character is stepped through once its last byte comes
+ * in, see dfafeed().  So mbrtowc() only runs while transitions are built,
+ * and bracket expressions and classes end up as byte transitions too.
+ *
+ * The tables are kept in g->dfa across regexec() calls, up to DFA_MAXMEM
+ * bytes.  When they're full they're flushed and built again; if that
+ * happens too often, the pattern is left to fast() for good.  So is a call
+ * which finds the tables in use by another thread.
+ */
+#define	DFA_MAXMEM	(1024*1024)	/* most memory per pattern */
+#define	DFA_MINSTATES	16		/* don't bother with fewer */
+#define	DFA_MINBYTES	10		/* bytes per state between flushes */
+#define	DFA_UNKNOWN	(-1)		/* transition not known yet */
+#define	DFA_MATCH	(-2)		/* a match ends before this byte */
+#define	DFA_FULL	(-3)		/* no room for another state */
+/* class of the previous character, as far as the strip cares */
+#define	DFA_BOL		0		/* ^ can match after it */
+#define	DFA_NONE	1		/* start of string with REG_NOTBOL */
+#define	DFA_WORD	2		/* word character */
+#define	DFA_OTHER	3		/* anything else */
+#define	DFA_CLASS	3
+#define	DFA_FRESH	4		/* the set is fresh, see fast() */
+#define	DFA_PARTLEN	8		/* count and bytes of a partial character */
+
+/*
+ - dfaclass - class of the character before the next one
+ == static int dfaclass(struct re_guts *g, int eflags, wint_t c);
+ *
+ * c is OUT at the start of the string.
+ */
+static int
+dfaclass(struct re_guts *g, int eflags, wint_t c)
+{
+	int bol;
+
+	if (c == OUT)
+		bol = !(eflags&REG_NOTBOL);
+	else
+		bol = (c == '\n' && (g->cflags&REG_NEWLINE));
+	if (bol && (g->nbol > 0 || g->dfa.words))
+		return(DFA_BOL);
+	if (!g->dfa.words)
+		return(DFA_OTHER);
+	if (c == OUT)
+		return(DFA_NONE);
+	return(ISWORD(c) ? DFA_WORD : DFA_OTHER);
+}
+
+/*
+ - dfaflags - step st through the ^, $, \< and \> between a character of
+ - class cls and c, like fast() does
+ == static void dfaflags(struct re_guts *g, int eflags, int cls, wint_t c, \
+ ==	char *st);
+ *
+ * sstep() works on a copy of the set, lstep() updates it as it goes, so
+ * that one step through $ can get past $$.  For smatcher() we step from
+ * a copy too, or slow() couldn't find the matches we find.
+ */
+static void
+dfaflags(struct re_guts *g, int eflags, int cls, wint_t c, char *st)
+{
+	const sopno gf = g->firststate+1;
+	const sopno gl = g->laststate;
+	char *bef = (g->dfa.small) ? g->dfa.work + 3 * g->nstates : st;
+	wint_t flagch = '\0';
+	int i = 0;
+
+	if (cls == DFA_BOL) {
+		flagch = BOL;
+		i = g->nbol;
+	}
+	if ( (c == '\n' && g->cflags&REG_NEWLINE) ||
+			(c == OUT && !(eflags&REG_NOTEOL)) ) {
+		flagch = (flagch == BOL) ? BOLEOL : EOL;
+		i += g->neol;
+	}
+	for (; i > 0; i--) {
+		if (bef != st)
+			memcpy(bef, st, g->nstates);
+		step(g, gf, gl, bef, flagch, st);
+	}
+
+	if (!g->dfa.words)
+		return;
+	if ( (flagch == BOL || cls == DFA_OTHER) &&
+				(c != OUT && ISWORD(c)) ) {
+		flagch = BOW;
+	}
+	if ( cls == DFA_WORD &&
+			(flagch == EOL || (c != OUT && !ISWORD(c))) ) {
+		flagch = EOW;
+	}
+	if (flagch == BOW || flagch == EOW) {
+		if (bef != st)
+			memcpy(bef, st, g->nstates);
+		step(g, gf, gl, bef, flagch, st);
+	}
+}
+
+/*
+ - dfachar - step st, after a character of class *clsp, through c like
+ - fast() does, and set *clsp to the class of c
+ == static int dfachar(struct re_guts *g, char *st, int *clsp, wint_t c);
+ *
+ * Returns 1 if a match ends before c, without stepping through c.
+ */
+static int
+dfachar(struct re_guts *g, char *st, int *clsp, wint_t c)
+{
+	char *tmp = g->dfa.work + g->nstates;
+
+	dfaflags(g, 0, *clsp, c, st);
+	if (st[g->laststate])
+		return(1);
+	memcpy(tmp, g->dfa.work + 2 * g->nstates, g->nstates);
+	step(g, g->firststate+1, g->laststate, st, c, tmp);
+	memcpy(st, tmp, g->nstates);
+	*clsp = dfaclass(g, 0, c);
+	return(0);
+}
+
+/*
+ - dfafeed - step st through the characters in the *np bytes at s
+ == static int dfafeed(struct re_guts *g, char *st, int *clsp, \
+ ==	const char *s, size_t *np, int end);
+ *
+ * They're decoded the way xmbrtowc() does in mmatcher(), so each byte
+ * which doesn't start a valid character is a BADCHAR.  A partial character
+ * at the end is left for later unless end is set; *np is set to where it
+ * starts.  Returns 1 if a match ends before one of the characters.
+ */
+static int
+dfafeed(struct re_guts *g, char *st, int *clsp, const char *s, size_t *np,
+    int end)
+{
+	size_t i, clen;
+	wint_t c;
+
+	for (i = 0; i < *np; i += clen) {
+		clen = xmbrtowc_part(&c, s + i, *np - i);
+		if (clen == (size_t)-2 && !end)
+			break;
+		if (clen == (size_t)-1 || clen == (size_t)-2) {
+			c = BADCHAR;
+			clen = 1;
+		}
+		if (dfachar(g, st, clsp, c))
+			return(1);
+	}
+	*np = i;
+	return(0);
+}
+
+/*
+ - dfahash - hash a state
+ == static unsigned dfahash(struct re_dfa *d, const unsigned char *set, \
+ ==	int cls, const unsigned char *part);
+ */
+static unsigned
+dfahash(struct re_dfa *d, const unsigned char *set, int cls,
+    const unsigned char *part)
+{
+	unsigned h = 2166136261U;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < d->setlen; i++)
+		h = (h ^ set[i]) * 16777619U;
+	for (i = 0; i <= part[0]; i++)
+		h = (h ^ part[i]) * 16777619U;
+	return((h ^ cls) * 16777619U);
+}
+
+/*
+ - dfagrow - make room for more states
+ == static int dfagrow(struct re_dfa *d);
+ */
+static int
+dfagrow(struct re_dfa *d)
+{
+	int n = (d->maxstate > 0) ? 2 * d->maxstate : DFA_MINSTATES;
+	int hashsize;
+	int *next, *hash;
+	unsigned char *sets, *flags, *part;
+	int s;
+	unsigned h;
+
+	if (n > d->limit)
+		n = d->limit;
+	if (n <= d->maxstate)
+		return(0);
+	for (hashsize = 1; hashsize < 2 * n; hashsize <<= 1)
+		continue;
+
+	/* each of these only gets bigger, so failing halfway is harmless */
+	next = realloc(d->next, n * NC * sizeof(int));
+	if (next == NULL)
+		return(0);
+	d->next = next;
+	sets = realloc(d->sets, (n + 1) * d->setlen);	/* +1 for dfastate() */
+	if (sets == NULL)
+		return(0);
+	d->sets = sets;
+	part = realloc(d->part, (n + 1) * DFA_PARTLEN);
+	if (part == NULL)
+		return(0);
+	d->part = part;
+	flags = realloc(d->flags, n);
+	if (flags == NULL)
+		return(0);
+	d->flags = flags;
+	hash = realloc(d->hash, hashsize * sizeof(int));
+	if (hash == NULL)
+		return(0);
+	d->hash = hash;
+
+	d->maxstate = n;
+	d->hashsize = hashsize;
+	memset(d->hash, 0xff, hashsize * sizeof(int));
+	for (s = 0; s < d->nstate; s++) {
+		h = dfahash(d, &d->sets[s * d->setlen], d->flags[s]&DFA_CLASS,
+		    &d->part[s * DFA_PARTLEN]);
+		while (d->hash[h & (hashsize - 1)] >= 0)
+			h++;
+		d->hash[h & (hashsize - 1)] = s;
+	}
+	return(1);
+}
+
+/*
+ - dfainit - set up g->dfa on first use
+ == static int dfainit(struct re_guts *g, int small, int utf8);
+ */
+static int
+dfainit(struct re_guts *g, int small, int utf8)
+{
+	struct re_dfa *d = &g->dfa;
+	const sopno gf = g->firststate+1;
+	const sopno gl = g->laststate;
+	char *fresh;
+	sopno i;
+
+	d->setlen = (g->nstates + CHAR_BIT - 1) / CHAR_BIT;
+	d->limit = DFA_MAXMEM /
+	    (NC * sizeof(int) + d->setlen + DFA_PARTLEN + 1 + 2 * sizeof(int));
+	if (d->limit < DFA_MINSTATES ||
+	    (d->work = malloc(4 * g->nstates)) == NULL || !dfagrow(d)) {
+		d->failed = 1;
+		return(0);
+	}
+	d->small = small;
+	d->utf8 = utf8;
+	for (i = 0; i < g->nstates; i++)
+		if (OP(g->strip[i]) == OBOW || OP(g->strip[i]) == OEOW)
+			d->words = 1;
+	for (i = 0; i < 4; i++)
+		d->start[i] = DFA_UNKNOWN;
+
+	/* the states for a fresh start, see fast() */
+	fresh = d->work + 2 * g->nstates;
+	memset(fresh, 0, g->nstates);
+	fresh[gf] = 1;
+	step(g, gf, gl, fresh, NOTHING, fresh);
+	return(1);
+}
+
+/*
+ - dfaflush - throw all states away
+ == static void dfaflush(struct re_dfa *d);
+ */
+static void
+dfaflush(struct re_dfa *d)
+{
+	int i;
+
+	d->nstate = 0;
+	d->nbytes = 0;
+	for (i = 0; i < 4; i++)
+		d->start[i] = DFA_UNKNOWN;
+	memset(d->hash, 0xff, d->hashsize * sizeof(int));
+}
+
+/*
+ - dfastate - find or add the state for a set, a class and a partial
+ - character
+ == static int dfastate(struct re_guts *g, const char *st, int cls, \
+ ==	const unsigned char *part);
+ *
+ * part is a count and that many bytes, or NULL for none.  Returns DFA_FULL
+ * if the state is new and there's no room for it.
+ */
+static int
+dfastate(struct re_guts *g, const char *st, int cls,
+    const unsigned char *part)
+{
+	struct re_dfa *d = &g->dfa;
+	unsigned char *set, *spare;
+	unsigned h;
+	sopno i;
+	int s;
+
+	for (;;) {
+		/* pack it into the spare set after the last one */
+		set = &d->sets[d->maxstate * d->setlen];
+		memset(set, 0, d->setlen);
+		for (i = 0; i < g->nstates; i++)
+			if (st[i])
+				set[i / CHAR_BIT] |= 1 << (i % CHAR_BIT);
+		spare = &d->part[d->maxstate * DFA_PARTLEN];
+		memset(spare, 0, DFA_PARTLEN);
+		if (part != NULL)
+			memcpy(spare, part, 1 + part[0]);
+		h = dfahash(d, set, cls, spare);
+		for (; (s = d->hash[h & (d->hashsize - 1)]) >= 0; h++)
+			if ((d->flags[s]&DFA_CLASS) == cls &&
+			    memcmp(&d->sets[s * d->setlen], set, d->setlen) == 0 &&
+			    memcmp(&d->part[s * DFA_PARTLEN], spare,
+			    DFA_PARTLEN) == 0)
+				return(s);
+		if (d->nstate < d->maxstate)
+			break;
+		if (!dfagrow(d))
+			return(DFA_FULL);
+	}
+
+	s = d->nstate++;
+	d->hash[h & (d->hashsize - 1)] = s;
+	memcpy(&d->sets[s * d->setlen], set, d->setlen);
+	memcpy(&d->part[s * DFA_PARTLEN], spare, DFA_PARTLEN);
+	d->flags[s] = cls;
+	if (spare[0] == 0 &&
+	    memcmp(st, d->work + 2 * g->nstates, g->nstates) == 0)
+		d->flags[s] |= DFA_FRESH;
+	for (i = 0; i < NC; i++)
+		d->next[s * NC + i] = DFA_UNKNOWN;
+	return(s);
+}
+
+/*
+ - dfaunpack - get the set of state s
+ == static char *dfaunpack(struct re_guts *g, int s);
+ */
+static char *
+dfaunpack(struct re_guts *g, int s)
+{
+	struct re_dfa *d = &g->dfa;
+	const unsigned char *set = &d->sets[s * d->setlen];
+	char *st = d->work;
+	sopno i;
+
+	for (i = 0; i < g->nstates; i++)
+		st[i] = (set[i / CHAR_BIT] >> (i % CHAR_BIT)) & 1;
+	return(st);
+}
+
+/*
+ - dfastart - the state for a fresh start after a character of class cls
+ == static int dfastart(struct re_guts *g, int cls);
+ */
+static int
+dfastart(struct re_guts *g, int cls)
+{
+	struct re_dfa *d = &g->dfa;
+
+	if (d->start[cls] < 0)
+		d->start[cls] = dfastate(g, d->work + 2 * g->nstates, cls, NULL);
+	return(d->start[cls]);
+}
+
+/*
+ - dfanext - compute the transition from state s on byte c
+ == static int dfanext(struct re_guts *g, int s, wint_t c);
+ */
+static int
+dfanext(struct re_guts *g, int s, wint_t c)
+{
+	struct re_dfa *d = &g->dfa;
+	char *st = dfaunpack(g, s);
+	int cls = d->flags[s]&DFA_CLASS;
+	unsigned char part[DFA_PARTLEN];
+	size_t len, n;
+	int t;
+
+	if (!d->utf8) {
+		if (dfachar(g, st, &cls, c))
+			t = DFA_MATCH;
+		else
+			t = dfastate(g, st, cls, NULL);
+	} else {
+		/* the partial character so far, and c */
+		memcpy(part, &d->part[s * DFA_PARTLEN], DFA_PARTLEN);
+		len = part[0];
+		part[1 + len++] = c;
+		n = len;
+		if (dfafeed(g, st, &cls, (char *)part + 1, &n, 0))
+			t = DFA_MATCH;
+		else if (len - n > DFA_PARTLEN - 2)
+			return(DFA_FULL);	/* not in UTF-8 */
+		else {
+			/* keep the start of the next one */
+			part[0] = len - n;
+			memmove(part + 1, part + 1 + n, len - n);
+			t = dfastate(g, st, cls, part);
+		}
+	}
+	if (t == DFA_FULL)
+		return(t);
+	d->next[s * NC + c] = t;
+	return(t);
+}
+
+/*
+ - dfafast - fast() with the DFA
+ == static int dfafast(struct re_guts *g, int eflags, int small, int utf8, \
+ ==	const char *beginp, const char *endp, const char *start, \
+ ==	const char *stop, const char **coldpp, const char **matchpp);
+ *
+ * small is set when called by smatcher(), see dfaflags(), and utf8 when
+ * called by mmatcher() in a UTF-8 locale.
+ * Returns 0 if the caller has to use fast() instead.  Otherwise it sets
+ * *coldpp and *matchpp to what fast() would set m->coldp to and return.
+ */
+static int
+dfafast(struct re_guts *g,
+	int eflags,
+	int small,
+	int utf8,
+	const char *beginp,
+	const char *endp,
+	const char *start,
+	const char *stop,
+	const char **coldpp,
+	const char **matchpp)
+{
+	struct re_dfa *d = &g->dfa;
+	const char *p = start;
+	const char *coldp = start;
+	const char *flushp = start;	/* where the bytes count from */
+	const char *q;
+	char *st;
+	unsigned char part[DFA_PARTLEN];
+	size_t n;
+	int s, t, cls;
+	int matched = 0;
+	wint_t c;
+
+	/* fast() stops short of a character which crosses stop, we don't */
+	if (d->failed || (utf8 && stop != endp) ||
+	    __sync_lock_test_and_set(&d->busy, 1))
+		return(0);
+	if ((d->work == NULL && !dfainit(g, small, utf8)) ||
+	    d->small != small || d->utf8 != utf8) {
+		__sync_lock_release(&d->busy);
+		return(0);
+	}
+
+	if (start == beginp)
+		c = OUT;
+	else if (utf8)
+		c = xprevwc(beginp, start, BADCHAR);
+	else
+		c = (uch)*(start - 1);
+	cls = dfaclass(g, eflags, c);
+	st = d->work + 2 * g->nstates;
+	part[0] = 0;
+	s = dfastart(g, cls);
+	for (;;) {
+		if (s == DFA_FULL) {
+			/* flush, unless it doesn't pay, and add st again */
+			d->nbytes += p - flushp;
+			flushp = p;
+			if (d->nbytes >= DFA_MINBYTES * d->nstate) {
+				dfaflush(d);
+				s = dfastate(g, st, cls, part);
+			}
+			if (s == DFA_FULL) {
+				d->failed = 1;
+				__sync_lock_release(&d->busy);
+				return(0);
+			}
+		}
+		if (d->flags[s]&DFA_FRESH) {
+			coldp = p;
+			/* a match has to start with the prefix, skip to it */
+			if (g->prefix != NULL) {
+				q = memmem(p, stop - p, g->prefix, g->plen);
+				if (q == NULL)
+					break;
+				if (q != p) {
+					p = coldp = q;
+					c = (utf8) ? xprevwc(beginp, q, BADCHAR) :
+					    (uch)*(q - 1);
+					cls = dfaclass(g, eflags, c);
+					st = d->work + 2 * g->nstates;
+					part[0] = 0;
+					s = dfastart(g, cls);
+					continue;
+				}
+			}
+		}
+		if (p == stop) {
+			/* the end, by hand, with what's left of a character */
+			st = dfaunpack(g, s);
+			cls = d->flags[s]&DFA_CLASS;
+			memcpy(part, &d->part[s * DFA_PARTLEN], DFA_PARTLEN);
+			n = part[0];
+			if (dfafeed(g, st, &cls, (char *)part + 1, &n, 1)) {
+				matched = 1;
+				break;
+			}
+			c = (p == endp) ? OUT : (uch)*p;
+			dfaflags(g, eflags, cls, c, st);
+			matched = st[g->laststate];
+			break;
+		}
+		c = (uch)*p;
+		t = d->next[s * NC + c];
+		if (t < 0) {
+			if (t == DFA_UNKNOWN)
+				t = dfanext(g, s, c);
+			if (t == DFA_MATCH) {
+				matched = 1;
+				break;
+			}
+			if (t == DFA_FULL) {
+				cls = d->flags[s]&DFA_CLASS;
+				st = dfaunpack(g, s);
+				memcpy(part, &d->part[s * DFA_PARTLEN],
+				    DFA_PARTLEN);
+				s = DFA_FULL;
+				continue;
+			}
+		}
+		s = t;
+		p++;
+	}
+
+	d->nbytes += p - flushp;
+	__sync_lock_release(&d->busy);
+	*coldpp = coldp;
+	*matchpp = matched ? p + 1 : NULL;
+	return(1);
+}
+#endif
+
 #ifdef REDEBUG
 /*
  - print - print a set of states
@@ -1195,3 +1803,5 @@ pchar(int ch)
 #undef	print
 #undef	at
 #undef	match
+#undef	dfasmall
+#undef	dfamb
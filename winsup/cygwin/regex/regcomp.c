@@ -87,18 +87,10 @@ extern "C" {
 #endif
 
 /* === regcomp.c === */
-#ifdef __CYGWIN__ /* Defined below `int stop'.  Our gcc chokes on that. */
 static void p_ere(struct parse *p, int stop);
-#else
-static void p_ere(struct parse *p, wint_t stop);
-#endif
 static void p_ere_exp(struct parse *p);
 static void p_str(struct parse *p);
-#ifdef __CYGWIN__ /* Defined below `int end1/end2'.  Our gcc chokes on that. */
 static void p_bre(struct parse *p, int end1, int end2);
-#else
-static void p_bre(struct parse *p, wint_t end1, wint_t end2);
-#endif
 static int p_simp_re(struct parse *p, int starordinary);
 static int p_count(struct parse *p);
 static void p_bracket(struct parse *p);
@@ -126,6 +118,14 @@ static void dofwd(struct parse *p, sopno pos, sop value);
 static void enlarge(struct parse *p, sopno size);
 static void stripsnug(struct parse *p, struct re_guts *g);
 static void findmust(struct parse *p, struct re_guts *g);
+#ifndef NOLITS
+static void findprefix(struct parse *p, struct re_guts *g);
+static int byterank(int c);
+static int cspair(cset *cs, int *a, int *b);
+static int litin(const char *lit, const char *alt, int len, struct re_lit *l);
+static void addlit(struct re_guts *g, const char *lit, const char *alt, int len);
+static void findlits(struct parse *p, struct re_guts *g);
+#endif
 static int altoffset(sop *scan, int offset);
 static void computejumps(struct parse *p, struct re_guts *g);
 static void computematchjumps(struct parse *p, struct re_guts *g);
@@ -252,6 +252,14 @@ regcomp(regex_t * __restrict preg,
 	g->charjump = NULL;
 	g->matchjump = NULL;
 	g->mlen = 0;
+	g->prefix = NULL;
+	g->plen = 0;
+	g->nlits = 0;
+	g->oneline = 0;
+#ifdef REGSTATS
+	memset(&g->stats, 0, sizeof(g->stats));
+#endif
+	memset(&g->dfa, 0, sizeof(g->dfa));
 	g->nsub = 0;
 	g->backrefs = 0;
 
@@ -270,6 +278,10 @@ regcomp(regex_t * __restrict preg,
 	/* tidy up loose ends and fill things in */
 	stripsnug(p, g);
 	findmust(p, g);
+#ifndef NOLITS
+	findprefix(p, g);
+	findlits(p, g);
+#endif
 	/* only use Boyer-Moore algorithm if the pattern is bigger
 	 * than three characters
 	 */
@@ -1649,6 +1661,308 @@ findmust(struct parse *p, struct re_guts *g)
 	*cp++ = '\0';		/* just on general principles */
 }
 
+#ifndef NOLITS
+/*
+ - findprefix - fill in prefix and plen with the literal string every match
+ - starts with
+ == static void findprefix(struct parse *p, struct re_guts *g);
+ *
+ * regexec() skips to the places where it occurs with memmem().  Parens
+ * and anchors don't match anything, and the body of a + loop is matched
+ * at least once, so we look through those.
+ */
+static void
+findprefix(struct parse *p, struct re_guts *g)
+{
+	sop *scan;
+	sop s;
+	char buf[256];
+	size_t clen;
+	mbstate_t mbs;
+	int len = 0;
+
+	if (p->error != 0)
+		return;
+
+	/* see findmust() */
+	if (MB_CUR_MAX > 1 &&
+#ifdef __CYGWIN__
+	    strcmp(__current_locale_charset (), "UTF-8") != 0)
+#else
+	    strcmp(_CurrentRuneLocale->__encoding, "UTF-8") != 0)
+#endif
+		return;
+
+	memset(&mbs, 0, sizeof(mbs));
+	for (scan = g->strip + 1; ; scan++) {
+		s = *scan;
+		if (OP(s) == OCHAR) {
+			if (len + MB_LEN_MAX > sizeof(buf))
+				break;
+			clen = xwcrtomb(buf + len, OPND(s), &mbs);
+			if (clen == (size_t)-1)
+				break;
+			len += clen;
+		} else if (OP(s) != OLPAREN && OP(s) != ORPAREN &&
+		    OP(s) != OPLUS_ && OP(s) != OBOL && OP(s) != OEOL &&
+		    OP(s) != OBOW && OP(s) != OEOW)
+			break;
+	}
+	if (len == 0)
+		return;
+
+	g->prefix = malloc(len + 1);
+	if (g->prefix == NULL)		/* just forget it */
+		return;
+	memcpy(g->prefix, buf, len);
+	g->prefix[len] = '\0';
+	g->plen = len;
+}
+
+/*
+ - byterank - a rough guess how common byte c is in text, 0 to 255
+ == static int byterank(int c);
+ */
+static int
+byterank(int c)
+{
+	static const char lower[] = "etaoinsrhldcumfpgwybvkxjqz";
+	static const char upper[] = "ETAOINSRHLDCUMFPGWYBVKXJQZ";
+	static const char punct[] = "\n.,-_:/=\"'()\t";
+	const char *cp;
+
+	if (c == ' ')
+		return(255);
+	if (c == '\0')
+		return(0);
+	if ((cp = strchr(lower, c)) != NULL)
+		return(250 - 6 * (cp - lower));
+	if (c >= '0' && c <= '9')
+		return(200 - 4 * (c - '0'));
+	if ((cp = strchr(punct, c)) != NULL)
+		return(180 - 5 * (cp - punct));
+	if ((cp = strchr(upper, c)) != NULL)
+		return(150 - 3 * (cp - upper));
+	if (c < ' ')
+		return(10);
+	if (c >= 0x80)
+		return(40);
+	return(60);
+}
+
+/*
+ - cspair - is a set just one or two bytes, like [eE]?
+ == static int cspair(cset *cs, int *a, int *b);
+ *
+ * In UTF-8 only ASCII will do, and with REG_ICASE not i, k and s, which
+ * some other characters turn into when their case changes, see CHIN().
+ */
+static int
+cspair(cset *cs, int *a, int *b)
+{
+	int max = (MB_CUR_MAX > 1) ? 0x80 : NC;
+	int n = 0;
+	int i;
+
+	*a = *b = -1;
+	if (cs->invert || cs->ntypes != 0 || cs->nwides != 0 ||
+	    cs->nranges != 0)
+		return(0);
+	for (i = 0; i < NC; i++) {
+		if (!(cs->bmp[i >> 3] & (1 << (i & 7))))
+			continue;
+		if (i >= max || n == 2)
+			return(0);
+		if (MB_CUR_MAX > 1 && cs->icase && strchr("iksIKS", i) != NULL)
+			return(0);
+		if (n++ == 0)
+			*a = *b = i;
+		else
+			*b = i;
+	}
+	return(n > 0);
+}
+
+/*
+ - litin - does l contain the literal lit, alt?
+ == static int litin(const char *lit, const char *alt, int len, \
+ ==	struct re_lit *l);
+ */
+static int
+litin(const char *lit, const char *alt, int len, struct re_lit *l)
+{
+	int i, j;
+
+	for (i = 0; i + len <= l->len; i++) {
+		for (j = 0; j < len; j++)
+			if (lit[j] != l->lit[i + j] || alt[j] != l->alt[i + j])
+				break;
+		if (j == len)
+			return(1);
+	}
+	return(0);
+}
+
+/*
+ - addlit - add a literal to g->lits, if it's one of the rarest
+ == static void addlit(struct re_guts *g, const char *lit, const char *alt, \
+ ==	int len);
+ */
+static void
+addlit(struct re_guts *g, const char *lit, const char *alt, int len)
+{
+	struct re_lit l;
+	int i, sc, sc2;
+
+	if (len == 0)
+		return;
+	/* nothing new, like the copy of a group a backreference makes */
+	for (i = 0; i < g->nlits; i++)
+		if (litin(lit, alt, len, &g->lits[i]))
+			return;
+	l.len = len;
+	l.rare = 0;
+	l.score = INT_MAX;
+	l.icase = 0;
+	for (i = 0; i < len; i++) {
+		sc = byterank((unsigned char)lit[i]);
+		if (alt[i] != lit[i]) {
+			/* two memchr()s to do */
+			sc2 = byterank((unsigned char)alt[i]);
+			sc = ((sc > sc2) ? sc : sc2) + 16;
+			l.icase = 1;
+		}
+		if (sc < l.score) {
+			l.score = sc;
+			l.rare = i;
+		}
+	}
+
+	/* rarest first, and the longer one of two */
+	for (i = g->nlits; i > 0; i--)
+		if (g->lits[i - 1].score < l.score ||
+		    (g->lits[i - 1].score == l.score &&
+		     g->lits[i - 1].len >= l.len))
+			break;
+	if (i == RE_NLITS)
+		return;
+	l.lit = malloc(2 * len);
+	if (l.lit == NULL)		/* just forget it */
+		return;
+	l.alt = l.lit + len;
+	memcpy(l.lit, lit, len);
+	memcpy(l.alt, alt, len);
+	if (g->nlits == RE_NLITS)
+		free(g->lits[--g->nlits].lit);
+	memmove(&g->lits[i + 1], &g->lits[i], (g->nlits - i) * sizeof(l));
+	g->lits[i] = l;
+	g->nlits++;
+}
+
+/*
+ - findlits - fill in lits with the literals every match contains
+ == static void findlits(struct parse *p, struct re_guts *g);
+ *
+ * Like findmust(), but a position may be a set of two bytes, so REG_ICASE
+ * patterns have literals too, and we keep the rarest ones rather than the
+ * longest.  regexec() makes sure they're all there before it runs the
+ * matcher.  Also find out whether a match can contain a newline.
+ */
+static void
+findlits(struct parse *p, struct re_guts *g)
+{
+	sop *scan;
+	sop s;
+	char lit[RE_MAXLIT];
+	char alt[RE_MAXLIT];
+	char buf[MB_LEN_MAX];
+	size_t clen;
+	mbstate_t mbs;
+	int len = 0;
+	int a, b;
+
+	if (p->error != 0)
+		return;
+
+	/* with REG_NEWLINE, . and [^...] don't match \n, see p_bracket() */
+	if (g->cflags&REG_NEWLINE) {
+		g->oneline = 1;
+		for (scan = g->strip + 1; OP(*scan) != OEND; scan++)
+			if ((OP(*scan) == OCHAR && OPND(*scan) == '\n') ||
+			    (OP(*scan) == OANYOF &&
+			     CHIN(&g->sets[OPND(*scan)], '\n')) ||
+			    OP(*scan) == OANY)
+				g->oneline = 0;
+	}
+
+	/* see findmust() */
+	if (MB_CUR_MAX > 1 &&
+#ifdef __CYGWIN__
+	    strcmp(__current_locale_charset (), "UTF-8") != 0)
+#else
+	    strcmp(_CurrentRuneLocale->__encoding, "UTF-8") != 0)
+#endif
+		return;
+
+	memset(&mbs, 0, sizeof(mbs));
+	scan = g->strip + 1;
+	do {
+		s = *scan++;
+		switch (OP(s)) {
+		case OCHAR:		/* sequence member */
+			clen = xwcrtomb(buf, OPND(s), &mbs);
+			if (clen == (size_t)-1) {
+				addlit(g, lit, alt, len);
+				len = 0;
+				break;
+			}
+			if (len + clen > RE_MAXLIT) {
+				addlit(g, lit, alt, len);
+				len = 0;
+			}
+			memcpy(lit + len, buf, clen);
+			memcpy(alt + len, buf, clen);
+			len += clen;
+			break;
+		case OANYOF:		/* a member if it's like [eE] */
+			if (!cspair(&g->sets[OPND(s)], &a, &b)) {
+				addlit(g, lit, alt, len);
+				len = 0;
+				break;
+			}
+			if (len == RE_MAXLIT) {
+				addlit(g, lit, alt, len);
+				len = 0;
+			}
+			lit[len] = a;
+			alt[len] = b;
+			len++;
+			break;
+		case OPLUS_:		/* things that don't break one */
+		case OLPAREN:
+		case ORPAREN:
+			break;
+		case OQUEST_:		/* things that must be skipped */
+		case OCH_:
+			scan--;
+			do {
+				scan += OPND(s);
+				s = *scan;
+				/* findmust() has flagged this */
+				if (OP(s) != O_QUEST && OP(s) != O_CH &&
+							OP(s) != OOR2)
+					return;
+			} while (OP(s) != O_QUEST && OP(s) != O_CH);
+			/* FALLTHROUGH */
+		default:		/* things that break one */
+			addlit(g, lit, alt, len);
+			len = 0;
+			break;
+		}
+	} while (OP(s) != OEND);
+}
+#endif
+
 /*
  - altoffset - choose biggest offset among multiple choices
  == static int altoffset(sop *scan, int offset);
@@ -162,6 +162,61 @@ CHIN(cset *cs, wint_t ch)
 		return (CHIN1(cs, ch));
 }
 
+/*
+ * A string of bytes every match contains, see findlits() in regcomp.c.
+ * Each position is one of two bytes, lit[i] or alt[i], which are the same
+ * unless the position came from something like [eE] or REG_ICASE.
+ */
+struct re_lit {
+	char *lit;		/* malloced, alt follows */
+	char *alt;
+	int len;
+	int rare;		/* position of the rarest byte */
+	int score;		/* how common that byte is, lower is rarer */
+	int icase;		/* alt differs from lit somewhere */
+};
+#define	RE_NLITS	4	/* most literals we keep */
+#define	RE_MAXLIT	64	/* longest literal we keep */
+
+#ifdef REGSTATS
+/* what the literals did, see regstats() in regexec.c */
+struct re_stats {
+	unsigned long calls;	/* regexec() calls */
+	unsigned long rejected;	/* a literal wasn't there */
+	unsigned long windows;	/* started on the line of the rarest one */
+	unsigned long long skipped;	/* bytes skipped that way */
+};
+#endif
+
+/*
+ * Lazily built DFA used in place of fast() by the single-byte matchers,
+ * and by the multibyte one in UTF-8, see dfafast() in engine.c.  A state is the set of strip states reached
+ * after a character, plus the class of that character, which decides
+ * which of ^, $, \< and \> can match before the next one.  In a UTF-8
+ * locale it's also the bytes read so far of a character which isn't
+ * complete yet.
+ */
+struct re_dfa {
+	int busy;		/* in use by a regexec() call */
+	int failed;		/* too many states; stick to fast() */
+	int words;		/* strip contains OBOW or OEOW */
+	int small;		/* built for smatcher(), see dfaflags() */
+	int utf8;		/* built for mmatcher() in UTF-8 */
+	int nstate;		/* number of states in use */
+	int maxstate;		/* number of states allocated */
+	int limit;		/* most states we allocate */
+	size_t setlen;		/* bytes per state set */
+	size_t nbytes;		/* input scanned since the last flush */
+	int start[4];		/* initial state per class */
+	int *next;		/* [maxstate][NC] transitions */
+	unsigned char *sets;	/* [maxstate][setlen] state sets as bits */
+	unsigned char *part;	/* [maxstate][DFA_PARTLEN] partial characters */
+	unsigned char *flags;	/* [maxstate] class and DFA_FRESH */
+	int *hash;		/* [hashsize] indexes into sets, or -1 */
+	int hashsize;		/* a power of 2, at least 2*maxstate */
+	char *work;		/* [4][nstates] for step() */
+};
+
 /*
  * main compiled-expression structure
  */
@@ -186,6 +241,15 @@ struct re_guts {
 	int *charjump;		/* Boyer-Moore char jump table */
 	int *matchjump;		/* Boyer-Moore match jump table */
 	int mlen;		/* length of must */
+	char *prefix;		/* every match starts with this string */
+	int plen;		/* length of prefix */
+	struct re_lit lits[RE_NLITS];	/* every match contains these */
+	int nlits;		/* number of lits, rarest first */
+	int oneline;		/* REG_NEWLINE, and no match can contain \n */
+#ifdef REGSTATS
+	struct re_stats stats;
+#endif
+	struct re_dfa dfa;	/* built by regexec() on first use */
 	size_t nsub;		/* copy of re_nsub */
 	int backrefs;		/* does it use back references? */
 	sopno nplus;		/* how deep does it nest +s? */
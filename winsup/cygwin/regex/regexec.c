@@ -48,6 +48,7 @@ __FBSDID("$FreeBSD: src/lib/libc/regex/regexec.c,v 1.8 2007/06/11 03:05:54 delph
  */
 #ifdef __CYGWIN__
 #include "winsup.h"
+#include "../locale/setlocale.h"
 #endif
 #include <sys/types.h>
 #include <stdio.h>
@@ -56,6 +57,9 @@ __FBSDID("$FreeBSD: src/lib/libc/regex/regexec.c,v 1.8 2007/06/11 03:05:54 delph
 #include <limits.h>
 #include <ctype.h>
 #include <regex.h>
+#ifndef __CYGWIN__
+#include <runetype.h>
+#endif
 #include <wchar.h>
 #include <wctype.h>
 
@@ -113,6 +117,128 @@ xmbrtowc_dummy(wint_t *wi,
 	return (1);
 }
 
+/*
+ - xmbrtowc_part - xmbrtowc() for bytes which may end partway through a
+ - character
+ *
+ * Returns (size_t)-2 if they're the start of a valid character, and
+ * (size_t)-1 where xmbrtowc() returns 1 for a bad one.
+ */
+static size_t
+xmbrtowc_part(wint_t *wi, const char *s, size_t n)
+{
+	mbstate_t mbs;
+	size_t nr, n2;
+	wchar_t wc;
+
+	memset(&mbs, 0, sizeof(mbs));
+	nr = mbrtowc(&wc, s, n, &mbs);
+	if (nr == (size_t)-1 || nr == (size_t)-2)
+		return (nr);
+	if (nr == 0)
+		nr = 1;
+	*wi = wc;
+	if (sizeof (wchar_t) == 2 && wc >= 0xd800 && wc <= 0xdbff) {
+		/* see xmbrtowc() */
+		n2 = mbrtowc(&wc, s + nr, n - nr, &mbs);
+		if (n2 == (size_t)-2)
+			return (n2);
+		if (n2 == 0 || n2 == (size_t)-1)
+			return ((size_t)-1);
+		*wi = (((*wi & 0x3ff) << 10) | (wc & 0x3ff)) + 0x10000;
+		nr += n2;
+	}
+	return (nr);
+}
+
+/*
+ - xprevwc - the UTF-8 character which ends at p, after beginp
+ *
+ * That's the character p - 1 is the last byte of if there is one, and
+ * dummy if p - 1 is a byte xmbrtowc() skips as a bad one.
+ */
+static wint_t
+xprevwc(const char *beginp, const char *p, wint_t dummy)
+{
+	const char *q = p - 1;
+	wint_t wc = dummy;
+
+	while (q > beginp && p - q < MB_LEN_MAX && ((uch)*q & 0xc0) == 0x80)
+		q--;
+	if (xmbrtowc_part(&wc, q, p - q) != p - q)
+		wc = dummy;
+	return (wc);
+}
+
+/*
+ - isutf8 - is the charset of the current locale UTF-8?
+ */
+static int
+isutf8(void)
+{
+#ifdef __CYGWIN__
+	return (strcmp(__current_locale_charset (), "UTF-8") == 0);
+#else
+	return (strcmp(_CurrentRuneLocale->__encoding, "UTF-8") == 0);
+#endif
+}
+
+#ifdef REGSTATS
+#define	STATS(s)	((void)(s))
+#else
+#define	STATS(s)	((void)0)
+#endif
+
+/*
+ - litmatch - does s start with the literal l?
+ */
+static __inline int
+litmatch(const struct re_lit *l, const char *s)
+{
+	int i;
+
+	for (i = 0; i < l->len; i++)
+		if (s[i] != l->lit[i] && s[i] != l->alt[i])
+			return (0);
+	return (1);
+}
+
+/*
+ - findlit - find the first place in [start, stop) where l occurs
+ *
+ * memmem() unless l has positions with two choices, then memchr() for
+ * both choices of the rarest position, and check the rest at each hit.
+ */
+static const char *
+findlit(const struct re_lit *l, const char *start, const char *stop)
+{
+	const char *p, *q, *r;
+	int a, b;
+
+	if (stop - start < l->len)
+		return (NULL);
+	if (!l->icase)
+		return (memmem(start, stop - start, l->lit, l->len));
+
+	/* the rarest position can't be further than this */
+	stop -= l->len - 1 - l->rare;
+	start += l->rare;
+	a = (unsigned char)l->lit[l->rare];
+	b = (unsigned char)l->alt[l->rare];
+	p = memchr(start, a, stop - start);
+	q = (b != a) ? memchr(start, b, stop - start) : NULL;
+	while (p != NULL || q != NULL) {
+		r = (q == NULL || (p != NULL && p < q)) ? p : q;
+		if (litmatch(l, r - l->rare))
+			return (r - l->rare);
+		if (r == p)
+			p = memchr(p + 1, a, stop - p - 1);
+		else
+			q = memchr(q + 1, b, stop - q - 1);
+	}
+	return (NULL);
+}
+
 /* macros for manipulating states, small version */
 #define	states	long
 #define	states1	states		/* for later use in regexec() decision */
@@ -138,6 +264,7 @@ xmbrtowc_dummy(wint_t *wi,
 /* no multibyte support */
 #define	XMBRTOWC	xmbrtowc_dummy
 #define	ZAPSTATE(mbs)	((void)(mbs))
+#define	ISUTF8()	0
 /* function names */
 #define SNAMES			/* engine.c looks after details */
 
@@ -165,6 +292,7 @@ xmbrtowc_dummy(wint_t *wi,
 #undef	SNAMES
 #undef	XMBRTOWC
 #undef	ZAPSTATE
+#undef	ISUTF8
 
 /* macros for manipulating states, large version */
 #define	states	char *
@@ -192,6 +320,7 @@ xmbrtowc_dummy(wint_t *wi,
 /* no multibyte support */
 #define	XMBRTOWC	xmbrtowc_dummy
 #define	ZAPSTATE(mbs)	((void)(mbs))
+#define	ISUTF8()	0
 /* function names */
 #define	LNAMES			/* flag */
 
@@ -201,8 +330,10 @@ xmbrtowc_dummy(wint_t *wi,
 #undef	LNAMES
 #undef	XMBRTOWC
 #undef	ZAPSTATE
+#undef	ISUTF8
 #define	XMBRTOWC	xmbrtowc
 #define	ZAPSTATE(mbs)	memset((mbs), 0, sizeof(*(mbs)))
+#define	ISUTF8()	isutf8()
 #define	MNAMES
 
 #include "engine.c"
@@ -250,3 +381,36 @@ regexec(const regex_t * __restrict preg,
 	else
 		return(lmatcher(g, (char *)string, nmatch, pmatch, eflags));
 }
+
+#ifdef REGSTATS
+/*
+ - regstats - print the literals of preg and what they did, for tuning
+ == #ifdef REGSTATS
+ == extern void regstats(const regex_t *, FILE *);
+ == #endif
+ *
+ * The counters aren't updated atomically, so they can be off if preg is
+ * used by several threads at once.
+ */
+void
+regstats(const regex_t *preg, FILE *f)
+{
+	struct re_guts *g = preg->re_g;
+	struct re_lit *l;
+	int i, j;
+
+	for (i = 0; i < g->nlits; i++) {
+		l = &g->lits[i];
+		fprintf(f, "%s\"", (i == 0) ? "" : " ");
+		for (j = 0; j < l->len; j++)
+			if (l->alt[j] != l->lit[j])
+				fprintf(f, "[%c%c]", l->lit[j], l->alt[j]);
+			else
+				fprintf(f, "%c", l->lit[j]);
+		fprintf(f, "\"");
+	}
+	fprintf(f, "%s: %lu calls, %lu rejected, %lu windows, %llu bytes "
+	    "skipped\n", (g->oneline) ? " oneline" : "", g->stats.calls,
+	    g->stats.rejected, g->stats.windows, g->stats.skipped);
+}
+#endif
@@ -85,5 +85,15 @@ regfree(regex_t *preg)
 		free(&g->charjump[CHAR_MIN]);
 	if (g->matchjump != NULL)
 		free(g->matchjump);
+	if (g->prefix != NULL)
+		free(g->prefix);
+	for (i = 0; i < g->nlits; i++)
+		free(g->lits[i].lit);
+	free(g->dfa.next);
+	free(g->dfa.sets);
+	free(g->dfa.part);
+	free(g->dfa.flags);
+	free(g->dfa.hash);
+	free(g->dfa.work);
 	free((char *)g);
 }
@@ -871,6 +871,7 @@ cygheap_exec_info::alloc ()
 					 sizeof (cygheap_exec_info)
 					 + (nprocs * sizeof (children[0])));
   res->sigmask = _my_tls.sigmask;
+  res->ctty_fd = -1;
   return res;
 }
 
@@ -919,6 +920,8 @@ child_info_spawn::cleanup ()
 	    cfree (*e);
 	  cfree (moreinfo->envp);
 	}
+      if (moreinfo->fdmoves)
+	cfree (moreinfo->fdmoves);
       if (type != _CH_SPAWN && moreinfo->myself_pinfo)
 	CloseHandle (moreinfo->myself_pinfo);
       cfree (moreinfo);
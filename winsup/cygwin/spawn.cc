@@ -10,6 +10,7 @@ details. */
 #include <stdlib.h>
 #include <unistd.h>
 #include <process.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <wchar.h>
 #include <ctype.h>
@@ -252,10 +253,17 @@ struct system_call_handle
 
 child_info_spawn NO_COPY ch_spawn;
 
+/* posix_spawn holds this exclusively while its temporary fds are open, any
+   other spawn holds it shared until its child has inherited our handles.
+   So other spawns run in parallel, but none of them gets posix_spawn's
+   temporary fds.  Fork is kept out by lock_process. */
+static NO_COPY SRWLOCK spawn_tmpfd_lock;
+
 int
 child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 			  const char *const envp[], int mode,
-			  int in__stdin, int in__stdout)
+			  int in__stdin, int in__stdout,
+			  const spawn_actions *actions)
 {
   bool rc;
   int res = -1;
@@ -280,15 +288,7 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
   /* Environment variable MSYS2_ARG_CONV_EXCL contains a list
      of ';' separated argument prefixes to pass un-modified.
      A value of * means don't convert any arguments. */
-  char* msys2_arg_conv_excl_env = getenv("MSYS2_ARG_CONV_EXCL");
-  char* msys2_arg_conv_excl = NULL;
-  size_t msys2_arg_conv_excl_count = 0;
-  if (msys2_arg_conv_excl_env)
-    {
-      msys2_arg_conv_excl = (char*)alloca (strlen(msys2_arg_conv_excl_env)+1);
-      strcpy (msys2_arg_conv_excl, msys2_arg_conv_excl_env);
-      msys2_arg_conv_excl_count = string_split_delimited (msys2_arg_conv_excl, ';');
-    }
+  arg_heuristic_batch arg_conv (getenv ("MSYS2_ARG_CONV_EXCL"));
 
   /* Check if we have been called from exec{lv}p or spawn{lv}p and mask
      mode to keep only the spawn mode. */
@@ -331,6 +331,7 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
   bool null_app_name = false;
   STARTUPINFOW si = {};
   int looped = 0;
+  bool tmpfd_locked = false;
 
   system_call_handle system_call (mode == _P_SYSTEM);
 
@@ -343,6 +344,21 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 	chtype = _CH_SPAWN;
 
       moreinfo = cygheap_exec_info::alloc ();
+      if (actions)
+	{
+	  if (actions->flags & POSIX_SPAWN_SETSIGMASK)
+	    moreinfo->sigmask = actions->sigmask;
+	  if (actions->flags & POSIX_SPAWN_SETSIGDEF)
+	    moreinfo->sigdefault = actions->sigdefault;
+	  if (actions->nfdmoves)
+	    {
+	      size_t size = 2 * actions->nfdmoves * sizeof (int);
+	      moreinfo->fdmoves = (int *) cmalloc_abort (HEAP_1_EXEC, size);
+	      memcpy (moreinfo->fdmoves, actions->fdmoves, size);
+	      moreinfo->nfdmoves = actions->nfdmoves;
+	    }
+	  moreinfo->ctty_fd = actions->ctty_fd;
+	}
 
       /* CreateProcess takes one long string that is the command line (sigh).
 	 We need to quote any argument that has whitespace or embedded "'s.  */
@@ -404,13 +420,10 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 	      for (int i = 0; i < newargv.argc; i++)
 	        {
 	          //convert argv to win32
-	          int newargvlen = strlen (newargv[i]);
-	          char *tmpbuf = (char *)malloc (newargvlen + 1);
-	          memcpy (tmpbuf, newargv[i], newargvlen + 1);
-	          tmpbuf = arg_heuristic_with_exclusions(tmpbuf, msys2_arg_conv_excl, msys2_arg_conv_excl_count);
+	          const char *arg = arg_conv.convert (newargv[i]);
 	          debug_printf("newargv[%d] = %s", i, newargv[i]);
-	          newargv.replace (i, tmpbuf);
-	          free (tmpbuf);
+	          if (arg != newargv[i])
+	            newargv.replace (i, arg);
 	        }
 	      if ((wincmdln || !real_path.iscygexec ())
 	            && !cmd.fromargv (newargv, real_path.get_win32 (),
@@ -578,6 +591,14 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 	 they ignore it explicitely.  CREATE_NEW_PROCESS_GROUP does that for us. */
       if (!iscygwin () && ctty_pgid && ctty_pgid != myself->pgid)
 	c_flags |= CREATE_NEW_PROCESS_GROUP;
+
+      /* Don't let the child inherit the temporary fds of a posix_spawn
+	 in another thread.  posix_spawn itself already holds the lock. */
+      if (!actions)
+	{
+	  AcquireSRWLockShared (&spawn_tmpfd_lock);
+	  tmpfd_locked = true;
+	}
       refresh_cygheap ();
 
       if (mode == _P_DETACH)
@@ -652,10 +673,22 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 	}
 
       /* Set up needed handles for stdio */
+      int stdfd[3] = { in__stdin < 0 ? 0 : in__stdin,
+		       in__stdout < 0 ? 1 : in__stdout, 2 };
+      for (int i = 0; actions && i < actions->nfdmoves; i++)
+	{
+	  int from = actions->fdmoves[2 * i];
+	  int to = actions->fdmoves[2 * i + 1];
+
+	  if (to < 0 && from <= 2)
+	    stdfd[from] = -1;
+	  else if (to >= 0 && to <= 2)
+	    stdfd[to] = from;
+	}
       si.dwFlags = STARTF_USESTDHANDLES;
-      si.hStdInput = handle ((in__stdin < 0 ? 0 : in__stdin), false);
-      si.hStdOutput = handle ((in__stdout < 0 ? 1 : in__stdout), true);
-      si.hStdError = handle (2, true);
+      si.hStdInput = handle (stdfd[0], false);
+      si.hStdOutput = handle (stdfd[1], true);
+      si.hStdError = handle (stdfd[2], true);
 
       si.cb = sizeof (si);
 
@@ -879,6 +912,8 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 	      res = -1;
 	      __leave;
 	    }
+	  if (actions && (actions->flags & POSIX_SPAWN_SETPGROUP))
+	    child->pgid = actions->pgroup ?: cygpid;
 	}
 
       /* Start the child running */
@@ -906,6 +941,12 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
 	   wait for it to exit in maybe_set_exit_code_from_windows(). */
 	synced = iscygwin () ? sync (pi.dwProcessId, pi.hProcess, INFINITE) : true;
 
+      if (tmpfd_locked && mode != _P_OVERLAY)
+	{
+	  ReleaseSRWLockShared (&spawn_tmpfd_lock);
+	  tmpfd_locked = false;
+	}
+
       switch (mode)
 	{
 	case _P_OVERLAY:
@@ -956,6 +997,8 @@ child_info_spawn::worker (const char *prog_arg, const char *const *argv,
       res = -1;
     }
   __endtry
+  if (tmpfd_locked)
+    ReleaseSRWLockShared (&spawn_tmpfd_lock);
   this->cleanup ();
   if (envblock)
     free (envblock);
@@ -1143,6 +1186,143 @@ spawnvpe (int mode, const char *file, const char * const *argv,
 		  argv, envp);
 }
 
+/* posix_spawn and posix_spawnp without forking, called by
+   newlib/libc/posix/posix_spawn.c.  The file actions come as pairs of
+   fds, { from, to } for dup2 (from, to) and { fd, -1 } for close (fd).
+   The caller has already opened the files of the open actions,
+   close-on-exec and above the other fds the actions use.  CTTYFD is the
+   first of them which is a tty and was opened without O_NOCTTY, or -1.
+   The child makes it its controlling tty, see handle_spawn.
+
+   We work out which fds the child ends up with, dup each of them to a
+   temporary fd above all fds the actions use, and let the child move them
+   into place in child_info_spawn::handle_spawn, just as popen does with
+   stdin and stdout.  So everything which can fail, fails here.  Until the
+   temporary fds are closed again, we hold spawn_tmpfd_lock and, like popen,
+   lock_process, so no other thread's spawn or fork can inherit them.
+
+   Returns 0 or an errno value, ENOSYS if the caller has to fall back to
+   vfork for the requested attributes. */
+extern "C" int
+__posix_spawn_native (pid_t *pid, const char *path, int use_env_path,
+		      const int *fdactions, int nfdactions, int cttyfd,
+		      short flags, pid_t pgroup, const sigset_t *sigmask,
+		      const sigset_t *sigdefault, char *const argv[],
+		      char *const envp[])
+{
+  spawn_actions actions = {};
+  int maxfd = -1, nmoves = 0, fd, ret, i;
+
+  if ((flags & (POSIX_SPAWN_SETSCHEDPARAM | POSIX_SPAWN_SETSCHEDULER))
+      || ((flags & POSIX_SPAWN_RESETIDS)
+	  && (geteuid () != getuid () || getegid () != getgid ())))
+    return ENOSYS;
+  if ((flags & POSIX_SPAWN_SETPGROUP) && pgroup < 0)
+    return EINVAL;
+  for (i = 0; i < 2 * nfdactions; i++)
+    if (fdactions[i] >= OPEN_MAX_MAX)
+      return EBADF;
+    else if (fdactions[i] > maxfd)
+      maxfd = fdactions[i];
+
+  /* src[fd] is the parent's fd the child's fd is a copy of, or -1. */
+  tmp_pathbuf tp;
+  int *src = (int *) tp.c_get ();
+  bool *changed = (bool *) (src + maxfd + 1);
+  int *fdmoves = (int *) tp.c_get ();
+
+  for (fd = 0; fd <= maxfd; fd++)
+    {
+      src[fd] = cygheap->fdtab.not_open (fd) ? -1 : fd;
+      changed[fd] = false;
+    }
+  for (i = 0; i < nfdactions; i++)
+    {
+      int from = fdactions[2 * i];
+      int to = fdactions[2 * i + 1];
+
+      if (to >= 0 && src[from] < 0)
+	return EBADF;
+      /* dup2 (fd, fd) clears close-on-exec as well. */
+      src[to < 0 ? from : to] = to < 0 ? -1 : src[from];
+      changed[to < 0 ? from : to] = true;
+    }
+
+  /* The child's fd which is the tty, if any is left after the actions. */
+  actions.ctty_fd = -1;
+  for (fd = 0; cttyfd >= 0 && fd <= maxfd; fd++)
+    if (changed[fd] && src[fd] == cttyfd)
+      {
+	actions.ctty_fd = fd;
+	break;
+      }
+
+  AcquireSRWLockExclusive (&spawn_tmpfd_lock);
+  lock_process now;
+  ret = 0;
+  for (fd = 0; fd <= maxfd; fd++)
+    {
+      if (!changed[fd])
+	continue;
+
+      cygheap_fdget cfd (fd, false, false);
+      bool inherited = cfd >= 0 && !cfd->close_on_exec ();
+
+      if (src[fd] == fd && inherited)
+	continue;
+      if (src[fd] < 0)
+	{
+	  if (!inherited)
+	    continue;
+	  fdmoves[2 * nmoves] = fd;
+	  fdmoves[2 * nmoves + 1] = -1;
+	}
+      else if ((fdmoves[2 * nmoves] = fcntl64 (src[fd], F_DUPFD, maxfd + 1))
+	       >= 0)
+	fdmoves[2 * nmoves + 1] = fd;
+      else
+	{
+	  ret = get_errno ();
+	  break;
+	}
+      nmoves++;
+    }
+
+  if (!ret)
+    {
+      path_conv buf;
+
+      actions.flags = flags;
+      actions.pgroup = pgroup;
+      if (flags & POSIX_SPAWN_SETSIGMASK)
+	actions.sigmask = *sigmask;
+      if (flags & POSIX_SPAWN_SETSIGDEF)
+	actions.sigdefault = *sigdefault;
+      actions.nfdmoves = nmoves;
+      actions.fdmoves = fdmoves;
+      if (use_env_path)
+	path = find_exec (path, buf, "PATH", FE_NNF) ?: "";
+      ret = ch_spawn.worker (path, (const char *const *) argv,
+			     (const char *const *) (envp ?: cur_environ ()),
+			     _P_NOWAIT | (use_env_path ? _P_PATH_TYPE_EXEC : 0),
+			     -1, -1, &actions);
+      if (ret < 0)
+	ret = get_errno ();
+      else
+	{
+	  if (pid)
+	    *pid = ret;
+	  ret = 0;
+	}
+    }
+
+  for (i = 0; i < nmoves; i++)
+    if (fdmoves[2 * i + 1] >= 0)
+      close (fdmoves[2 * i]);
+  ReleaseSRWLockExclusive (&spawn_tmpfd_lock);
+  return ret;
+}
+
 int
 av::setup (const char *prog_arg, path_conv& real_path, const char *ext,
 	   int argc, const char *const *argv, bool p_type_exec)
@@ -15,6 +15,7 @@ details. */
 #include "fhandler.h"
 #include "dtable.h"
 #include "cygheap.h"
+#include "utf8_fast.h"
 
 /* Transform characters invalid for Windows filenames to the Unicode private
    use area in the U+f0XX range.  The affected characters are all control
@@ -429,10 +430,30 @@ sys_wcstombs (char *dst, size_t len, const wchar_t *src, size_t nwc,
     len = (size_t) -1;
   while (n < len && nwc-- > 0)
     {
-      wchar_t pw = *pwcs;
+      wchar_t pw;
       int bytes;
       unsigned char cwc;
 
+      /* Convert everything up to the next character which needs special
+	 treatment in one go. */
+      if (f_wctomb == __utf8_wctomb && ps.__count == 0)
+	{
+	  size_t nread, nbytes;
+
+	  nbytes = utf16_to_utf8_fast (ptr, len - n, pwcs, nwc + 1, is_path,
+				       &nread);
+	  if (nread > 0)
+	    {
+	      pwcs += nread;
+	      nwc -= nread - 1;
+	      n += nbytes;
+	      if (dst)
+		ptr += nbytes;
+	      continue;
+	    }
+	}
+      pw = *pwcs;
+
       /* Convert UNICODE private use area.  Reverse functionality for the
 	 ASCII area <= 0x7f (only for path names) is transform_chars above.
 	 Reverse functionality for invalid bytes in a multibyte sequence is
@@ -577,6 +598,24 @@ sys_cp_mbstowcs (mbtowc_p f_mbtowc, wchar_t *dst, size_t dlen,
     len = (size_t)-1;
   while (len > 0 && nms > 0)
     {
+      /* Convert everything up to the next invalid or incomplete sequence
+	 in one go. */
+      if (f_mbtowc == __utf8_mbtowc && ps.__count == 0)
+	{
+	  size_t nread, nconv;
+
+	  nconv = utf8_to_utf16_fast (ptr, len, pmbs, nms, &nread);
+	  if (nconv > 0)
+	    {
+	      pmbs += nread;
+	      nms -= nread;
+	      count += nconv;
+	      if (dst)
+		ptr += nconv;
+	      len -= nconv;
+	      continue;
+	    }
+	}
       /* ASCII CAN handling. */
       if (*pmbs == 0x18)
 	{
@@ -1058,6 +1058,8 @@ out:
   /* Stop transaction if we started one. */
   if (trans)
     stop_transaction (status, old_trans, trans);
+  if (NT_SUCCESS (status))
+    flush_path_conv_cache ();
   syscall_printf ("%S, return status = %y", pc.get_nt_native_path (), status);
   return status;
 }
@@ -2789,6 +2791,7 @@ skip_pre_W10_checks:
 	{
 	  if (removepc)
 	    unlink_nt (*removepc);
+	  flush_path_conv_cache ();
 	  res = 0;
 	}
       else
@@ -3864,6 +3867,7 @@ chroot (const char *newroot)
       getwinenv("PATH="); /* Save the native PATH */
       cygheap->root.set (path.get_posix (), path.get_win32 (),
 			 !!path.objcaseinsensitive ());
+      flush_path_conv_cache ();
       ret = 0;
     }
 
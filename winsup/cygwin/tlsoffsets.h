@@ -61,6 +61,8 @@
 //; $tls::pstack = 3828;
 //; $tls::initialized = -7848;
 //; $tls::pinitialized = 4852;
+//; $tls::mallocmag = -7844;
+//; $tls::pmallocmag = 4856;
 //; __DATA__
 
 #define tls_locals (-12700)
@@ -123,3 +125,5 @@
 #define tls_pstack (3828)
 #define tls_initialized (-7848)
 #define tls_pinitialized (4852)
+#define tls_mallocmag (-7844)
+#define tls_pmallocmag (4856)
@@ -61,6 +61,8 @@
 //; $tls::pstack = 5720;
 //; $tls::initialized = -5032;
 //; $tls::pinitialized = 7768;
+//; $tls::mallocmag = -5024;
+//; $tls::pmallocmag = 7776;
 //; __DATA__
 
 #define tls_locals (-12800)
@@ -123,3 +125,5 @@
 #define tls_pstack (5720)
 #define tls_initialized (-5032)
 #define tls_pinitialized (7768)
+#define tls_mallocmag (-5024)
+#define tls_pmallocmag (7776)
@@ -0,0 +1,243 @@
+/* utf8_fast.h: fast paths for the UTF-8 <-> UTF-16 conversions of
+   sys_mbstowcs and sys_wcstombs.
+
+This file is part of Cygwin.
+
+This software is a copyrighted work licensed under the terms of the
+Cygwin license.  Please consult the file "CYGWIN_LICENSE" for
+details. */
+
+#ifndef _UTF8_FAST_H
+#define _UTF8_FAST_H
+
+/* This file doesn't depend on anything else in Cygwin, so the conversions
+   can be tested and benchmarked on any host.  See
+   winsup/testsuite/host/utf8_fast.cc.
+
+   sys_cp_mbstowcs and sys_wcstombs call newlib's __utf8_mbtowc and
+   __utf8_wctomb once per character.  The functions here convert the longest
+   prefix of the input which those would convert without any special
+   handling, in one go, and return to the caller's loop at the first thing
+   they don't handle: a NUL, an invalid or incomplete sequence, a lone
+   surrogate, a character the caller has to transform, or not enough room
+   left in the output.  The caller converts that one character its usual
+   way and calls them again.
+
+   The results have to be exactly the same as __utf8_mbtowc's and
+   __utf8_wctomb's.  In particular __utf8_mbtowc accepts UTF-8 encoded
+   surrogates (CESU-8), and returns a character from a four byte sequence
+   as two UTF-16 surrogates.  Runs of ASCII characters are converted 16 at
+   a time with SSE2.
+
+   The wide char type is a template parameter, since the host test doesn't
+   have a 16 bit wchar_t. */
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* The callers often don't know the length of the input and just pass
+   (size_t) -1 and rely on the NUL.  So a 16 byte load must not cross a page
+   boundary, unless we know the whole block is part of the input. */
+#define UTF8_FAST_PAGE_OK(p, n) ((((uintptr_t) (p)) & 4095) <= 4096 - (n))
+
+/* Convert UTF-8 from SRC, at most NMS bytes, to at most DLEN UTF-16 units
+   at DST.  If DST is NULL, just count them.  Store the number of bytes
+   read in *NREAD, return the number of UTF-16 units. */
+template <typename WC> static inline size_t
+utf8_to_utf16_fast (WC *dst, size_t dlen, const unsigned char *src,
+		    size_t nms, size_t *nread)
+{
+  const unsigned char *s = src;
+  size_t left = nms, out = 0;
+  unsigned c, c1, c2, c3, w;
+
+  while (out < dlen && left > 0)
+    {
+#ifdef __SSE2__
+      const __m128i zero = _mm_setzero_si128 ();
+
+      while (left >= 16 && dlen - out >= 16 && UTF8_FAST_PAGE_OK (s, 16))
+	{
+	  __m128i v = _mm_loadu_si128 ((const __m128i *) s);
+
+	  /* Not ASCII, or NUL. */
+	  if (_mm_movemask_epi8 (v)
+	      | _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero)))
+	    break;
+	  if (dst)
+	    {
+	      _mm_storeu_si128 ((__m128i *) (dst + out),
+				_mm_unpacklo_epi8 (v, zero));
+	      _mm_storeu_si128 ((__m128i *) (dst + out + 8),
+				_mm_unpackhi_epi8 (v, zero));
+	    }
+	  s += 16;
+	  left -= 16;
+	  out += 16;
+	}
+      if (out >= dlen || left == 0)
+	break;
+#endif
+      /* Don't look at a byte after one which ends the input. */
+      c = s[0];
+      if (c >= 0x01 && c <= 0x7f)
+	{
+	  if (dst)
+	    dst[out] = c;
+	  ++out;
+	  ++s;
+	  --left;
+	}
+      else if (c >= 0xc2 && c <= 0xdf)
+	{
+	  if (left < 2 || ((c1 = s[1]) & 0xc0) != 0x80)
+	    break;
+	  if (dst)
+	    dst[out] = ((c & 0x1f) << 6) | (c1 & 0x3f);
+	  ++out;
+	  s += 2;
+	  left -= 2;
+	}
+      else if (c >= 0xe0 && c <= 0xef)
+	{
+	  if (left < 3 || ((c1 = s[1]) & 0xc0) != 0x80
+	      || (c == 0xe0 && c1 < 0xa0) || ((c2 = s[2]) & 0xc0) != 0x80)
+	    break;
+	  if (dst)
+	    dst[out] = ((c & 0x0f) << 12) | ((c1 & 0x3f) << 6) | (c2 & 0x3f);
+	  ++out;
+	  s += 3;
+	  left -= 3;
+	}
+      else if (c >= 0xf0 && c <= 0xf4)
+	{
+	  /* __utf8_mbtowc returns the high surrogate after three bytes, and
+	     the low one after the fourth.  Leave it to the caller if there's
+	     only room for one of them. */
+	  if (left < 4 || dlen - out < 2 || ((c1 = s[1]) & 0xc0) != 0x80
+	      || (c == 0xf0 && c1 < 0x90) || (c == 0xf4 && c1 >= 0x90)
+	      || ((c2 = s[2]) & 0xc0) != 0x80 || ((c3 = s[3]) & 0xc0) != 0x80)
+	    break;
+	  w = ((c & 0x07) << 18) | ((c1 & 0x3f) << 12) | ((c2 & 0x3f) << 6)
+	      | (c3 & 0x3f);
+	  if (dst)
+	    {
+	      dst[out] = 0xd800 | ((w - 0x10000) >> 10);
+	      dst[out + 1] = 0xdc00 | (w & 0x3ff);
+	    }
+	  out += 2;
+	  s += 4;
+	  left -= 4;
+	}
+      else
+	break;
+    }
+  *nread = s - src;
+  return out;
+}
+
+/* Convert UTF-16 from SRC, at most NWC units, to at most LEN bytes of
+   UTF-8 at DST.  If DST is NULL, just count them.  If IS_PATH, stop at
+   characters in the range 0xf000 - 0xf0ff, which may have to be
+   transformed back.  Store the number of UTF-16 units read in *NREAD,
+   return the number of bytes. */
+template <typename WC> static inline size_t
+utf16_to_utf8_fast (char *dst, size_t len, const WC *src, size_t nwc,
+		    bool is_path, size_t *nread)
+{
+  const WC *s = src;
+  size_t left = nwc, out = 0;
+  unsigned w, w2;
+
+  while (left > 0)
+    {
+#ifdef __SSE2__
+      const __m128i zero = _mm_setzero_si128 ();
+
+      while (left >= 16 && len - out >= 16
+	     && UTF8_FAST_PAGE_OK (s, 16 * sizeof (WC)))
+	{
+	  __m128i lo = _mm_loadu_si128 ((const __m128i *) s);
+	  __m128i hi = _mm_loadu_si128 ((const __m128i *) (s + 8));
+	  /* Units > 0xff saturate to 0xff, which has the high bit set. */
+	  __m128i v = _mm_packus_epi16 (lo, hi);
+
+	  if (_mm_movemask_epi8 (v)
+	      | _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero)))
+	    break;
+	  if (dst)
+	    _mm_storeu_si128 ((__m128i *) (dst + out), v);
+	  s += 16;
+	  left -= 16;
+	  out += 16;
+	}
+      if (left == 0)
+	break;
+#endif
+      w = s[0];
+      if (w >= 0x01 && w <= 0x7f)
+	{
+	  if (len - out < 1)
+	    break;
+	  if (dst)
+	    dst[out] = w;
+	  out += 1;
+	  ++s;
+	  --left;
+	}
+      else if (w >= 0x80 && w <= 0x7ff)
+	{
+	  if (len - out < 2)
+	    break;
+	  if (dst)
+	    {
+	      dst[out] = 0xc0 | (w >> 6);
+	      dst[out + 1] = 0x80 | (w & 0x3f);
+	    }
+	  out += 2;
+	  ++s;
+	  --left;
+	}
+      else if (w >= 0xd800 && w <= 0xdfff)
+	{
+	  /* Only valid surrogate pairs, the caller handles lone surrogates. */
+	  if (w > 0xdbff || left < 2 || ((w2 = s[1]) & 0xfc00) != 0xdc00
+	      || len - out < 4)
+	    break;
+	  w = (((w & 0x3ff) << 10) | (w2 & 0x3ff)) + 0x10000;
+	  if (dst)
+	    {
+	      dst[out] = 0xf0 | (w >> 18);
+	      dst[out + 1] = 0x80 | ((w >> 12) & 0x3f);
+	      dst[out + 2] = 0x80 | ((w >> 6) & 0x3f);
+	      dst[out + 3] = 0x80 | (w & 0x3f);
+	    }
+	  out += 4;
+	  s += 2;
+	  left -= 2;
+	}
+      else if (w >= 0x800 && (!is_path || (w & 0xff00) != 0xf000))
+	{
+	  if (len - out < 3)
+	    break;
+	  if (dst)
+	    {
+	      dst[out] = 0xe0 | (w >> 12);
+	      dst[out + 1] = 0x80 | ((w >> 6) & 0x3f);
+	      dst[out + 2] = 0x80 | (w & 0x3f);
+	    }
+	  out += 3;
+	  ++s;
+	  --left;
+	}
+      else
+	break;
+    }
+  *nread = s - src;
+  return out;
+}
+
+#endif /* _UTF8_FAST_H */
@@ -0,0 +1,263 @@
+/* dtoa_fast.c: host test and benchmark for the fast path of newlib's
+   _dtoa_r modes 2 and 3, newlib/libc/stdlib/dtoa_fast.c.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.
+
+   The fast path is differential tested against the host's printf, which
+   like the bignum algorithm in newlib's dtoa.c rounds the exact binary
+   value half to even.  Mode 2 is %.*e with one digit less, mode 3 is
+   %.*f.  Whenever the fast path claims a result, it must have the same
+   digits and decimal point position.  The inputs are random doubles,
+   short decimals, integers, exact ties, powers of ten and two and their
+   neighbours, the extremes and subnormals.  Then the speed is compared
+   to the host's snprintf, unless -n is given. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include "timing.h"
+
+int __dtoa_fast (double d, int mode, int ndigits, char *buf, int *decpt,
+		 char **rve);
+
+static int errors;
+static long tried, fast;
+
+/* The digits and decimal point position _dtoa_r returns, from the host's
+   printf.  Return the number of digits, 0 for no digits at all, which is
+   what dtoa returns as "0" with *DECPT = 1 - NDIGITS or so. */
+static int
+ref_dtoa (double d, int mode, int ndigits, char *digits, int *decpt)
+{
+  static char buf[2048];
+  char *p, *s = digits;
+  int n;
+
+  if (mode == 2)
+    {
+      snprintf (buf, sizeof buf, "%.*e", (ndigits > 0 ? ndigits : 1) - 1, d);
+      p = strchr (buf, 'e');
+      *decpt = atoi (p + 1) + 1;
+      *p = '\0';
+    }
+  else
+    {
+      snprintf (buf, sizeof buf, "%.*f", ndigits, d);
+      *decpt = strchr (buf, '.') ? strchr (buf, '.') - buf : strlen (buf);
+    }
+  for (p = buf; *p; p++)
+    if (*p >= '0' && *p <= '9')
+      *s++ = *p;
+  *s = '\0';
+  /* Leading zeros of %f move the decimal point. */
+  for (p = digits; *p == '0'; p++)
+    --*decpt;
+  memmove (digits, p, strlen (p) + 1);
+  n = strlen (digits);
+  while (n && digits[n - 1] == '0')
+    digits[--n] = '\0';
+  return n;
+}
+
+static void
+check_mode (double d, int mode, int ndigits)
+{
+  char buf[32], ref[2048], *rve;
+  int decpt, ref_decpt;
+
+  tried++;
+  if (!__dtoa_fast (d, mode, ndigits, buf, &decpt, &rve))
+    return;
+  fast++;
+  if (!ref_dtoa (d, mode, ndigits, ref, &ref_decpt))
+    {
+      if (errors++ < 20)
+	fprintf (stderr, "dtoa_fast: %a mode %d ndigits %d: %s instead of "
+		 "no digits\n", d, mode, ndigits, buf);
+      return;
+    }
+  if ((strcmp (buf, ref) || decpt != ref_decpt || *rve || rve != buf
+       + strlen (buf)) && errors++ < 20)
+    fprintf (stderr, "dtoa_fast: %a mode %d ndigits %d: %s, %d instead of "
+	     "%s, %d\n", d, mode, ndigits, buf, decpt, ref, ref_decpt);
+}
+
+static void
+check (double d)
+{
+  for (int n = 0; n <= 18; n++)
+    check_mode (d, 2, n);
+  for (int n = 0; n <= 20; n++)
+    check_mode (d, 3, n);
+}
+
+static double
+bits2d (uint64_t bits)
+{
+  double d;
+
+  memcpy (&d, &bits, sizeof d);
+  return d;
+}
+
+static uint64_t
+rand64 (void)
+{
+  return (uint64_t) random () << 42 ^ (uint64_t) random () << 21 ^ random ();
+}
+
+static double
+random_double (void)
+{
+  double d;
+
+  do
+    d = bits2d (rand64 () & ~((uint64_t) 1 << 63));
+  while (!isfinite (d));
+  return d;
+}
+
+static void
+check_random (void)
+{
+  char buf[64];
+
+  for (int i = 0; i < 40000; i++)
+    {
+      /* Anything, and the kind of numbers usually printed. */
+      check (random_double ());
+      snprintf (buf, sizeof buf, "%d.%de%d", (int) (random () % 100000),
+		(int) (random () % 1000), (int) (random () % 40) - 20);
+      check (strtod (buf, NULL));
+      check ((double) (random () % 10000000) / 1000);
+      check ((double) rand64 ());
+    }
+}
+
+/* Exact ties for some number of digits, which have to round to even, and
+   their neighbours. */
+static void
+check_ties (void)
+{
+  for (int i = 0; i < 20000; i++)
+    {
+      double d = (double) (random () % 100000000) + 0.5;
+
+      switch (i % 3)
+	{
+	case 1:
+	  d = (double) (random () % 1000000) + 0.25;
+	  break;
+	case 2:
+	  d = (double) (random () % 1000000) + 0.125;
+	  break;
+	}
+      check (d);
+      check (nextafter (d, 0));
+      check (nextafter (d, INFINITY));
+      d = (double) (rand64 () >> 11) * 10 + 5;
+      check (d);
+      check (nextafter (d, 0));
+      check (nextafter (d, INFINITY));
+    }
+}
+
+static void
+check_special (void)
+{
+  double d;
+
+  for (int e = -323; e <= 308; e++)
+    {
+      d = strtod ("1e0", NULL) * pow (10, e);
+      check (d);
+      check (nextafter (d, 0));
+      check (nextafter (d, INFINITY));
+    }
+  for (int e = -1074; e <= 1023; e++)
+    {
+      d = ldexp (1, e);
+      check (d);
+      check (nextafter (d, 0));
+      check (nextafter (d, INFINITY));
+    }
+  check (DBL_MAX);
+  check (DBL_MIN);
+  check (DBL_TRUE_MIN);
+  check (0.1);
+  check (1e23);
+  check (5e-324);
+  check (9007199254740993.0);
+  for (int i = 0; i < 2000; i++)
+    check (bits2d (rand64 () & ((((uint64_t) 1) << 52) - 1)));
+  /* All floats with a stride, which covers every exponent. */
+  for (uint32_t u = 0; u < 0x7f800000; u += 0x7f800000 / 20000)
+    {
+      float f;
+
+      memcpy (&f, &u, sizeof f);
+      check (f);
+    }
+}
+
+/* Digits for %.6g and %.3f of typical numbers with the host's snprintf and
+   with the fast path, falling back to the host's snprintf. */
+static void
+benchmark (void)
+{
+  enum { N = 1000000 };
+  static double d[N];
+  volatile int sink = 0;
+  double start, t_ref, t_fast;
+  long fallback = 0;
+  char buf[64];
+  int decpt;
+
+  for (int i = 0; i < N; i++)
+    d[i] = i % 2 ? random_double () : (double) (rand64 () % 100000000) / 1000;
+
+  start = now ();
+  for (int i = 0; i < N; i++)
+    sink += snprintf (buf, sizeof buf, i % 2 ? "%.5e" : "%.3f", d[i]);
+  t_ref = now () - start;
+
+  start = now ();
+  for (int i = 0; i < N; i++)
+    if (__dtoa_fast (d[i], i % 2 ? 2 : 3, i % 2 ? 6 : 3, buf, &decpt, NULL))
+      sink += decpt;
+    else
+      {
+	fallback++;
+	sink += snprintf (buf, sizeof buf, i % 2 ? "%.5e" : "%.3f", d[i]);
+      }
+  t_fast = now () - start;
+
+  printf ("host snprintf: %6.1f ns/number\n", t_ref * 1e9 / N);
+  printf ("fast path:     %6.1f ns/number, %.3f%% fallbacks\n",
+	  t_fast * 1e9 / N, fallback * 100.0 / N);
+}
+
+int
+main (int argc, char **argv)
+{
+  srandom (42);
+  check_special ();
+  check_random ();
+  check_ties ();
+  printf ("%ld conversions, %.2f%% by the fast path\n", tried,
+	  fast * 100.0 / tried);
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  if (argc > 1 && !strcmp (argv[1], "-n"))
+    return 0;
+  benchmark ();
+  return 0;
+}
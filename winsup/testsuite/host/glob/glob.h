@@ -0,0 +1,18 @@
+/* <glob.h> for the host build of Cygwin's glob: Cygwin's glob_t and flags
+   instead of the host's, and what else glob.cc gets from Cygwin's headers.
+   glob.cc includes this after <sys/stat.h>. */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define __GNU_VISIBLE 1
+#define __INSIDE_CYGWIN__	/* no dllimport */
+
+#include "../../../cygwin/include/glob.h"
+
+#define lstat64 lstat
+#define stat64 stat
+#define issetugid() 0
+#ifndef ARG_MAX
+#define ARG_MAX 32000
+#endif
@@ -0,0 +1,483 @@
+/* glob_tree.c: host test and benchmark for Cygwin's glob in
+   winsup/cygwin/glob.cc, which takes the file types from d_type instead
+   of stat'ing every name, skips names which aren't directories when more
+   segments follow, and keeps a map of ASCII characters for each bracket
+   expression.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.  glob.cc is built as cyg_glob, and with
+   GLOB_ALTDIRFUNC it doesn't trust d_type, so it stats as before.
+
+   Both ways must give the listed results for a small tree with hidden
+   files and symlinks, with and without GLOB_MARK.  Random patterns over a
+   directory of random names must match the same names as the recursive
+   matcher glob.cc had before, in the C locale and, if there is one, a
+   UTF-8 locale.  Unless -n is
+   given, a tree of 30000 files is globbed both ways and the times and the
+   number of stats GLOB_ALTDIRFUNC took are printed. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <locale.h>
+#include <unistd.h>
+#include <wchar.h>
+#include <sys/stat.h>
+#include <glob.h>
+#include "timing.h"
+
+/* glob.cc needs these outside Cygwin, see collate.h */
+const int __collate_load_error = 0;
+
+int
+__collate_range_cmp (int c1, int c2)
+{
+  wchar_t s1[2] = { (wchar_t) c1, L'\0' };
+  wchar_t s2[2] = { (wchar_t) c2, L'\0' };
+
+  return wcscoll (s1, s2);
+}
+
+static int errors;
+static long nstats;
+static char topdir[] = "/tmp/glob_treeXXXXXX";
+
+/* The GLOB_ALTDIRFUNC functions, counting the stats */
+static int
+alt_lstat (const char *path, struct stat *sb)
+{
+  nstats++;
+  return lstat (path, sb);
+}
+
+static int
+alt_stat (const char *path, struct stat *sb)
+{
+  nstats++;
+  return stat (path, sb);
+}
+
+static void
+alt_closedir (void *dirp)
+{
+  closedir ((DIR *) dirp);
+}
+
+static struct dirent *
+alt_readdir (void *dirp)
+{
+  return readdir ((DIR *) dirp);
+}
+
+static void *
+alt_opendir (const char *path)
+{
+  return opendir (path);
+}
+
+static int errfunc_calls;
+
+static int
+count_errfunc (const char *path, int err)
+{
+  errfunc_calls++;
+  return 0;
+}
+
+/* Glob PATTERN, with GLOB_ALTDIRFUNC if ALT, and return the results joined
+   by spaces, or "NOMATCH" or "ERROR n". */
+static char *
+run_glob (const char *pattern, int flags, int alt)
+{
+  static char buf[1 << 20];
+  glob_t g;
+  size_t i, len = 0;
+  int ret;
+
+  memset (&g, 0, sizeof g);
+  if (alt)
+    {
+      flags |= GLOB_ALTDIRFUNC;
+      g.gl_closedir = alt_closedir;
+      g.gl_readdir = alt_readdir;
+      g.gl_opendir = alt_opendir;
+      g.gl_lstat = alt_lstat;
+      g.gl_stat = alt_stat;
+    }
+  ret = glob (pattern, flags, (flags & GLOB_ERR) ? count_errfunc : NULL, &g);
+  if (ret == GLOB_NOMATCH)
+    strcpy (buf, "NOMATCH");
+  else if (ret)
+    sprintf (buf, "ERROR %d", ret);
+  else
+    {
+      buf[0] = '\0';
+      for (i = 0; i < g.gl_pathc && len < sizeof buf - 4096; i++)
+	len += sprintf (buf + len, "%s%s", i ? " " : "", g.gl_pathv[i]);
+    }
+  globfree (&g);
+  return buf;
+}
+
+static void
+check (const char *what, const char *pattern, int flags, const char *want,
+       const char *got)
+{
+  if (strcmp (want, got) && errors++ < 20)
+    fprintf (stderr, "glob_tree: %s: \"%s\" flags %#x: want \"%s\", "
+	     "got \"%s\"\n", what, pattern, flags, want, got);
+}
+
+static void
+make_file (const char *path)
+{
+  FILE *fp = fopen (path, "w");
+
+  if (!fp)
+    {
+      perror (path);
+      exit (1);
+    }
+  fclose (fp);
+}
+
+static const struct
+{
+  const char *pattern;
+  int flags;
+  const char *want;
+  int errfunc_calls;
+} known[] = {
+  { "*", 0, "a b dangling file.txt link" },
+  { "*", GLOB_MARK, "a/ b/ dangling file.txt link/" },
+  { "*/", 0, "a/ b/ link/" },
+  { "*/*.c", 0, "a/x.c b/z.c link/x.c" },
+  { "*/.*.c", 0, "a/.hidden.c link/.hidden.c" },
+  { "*/sub/*", 0, "b/sub/w.c" },
+  { "*/*/*", GLOB_MARK, "b/sub/w.c" },
+  { "?/*.[ch]", 0, "a/x.c a/y.h b/z.c" },
+  { "[!a]/*", GLOB_MARK, "b/sub/ b/z.c" },
+  { "*/*", GLOB_MARK, "a/x.c a/y.h b/sub/ b/z.c link/x.c link/y.h" },
+  { "l*/", GLOB_MARK, "link/" },
+  { "[a-b]/[x-z].?", 0, "a/x.c a/y.h b/z.c" },
+  { "file.txt/*", 0, "NOMATCH" },
+  { "nonexistent/*", 0, "NOMATCH" },
+  { "a/x.c", 0, "a/x.c" },
+  { "a/x.c", GLOB_MARK, "a/x.c" },
+  { "b/sub", GLOB_MARK, "b/sub/" },
+  { "*.\\txt", 0, "file.txt" },
+  /* file.txt isn't a directory, which is no error */
+  { "[!d]*/*", GLOB_ERR, "a/x.c a/y.h b/sub b/z.c link/x.c link/y.h" },
+  /* but a missing one is, also behind a dangling symlink */
+  { "nonexistent/*", GLOB_ERR, "ERROR -2", 1 },
+  { "*/*", GLOB_ERR, "ERROR -2", 1 },
+};
+
+#define NKNOWN (sizeof known / sizeof *known)
+
+static void
+check_known (void)
+{
+  size_t i;
+  int alt;
+
+  mkdir ("known", 0777);
+  chdir ("known");
+  mkdir ("a", 0777);
+  mkdir ("b", 0777);
+  mkdir ("b/sub", 0777);
+  make_file ("a/x.c");
+  make_file ("a/y.h");
+  make_file ("a/.hidden.c");
+  make_file ("b/z.c");
+  make_file ("b/sub/w.c");
+  make_file ("file.txt");
+  symlink ("a", "link");
+  symlink ("nonexistent", "dangling");
+
+  for (i = 0; i < NKNOWN; i++)
+    for (alt = 0; alt < 2; alt++)
+      {
+	errfunc_calls = 0;
+	check (alt ? "known, GLOB_ALTDIRFUNC" : "known", known[i].pattern,
+	       known[i].flags, known[i].want,
+	       run_glob (known[i].pattern, known[i].flags, alt));
+	if (errfunc_calls != known[i].errfunc_calls)
+	  check ("errfunc calls", known[i].pattern, known[i].flags,
+		 known[i].errfunc_calls ? "1" : "0",
+		 errfunc_calls ? "1 or more" : "0");
+      }
+  chdir ("..");
+}
+
+static int
+compare_strings (const void *a, const void *b)
+{
+  return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+/* The recursive matcher glob.cc used to have, on wide characters, for
+   the sets, ranges and quotes of check_random's patterns */
+static int
+ref_match (const wchar_t *p, const wchar_t *s)
+{
+  const wchar_t *end;
+  wchar_t lo[2] = { 0, 0 }, hi[2] = { 0, 0 }, c[2] = { 0, 0 };
+  int ok, negate;
+
+  for (;; p++, s++)
+    switch (*p)
+      {
+      case L'\0':
+	return *s == L'\0';
+      case L'*':
+	do
+	  if (ref_match (p + 1, s))
+	    return 1;
+	while (*s++);
+	return 0;
+      case L'?':
+	if (!*s)
+	  return 0;
+	break;
+      case L'[':
+	negate = p[1] == L'!';
+	end = wcschr (p + 2 + negate, L']');
+	if (!*s)
+	  return 0;
+	c[0] = *s;
+	for (ok = 0, p += 1 + negate; p < end; p++)
+	  if (p[1] == L'-' && p + 2 < end)
+	    {
+	      lo[0] = p[0];
+	      hi[0] = p[2];
+	      ok |= wcscoll (lo, c) <= 0 && wcscoll (c, hi) <= 0;
+	      p += 2;
+	    }
+	  else
+	    ok |= *p == *s;
+	if (ok == negate)
+	  return 0;
+	break;
+      case L'\\':
+	p++;
+	/* FALLTHROUGH */
+      default:
+	if (*p != *s)
+	  return 0;
+	break;
+      }
+}
+
+/* The names in DIR which ref_match PATTERN, like glob would list them */
+static char *
+run_ref (const char *dir, const char *pattern)
+{
+  static char buf[1 << 20];
+  static char *names[4096];
+  wchar_t wpattern[128], wname[256];
+  struct dirent *dp;
+  DIR *dirp = opendir (dir);
+  size_t i, n = 0, len = 0;
+
+  mbstowcs (wpattern, pattern, 128);
+  while ((dp = readdir (dirp)) && n < 4096)
+    {
+      mbstowcs (wname, dp->d_name, 256);
+      /* A leading period must be matched by a period */
+      if ((wname[0] != L'.' || wpattern[0] == L'.')
+	  && ref_match (wpattern, wname))
+	names[n++] = strdup (dp->d_name);
+    }
+  closedir (dirp);
+  if (!n)
+    return strcpy (buf, "NOMATCH");
+  qsort (names, n, sizeof *names, compare_strings);
+  for (i = 0; i < n; i++)
+    {
+      len += sprintf (buf + len, "%s%s/%s", i ? " " : "", dir, names[i]);
+      free (names[i]);
+    }
+  return buf;
+}
+
+/* Random names and patterns made of PIECES, the first NCHARS of which are
+   plain characters */
+static void
+check_random (const char *what, const char *const *pieces, int nchars,
+	      int npieces, int iterations)
+{
+  char dir[32], name[64], pattern[128], *want;
+  int i, j, len;
+
+  sprintf (dir, "random-%s", what);
+  mkdir (dir, 0777);
+  for (i = 0; i < 300; i++)
+    {
+      len = 1 + random () % 6;
+      strcpy (name, dir);
+      strcat (name, "/");
+      for (j = 0; j < len; j++)
+	strcat (name, pieces[random () % nchars]);
+      if (strcmp (name + strlen (dir), "/.") && strcmp (name + strlen (dir),
+							   "/.."))
+	make_file (name);
+    }
+
+  for (i = 0; i < iterations; i++)
+    {
+      len = 1 + random () % 6;
+      pattern[0] = '\0';
+      for (j = 0; j < len; j++)
+	strcat (pattern, pieces[random () % npieces]);
+      want = strdup (run_ref (dir, pattern));
+      sprintf (name, "%s/", dir);
+      memmove (pattern + strlen (name), pattern, strlen (pattern) + 1);
+      memcpy (pattern, name, strlen (name));
+      check (what, pattern, 0, want, run_glob (pattern, 0, 0));
+      free (want);
+    }
+}
+
+static const char *const ascii_pieces[] = {
+  "a", "b", "c", ".",
+  "*", "?", "[ab]", "[!a]", "[a-b]", "[!b-c.]", "[.]", "\\*"
+};
+
+static const char *const utf8_pieces[] = {
+  "a", "b", "é", "€",
+  "*", "?", "[aé]", "[!é]", "[a-é]", "[é-€]", "[!a-b]"
+};
+
+/* Each * used to take a level of recursion for every character it could
+   start at. */
+static void
+check_stars (void)
+{
+  char name[64];
+
+  mkdir ("stars", 0777);
+  chdir ("stars");
+  memset (name, 'a', 40);
+  strcpy (name + 40, "c");
+  make_file (name);
+  check ("stars", "*a*a*a*a*a*a*a*a*a*a*b", 0, "NOMATCH",
+	 run_glob ("*a*a*a*a*a*a*a*a*a*a*b", 0, 0));
+  check ("stars", "*a*a*a*a*a*a*a*a*a*a*c", 0, name,
+	 run_glob ("*a*a*a*a*a*a*a*a*a*a*c", 0, 0));
+  chdir ("..");
+}
+
+static const struct
+{
+  const char *pattern;
+  int flags;
+} tree_patterns[] = {
+  { "src/*/*/*.c", 0 },
+  { "src/d1?/*/f[0-2]*.[ch]", 0 },
+  { "src/*/*/*", GLOB_MARK },
+  { "src/*/*/", 0 },
+  { "src/*/*/*/*.c", 0 },
+  { "src/*/s0[0-4]/f00[0-9].o", 0 },
+};
+
+#define NTREE_PATTERNS (sizeof tree_patterns / sizeof *tree_patterns)
+
+static void
+benchmark (void)
+{
+  char path[64];
+  char *want;
+  double start, t, talt;
+  int i, j, k, iter = 5, n;
+
+  mkdir ("src", 0777);
+  for (i = 0; i < 20; i++)
+    {
+      sprintf (path, "src/d%02d", i);
+      mkdir (path, 0777);
+      for (j = 0; j < 10; j++)
+	{
+	  sprintf (path, "src/d%02d/s%02d", i, j);
+	  mkdir (path, 0777);
+	  for (k = 0; k < 150; k++)
+	    {
+	      sprintf (path, "src/d%02d/s%02d/f%03d.%c", i, j, k / 3,
+		       "cho"[k % 3]);
+	      make_file (path);
+	    }
+	}
+    }
+
+  printf ("%-26s %7s %10s %17s %10s\n", "pattern", "matches", "d_type ms",
+	  "GLOB_ALTDIRFUNC ms", "stats");
+  for (i = 0; i < (int) NTREE_PATTERNS; i++)
+    {
+      const char *pattern = tree_patterns[i].pattern;
+      int flags = tree_patterns[i].flags;
+
+      want = strdup (run_glob (pattern, flags, 1));
+      check ("tree", pattern, flags, want, run_glob (pattern, flags, 0));
+      for (n = 0, j = 0; want[j]; j++)
+	n += want[j] == ' ';
+      n += strcmp (want, "NOMATCH") != 0;
+      free (want);
+
+      start = now ();
+      for (j = 0; j < iter; j++)
+	run_glob (pattern, flags, 0);
+      t = (now () - start) / iter;
+      nstats = 0;
+      start = now ();
+      for (j = 0; j < iter; j++)
+	run_glob (pattern, flags, 1);
+      talt = (now () - start) / iter;
+      printf ("%-26s %7d %10.2f %17.2f %10ld\n", pattern, n, t * 1e3,
+	      talt * 1e3, nstats / iter);
+    }
+}
+
+static int
+remove_entry (const char *path, const struct stat *sb, int type,
+	      struct FTW *ftw)
+{
+  return remove (path);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (!mkdtemp (topdir) || chdir (topdir))
+    {
+      perror (topdir);
+      return 1;
+    }
+  srandom (42);
+  check_known ();
+  check_stars ();
+  check_random ("C", ascii_pieces, 4,
+		sizeof ascii_pieces / sizeof *ascii_pieces, 3000);
+  if (setlocale (LC_ALL, "C.UTF-8") || setlocale (LC_ALL, "en_US.UTF-8"))
+    {
+      check_random ("UTF-8", utf8_pieces, 4,
+		    sizeof utf8_pieces / sizeof *utf8_pieces, 3000);
+      setlocale (LC_ALL, "C");
+    }
+  else
+    puts ("glob_tree: no UTF-8 locale, only checking the C locale");
+
+  if (!errors && (argc < 2 || strcmp (argv[1], "-n")))
+    benchmark ();
+  chdir ("/");
+  nftw (topdir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  return 0;
+}
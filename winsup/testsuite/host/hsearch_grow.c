@@ -0,0 +1,119 @@
+/* hsearch_grow.c: host test and benchmark for newlib's hsearch_r,
+   newlib/libc/search/hcreate_r.c.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.
+
+   200000 keys are entered into tables created for 16 and for all of them,
+   so the first one has to grow a lot.  Every key must be found again, also
+   through a copy of it, the pointers hsearch_r returned before the table
+   grew must still be valid, keys which were never entered must not be
+   found, and entering a key again must find the first entry.  Unless -n is
+   given, the time per enter, find and failed find is printed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <search.h>
+#include "timing.h"
+
+#define NKEYS 200000
+
+static int errors;
+
+#define check(e) \
+  ((e) ? (void) 0 \
+       : (void) (errors++ < 20 \
+		 && fprintf (stderr, "hsearch_grow: %s:%d: %s failed\n", \
+			     __FILE__, __LINE__, #e)))
+
+static char **keys;
+
+static void
+grow (size_t nel, int timing)
+{
+  struct hsearch_data htab;
+  ENTRY e, *ep, *first = NULL;
+  char buf[32];
+  double start, t_enter, t_find, t_miss;
+  long i;
+
+  memset (&htab, 0, sizeof htab);
+  check (hcreate_r (nel, &htab));
+  check (!hcreate_r (nel, &htab));	/* Exists already. */
+
+  start = now ();
+  for (i = 0; i < NKEYS; i++)
+    {
+      e.key = keys[i];
+      e.data = (void *) i;
+      check (hsearch_r (e, ENTER, &ep, &htab));
+      check (ep->key == keys[i] && (long) ep->data == i);
+      if (i == 0)
+	first = ep;
+    }
+  t_enter = now () - start;
+  /* Entered before the table grew, and still the same. */
+  check (first->key == keys[0] && (long) first->data == 0);
+
+  start = now ();
+  for (i = 0; i < NKEYS; i++)
+    {
+      /* A copy, so the key has to be compared. */
+      strcpy (buf, keys[i]);
+      e.key = buf;
+      check (hsearch_r (e, FIND, &ep, &htab));
+      check (ep->key == keys[i] && (long) ep->data == i);
+    }
+  t_find = now () - start;
+
+  start = now ();
+  for (i = 0; i < NKEYS; i++)
+    {
+      snprintf (buf, sizeof buf, "key%ld", NKEYS + i);
+      e.key = buf;
+      check (!hsearch_r (e, FIND, &ep, &htab));
+      check (ep == NULL);
+    }
+  t_miss = now () - start;
+
+  /* Entering an existing key finds it. */
+  e.key = keys[1];
+  e.data = (void *) 12345L;
+  check (hsearch_r (e, ENTER, &ep, &htab));
+  check (ep->key == keys[1] && (long) ep->data == 1);
+
+  hdestroy_r (&htab);
+  check (htab.htable == NULL);
+
+  if (timing)
+    printf ("nel %6lu, %d keys: enter %5.1f ns, find %5.1f ns, "
+	    "not found %5.1f ns\n", (unsigned long) nel, NKEYS,
+	    t_enter * 1e9 / NKEYS, t_find * 1e9 / NKEYS,
+	    t_miss * 1e9 / NKEYS);
+}
+
+int
+main (int argc, char **argv)
+{
+  int timing = !(argc > 1 && !strcmp (argv[1], "-n"));
+  long i;
+
+  keys = malloc (NKEYS * sizeof *keys);
+  for (i = 0; i < NKEYS; i++)
+    {
+      keys[i] = malloc (16);
+      snprintf (keys[i], 16, "key%ld", i * 7919 % NKEYS);
+    }
+  grow (16, timing);
+  grow (NKEYS, timing);
+  for (i = 0; i < NKEYS; i++)
+    free (keys[i]);
+  free (keys);
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  return 0;
+}
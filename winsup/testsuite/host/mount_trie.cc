@@ -0,0 +1,223 @@
+/* mount_trie.cc: host test and benchmark for winsup/cygwin/mount_trie.h.
+
+   This doesn't need Cygwin.  Build and run it on any host with
+   `make check', see Makefile.
+
+   It builds random mount tables, looks up random paths through the prefix
+   tree and through the linear scan used before, and compares the results.
+   Then it measures the lookup rate of both. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <alloca.h>
+#include "mount_trie.h"
+#include "timing.h"
+
+#define MAX_MOUNTS 64
+#define MAX_PATH_LEN 260
+
+struct mount_item
+{
+  char native_path[MAX_PATH_LEN];
+  int native_pathlen;
+  char posix_path[MAX_PATH_LEN];
+  int posix_pathlen;
+  bool caseinsensitive;
+};
+
+static mount_item mount[MAX_MOUNTS];
+static int nmounts;
+static int order[MAX_MOUNTS];
+static mount_trie trie;
+
+static bool
+isdirsep (char c)
+{
+  return c == '/' || c == '\\';
+}
+
+/* Like cygwin_strncasecmp, convert to wide chars first and compare case
+   insensitive, so the cost of a linear scan is comparable to the DLL. */
+static int
+strncasematch (const char *cs, const char *ct, size_t n)
+{
+  wchar_t *ws = (wchar_t *) alloca ((n + 1) * sizeof (wchar_t));
+  wchar_t *wt = (wchar_t *) alloca ((n + 1) * sizeof (wchar_t));
+  size_t ls = strnlen (cs, n), lt = strnlen (ct, n);
+  char *bs = strndup (cs, ls), *bt = strndup (ct, lt);
+
+  ls = mbstowcs (ws, bs, n + 1);
+  lt = mbstowcs (wt, bt, n + 1);
+  free (bs);
+  free (bt);
+  if (ls != lt)
+    return 0;
+  for (size_t i = 0; i < ls; ++i)
+    if (towupper (ws[i]) != towupper (wt[i]))
+      return 0;
+  return 1;
+}
+
+/* Same as path_prefix_p in path.cc. */
+static int
+path_prefix_p (const char *path1, const char *path2, int len1,
+	       bool caseinsensitive)
+{
+  if (len1 > 0 && isdirsep (path1[len1 - 1]))
+    len1--;
+  if (len1 == 0)
+    return isdirsep (path2[0]) && !isdirsep (path2[1]);
+  if (isdirsep (path2[len1]) || path2[len1] == 0 || path1[len1 - 1] == ':')
+    return caseinsensitive ? strncasematch (path1, path2, len1)
+			   : !strncmp (path1, path2, len1);
+  return 0;
+}
+
+static const char *const components[] =
+{
+  "usr", "Usr", "bin", "lib", "opt", "home", "HOME", "src", "build",
+  "mingw64", "tmp", "var", "x", "xy", "xyz", "data", "Data", "\xc3\xa4rger",
+};
+#define NCOMP (sizeof components / sizeof *components)
+
+static void
+random_path (char *buf, int maxdepth)
+{
+  int depth = rand () % (maxdepth + 1);
+
+  if (!depth)
+    {
+      strcpy (buf, "/");
+      return;
+    }
+  *buf = '\0';
+  for (int i = 0; i < depth; ++i)
+    {
+      strcat (buf, "/");
+      strcat (buf, components[rand () % NCOMP]);
+    }
+}
+
+static void
+build_table (int n)
+{
+  nmounts = n;
+  for (int i = 0; i < n; ++i)
+    {
+      random_path (mount[i].posix_path, 4);
+      mount[i].posix_pathlen = strlen (mount[i].posix_path);
+      snprintf (mount[i].native_path, MAX_PATH_LEN, "C:\\m%d", i);
+      mount[i].native_pathlen = strlen (mount[i].native_path);
+      mount[i].caseinsensitive = rand () & 1;
+      order[i] = i;
+    }
+  /* Check longer mount points first, like mount_info::sort arranges it.
+     Any order would do for the comparison, as long as both lookups use
+     the same. */
+  for (int i = 1; i < n; ++i)
+    for (int j = i; j > 0
+		    && mount[order[j]].posix_pathlen
+		       > mount[order[j - 1]].posix_pathlen; --j)
+      {
+	int t = order[j];
+	order[j] = order[j - 1];
+	order[j - 1] = t;
+      }
+  trie.init ();
+  for (int i = 0; i < n; ++i)
+    {
+      mount_item *mi = mount + order[i];
+      trie.insert (order[i], i, mi->posix_pathlen, mi->caseinsensitive,
+		   mount->posix_path, sizeof *mount);
+    }
+}
+
+static int
+lookup_linear (const char *path)
+{
+  for (int i = 0; i < nmounts; ++i)
+    {
+      mount_item *mi = mount + order[i];
+      if (path_prefix_p (mi->posix_path, path, mi->posix_pathlen,
+			 mi->caseinsensitive))
+	return i;
+    }
+  return -1;
+}
+
+static int
+lookup_trie (const char *path)
+{
+  for (uint64_t cand = trie.lookup (path, mount->posix_path, sizeof *mount);
+       cand;
+       cand &= cand - 1)
+    {
+      int i = __builtin_ctzll (cand);
+      mount_item *mi = mount + order[i];
+      if (path_prefix_p (mi->posix_path, path, mi->posix_pathlen,
+			 mi->caseinsensitive))
+	return i;
+    }
+  return -1;
+}
+
+int
+main ()
+{
+  static char paths[4096][MAX_PATH_LEN];
+  int errors = 0;
+
+  setlocale (LC_CTYPE, "C.UTF-8");
+  srand (42);
+  for (int round = 0; round < 2000; ++round)
+    {
+      build_table (1 + rand () % MAX_MOUNTS);
+      for (int i = 0; i < 200; ++i)
+	{
+	  char path[MAX_PATH_LEN];
+
+	  random_path (path, 6);
+	  if (rand () % 8 == 0)
+	    path[1] = '/';
+	  if (lookup_linear (path) != lookup_trie (path))
+	    {
+	      if (errors++ < 10)
+		fprintf (stderr, "mismatch for %s: linear %d, trie %d\n",
+			 path, lookup_linear (path), lookup_trie (path));
+	    }
+	}
+    }
+  if (errors)
+    {
+      fprintf (stderr, "%d mismatches\n", errors);
+      return 1;
+    }
+
+  for (int n = 8; n <= MAX_MOUNTS; n *= 2)
+    {
+      const int loops = 200;
+      volatile int sink = 0;
+      double t0, lin, tri;
+
+      build_table (n);
+      for (int i = 0; i < 4096; ++i)
+	random_path (paths[i], 6);
+      t0 = now ();
+      for (int l = 0; l < loops; ++l)
+	for (int i = 0; i < 4096; ++i)
+	  sink += lookup_linear (paths[i]);
+      lin = now () - t0;
+      t0 = now ();
+      for (int l = 0; l < loops; ++l)
+	for (int i = 0; i < 4096; ++i)
+	  sink += lookup_trie (paths[i]);
+      tri = now () - t0;
+      printf ("%2d mounts: linear %6.1f ns/lookup, trie %6.1f ns/lookup\n",
+	      n, lin * 1e9 / (loops * 4096), tri * 1e9 / (loops * 4096));
+    }
+  return 0;
+}
@@ -0,0 +1,152 @@
+/* msys2_path_conv_test.cc: host test and benchmark for
+   winsup/cygwin/msys2_path_conv.cc.
+
+   Build and run it with `make check', see Makefile.
+
+   The corpus file contains command line arguments and environment strings
+   as seen by arg_heuristic in path.cc, one per line prefixed with "< ",
+   each followed by the expected result prefixed with "> ".  The program
+   converts all of them, compares the results, and then measures the
+   throughput of convert over the whole corpus.
+
+   After adding inputs to the corpus, regenerate the expected results with
+
+     ./msys2_path_conv_test -g msys2_path_conv.corpus > new.corpus
+
+   and check the differences carefully. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include "msys2_path_conv.h"
+#include "timing.h"
+
+#define MAX_PATH 260
+
+/* A stand-in for the path_conv based implementation in the DLL, mimicking
+   a default MSYS2 installation in C:\msys64 with the cygdrive prefix set
+   to "/".  It only has to be deterministic, not exact. */
+void
+posix_to_win32_path (const char *from, const char *to, char **dst,
+		     const char *dstend)
+{
+  static const char root[] = "C:/msys64";
+  const char *s;
+
+  if (from == to)
+    return;
+  if (to - from >= 2 && isalpha ((unsigned char) from[1])
+      && (to - from == 2 || from[2] == '/'))
+    {
+      char drive[3] = { (char) toupper ((unsigned char) from[1]), ':', '/' };
+
+      for (s = drive; s < drive + 3 && *dst != dstend; ++s, ++*dst)
+	**dst = *s;
+      from += 3;
+    }
+  else
+    for (s = root; *s && *dst != dstend; ++s, ++*dst)
+      **dst = *s;
+  for (s = from; s < to && *dst != dstend; ++s, ++*dst)
+    **dst = (*s == '\\') ? '/' : *s;
+}
+
+/* Same as arg_heuristic_with_exclusions in path.cc, minus the exclusion
+   list and the reallocation of the result. */
+static const char *
+arg_heuristic (const char *arg, std::vector<char> &buf)
+{
+  size_t stack_len = strlen (arg) + 16 * MAX_PATH;
+
+  if (buf.size () < stack_len)
+    buf.resize (stack_len);
+  memset (buf.data (), 0, MAX_PATH);
+  return convert (buf.data (), stack_len - 1, arg);
+}
+
+int
+main (int argc, char **argv)
+{
+  std::vector<std::string> in, out;
+  std::vector<char> buf;
+  bool generate = false;
+  char *line = NULL;
+  size_t n = 0;
+  ssize_t len;
+  FILE *fp;
+  int errors = 0;
+
+  if (argc > 1 && !strcmp (argv[1], "-g"))
+    {
+      generate = true;
+      --argc;
+      ++argv;
+    }
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: msys2_path_conv_test [-g] corpus\n");
+      return 2;
+    }
+  if (!(fp = fopen (argv[1], "r")))
+    {
+      perror (argv[1]);
+      return 2;
+    }
+  while ((len = getline (&line, &n, fp)) >= 0)
+    {
+      if (len > 0 && line[len - 1] == '\n')
+	line[--len] = '\0';
+      if (!strncmp (line, "< ", 2))
+	{
+	  in.push_back (line + 2);
+	  out.push_back ("");
+	}
+      else if (!strncmp (line, "> ", 2) && !in.empty ())
+	out.back () = line + 2;
+    }
+  free (line);
+  fclose (fp);
+  /* MSYS_NO_PATHCONV switches off all conversions. */
+  unsetenv ("MSYS_NO_PATHCONV");
+
+  for (size_t i = 0; i < in.size (); ++i)
+    {
+      const char *res = arg_heuristic (in[i].c_str (), buf);
+
+      if (generate)
+	printf ("< %s\n> %s\n", in[i].c_str (), res);
+      else if (out[i] != res)
+	{
+	  if (errors++ < 10)
+	    fprintf (stderr, "mismatch for \"%s\":\n  expected \"%s\"\n"
+			     "  got      \"%s\"\n",
+		     in[i].c_str (), out[i].c_str (), res);
+	}
+    }
+  if (generate)
+    return 0;
+  if (errors)
+    {
+      fprintf (stderr, "%d of %zu conversions differ\n", errors, in.size ());
+      return 1;
+    }
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < in.size (); ++i)
+    bytes += in[i].size () + 1;
+
+  const int loops = 20000;
+  volatile char sink = 0;
+  double t0 = now (), t;
+  for (int l = 0; l < loops; ++l)
+    for (size_t i = 0; i < in.size (); ++i)
+      sink += *arg_heuristic (in[i].c_str (), buf);
+  t = now () - t0;
+  printf ("%zu strings, %zu bytes: %.1f MB/s, %.1f ns/string\n",
+	  in.size (), bytes, bytes * (double) loops / t / 1e6,
+	  t * 1e9 / ((double) loops * in.size ()));
+  return 0;
+}
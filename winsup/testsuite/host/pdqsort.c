@@ -0,0 +1,374 @@
+/* pdqsort.c: host test and benchmark for newlib's qsort, qsort_r and
+   __bsd_qsort_r, newlib/libc/search/qsort.c.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.
+
+   Arrays of various element sizes and alignments, with random, sorted,
+   reversed, few distinct, organ pipe, sawtooth and mostly sorted
+   contents, are sorted with a comparison function defining a total order,
+   so the result must be the same as with the host's qsort.  The thunk
+   must make it to the comparison function of both qsort_r variants.
+   Then McIlroy's adversary builds an input which is as bad as possible
+   for the quicksort, and the number of comparisons for that must still be
+   O(n log n).  Comparison functions which don't define an order at all
+   must still leave a permutation of the array, and the sort must not
+   touch anything outside of it, which pdqsort_asan checks.  Unless -n is
+   given, the time per element for some of these
+   inputs and element sizes is compared with the host's qsort. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "timing.h"
+
+void nl_qsort (void *, size_t, size_t, int (*) (const void *, const void *));
+void nl_qsort_r (void *, size_t, size_t,
+		 int (*) (const void *, const void *, void *), void *);
+void nl_bsd_qsort_r (void *, size_t, size_t, void *,
+		     int (*) (void *, const void *, const void *));
+
+enum { RANDOM, SORTED, REVERSED, FEW, ORGAN, SAWTOOTH, MOSTLY, EQUAL,
+       NPATTERNS };
+static const char *const pattern_names[NPATTERNS] = {
+  "random", "sorted", "reversed", "few unique", "organ pipe", "sawtooth",
+  "mostly sorted", "all equal"
+};
+
+static int errors;
+static size_t cmp_size;
+static long ncmp;
+static int thunk_object;
+
+static int
+cmp_bytes (const void *a, const void *b)
+{
+  ncmp++;
+  return memcmp (a, b, cmp_size);
+}
+
+static int
+cmp_gnu (const void *a, const void *b, void *thunk)
+{
+  if (thunk != &thunk_object && errors++ < 20)
+    fprintf (stderr, "pdqsort: wrong thunk for qsort_r\n");
+  return cmp_bytes (a, b);
+}
+
+static int
+cmp_bsd (void *thunk, const void *a, const void *b)
+{
+  if (thunk != &thunk_object && errors++ < 20)
+    fprintf (stderr, "pdqsort: wrong thunk for __bsd_qsort_r\n");
+  return cmp_bytes (a, b);
+}
+
+static uint32_t
+key (int pattern, size_t i, size_t n)
+{
+  switch (pattern)
+    {
+    case SORTED:
+      return i;
+    case REVERSED:
+      return n - i;
+    case FEW:
+      return random () % 4;
+    case ORGAN:
+      return i < n / 2 ? i : n - i;
+    case SAWTOOTH:
+      return i % 37;
+    case MOSTLY:
+      return i % 50 == 49 ? random () : i;
+    case EQUAL:
+      return 7;
+    default:
+      return random ();
+    }
+}
+
+/* Fill N elements of size ES at A.  The first bytes hold a big endian key,
+   so that memcmp orders by it, and the rest are random, with only a few
+   distinct values. */
+static void
+fill (unsigned char *a, size_t n, size_t es, int pattern)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+      uint32_t k = key (pattern, i, n);
+      unsigned char *e = a + i * es;
+      size_t kb = es < 4 ? es : 4;
+
+      for (size_t j = 0; j < es; j++)
+	e[j] = j < kb ? k >> (8 * (kb - 1 - j)) : random () % 3;
+    }
+}
+
+static void
+check_one (size_t n, size_t es, size_t offset, int pattern)
+{
+  static unsigned char buf[3][100000 * 40 + 16];
+  unsigned char *ref = buf[0], *a = buf[1] + offset, *b = buf[2] + offset;
+
+  if (n * es + offset > sizeof buf[0])
+    return;
+  fill (ref, n, es, pattern);
+  memcpy (a, ref, n * es);
+  memcpy (b, ref, n * es);
+  cmp_size = es;
+  qsort (ref, n, es, cmp_bytes);
+
+  nl_qsort (a, n, es, cmp_bytes);
+  if (memcmp (a, ref, n * es) && errors++ < 20)
+    fprintf (stderr, "pdqsort: qsort %s n %zu size %zu offset %zu failed\n",
+	     pattern_names[pattern], n, es, offset);
+  if (n % 3 == 0)
+    {
+      nl_qsort_r (b, n, es, cmp_gnu, &thunk_object);
+      if (memcmp (b, ref, n * es) && errors++ < 20)
+	fprintf (stderr, "pdqsort: qsort_r %s n %zu size %zu failed\n",
+		 pattern_names[pattern], n, es);
+    }
+  else if (n % 3 == 1)
+    {
+      nl_bsd_qsort_r (b, n, es, &thunk_object, cmp_bsd);
+      if (memcmp (b, ref, n * es) && errors++ < 20)
+	fprintf (stderr, "pdqsort: __bsd_qsort_r %s n %zu size %zu failed\n",
+		 pattern_names[pattern], n, es);
+    }
+}
+
+static void
+check_sorting (void)
+{
+  static const size_t sizes[] = { 1, 2, 3, 4, 8, 12, 16, 24, 40 };
+  static const size_t counts[] = { 100, 128, 129, 200, 1000, 4096, 10000,
+				   100000 };
+
+  for (int p = 0; p < NPATTERNS; p++)
+    for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++)
+      {
+	size_t es = sizes[s];
+
+	for (size_t n = 0; n <= 70; n++)
+	  check_one (n, es, 0, p);
+	for (size_t c = 0; c < sizeof counts / sizeof *counts; c++)
+	  {
+	    check_one (counts[c], es, 0, p);
+	    if (es % 4 == 0)
+	      check_one (counts[c] / 10, es, 4, p);
+	    check_one (counts[c] / 10, es, 1, p);
+	  }
+      }
+}
+
+/* Comparison functions which are not a consistent order.  They all read
+   the elements, so that AddressSanitizer sees pointers past the ends. */
+static void
+touch (const void *a, const void *b)
+{
+  (void) *(const volatile unsigned char *) a;
+  (void) *(const volatile unsigned char *) b;
+}
+
+static int
+cmp_always_less (const void *a, const void *b)
+{
+  touch (a, b);
+  return -1;
+}
+
+static int
+cmp_always_greater (const void *a, const void *b)
+{
+  touch (a, b);
+  return 1;
+}
+
+static int
+cmp_random (const void *a, const void *b)
+{
+  touch (a, b);
+  return random () % 3 - 1;
+}
+
+/* Rock, paper, scissors on the first byte. */
+static int
+cmp_cyclic (const void *a, const void *b)
+{
+  int d = (*(const unsigned char *) a - *(const unsigned char *) b) % 3;
+
+  return d == 0 ? 0 : d == 1 || d == -2 ? 1 : -1;
+}
+
+static void
+check_inconsistent (void)
+{
+  static int (*const cmps[]) (const void *, const void *) = {
+    cmp_always_less, cmp_always_greater, cmp_random, cmp_cyclic
+  };
+  static const size_t sizes[] = { 1, 4, 8, 12, 40 };
+  static const size_t counts[] = { 2, 3, 24, 25, 100, 129, 1000, 10000,
+				   100000 };
+
+  for (size_t f = 0; f < sizeof cmps / sizeof *cmps; f++)
+    for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++)
+      for (size_t c = 0; c < sizeof counts / sizeof *counts; c++)
+	{
+	  size_t n = counts[c], es = sizes[s];
+	  /* Exactly the size of the array, for AddressSanitizer. */
+	  unsigned char *a = malloc (n * es), *ref = malloc (n * es);
+
+	  fill (ref, n, es, f % 2 ? RANDOM : SORTED);
+	  memcpy (a, ref, n * es);
+	  nl_qsort (a, n, es, cmps[f]);
+	  cmp_size = es;
+	  nl_qsort (a, n, es, cmp_bytes);
+	  nl_qsort (ref, n, es, cmp_bytes);
+	  if (memcmp (a, ref, n * es) && errors++ < 20)
+	    fprintf (stderr, "pdqsort: inconsistent comparison %zu n %zu "
+		     "size %zu lost elements\n", f, n, es);
+	  free (a);
+	  free (ref);
+	}
+}
+
+/* McIlroy, "A Killer Adversary for Quicksort".  The values are only
+   decided when the sort compares them, as badly as possible. */
+static int *val, gas, nsolid, candidate;
+
+static int
+cmp_adversary (const void *px, const void *py)
+{
+  int x = *(const int *) px, y = *(const int *) py;
+
+  ncmp++;
+  if (val[x] == gas && val[y] == gas)
+    val[x == candidate ? x : y] = nsolid++;
+  if (val[x] == gas)
+    candidate = x;
+  else if (val[y] == gas)
+    candidate = y;
+  return val[x] > val[y] ? 1 : val[x] < val[y] ? -1 : 0;
+}
+
+static int
+cmp_int (const void *a, const void *b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+
+  ncmp++;
+  return x > y ? 1 : x < y ? -1 : 0;
+}
+
+static void
+check_adversary (void)
+{
+  for (int n = 1000; n <= 1000000; n *= 10)
+    {
+      int *ptr = malloc (n * sizeof *ptr);
+      double bound = 4.0 * n * log2 (n);
+
+      val = malloc (n * sizeof *val);
+      gas = n;
+      nsolid = candidate = 0;
+      for (int i = 0; i < n; i++)
+	ptr[i] = i, val[i] = gas;
+      ncmp = 0;
+      nl_qsort (ptr, n, sizeof *ptr, cmp_adversary);
+      /* Now val is the killer input.  Sort it again. */
+      ncmp = 0;
+      nl_qsort (val, n, sizeof *val, cmp_int);
+      for (int i = 1; i < n; i++)
+	if (val[i - 1] > val[i] && errors++ < 20)
+	  fprintf (stderr, "pdqsort: killer input n %d not sorted\n", n);
+      if (ncmp > bound && errors++ < 20)
+	fprintf (stderr, "pdqsort: killer input n %d took %ld comparisons\n",
+		 n, ncmp);
+      printf ("killer input n %7d: %.2f n log2 n comparisons\n", n,
+	      ncmp / (n * log2 (n)));
+      free (ptr);
+      free (val);
+    }
+}
+
+static int
+cmp_u64 (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+  return x > y ? 1 : x < y ? -1 : 0;
+}
+
+static double
+time_sort (void (*sort) (void *, size_t, size_t,
+			 int (*) (const void *, const void *)),
+	   unsigned char *a, const unsigned char *orig, size_t n, size_t es,
+	   int (*cmp) (const void *, const void *))
+{
+  double start, best = 1e9;
+
+  for (int r = 0; r < 3; r++)
+    {
+      memcpy (a, orig, n * es);
+      start = now ();
+      sort (a, n, es, cmp);
+      if (now () - start < best)
+	best = now () - start;
+    }
+  return best * 1e9 / n;
+}
+
+static void
+benchmark (void)
+{
+  enum { N = 1000000 };
+  static const size_t sizes[] = { 4, 8, 16, 40 };
+  unsigned char *orig = malloc (N * 40), *a = malloc (N * 40);
+
+  printf ("ns/element, n = %d     newlib  host\n", N);
+  for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++)
+    for (int p = 0; p < NPATTERNS; p++)
+      {
+	size_t es = sizes[s];
+
+	if (p == SAWTOOTH || p == EQUAL)
+	  continue;
+	/* The key is an integer in the first 4 or 8 bytes. */
+	for (size_t i = 0; i < N; i++)
+	  {
+	    uint64_t k = key (p, i, N);
+
+	    memset (orig + i * es, 0, es);
+	    memcpy (orig + i * es, &k, es == 4 ? 4 : 8);
+	  }
+	printf ("%2zu bytes %-14s %6.1f %6.1f\n", es, pattern_names[p],
+		time_sort (nl_qsort, a, orig, N, es,
+			   es == 4 ? cmp_int : cmp_u64),
+		time_sort (qsort, a, orig, N, es,
+			   es == 4 ? cmp_int : cmp_u64));
+      }
+  free (orig);
+  free (a);
+}
+
+int
+main (int argc, char **argv)
+{
+  srandom (42);
+  check_sorting ();
+  check_adversary ();
+  check_inconsistent ();
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  if (argc > 1 && !strcmp (argv[1], "-n"))
+    return 0;
+  benchmark ();
+  return 0;
+}
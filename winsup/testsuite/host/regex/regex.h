@@ -0,0 +1,13 @@
+/* <regex.h> for the host build of Cygwin's regex functions: Cygwin's
+   declarations without the rest of newlib's headers, instead of the host's
+   own <regex.h>. */
+
+#include <sys/types.h>
+#include <stddef.h>
+
+/* Found with -idirafter, but not needed: */
+#define _ANSIDECL_H_		/* <_ansi.h> */
+#define _SYS__TYPES_H		/* <sys/_types.h> */
+#define _SIZE_T_DECLARED
+
+#include "../../../cygwin/include/regex.h"
@@ -0,0 +1,6 @@
+/* regcomp only wants to know whether the charset is UTF-8. */
+
+#include <langinfo.h>
+
+#define _CurrentRuneLocale \
+	(&(struct { const char *__encoding; }) { nl_langinfo (CODESET) })
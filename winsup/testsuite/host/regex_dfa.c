@@ -0,0 +1,493 @@
+/* regex_dfa.c: host test and benchmark for the lazy DFA of Cygwin's
+   regexec, winsup/cygwin/regex/engine.c, and for the literals it looks
+   for before it runs the matcher at all.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.  The regex functions are built twice, as dfa_*
+   and as nfa_* with -DNODFA -DNOLITS, which matches with fast() alone and
+   looks for no literals, as before.
+
+   Both must give the same results, including the subexpressions, for a
+   few patterns with known matches, which check the literals and prefix
+   regexec skips to, for a set of patterns typical for grep over a
+   synthetic log file, and for random patterns and strings made of a few
+   characters, which exercise the anchors, word boundaries and flags.  A
+   pattern with more DFA states than fit into the cache has to give the
+   same results too.  Unless -n is given, the time to run each of the log
+   patterns over every line of the log is compared, and what the literals
+   did is shown, see regstats() in regexec.c. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <regex.h>
+#include "timing.h"
+
+int dfa_regcomp (regex_t *, const char *, int);
+int dfa_regexec (const regex_t *, const char *, size_t, regmatch_t [], int);
+void dfa_regfree (regex_t *);
+int nfa_regcomp (regex_t *, const char *, int);
+int nfa_regexec (const regex_t *, const char *, size_t, regmatch_t [], int);
+void nfa_regfree (regex_t *);
+void dfa_regstats (const regex_t *, FILE *);
+
+/* regcomp needs these outside Cygwin, see collate.h */
+const int __collate_load_error = 1;
+
+int
+__collate_range_cmp (int c1, int c2)
+{
+  return c1 - c2;
+}
+
+#define NSUB 4
+
+static int errors;
+
+static const struct
+{
+  const char *pattern;
+  int cflags;
+} log_patterns[] = {
+  { "timeout", REG_EXTENDED },
+  { "error: .*timeout", REG_EXTENDED },
+  { "^2024-03-0[1-7] [0-9:.]+ \\[worker-[0-9]+\\] ERROR", REG_EXTENDED },
+  { "[0-9]+ms from 10\\.0\\.[0-9]+\\.[0-9]+$", REG_EXTENDED },
+  { "(GET|POST|PUT) /api/v[12]/[a-z]+/[0-9]+ 5[0-9][0-9]", REG_EXTENDED },
+  { "[[:<:]]cache[[:>:]].*[[:<:]]miss", REG_EXTENDED },
+  { "worker-(1[0-9]|2[0-3])\\] WARN", REG_EXTENDED },
+  { "connection reset", REG_EXTENDED | REG_ICASE },
+  { "[a-z]+_[a-z]+=[0-9]{4,}", REG_EXTENDED },
+  { "\\(worker-[0-9]*\\).*\\1", 0 },
+};
+
+#define NLOG_PATTERNS (sizeof log_patterns / sizeof *log_patterns)
+
+/* Matches of a literal prefix, which only the anchors around it can spoil */
+static const struct
+{
+  const char *pattern;
+  int cflags;
+  const char *string;
+  int so, eo;			/* -1 for no match */
+} known[] = {
+  { "abc", REG_EXTENDED, "xxabc", 2, 5 },
+  { "^abc", REG_EXTENDED, "xabc", -1, -1 },
+  { "^abc", REG_EXTENDED | REG_NEWLINE, "ab\nabc", 3, 6 },
+  { "[[:<:]]abc", REG_EXTENDED, "xabc", -1, -1 },
+  { "[[:<:]]abc", REG_EXTENDED, "xabc abc", 5, 8 },
+  { "(ab)+c", REG_EXTENDED, "xababc", 1, 6 },
+  { "ab$", REG_EXTENDED, "abab", 2, 4 },
+  { "timeout", REG_EXTENDED | REG_ICASE, "a TimeOut", 2, 9 },
+  { "x[yY]z", REG_EXTENDED, "xyz xYz", 0, 3 },
+  { "ab.*cd", REG_EXTENDED | REG_NEWLINE, "ab\ncd ab cd", 6, 11 },
+  { "a[^b]c", REG_EXTENDED | REG_NEWLINE, "a\nc abc adc", 8, 11 },
+  { "a.c", REG_EXTENDED, "ab\na\nc", 3, 6 },
+  { "(^|x)ok", REG_EXTENDED | REG_NEWLINE, "no\nok", 3, 5 },
+};
+
+#define NKNOWN (sizeof known / sizeof *known)
+
+/* A log file of about SIZE bytes, the same every time. */
+static char *
+make_log (size_t size)
+{
+  static const char *const levels[] = {
+    "INFO ", "INFO ", "INFO ", "INFO ", "DEBUG", "DEBUG", "WARN ", "ERROR"
+  };
+  static const char *const methods[] = { "GET", "GET", "POST", "PUT" };
+  static const char *const things[] = {
+    "items", "users", "orders", "carts", "sessions"
+  };
+  char *log = malloc (size + 256), *p = log;
+  unsigned n = 0;
+
+  while (p < log + size)
+    {
+      unsigned r = random ();
+
+      p += sprintf (p, "2024-03-%02u %02u:%02u:%02u.%03u [worker-%u] %s ",
+		    1 + n / 100000 % 28, n / 3600 % 24, n / 60 % 60, n % 60,
+		    r % 1000, r / 1000 % 24, levels[r / 24000 % 8]);
+      switch (r / 192000 % 8)
+	{
+	case 0:
+	case 1:
+	case 2:
+	  p += sprintf (p, "http: %s /api/v%u/%s/%u %u %ums from 10.0.%u.%u",
+			methods[r % 4], 1 + r % 2, things[r % 5], r % 100000,
+			r % 50 ? 200 : 500 + r % 4, r % 300, r % 8,
+			r % 200);
+	  break;
+	case 3:
+	  p += sprintf (p, "cache %s for key user_%u", r % 3 ? "hit" : "miss",
+			r % 10000);
+	  break;
+	case 4:
+	  p += sprintf (p, "db: query took %ums, rows=%u", r % 900, r % 20);
+	  break;
+	case 5:
+	  if (r % 16 == 0)
+	    p += sprintf (p, "error: upstream %u.%u timeout after %ums",
+			  r % 10, r % 7, r % 3000);
+	  else
+	    p += sprintf (p, "upstream %u.%u ok", r % 10, r % 7);
+	  break;
+	case 6:
+	  p += sprintf (p, "%s by peer, retry_count=%u",
+			r % 32 ? "closed" : "Connection RESET", r % 100000);
+	  break;
+	default:
+	  p += sprintf (p, "gc pause %uus heap %uMB", r % 5000, r % 4096);
+	  break;
+	}
+      *p++ = '\n';
+      n++;
+    }
+  *p = '\0';
+  return log;
+}
+
+static void
+compare (const char *what, const char *pattern, const char *string,
+	 int eflags, int rd, int rn, const regmatch_t *md,
+	 const regmatch_t *mn)
+{
+  int i;
+
+  if (rd != rn)
+    goto fail;
+  if (rd != 0)
+    return;
+  for (i = 0; i < NSUB; i++)
+    if (md[i].rm_so != mn[i].rm_so || md[i].rm_eo != mn[i].rm_eo)
+      goto fail;
+  return;
+
+fail:
+  if (errors++ < 20)
+    {
+      fprintf (stderr, "regex_dfa: %s: /%s/ eflags %d \"", what, pattern,
+	       eflags);
+      for (; *string; string++)
+	fprintf (stderr, *string == '\n' ? "\\n" : "%c", *string);
+      fprintf (stderr, "\": dfa %d", rd);
+      for (i = 0; rd == 0 && i < NSUB; i++)
+	fprintf (stderr, " %d-%d", (int) md[i].rm_so, (int) md[i].rm_eo);
+      fprintf (stderr, ", nfa %d", rn);
+      for (i = 0; rn == 0 && i < NSUB; i++)
+	fprintf (stderr, " %d-%d", (int) mn[i].rm_so, (int) mn[i].rm_eo);
+      fprintf (stderr, "\n");
+    }
+}
+
+/* Match STRING against both, with NSUB subexpressions, and with none. */
+static void
+check_one (const char *what, const char *pattern, regex_t *rd, regex_t *rn,
+	   const char *string, int eflags)
+{
+  regmatch_t md[NSUB], mn[NSUB];
+
+  compare (what, pattern, string, eflags,
+	   dfa_regexec (rd, string, NSUB, md, eflags),
+	   nfa_regexec (rn, string, NSUB, mn, eflags), md, mn);
+  compare (what, pattern, string, eflags,
+	   dfa_regexec (rd, string, 0, NULL, eflags),
+	   nfa_regexec (rn, string, 0, NULL, eflags), md, md);
+}
+
+static void
+check_known (void)
+{
+  regmatch_t md[NSUB];
+  regex_t rd, rn;
+  size_t i;
+
+  for (i = 0; i < NKNOWN; i++)
+    {
+      dfa_regcomp (&rd, known[i].pattern, known[i].cflags);
+      nfa_regcomp (&rn, known[i].pattern, known[i].cflags);
+      check_one ("known", known[i].pattern, &rd, &rn, known[i].string, 0);
+      if (dfa_regexec (&rd, known[i].string, NSUB, md, 0) != 0)
+	md[0].rm_so = md[0].rm_eo = -1;
+      if (md[0].rm_so != known[i].so || md[0].rm_eo != known[i].eo)
+	{
+	  fprintf (stderr, "regex_dfa: /%s/ \"%s\": %d-%d, expected %d-%d\n",
+		   known[i].pattern, known[i].string, (int) md[0].rm_so,
+		   (int) md[0].rm_eo, known[i].so, known[i].eo);
+	  errors++;
+	}
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+    }
+}
+
+/* Match every line of LOG, and then find all matches in LOG as a whole. */
+static void
+check_log (const char *pattern, int cflags, const char *log, size_t nlines)
+{
+  regex_t rd, rn;
+  regmatch_t md[NSUB], mn[NSUB];
+  const char *p, *q;
+  char line[256];
+  size_t i, len;
+  regoff_t so;
+  int r1, r2, eflags;
+
+  if (dfa_regcomp (&rd, pattern, cflags) || nfa_regcomp (&rn, pattern, cflags))
+    {
+      fprintf (stderr, "regex_dfa: /%s/ doesn't compile\n", pattern);
+      errors++;
+      return;
+    }
+  for (p = log, i = 0; i < nlines && *p; p = q + 1, i++)
+    {
+      q = strchr (p, '\n');
+      len = q - p;
+      if (len >= sizeof line)
+	len = sizeof line - 1;
+      memcpy (line, p, len);
+      line[len] = '\0';
+      check_one ("log line", pattern, &rd, &rn, line, 0);
+    }
+
+  dfa_regfree (&rd);
+  nfa_regfree (&rn);
+  if (dfa_regcomp (&rd, pattern, cflags | REG_NEWLINE)
+      || nfa_regcomp (&rn, pattern, cflags | REG_NEWLINE))
+    return;
+  /* The same lines in one go, REG_STARTEND saves a strlen per match */
+  eflags = REG_STARTEND;
+  for (so = 0; so < p - log; )
+    {
+      md[0].rm_so = mn[0].rm_so = so;
+      md[0].rm_eo = mn[0].rm_eo = p - log;
+      r1 = dfa_regexec (&rd, log, NSUB, md, eflags);
+      r2 = nfa_regexec (&rn, log, NSUB, mn, eflags);
+      compare ("whole log", pattern, "", eflags, r1, r2, md, mn);
+      if (r1 || r2 || errors)
+	break;
+      so = md[0].rm_eo > md[0].rm_so ? md[0].rm_eo : md[0].rm_so + 1;
+      eflags = REG_STARTEND | REG_NOTBOL;
+    }
+  dfa_regfree (&rd);
+  nfa_regfree (&rn);
+}
+
+/* A random ERE over a few characters, with all kinds of operators. */
+static void
+random_ere (char *buf, int depth)
+{
+  static const char *const atoms[] = {
+    "a", "b", "c", " ", "_", ".", "[ab]", "[^a ]", "^", "$", "[[:<:]]",
+    "[[:>:]]", "ab", "ba", "abc"
+  };
+  static const char *const ops[] = { "", "", "", "*", "+", "?", "{0,2}",
+				     "{1,3}", "{2}" };
+  int n = 1 + random () % 4, i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (depth < 3 && random () % 5 == 0)
+	{
+	  strcat (buf, "(");
+	  random_ere (buf, depth + 1);
+	  strcat (buf, ")");
+	}
+      else
+	strcat (buf, atoms[random () % (sizeof atoms / sizeof *atoms)]);
+      strcat (buf, ops[random () % (sizeof ops / sizeof *ops)]);
+    }
+  if (depth < 3 && random () % 6 == 0)
+    {
+      strcat (buf, "|");
+      random_ere (buf, depth + 1);
+    }
+}
+
+static void
+check_random (int n)
+{
+  static const char chars[] = "aabbc _\nA";
+  char pattern[1024], string[64];
+  regex_t rd, rn;
+  int i, j, k, len, cflags, eflags, e1, e2;
+
+  for (i = 0; i < n; i++)
+    {
+      pattern[0] = '\0';
+      random_ere (pattern, 0);
+      cflags = REG_EXTENDED;
+      if (random () % 3 == 0)
+	cflags |= REG_NEWLINE;
+      if (random () % 5 == 0)
+	cflags |= REG_ICASE;
+      e1 = dfa_regcomp (&rd, pattern, cflags);
+      e2 = nfa_regcomp (&rn, pattern, cflags);
+      if (e1 != e2)
+	{
+	  fprintf (stderr, "regex_dfa: /%s/ compiles differently\n", pattern);
+	  errors++;
+	}
+      if (e1 || e2)
+	{
+	  if (!e1)
+	    dfa_regfree (&rd);
+	  if (!e2)
+	    nfa_regfree (&rn);
+	  continue;
+	}
+      /* Many strings per pattern, so the DFA gets reused. */
+      for (j = 0; j < 50; j++)
+	{
+	  len = random () % (sizeof string);
+	  for (k = 0; k < len; k++)
+	    string[k] = chars[random () % (sizeof chars - 1)];
+	  string[len] = '\0';
+	  eflags = random () % 4;	/* REG_NOTBOL, REG_NOTEOL */
+	  check_one ("random", pattern, &rd, &rn, string, eflags);
+	}
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+    }
+}
+
+/* (a|b)*a(a|b){12} needs 2^13 DFA states, which don't fit. */
+static void
+check_many_states (void)
+{
+  const char *pattern = "(a|b)*a(a|b){12}c";
+  char *string = malloc (200001);
+  regex_t rd, rn;
+  int i, j;
+
+  dfa_regcomp (&rd, pattern, REG_EXTENDED);
+  nfa_regcomp (&rn, pattern, REG_EXTENDED);
+  for (i = 0; i < 4; i++)
+    {
+      for (j = 0; j < 200000; j++)
+	string[j] = "ab"[random () % 2];
+      string[200000] = '\0';
+      if (i % 2)
+	string[100000 + i] = 'c';
+      check_one ("many states", pattern, &rd, &rn, string, 0);
+    }
+  dfa_regfree (&rd);
+  nfa_regfree (&rn);
+  free (string);
+}
+
+/* Seconds to match every line of LOG with nmatch 0, like grep does */
+static double
+time_grep (int (*exec) (const regex_t *, const char *, size_t, regmatch_t [],
+			int), const regex_t *re, char *log, int *nmatches)
+{
+  double start = now ();
+  char *p, *q;
+
+  *nmatches = 0;
+  for (p = log; *p; p = q + 1)
+    {
+      q = strchr (p, '\n');
+      *q = '\0';
+      if (exec (re, p, 0, NULL, 0) == 0)
+	++*nmatches;
+      *q = '\n';
+    }
+  return now () - start;
+}
+
+/* Seconds to find every match in LOG as a whole, with REG_NEWLINE */
+static double
+time_buffer (int (*exec) (const regex_t *, const char *, size_t,
+			  regmatch_t [], int), const regex_t *re,
+	     const char *log, int *nmatches)
+{
+  double start = now ();
+  regoff_t so = 0, size = strlen (log);
+  regmatch_t m;
+  int eflags = REG_STARTEND;
+
+  *nmatches = 0;
+  while (so < size)
+    {
+      m.rm_so = so;
+      m.rm_eo = size;
+      if (exec (re, log, 1, &m, eflags) != 0)
+	break;
+      ++*nmatches;
+      so = m.rm_eo > m.rm_so ? m.rm_eo : m.rm_so + 1;
+      eflags = REG_STARTEND | REG_NOTBOL;
+    }
+  return now () - start;
+}
+
+static void
+benchmark (char *log)
+{
+  size_t size = strlen (log), i;
+  regex_t rd, rn, bd, bn;
+  double td, tn, tbd, tbn;
+  int md, mn, mbd, mbn;
+
+  printf ("MB/s over %zu MB of log           lines: dfa     nfa   buffer: "
+	  "dfa     nfa\n", size >> 20);
+  for (i = 0; i < NLOG_PATTERNS; i++)
+    {
+      dfa_regcomp (&rd, log_patterns[i].pattern, log_patterns[i].cflags);
+      nfa_regcomp (&rn, log_patterns[i].pattern, log_patterns[i].cflags);
+      dfa_regcomp (&bd, log_patterns[i].pattern,
+		   log_patterns[i].cflags | REG_NEWLINE);
+      nfa_regcomp (&bn, log_patterns[i].pattern,
+		   log_patterns[i].cflags | REG_NEWLINE);
+      td = time_grep (dfa_regexec, &rd, log, &md);
+      tn = time_grep (nfa_regexec, &rn, log, &mn);
+      tbd = time_buffer (dfa_regexec, &bd, log, &mbd);
+      tbn = time_buffer (nfa_regexec, &bn, log, &mbn);
+      if (md != mn || mbd != mbn)
+	{
+	  fprintf (stderr, "regex_dfa: /%s/: %d and %d matches with dfa, "
+		   "%d and %d with nfa\n", log_patterns[i].pattern, md, mbd,
+		   mn, mbn);
+	  errors++;
+	}
+      printf ("%-36.36s %11.1f %7.1f %14.1f %7.1f\n",
+	      log_patterns[i].pattern, size / td / 1e6, size / tn / 1e6,
+	      size / tbd / 1e6, size / tbn / 1e6);
+      printf ("  lines:  ");
+      dfa_regstats (&rd, stdout);
+      printf ("  buffer: ");
+      dfa_regstats (&bd, stdout);
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+      dfa_regfree (&bd);
+      nfa_regfree (&bn);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  char *log;
+  size_t i;
+
+  setlocale (LC_ALL, "C");
+  srandom (42);
+  log = make_log (8 << 20);
+  check_known ();
+  for (i = 0; i < NLOG_PATTERNS; i++)
+    check_log (log_patterns[i].pattern, log_patterns[i].cflags, log, 20000);
+  check_random (5000);
+  check_many_states ();
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  if (argc < 2 || strcmp (argv[1], "-n"))
+    benchmark (log);
+  free (log);
+  return errors != 0;
+}
@@ -0,0 +1,433 @@
+/* regex_utf8.c: host test and benchmark for Cygwin's regexec in a UTF-8
+   locale, where the lazy DFA of winsup/cygwin/regex/engine.c reads the
+   string byte by byte instead of decoding each character with mbrtowc.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.  It uses the same dfa_* and nfa_* builds of the
+   regex functions as regex_dfa, and the nfa_* ones still decode every
+   character as they go.
+
+   Both must give the same results, including the subexpressions, for a
+   few patterns with known matches, for random patterns made of one to
+   four byte characters, bracket expressions and classes, matched against
+   random strings of those characters mixed with bad and cut off
+   sequences, and for a pattern with more DFA states than fit into the
+   cache.  Unless -n is given, the time to run a few patterns over every
+   line of a log file in several languages is compared. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <regex.h>
+#include "timing.h"
+
+int dfa_regcomp (regex_t *, const char *, int);
+int dfa_regexec (const regex_t *, const char *, size_t, regmatch_t [], int);
+void dfa_regfree (regex_t *);
+int nfa_regcomp (regex_t *, const char *, int);
+int nfa_regexec (const regex_t *, const char *, size_t, regmatch_t [], int);
+void nfa_regfree (regex_t *);
+
+/* regcomp needs these outside Cygwin, see collate.h */
+const int __collate_load_error = 1;
+
+int
+__collate_range_cmp (int c1, int c2)
+{
+  return c1 - c2;
+}
+
+#define NSUB 4
+
+static int errors;
+
+static const struct
+{
+  const char *pattern;
+  int cflags;
+  const char *string;
+  int so, eo;			/* -1 for no match */
+} known[] = {
+  { "é+", REG_EXTENDED, "caféé!", 3, 7 },
+  { "[à-ÿ]+", REG_EXTENDED, "naïve", 2, 4 },
+  { "[[:alpha:]]+", REG_EXTENDED, "12 αβγ 3", 3, 9 },
+  { "ΣΟΦΙΑ", REG_EXTENDED | REG_ICASE, "η σοφια", 3, 13 },
+  { "[^a]", REG_EXTENDED, "é", 0, 2 },
+  { "a.b", REG_EXTENDED, "a€b", 0, 5 },
+  { "x.y", REG_EXTENDED, "x😀y", 0, 6 },
+  { "a.b", REG_EXTENDED, "a\xc3" "b", -1, -1 },
+  { "a.*b", REG_EXTENDED, "a\xe2\x82" "b", -1, -1 },
+  { "b$", REG_EXTENDED, "ab\xe2\x82", -1, -1 },
+  { "[[:<:]]bc", REG_EXTENDED, "ébc", -1, -1 },
+  { "[[:<:]]bc", REG_EXTENDED, "€bc", 3, 5 },
+  { "é$", REG_EXTENDED | REG_NEWLINE, "é\nx", 0, 2 },
+  { "^b", REG_EXTENDED | REG_NEWLINE, "\xc3\nb", 2, 3 },
+};
+
+#define NKNOWN (sizeof known / sizeof *known)
+
+static void
+compare (const char *what, const char *pattern, const char *string,
+	 int eflags, int rd, int rn, const regmatch_t *md,
+	 const regmatch_t *mn)
+{
+  int i;
+
+  if (rd != rn)
+    goto fail;
+  if (rd != 0)
+    return;
+  for (i = 0; i < NSUB; i++)
+    if (md[i].rm_so != mn[i].rm_so || md[i].rm_eo != mn[i].rm_eo)
+      goto fail;
+  return;
+
+fail:
+  if (errors++ < 20)
+    {
+      fprintf (stderr, "regex_utf8: %s: /%s/ eflags %d \"", what, pattern,
+	       eflags);
+      for (; *string; string++)
+	fprintf (stderr, *string == '\n' ? "\\n"
+		 : (unsigned char) *string >= 0x80 ? "\\x%02x" : "%c",
+		 (unsigned char) *string);
+      fprintf (stderr, "\": dfa %d", rd);
+      for (i = 0; rd == 0 && i < NSUB; i++)
+	fprintf (stderr, " %d-%d", (int) md[i].rm_so, (int) md[i].rm_eo);
+      fprintf (stderr, ", nfa %d", rn);
+      for (i = 0; rn == 0 && i < NSUB; i++)
+	fprintf (stderr, " %d-%d", (int) mn[i].rm_so, (int) mn[i].rm_eo);
+      fprintf (stderr, "\n");
+    }
+}
+
+/* Match STRING from byte SO on against both, with NSUB subexpressions, and
+   with none. */
+static void
+check_one (const char *what, const char *pattern, regex_t *rd, regex_t *rn,
+	   const char *string, int so, int eflags)
+{
+  regmatch_t md[NSUB], mn[NSUB], m0;
+
+  if (so > 0)
+    eflags |= REG_STARTEND;
+  md[0].rm_so = mn[0].rm_so = m0.rm_so = so;
+  md[0].rm_eo = mn[0].rm_eo = m0.rm_eo = strlen (string);
+  compare (what, pattern, string, eflags,
+	   dfa_regexec (rd, string, NSUB, md, eflags),
+	   nfa_regexec (rn, string, NSUB, mn, eflags), md, mn);
+  compare (what, pattern, string, eflags,
+	   dfa_regexec (rd, string, 0, &m0, eflags),
+	   nfa_regexec (rn, string, 0, &m0, eflags), md, md);
+}
+
+static void
+check_known (void)
+{
+  regmatch_t md[NSUB];
+  regex_t rd, rn;
+  size_t i;
+
+  for (i = 0; i < NKNOWN; i++)
+    {
+      dfa_regcomp (&rd, known[i].pattern, known[i].cflags);
+      nfa_regcomp (&rn, known[i].pattern, known[i].cflags);
+      check_one ("known", known[i].pattern, &rd, &rn, known[i].string, 0, 0);
+      if (dfa_regexec (&rd, known[i].string, NSUB, md, 0) != 0)
+	md[0].rm_so = md[0].rm_eo = -1;
+      if (md[0].rm_so != known[i].so || md[0].rm_eo != known[i].eo)
+	{
+	  fprintf (stderr, "regex_utf8: /%s/ \"%s\": %d-%d, expected %d-%d\n",
+		   known[i].pattern, known[i].string, (int) md[0].rm_so,
+		   (int) md[0].rm_eo, known[i].so, known[i].eo);
+	  errors++;
+	}
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+    }
+}
+
+/* A random ERE over a few characters of each length. */
+static void
+random_ere (char *buf, int depth)
+{
+  static const char *const atoms[] = {
+    "a", "b", "é", "€", "😀", ".", "[aé]", "[^é]", "[^a€]", "[à-ÿ]",
+    "[€-😀]", "[[:alpha:]]", "[[:upper:]]", "[[:<:]]", "[[:>:]]", "^", "$",
+    "é€", "aé", "😀b"
+  };
+  static const char *const ops[] = { "", "", "", "*", "+", "?", "{0,2}",
+				     "{1,3}" };
+  int n = 1 + random () % 4, i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (depth < 3 && random () % 5 == 0)
+	{
+	  strcat (buf, "(");
+	  random_ere (buf, depth + 1);
+	  strcat (buf, ")");
+	}
+      else
+	strcat (buf, atoms[random () % (sizeof atoms / sizeof *atoms)]);
+      strcat (buf, ops[random () % (sizeof ops / sizeof *ops)]);
+    }
+  if (depth < 3 && random () % 6 == 0)
+    {
+      strcat (buf, "|");
+      random_ere (buf, depth + 1);
+    }
+}
+
+static void
+check_random (int n)
+{
+  /* mostly characters, and bytes which don't make one */
+  static const char *const pieces[] = {
+    "a", "a", "b", "é", "é", "É", "€", "😀", " ", "\n", "\xc3", "\xa9",
+    "\xe2\x82", "\xf0\x9f\x98", "\xff"
+  };
+  char pattern[1024], string[128];
+  regex_t rd, rn;
+  int i, j, k, len, cflags, eflags, e1, e2;
+
+  for (i = 0; i < n; i++)
+    {
+      pattern[0] = '\0';
+      random_ere (pattern, 0);
+      cflags = REG_EXTENDED;
+      if (random () % 3 == 0)
+	cflags |= REG_NEWLINE;
+      if (random () % 5 == 0)
+	cflags |= REG_ICASE;
+      e1 = dfa_regcomp (&rd, pattern, cflags);
+      e2 = nfa_regcomp (&rn, pattern, cflags);
+      if (e1 != e2)
+	{
+	  fprintf (stderr, "regex_utf8: /%s/ compiles differently\n", pattern);
+	  errors++;
+	}
+      if (e1 || e2)
+	{
+	  if (!e1)
+	    dfa_regfree (&rd);
+	  if (!e2)
+	    nfa_regfree (&rn);
+	  continue;
+	}
+      /* Many strings per pattern, so the DFA gets reused. */
+      for (j = 0; j < 50; j++)
+	{
+	  len = random () % 24;
+	  string[0] = '\0';
+	  for (k = 0; k < len; k++)
+	    strcat (string, pieces[random () % (sizeof pieces / sizeof *pieces)]);
+	  eflags = random () % 4;	/* REG_NOTBOL, REG_NOTEOL */
+	  /* sometimes start partway, even inside a character */
+	  k = (random () % 4 == 0 && *string) ? random () % strlen (string) : 0;
+	  check_one ("random", pattern, &rd, &rn, string, k, eflags);
+	}
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+    }
+}
+
+/* (a|é)*a(a|é){12} needs 2^13 DFA states, and then some for the bytes of
+   é, which don't fit. */
+static void
+check_many_states (void)
+{
+  const char *pattern = "(a|é)*a(a|é){12}c";
+  char *string = malloc (200001);
+  regex_t rd, rn;
+  int i, j;
+
+  dfa_regcomp (&rd, pattern, REG_EXTENDED);
+  nfa_regcomp (&rn, pattern, REG_EXTENDED);
+  for (i = 0; i < 4; i++)
+    {
+      for (j = 0; j < 200000; )
+	if (random () % 2)
+	  string[j++] = 'a';
+	else if (j < 199999)
+	  {
+	    string[j++] = '\xc3';
+	    string[j++] = '\xa9';
+	  }
+      string[j] = '\0';
+      if (i % 2)
+	string[100000 + i] = 'c';
+      check_one ("many states", pattern, &rd, &rn, string, 0, 0);
+    }
+  dfa_regfree (&rd);
+  nfa_regfree (&rn);
+  free (string);
+}
+
+static const struct
+{
+  const char *pattern;
+  int cflags;
+} log_patterns[] = {
+  { "ошибка", REG_EXTENDED },
+  { "тайм-аут|timeout", REG_EXTENDED },
+  { "ОШИБКА", REG_EXTENDED | REG_ICASE },
+  { "^2024-03-0[1-7] .*連線", REG_EXTENDED },
+  { "[[:upper:]][[:lower:]]+ [0-9]+ ms", REG_EXTENDED },
+  { "[a-z]+[à-ÿ] [a-z]+", REG_EXTENDED },
+  { "[^ -~]+ [0-9]+$", REG_EXTENDED },
+  { "σύνδεσ[ηε]", REG_EXTENDED },
+};
+
+#define NLOG_PATTERNS (sizeof log_patterns / sizeof *log_patterns)
+
+/* A log file of about SIZE bytes in a few languages, the same every time. */
+static char *
+make_log (size_t size)
+{
+  static const char *const levels[] = {
+    "INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR"
+  };
+  static const char *const messages[] = {
+    "utilisateur connecté depuis %u.%u, requête traitée en %u ms",
+    "Benutzer angemeldet, Größe %u KB, Dauer %u ms %u",
+    "запрос обработан за %u мс, пользователь %u, сессия %u",
+    "ошибка: тайм-аут соединения после %u мс (%u/%u)",
+    "σύνδεση με τον διακομιστή %u απέτυχε μετά από %u ms %u",
+    "已處理請求 %u 次，耗時 %u 毫秒 %u",
+    "連線逾時 %u 毫秒後中斷 %u %u",
+    "cache miss for key user_%u after %u ms %u",
+  };
+  char *log = malloc (size + 256), *p = log;
+  unsigned n = 0;
+
+  while (p < log + size)
+    {
+      unsigned r = random ();
+
+      p += sprintf (p, "2024-03-%02u %02u:%02u:%02u [worker-%u] %s ",
+		    1 + n / 100000 % 28, n / 3600 % 24, n / 60 % 60, n % 60,
+		    r % 24, levels[r / 24 % 6]);
+      p += sprintf (p, messages[r / 144 % 8], r % 1000, r / 1000 % 500,
+		    r % 97);
+      *p++ = '\n';
+      n++;
+    }
+  *p = '\0';
+  return log;
+}
+
+/* Match every line of LOG against both, and return the seconds each took
+   with nmatch 0, like grep does. */
+static void
+time_grep (const char *pattern, const regex_t *rd, const regex_t *rn,
+	   char *log, double *td, double *tn)
+{
+  double start;
+  char *p, *q;
+  int md = 0, mn = 0;
+
+  start = now ();
+  for (p = log; *p; p = q + 1)
+    {
+      q = strchr (p, '\n');
+      *q = '\0';
+      md += dfa_regexec (rd, p, 0, NULL, 0) == 0;
+      *q = '\n';
+    }
+  *td = now () - start;
+  start = now ();
+  for (p = log; *p; p = q + 1)
+    {
+      q = strchr (p, '\n');
+      *q = '\0';
+      mn += nfa_regexec (rn, p, 0, NULL, 0) == 0;
+      *q = '\n';
+    }
+  *tn = now () - start;
+  if (md != mn || md == 0)
+    {
+      fprintf (stderr, "regex_utf8: /%s/: %d matching lines with dfa, %d "
+	       "with nfa\n", pattern, md, mn);
+      errors++;
+    }
+}
+
+static void
+benchmark (char *log)
+{
+  size_t size = strlen (log), i;
+  regex_t rd, rn;
+  double td, tn;
+  const char *p;
+  int width;
+
+  printf ("MB/s over %zu MB of UTF-8 log lines     dfa     nfa\n",
+	  size >> 20);
+  for (i = 0; i < NLOG_PATTERNS; i++)
+    {
+      dfa_regcomp (&rd, log_patterns[i].pattern, log_patterns[i].cflags);
+      nfa_regcomp (&rn, log_patterns[i].pattern, log_patterns[i].cflags);
+      time_grep (log_patterns[i].pattern, &rd, &rn, log, &td, &tn);
+      /* pad to 36 characters, not bytes */
+      for (p = log_patterns[i].pattern, width = 36; *p; p++)
+	width += (*p & 0xc0) == 0x80;
+      printf ("%-*s %7.1f %7.1f\n", width, log_patterns[i].pattern,
+	      size / td / 1e6, size / tn / 1e6);
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  char *log;
+  char line[1024];
+  regex_t rd, rn;
+  size_t size, i;
+  int j;
+
+  if (!setlocale (LC_ALL, "C.UTF-8") && !setlocale (LC_ALL, "en_US.UTF-8"))
+    {
+      puts ("regex_utf8: no UTF-8 locale, SKIP test");
+      return 0;
+    }
+  srandom (42);
+  check_known ();
+  check_random (5000);
+  check_many_states ();
+
+  /* the log lines, with and without subexpressions */
+  log = make_log (8 << 20);
+  size = strlen (log);
+  for (i = 0; i < NLOG_PATTERNS; i++)
+    {
+      dfa_regcomp (&rd, log_patterns[i].pattern, log_patterns[i].cflags);
+      nfa_regcomp (&rn, log_patterns[i].pattern, log_patterns[i].cflags);
+      for (j = 0; j < 2000; j++)
+	{
+	  const char *p = log + random () % (size / 2);
+
+	  p = strchr (p, '\n') + 1;
+	  snprintf (line, sizeof line, "%.*s", (int) (strchr (p, '\n') - p),
+		    p);
+	  check_one ("log line", log_patterns[i].pattern, &rd, &rn, line, 0,
+		     0);
+	}
+      dfa_regfree (&rd);
+      nfa_regfree (&rn);
+    }
+
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  if (argc < 2 || strcmp (argv[1], "-n"))
+    benchmark (log);
+  free (log);
+  return errors != 0;
+}
@@ -0,0 +1,5 @@
+/* <search.h> for the host build of newlib's hsearch_r and tsearch: newlib's
+   struct hsearch_data and node_t instead of the host's.  The functions are
+   renamed to nl_* on the command line, see Makefile. */
+
+#include "../../../../newlib/libc/include/search.h"
@@ -0,0 +1,354 @@
+/* strtod_fast.c: host test and benchmark for the Eisel-Lemire fast path
+   of newlib's strtod, newlib/libc/stdlib/strtod_fast.h.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.
+
+   The fast path is differential tested against the host's strtod, which
+   like the exact algorithm in newlib's strtod.c is correctly rounded.
+   Whenever the fast path claims a result, it must be the same double.
+   The inputs are random doubles printed with various precisions, random
+   digit strings with random exponents, exact and nearly exact halfway
+   points between doubles, and the usual hard cases.  The decimal point is
+   a two byte character for some of them, as in some locales.  Then the
+   throughput for typical CSV data is measured, unless -n is given. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include "timing.h"
+
+#include "strtod_fast.h"
+
+static int errors;
+static long tried, fast;
+
+/* Split the decimal number STR like strtod.c does: ND significant digits
+   at *S0 with the decimal point DP after the first *ND0 of them, times
+   10^*E.  Return ND, 0 if STR is zero. */
+static int
+split (const char *str, const char *dp, const char **s0, int *nd0, int *e)
+{
+  const char *s = str;
+  int nd = 0, nf = 0, nz = 0, dec_len = strlen (dp);
+
+  while (*s == '0')
+    s++;
+  *s0 = s;
+  for (; *s >= '0' && *s <= '9'; s++)
+    nd++;
+  *nd0 = nd;
+  if (!strncmp (s, dp, dec_len))
+    {
+      s += dec_len;
+      if (!nd)
+	{
+	  for (; *s == '0'; s++)
+	    nz++;
+	  *s0 = s;
+	  nf = nz;
+	  nz = 0;
+	}
+      for (; *s >= '0' && *s <= '9'; s++)
+	{
+	  nz++;
+	  if (*s != '0')
+	    {
+	      nf += nz;
+	      nd += nz;
+	      nz = 0;
+	    }
+	}
+    }
+  *e = (*s == 'e' || *s == 'E') ? atoi (s + 1) : 0;
+  *e -= nf;
+  if (!*nd0)
+    *nd0 = nd;
+  return nd;
+}
+
+static double
+bits2d (uint64_t bits)
+{
+  double d;
+
+  memcpy (&d, &bits, sizeof d);
+  return d;
+}
+
+/* Check the fast path for STR, a number using '.' as decimal point, and
+   with the decimal point DP instead. */
+static void
+check_dp (const char *str, const char *dp)
+{
+  char buf[1024];
+  const char *s0;
+  int nd, nd0, e;
+  uint64_t bits;
+  double ref = strtod (str, NULL);
+
+  snprintf (buf, sizeof buf, "%.*s%s%s", (int) strcspn (str, "."), str, dp,
+	    strchr (str, '.') ? strchr (str, '.') + 1 : "");
+  if (!strchr (str, '.'))
+    strcpy (buf, str);
+  nd = split (buf, dp, &s0, &nd0, &e);
+  if (!nd)
+    return;
+  tried++;
+  if (!_strtod_fast (s0, nd0, nd, strlen (dp), e, &bits))
+    return;
+  fast++;
+  if (bits2d (bits) != ref && errors++ < 20)
+    fprintf (stderr, "strtod_fast: %s: %a instead of %a\n", buf,
+	     bits2d (bits), ref);
+}
+
+static void
+check (const char *str)
+{
+  check_dp (str, ".");
+  /* U+00B7, MIDDLE DOT in UTF-8. */
+  if (tried % 16 == 0)
+    check_dp (str, "\xc2\xb7");
+}
+
+static uint64_t
+rand64 (void)
+{
+  return (uint64_t) random () << 42 ^ (uint64_t) random () << 21 ^ random ();
+}
+
+static double
+random_double (void)
+{
+  double d;
+
+  do
+    {
+      uint64_t bits = rand64 () & ~((uint64_t) 1 << 63);
+      d = bits2d (bits);
+    }
+  while (!isfinite (d));
+  return d;
+}
+
+/* Random doubles, printed with all precisions. */
+static void
+check_doubles (void)
+{
+  char buf[64];
+
+  for (int i = 0; i < 200000; i++)
+    {
+      double d = random_double ();
+
+      snprintf (buf, sizeof buf, "%.*e", i % 20, d);
+      check (buf);
+      snprintf (buf, sizeof buf, "%.17g", d);
+      check (buf);
+      /* Something more CSV like. */
+      d = (double) (rand64 () % 100000000) / 1000;
+      snprintf (buf, sizeof buf, "%.3f", d);
+      check (buf);
+    }
+}
+
+/* Random digit strings with random exponents. */
+static void
+check_digits (void)
+{
+  char buf[128];
+
+  for (int i = 0; i < 500000; i++)
+    {
+      int nd = random () % 25 + 1, dot = random () % (nd + 1), n = 0;
+
+      for (int j = 0; j < nd; j++)
+	{
+	  if (j == dot)
+	    buf[n++] = '.';
+	  buf[n++] = '0' + random () % 10;
+	}
+      sprintf (buf + n, "e%d", (int) (random () % 700) - 360);
+      check (buf);
+    }
+}
+
+/* Strip trailing zeros from the mantissa of the %e number in BUF. */
+static void
+strip (char *buf)
+{
+  char *e = strchr (buf, 'e'), *p = e;
+
+  while (p[-1] == '0')
+    p--;
+  memmove (p, e, strlen (e) + 1);
+}
+
+/* Exact halfway points between two doubles, and numbers just above and
+   below them.  The midpoints are exact long doubles on x86. */
+static void
+check_halfway (void)
+{
+  static char buf[1024];
+
+  for (int i = 0; i < 20000; i++)
+    {
+      double d = random_double ();
+      long double mid = ((long double) d + nextafter (d, INFINITY)) / 2;
+      char *e;
+
+      if (mid == d)
+	continue;
+      snprintf (buf, sizeof buf, "%.800Le", mid);
+      strip (buf);
+      check (buf);
+      /* Truncated to 19 and 25 digits, and one more in the last place. */
+      for (int n = 20; n <= 26; n += 6)
+	{
+	  e = strchr (buf, 'e');
+	  if (e - buf > n)
+	    {
+	      memmove (buf + n, e, strlen (e) + 1);
+	      check (buf);
+	      buf[n - 1] = buf[n - 1] == '9' ? '8' : buf[n - 1] + 1;
+	      check (buf);
+	    }
+	}
+    }
+
+  /* Halfway points which are integers of at most 19 digits: the round to
+     even case of the fast path. */
+  for (int i = 0; i < 100000; i++)
+    {
+      int k = random () % 11;
+      uint64_t m = (rand64 () | (uint64_t) 1 << 52) & (((uint64_t) 1 << 53) - 1);
+      uint64_t n = (2 * m + 1) << k;
+
+      if (n >= UINT64_C (10000000000000000000))
+	continue;
+      snprintf (buf, sizeof buf, "%llu", (unsigned long long) n);
+      check (buf);
+      snprintf (buf, sizeof buf, "%llu", (unsigned long long) n + 1);
+      check (buf);
+      snprintf (buf, sizeof buf, "%llu", (unsigned long long) n - 1);
+      check (buf);
+    }
+}
+
+static void
+check_hard (void)
+{
+  static const char *const hard[] = {
+    "0.1", "0.2", "0.3", "1", "1e23", "8.5", "9007199254740992",
+    "9007199254740993", "9007199254740995", "18014398509481993",
+    "7.3177701707893310e+15", "2.2250738585072011e-308",
+    "2.2250738585072012e-308", "2.2250738585072014e-308",
+    "4.9406564584124654e-324", "2.4703282292062327e-324",
+    "2.4703282292062328e-324", "1.7976931348623157e308",
+    "1.7976931348623158e308", "1.7976931348623159e308", "1e308", "1e309",
+    "1e-324", "1e-400", "1e400", "7.038531e-26",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "9.007199254740993e15", "123456789012345678901234567890",
+    "0.000000000000000000000000000000000000000000001",
+    "3.141592653589793238462643383279502884197169399375105820974944",
+    "5e-324", "1448997445238699", "1.8446744073709551615e19",
+    "18446744073709551615", "18446744073709551616", "9999999999999999999",
+    "10000000000000000000", "0.9999999999999999999999999999",
+    "4.4501477170144023e-308", "2.22507385850720113605740979670913197593"
+    "481954635164564e-308",
+  };
+
+  for (unsigned i = 0; i < sizeof hard / sizeof *hard; i++)
+    check (hard[i]);
+}
+
+/* Parse a column of typical CSV numbers with the host's strtod and with
+   the fast path, falling back to the host's strtod. */
+static void
+benchmark (void)
+{
+  enum { N = 1000000 };
+  static char buf[N][32];
+  volatile double sink = 0;
+  double start, t_ref, t_fast;
+  long fallback = 0;
+  size_t bytes = 0;
+
+  for (int i = 0; i < N; i++)
+    switch (i % 4)
+      {
+      case 0:
+	snprintf (buf[i], sizeof buf[i], "%.3f",
+		  (double) (rand64 () % 100000000) / 1000);
+	break;
+      case 1:
+	snprintf (buf[i], sizeof buf[i], "%.17g", random_double ());
+	break;
+      case 2:
+	snprintf (buf[i], sizeof buf[i], "%.6g",
+		  (double) rand64 () / 1e15);
+	break;
+      default:
+	snprintf (buf[i], sizeof buf[i], "%.15g",
+		  (double) random () / 3.0e5);
+	break;
+      }
+  for (int i = 0; i < N; i++)
+    bytes += strlen (buf[i]);
+
+  start = now ();
+  for (int i = 0; i < N; i++)
+    sink += strtod (buf[i], NULL);
+  t_ref = now () - start;
+
+  start = now ();
+  for (int i = 0; i < N; i++)
+    {
+      const char *s0;
+      int nd, nd0, e;
+      uint64_t bits;
+
+      nd = split (buf[i], ".", &s0, &nd0, &e);
+      if (nd && _strtod_fast (s0, nd0, nd, 1, e, &bits))
+	sink += bits2d (bits);
+      else
+	{
+	  fallback++;
+	  sink += strtod (buf[i], NULL);
+	}
+    }
+  t_fast = now () - start;
+
+  printf ("host strtod: %6.1f ns/number, %6.1f MB/s\n", t_ref * 1e9 / N,
+	  bytes / t_ref / 1e6);
+  printf ("fast path:   %6.1f ns/number, %6.1f MB/s, %.3f%% fallbacks\n",
+	  t_fast * 1e9 / N, bytes / t_fast / 1e6, fallback * 100.0 / N);
+}
+
+int
+main (int argc, char **argv)
+{
+  srandom (42);
+  check_hard ();
+  check_doubles ();
+  check_digits ();
+  check_halfway ();
+  printf ("%ld numbers, %.2f%% by the fast path\n", tried,
+	  fast * 100.0 / tried);
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  if (argc > 1 && !strcmp (argv[1], "-n"))
+    return 0;
+  benchmark ();
+  return 0;
+}
@@ -0,0 +1,21 @@
+/* timing.h: the clock for the benchmarks of the host tests.
+
+   The host tests print their timings for comparison only, nothing checks
+   them, so they share this instead of each having a copy. */
+
+#ifndef HOST_TIMING_H
+#define HOST_TIMING_H
+
+#include <time.h>
+
+/* Seconds since some fixed point in the past. */
+static inline double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif /* HOST_TIMING_H */
@@ -0,0 +1,108 @@
+/* tsearch_avl.c: host test and benchmark for newlib's tsearch, tfind and
+   tdelete, newlib/libc/search/tsearch.c, tfind.c and tdelete.c.
+
+   This doesn't need Cygwin.  Build and run it on any host with `make
+   check', see Makefile.
+
+   1M keys are inserted in sorted and in random order, which must leave a
+   tree no higher than an AVL tree may be, every key must be found, and
+   deleting all of them must leave an empty tree.  Unless -n is given, the
+   time per tsearch, tfind and tdelete is printed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <search.h>
+#include "timing.h"
+
+#define NKEYS 1000000
+
+static int errors;
+static int vals[NKEYS], keys[NKEYS];
+static int maxlevel;
+
+static int
+compar (const void *a, const void *b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+walk (const void *node, VISIT v, int level)
+{
+  if (level > maxlevel)
+    maxlevel = level;
+}
+
+static void
+run (int random_order, int timing)
+{
+  void *root = NULL;
+  double start, t_insert, t_find, t_delete;
+  int i, j, t, nfound = 0, ndeleted = 0;
+
+  for (i = 0; i < NKEYS; i++)
+    keys[i] = i;
+  if (random_order)
+    for (i = NKEYS - 1; i > 0; i--)
+      {
+	j = random () % (i + 1);
+	t = keys[i];
+	keys[i] = keys[j];
+	keys[j] = t;
+      }
+
+  start = now ();
+  for (i = 0; i < NKEYS; i++)
+    if (!tsearch (&vals[keys[i]], &root, compar))
+      break;
+  t_insert = now () - start;
+  if (i < NKEYS && errors++ < 20)
+    fprintf (stderr, "tsearch_avl: tsearch failed\n");
+
+  /* An AVL tree of 1M nodes is less than 1.45 log2 (1M + 2) = 29 high. */
+  maxlevel = 0;
+  twalk (root, walk);
+  if (maxlevel + 1 > 29 && errors++ < 20)
+    fprintf (stderr, "tsearch_avl: %s tree is %d high\n",
+	     random_order ? "random" : "sorted", maxlevel + 1);
+
+  start = now ();
+  for (i = 0; i < NKEYS; i++)
+    nfound += tfind (&keys[i], &root, compar) != NULL;
+  t_find = now () - start;
+  start = now ();
+  for (i = 0; i < NKEYS; i++)
+    ndeleted += tdelete (&keys[i], &root, compar) != NULL;
+  t_delete = now () - start;
+  if ((nfound != NKEYS || ndeleted != NKEYS || root) && errors++ < 20)
+    fprintf (stderr, "tsearch_avl: %d keys found, %d deleted\n",
+	     nfound, ndeleted);
+
+  if (timing)
+    printf ("%d keys, %-6s: tsearch %6.1f ns, tfind %6.1f ns, "
+	    "tdelete %6.1f ns\n", NKEYS, random_order ? "random" : "sorted",
+	    t_insert * 1e9 / NKEYS, t_find * 1e9 / NKEYS,
+	    t_delete * 1e9 / NKEYS);
+}
+
+int
+main (int argc, char **argv)
+{
+  int timing = !(argc > 1 && !strcmp (argv[1], "-n"));
+  int i;
+
+  for (i = 0; i < NKEYS; i++)
+    vals[i] = i;
+  srandom (42);
+  run (0, timing);
+  run (1, timing);
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  return 0;
+}
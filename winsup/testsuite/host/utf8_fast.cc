@@ -0,0 +1,647 @@
+/* utf8_fast.cc: host test and benchmark for winsup/cygwin/utf8_fast.h.
+
+   This doesn't need Cygwin.  Build and run it on any host with
+   `make check', see Makefile.
+
+   The conversion loops of sys_cp_mbstowcs and sys_wcstombs for the UTF-8
+   charset are copied here twice, with and without the fast paths, on top
+   of copies of newlib's __utf8_mbtowc and __utf8_wctomb for a 16 bit
+   wchar_t.  Random valid and invalid input, with and without a length,
+   with and without a destination and with random room in the destination
+   must give the same results and the same destination buffers from both.
+   Unless -n is given, the conversion rate of both is compared for ASCII
+   paths, European and Asian text. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "utf8_fast.h"
+#include "timing.h"
+
+typedef uint16_t WCHAR;
+
+struct state
+{
+  int count;
+  unsigned char wchb[4];
+};
+
+/* newlib/libc/stdlib/mbtowc_r.c:__utf8_mbtowc with sizeof (wchar_t) == 2. */
+static int
+utf8_mbtowc (WCHAR *pwc, const char *s, size_t n, state *state)
+{
+  WCHAR dummy;
+  unsigned char *t = (unsigned char *) s;
+  int ch;
+  int i = 0;
+
+  if (pwc == NULL)
+    pwc = &dummy;
+  if (n == 0)
+    return -2;
+  if (state->count == 0)
+    ch = t[i++];
+  else
+    ch = state->wchb[0];
+  if (ch == '\0')
+    {
+      *pwc = 0;
+      state->count = 0;
+      return 0;
+    }
+  if (ch <= 0x7f)
+    {
+      state->count = 0;
+      *pwc = ch;
+      return 1;
+    }
+  if (ch >= 0xc0 && ch <= 0xdf)
+    {
+      state->wchb[0] = ch;
+      if (state->count == 0)
+	state->count = 1;
+      else if (n < (size_t) -1)
+	++n;
+      if (n < 2)
+	return -2;
+      ch = t[i++];
+      if (ch < 0x80 || ch > 0xbf || state->wchb[0] < 0xc2)
+	return -1;
+      state->count = 0;
+      *pwc = ((state->wchb[0] & 0x1f) << 6) | (ch & 0x3f);
+      return i;
+    }
+  if (ch >= 0xe0 && ch <= 0xef)
+    {
+      state->wchb[0] = ch;
+      if (state->count == 0)
+	state->count = 1;
+      else if (n < (size_t) -1)
+	++n;
+      if (n < 2)
+	return -2;
+      ch = (state->count == 1) ? t[i++] : state->wchb[1];
+      if (state->wchb[0] == 0xe0 && ch < 0xa0)
+	return -1;
+      if (ch < 0x80 || ch > 0xbf)
+	return -1;
+      state->wchb[1] = ch;
+      if (state->count == 1)
+	state->count = 2;
+      else if (n < (size_t) -1)
+	++n;
+      if (n < 3)
+	return -2;
+      ch = t[i++];
+      if (ch < 0x80 || ch > 0xbf)
+	return -1;
+      state->count = 0;
+      *pwc = ((state->wchb[0] & 0x0f) << 12) | ((state->wchb[1] & 0x3f) << 6)
+	     | (ch & 0x3f);
+      return i;
+    }
+  if (ch >= 0xf0 && ch <= 0xf4)
+    {
+      uint32_t tmp;
+      state->wchb[0] = ch;
+      if (state->count == 0)
+	state->count = 1;
+      else if (n < (size_t) -1)
+	++n;
+      if (n < 2)
+	return -2;
+      ch = (state->count == 1) ? t[i++] : state->wchb[1];
+      if ((state->wchb[0] == 0xf0 && ch < 0x90)
+	  || (state->wchb[0] == 0xf4 && ch >= 0x90))
+	return -1;
+      if (ch < 0x80 || ch > 0xbf)
+	return -1;
+      state->wchb[1] = ch;
+      if (state->count == 1)
+	state->count = 2;
+      else if (n < (size_t) -1)
+	++n;
+      if (n < 3)
+	return -2;
+      ch = (state->count == 2) ? t[i++] : state->wchb[2];
+      if (ch < 0x80 || ch > 0xbf)
+	return -1;
+      state->wchb[2] = ch;
+      if (state->count == 2)
+	state->count = 3;
+      else if (n < (size_t) -1)
+	++n;
+      if (state->count == 3)
+	{
+	  tmp = ((state->wchb[0] & 0x07) << 18)
+		| ((state->wchb[1] & 0x3f) << 12)
+		| ((state->wchb[2] & 0x3f) << 6);
+	  state->count = 4;
+	  *pwc = 0xd800 | ((tmp - 0x10000) >> 10);
+	  return i;
+	}
+      if (n < 4)
+	return -2;
+      ch = t[i++];
+      if (ch < 0x80 || ch > 0xbf)
+	return -1;
+      tmp = ((state->wchb[0] & 0x07) << 18) | ((state->wchb[1] & 0x3f) << 12)
+	    | ((state->wchb[2] & 0x3f) << 6) | (ch & 0x3f);
+      *pwc = 0xdc00 | (tmp & 0x3ff);
+      state->count = 0;
+      return i;
+    }
+  return -1;
+}
+
+/* newlib/libc/stdlib/wctomb_r.c:__utf8_wctomb with sizeof (wchar_t) == 2. */
+static int
+utf8_wctomb (char *s, WCHAR wchar, state *state)
+{
+  int ret = 0;
+
+  if (state->count == -4 && (wchar < 0xdc00 || wchar > 0xdfff))
+    {
+      WCHAR tmp;
+      tmp = (state->wchb[0] << 16 | state->wchb[1] << 8)
+	    - (0x10000 >> 10 | 0xd80d);
+      *s++ = 0xe0 | ((tmp & 0xf000) >> 12);
+      *s++ = 0x80 | ((tmp &  0xfc0) >> 6);
+      *s++ = 0x80 |  (tmp &   0x3f);
+      state->count = 0;
+      ret = 3;
+    }
+  if (wchar <= 0x7f)
+    {
+      *s = wchar;
+      return ret + 1;
+    }
+  if (wchar >= 0x80 && wchar <= 0x7ff)
+    {
+      *s++ = 0xc0 | ((wchar & 0x7c0) >> 6);
+      *s   = 0x80 |  (wchar &  0x3f);
+      return ret + 2;
+    }
+  if (wchar >= 0xd800 && wchar <= 0xdfff)
+    {
+      uint32_t tmp;
+      if (wchar <= 0xdbff)
+	{
+	  tmp = ((wchar & 0x3ff) << 10) + 0x10000;
+	  state->wchb[0] = (tmp >> 16) & 0xff;
+	  state->wchb[1] = (tmp >> 8) & 0xff;
+	  state->count = -4;
+	  *s = (0xf0 | ((tmp & 0x1c0000) >> 18));
+	  return ret;
+	}
+      if (state->count == -4)
+	{
+	  tmp = (state->wchb[0] << 16) | (state->wchb[1] << 8)
+		| (wchar & 0x3ff);
+	  state->count = 0;
+	  *s++ = 0xf0 | ((tmp & 0x1c0000) >> 18);
+	  *s++ = 0x80 | ((tmp &  0x3f000) >> 12);
+	  *s++ = 0x80 | ((tmp &    0xfc0) >> 6);
+	  *s   = 0x80 |  (tmp &     0x3f);
+	  return 4;
+	}
+    }
+  *s++ = 0xe0 | ((wchar & 0xf000) >> 12);
+  *s++ = 0x80 | ((wchar &  0xfc0) >> 6);
+  *s   = 0x80 |  (wchar &   0x3f);
+  return ret + 3;
+}
+
+/* Whether tfx_rev_chars in strfuncs.cc maps C to the private use area. */
+static bool
+tfx_rev (unsigned char c)
+{
+  return c < 32 || (c && strchr (" \"*.:<>?|", c));
+}
+
+/* winsup/cygwin/strfuncs.cc:sys_wcstombs with f_wctomb == __utf8_wctomb. */
+static size_t
+sys_wcstombs (bool fast, char *dst, size_t len, const WCHAR *src, size_t nwc,
+	      bool is_path)
+{
+  char buf[10];
+  char *ptr = dst;
+  WCHAR *pwcs = (WCHAR *) src;
+  size_t n = 0;
+  state ps;
+
+  memset (&ps, 0, sizeof ps);
+  if (dst == NULL)
+    len = (size_t) -1;
+  while (n < len && nwc-- > 0)
+    {
+      WCHAR pw;
+      int bytes;
+      unsigned char cwc;
+
+      if (fast && ps.count == 0)
+	{
+	  size_t nread, nbytes;
+
+	  nbytes = utf16_to_utf8_fast (ptr, len - n, pwcs, nwc + 1, is_path,
+				       &nread);
+	  if (nread > 0)
+	    {
+	      pwcs += nread;
+	      nwc -= nread - 1;
+	      n += nbytes;
+	      if (dst)
+		ptr += nbytes;
+	      continue;
+	    }
+	}
+      pw = *pwcs;
+      if (is_path && (pw & 0xff00) == 0xf000
+	  && (((cwc = (pw & 0xff)) <= 0x7f && tfx_rev (cwc)) || cwc >= 0x80))
+	{
+	  buf[0] = (char) cwc;
+	  bytes = 1;
+	}
+      else
+	bytes = utf8_wctomb (buf, pw, &ps);
+      if (n + bytes <= len)
+	{
+	  if (dst)
+	    {
+	      for (int i = 0; i < bytes; ++i)
+		*ptr++ = buf[i];
+	    }
+	  if (*pwcs++ == 0x00)
+	    break;
+	  n += bytes;
+	}
+      else
+	break;
+    }
+  if (n && dst && len != (size_t) -1)
+    {
+      n = (n < len) ? n : len - 1;
+      dst[n] = '\0';
+    }
+  return n;
+}
+
+/* winsup/cygwin/strfuncs.cc:sys_cp_mbstowcs with f_mbtowc == __utf8_mbtowc,
+   not STRICTLY_7BIT_ASCII. */
+static size_t
+sys_mbstowcs (bool fast, WCHAR *dst, size_t dlen, const char *src,
+	      size_t nms)
+{
+  WCHAR *ptr = dst;
+  unsigned const char *pmbs = (unsigned const char *) src;
+  size_t count = 0;
+  size_t len = dlen;
+  int bytes;
+  state ps;
+
+  memset (&ps, 0, sizeof ps);
+  if (dst == NULL)
+    len = (size_t) -1;
+  while (len > 0 && nms > 0)
+    {
+      if (fast && ps.count == 0)
+	{
+	  size_t nread, nconv;
+
+	  nconv = utf8_to_utf16_fast (ptr, len, pmbs, nms, &nread);
+	  if (nconv > 0)
+	    {
+	      pmbs += nread;
+	      nms -= nread;
+	      count += nconv;
+	      if (dst)
+		ptr += nconv;
+	      len -= nconv;
+	      continue;
+	    }
+	}
+      if (*pmbs == 0x18)
+	{
+	  bytes = 1;
+	  if (dst)
+	    *ptr = 0x18;
+	}
+      else if ((bytes = utf8_mbtowc (ptr, (const char *) pmbs, nms, &ps)) < 0)
+	{
+	  bytes = 1;
+	  if (dst)
+	    *ptr = *pmbs;
+	  memset (&ps, 0, sizeof ps);
+	}
+      if (bytes > 0)
+	{
+	  pmbs += bytes;
+	  nms -= bytes;
+	  ++count;
+	  ptr = dst ? ptr + 1 : NULL;
+	  --len;
+	}
+      else
+	{
+	  if (bytes == 0)
+	    ++count;
+	  break;
+	}
+    }
+  if (count && dst)
+    {
+      count = (count < dlen) ? count : dlen - 1;
+      dst[count] = L'\0';
+    }
+  return count;
+}
+
+#define MAXLEN 600
+
+static int errors;
+
+static void
+put_utf8 (unsigned char *s, size_t *n, uint32_t c)
+{
+  if (c < 0x80)
+    s[(*n)++] = c;
+  else if (c < 0x800)
+    {
+      s[(*n)++] = 0xc0 | (c >> 6);
+      s[(*n)++] = 0x80 | (c & 0x3f);
+    }
+  else if (c < 0x10000)
+    {
+      s[(*n)++] = 0xe0 | (c >> 12);
+      s[(*n)++] = 0x80 | ((c >> 6) & 0x3f);
+      s[(*n)++] = 0x80 | (c & 0x3f);
+    }
+  else
+    {
+      s[(*n)++] = 0xf0 | (c >> 18);
+      s[(*n)++] = 0x80 | ((c >> 12) & 0x3f);
+      s[(*n)++] = 0x80 | ((c >> 6) & 0x3f);
+      s[(*n)++] = 0x80 | (c & 0x3f);
+    }
+}
+
+/* Random UTF-8, mostly in runs of the same kind of characters, with
+   sometimes a NUL, a CAN, a truncated, overlong or otherwise invalid
+   sequence, or an encoded surrogate. */
+static size_t
+random_utf8 (unsigned char *s, size_t max)
+{
+  size_t n = 0;
+
+  while (n + 8 < max)
+    {
+      int kind = random () % 16, run = 1 + random () % 40;
+      unsigned char *t;
+
+      for (; run > 0 && n + 8 < max; --run)
+	switch (kind)
+	  {
+	  default:
+	    s[n++] = 0x20 + random () % 0x5f;
+	    break;
+	  case 8:
+	  case 9:
+	    put_utf8 (s, &n, 0x80 + random () % 0x780);
+	    break;
+	  case 10:
+	    put_utf8 (s, &n, 0x800 + random () % 0xf800);
+	    break;
+	  case 11:
+	    put_utf8 (s, &n, 0x10000 + random () % 0x100000);
+	    break;
+	  case 12:
+	    /* A random byte, or a random continuation byte. */
+	    s[n++] = random () % 2 ? random () % 256 : 0x80 + random () % 64;
+	    run = 0;
+	    break;
+	  case 13:
+	    /* Truncated sequence, overlong, or > 0x10ffff. */
+	    t = s + n;
+	    put_utf8 (s, &n, 0x80 + random () % 0x10ff80);
+	    switch (random () % 3)
+	      {
+	      case 0:
+		n -= 1 + random () % (s + n - t);
+		break;
+	      case 1:
+		t[0] = (t[0] & 0xf0) == 0xf0 ? (random () % 2 ? 0xf0 : 0xf4)
+		       : (t[0] & 0xf0) == 0xe0 ? 0xe0 : 0xc0 + random () % 2;
+		break;
+	      case 2:
+		t[random () % (s + n - t)] = random () % 256;
+		break;
+	      }
+	    run = 0;
+	    break;
+	  case 14:
+	    put_utf8 (s, &n, 0xd800 + random () % 0x800);
+	    break;
+	  case 15:
+	    s[n++] = random () % 4 ? 0x18 : 0;
+	    run = 0;
+	    break;
+	  }
+    }
+  return n;
+}
+
+/* Random UTF-16, with sometimes a NUL, lone surrogates and characters in
+   the private use area sys_wcstombs converts back for paths. */
+static size_t
+random_utf16 (WCHAR *s, size_t max)
+{
+  size_t n = 0;
+
+  while (n + 2 < max)
+    {
+      int kind = random () % 16, run = 1 + random () % 40;
+
+      for (; run > 0 && n + 2 < max; --run)
+	switch (kind)
+	  {
+	  default:
+	    s[n++] = 0x20 + random () % 0x5f;
+	    break;
+	  case 8:
+	  case 9:
+	    s[n++] = 0x80 + random () % 0x780;
+	    break;
+	  case 10:
+	    s[n] = 0x800 + random () % 0xf800;
+	    if (s[n] >= 0xd800 && s[n] <= 0xdfff)
+	      s[n] -= 0x1000;
+	    ++n;
+	    break;
+	  case 11:
+	    s[n++] = 0xd800 + random () % 0x400;
+	    s[n++] = 0xdc00 + random () % 0x400;
+	    break;
+	  case 12:
+	    s[n++] = 0xd800 + random () % 0x800;
+	    run = 0;
+	    break;
+	  case 13:
+	    s[n++] = 0xf000 + random () % 0x100;
+	    break;
+	  case 14:
+	    s[n++] = 1 + random () % 0x7f;
+	    break;
+	  case 15:
+	    s[n++] = 0;
+	    run = 0;
+	    break;
+	  }
+    }
+  return n;
+}
+
+static void
+check_mbstowcs (const unsigned char *src, size_t n)
+{
+  static WCHAR ref[MAXLEN + 1], fast[MAXLEN + 1];
+  size_t dlen, nms, r, f;
+
+  for (int i = 0; i < 8; ++i)
+    {
+      nms = (i & 1) ? (size_t) -1 : random () % (n + 1);
+      dlen = (i & 2) ? MAXLEN + 1 : 1 + random () % (MAXLEN + 1);
+      if (i & 4)
+	{
+	  r = sys_mbstowcs (false, NULL, 0, (const char *) src, nms);
+	  f = sys_mbstowcs (true, NULL, 0, (const char *) src, nms);
+	}
+      else
+	{
+	  memset (ref, 0x55, sizeof ref);
+	  memset (fast, 0x55, sizeof fast);
+	  r = sys_mbstowcs (false, ref, dlen, (const char *) src, nms);
+	  f = sys_mbstowcs (true, fast, dlen, (const char *) src, nms);
+	  if (r == f && memcmp (ref, fast, sizeof ref))
+	    {
+	      printf ("sys_mbstowcs (%zu, %zd): different result\n", dlen, (ssize_t) nms);
+	      ++errors;
+	    }
+	}
+      if (r != f)
+	{
+	  printf ("sys_mbstowcs (%zu, %zd) returned %zu instead of %zu\n",
+		  dlen, (ssize_t) nms, f, r);
+	  ++errors;
+	}
+    }
+}
+
+static void
+check_wcstombs (const WCHAR *src, size_t n)
+{
+  static char ref[4 * MAXLEN + 1], fast[4 * MAXLEN + 1];
+  size_t len, nwc, r, f;
+
+  for (int i = 0; i < 16; ++i)
+    {
+      bool is_path = i & 8;
+
+      nwc = (i & 1) ? (size_t) -1 : random () % (n + 1);
+      len = (i & 2) ? sizeof ref : 1 + random () % sizeof ref;
+      if (i & 4)
+	{
+	  r = sys_wcstombs (false, NULL, 0, src, nwc, is_path);
+	  f = sys_wcstombs (true, NULL, 0, src, nwc, is_path);
+	}
+      else
+	{
+	  memset (ref, 0x55, sizeof ref);
+	  memset (fast, 0x55, sizeof fast);
+	  r = sys_wcstombs (false, ref, len, src, nwc, is_path);
+	  f = sys_wcstombs (true, fast, len, src, nwc, is_path);
+	  if (r == f && memcmp (ref, fast, sizeof ref))
+	    {
+	      printf ("sys_wcstombs (%zu, %zd, %d): different result\n",
+		      len, (ssize_t) nwc, is_path);
+	      ++errors;
+	    }
+	}
+      if (r != f)
+	{
+	  printf ("sys_wcstombs (%zu, %zd, %d) returned %zu instead of %zu\n",
+		  len, (ssize_t) nwc, is_path, f, r);
+	  ++errors;
+	}
+    }
+}
+
+static void
+benchmark (const char *name, const char *text)
+{
+  static WCHAR wbuf[MAXLEN + 1];
+  static char buf[4 * MAXLEN + 1];
+  size_t n = strlen (text), nw;
+  double t[2][2];
+  int iter = 20000000 / (n + 1);
+
+  nw = sys_mbstowcs (false, wbuf, MAXLEN + 1, text, (size_t) -1);
+  for (int fast = 0; fast < 2; ++fast)
+    {
+      double start = now ();
+      for (int i = 0; i < iter; ++i)
+	sys_mbstowcs (fast, wbuf, MAXLEN + 1, text, (size_t) -1);
+      t[fast][0] = now () - start;
+      start = now ();
+      for (int i = 0; i < iter; ++i)
+	sys_wcstombs (fast, buf, sizeof buf, wbuf, (size_t) -1, true);
+      t[fast][1] = now () - start;
+    }
+  printf ("%-9s %4zu bytes, %3zu chars: mbstowcs %6.0f -> %6.0f MB/s, "
+	  "wcstombs %6.0f -> %6.0f MB/s\n", name, n, nw,
+	  n * iter / t[0][0] / 1e6, n * iter / t[1][0] / 1e6,
+	  n * iter / t[0][1] / 1e6, n * iter / t[1][1] / 1e6);
+}
+
+int
+main (int argc, char **argv)
+{
+  static unsigned char mb[MAXLEN + 1];
+  static WCHAR wc[MAXLEN + 1];
+  int ntests = 200000;
+  size_t n;
+
+  srandom (1);
+  for (int i = 0; i < ntests; ++i)
+    {
+      n = random_utf8 (mb, 1 + random () % MAXLEN);
+      mb[n] = '\0';
+      check_mbstowcs (mb, n);
+      n = random_utf16 (wc, 1 + random () % MAXLEN);
+      wc[n] = 0;
+      check_wcstombs (wc, n);
+      if (errors > 20)
+	break;
+    }
+  if (errors)
+    {
+      printf ("%d errors\n", errors);
+      return 1;
+    }
+  printf ("%d random strings converted as before\n", ntests);
+
+  if (argc > 1 && !strcmp (argv[1], "-n"))
+    return 0;
+  benchmark ("path", "/usr/lib/gcc/x86_64-pc-msys/13.2.0/include/c++/bits/"
+		     "stl_algobase.h");
+  benchmark ("long path", "/home/user/projects/some-project/build/"
+			  "src/subdirectory/another/level/deep/object-file."
+			  "o.d/and/then/some/more/path/components/to/make/"
+			  "it/longer/than/usual/file.txt");
+  benchmark ("German", "/home/jörg/Dokumente/Übersicht der Straßenbäume "
+		       "für größere Städte.odt");
+  benchmark ("Chinese", "/home/用户/文档/中文文件名的测试和性能评估报告.txt");
+  benchmark ("emoji", "/tmp/\xf0\x9f\x98\x80\xf0\x9f\x98\x81\xf0\x9f\x98\x82"
+		      "\xf0\x9f\x98\x83\xf0\x9f\x98\x84.png");
+  return 0;
+}
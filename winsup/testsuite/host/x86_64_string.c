@@ -0,0 +1,549 @@
+/* x86_64_string.c: host test and benchmark for the string functions in
+   newlib/libc/machine/x86_64.
+
+   This doesn't need Cygwin.  Build and run it on any x86_64 host with
+   `make check', see Makefile.
+
+   The vectorized functions are built as vec_*, the generic C functions
+   from newlib/libc/string as c_*.  Both the SSE2 and, if the CPU supports
+   it, the AVX2 variants are checked against trivial reference
+   implementations for all alignments and many lengths, with the buffers
+   placed right in front of an inaccessible page to catch reads beyond the
+   end.  memcpy, memmove and memset are checked a second time with the
+   non-temporal threshold lowered so that their streaming paths are used
+   for short lengths too.  Then the throughput of all variants is measured,
+   unless -n is given. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include "timing.h"
+
+#define DECL(name, ret, args) \
+  ret vec_##name args; \
+  ret c_##name args;
+
+DECL (strlen, size_t, (const char *))
+DECL (strchr, char *, (const char *, int))
+DECL (rawmemchr, void *, (const void *, int))
+DECL (memchr, void *, (const void *, int, size_t))
+DECL (memrchr, void *, (const void *, int, size_t))
+DECL (memcmp, int, (const void *, const void *, size_t))
+DECL (strcmp, int, (const char *, const char *))
+DECL (memmove, void *, (void *, const void *, size_t))
+DECL (memcpy, void *, (void *, const void *, size_t))
+DECL (memset, void *, (void *, int, size_t))
+
+/* See string-vec.h. */
+#define X86_64_CPU_INIT		1
+#define X86_64_CPU_AVX2		2
+extern int __x86_64_cpu_features;
+extern int __x86_64_cpu_init (void);
+extern size_t __x86_64_nt_threshold;
+
+#define MAX_LEN	300
+
+static size_t page;
+static char *area;		/* Two accessible pages, then a guard page. */
+static char *area2;
+static char *guard, *guard2;
+static const char *mode;
+static int errors;
+
+static void
+error (const char *func, const char *fmt, ...)
+{
+  va_list ap;
+
+  if (errors++ < 20)
+    {
+      fprintf (stderr, "%s %s: ", mode, func);
+      va_start (ap, fmt);
+      vfprintf (stderr, fmt, ap);
+      va_end (ap);
+      fputc ('\n', stderr);
+    }
+}
+
+static char *
+map_area (char **guardp)
+{
+  char *p = mmap (NULL, 3 * page, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (p == MAP_FAILED || mprotect (p + 2 * page, page, PROT_NONE))
+    {
+      perror ("mmap");
+      exit (1);
+    }
+  *guardp = p + 2 * page;
+  return p;
+}
+
+/* Fill LEN bytes at P with random bytes other than NUL and C. */
+static void
+fill (char *p, size_t len, int c)
+{
+  for (size_t i = 0; i < len; ++i)
+    do
+      p[i] = rand ();
+    while (!p[i] || p[i] == (char) c);
+}
+
+/* Return a string of LEN bytes plus NUL at alignment ALIGN, or ending right
+   in front of the guard page if ALIGN is -1. */
+static char *
+place (char *base, char *guardp, int align, size_t len)
+{
+  return align < 0 ? guardp - len - 1 : base + align;
+}
+
+static const int chars[] = { 'a', 0x7f, 0x80, 0xff, 0 };
+#define NCHARS (sizeof chars / sizeof *chars)
+
+static void
+check_strlen (void)
+{
+  for (int align = -1; align < 64; ++align)
+    for (size_t len = 0; len <= MAX_LEN; ++len)
+      {
+	char *s = place (area, guard, align, len);
+
+	fill (s, len, 0);
+	s[len] = '\0';
+	if (vec_strlen (s) != len)
+	  error ("strlen", "align %d len %zu: %zu", align, len, vec_strlen (s));
+      }
+}
+
+static void
+check_strchr (void)
+{
+  for (unsigned ci = 0; ci < NCHARS; ++ci)
+    for (int align = -1; align < 64; ++align)
+      for (size_t len = 0; len <= MAX_LEN; len += 1 + len / 16)
+	for (size_t pos = 0; pos <= len; pos += 1 + pos / 8)
+	  {
+	    int c = chars[ci];
+	    char *s = place (area, guard, align, len);
+	    char *expect;
+
+	    /* POS == LEN means C isn't in the string at all. */
+	    fill (s, len, c);
+	    s[len] = '\0';
+	    if (pos < len)
+	      s[pos] = c;
+	    expect = pos < len ? s + pos : c ? NULL : s + len;
+	    if (vec_strchr (s, c) != expect)
+	      error ("strchr", "c %#x align %d len %zu pos %zu", c, align, len,
+		     pos);
+	    if (expect && vec_rawmemchr (s, c) != expect)
+	      error ("rawmemchr", "c %#x align %d len %zu pos %zu", c, align,
+		     len, pos);
+	  }
+}
+
+static void
+check_memchr (void)
+{
+  for (unsigned ci = 0; ci < NCHARS; ++ci)
+    for (int align = -1; align < 64; ++align)
+      for (size_t len = 0; len <= MAX_LEN; len += 1 + len / 16)
+	for (size_t pos = 0; pos <= len; pos += 1 + pos / 8)
+	  {
+	    int c = chars[ci];
+	    /* Surround the buffer with C, which must not be found. */
+	    char *s = align < 0 ? guard - len : area + 64 + align;
+	    char *hit = pos < len ? s + pos : NULL;
+
+	    memset (s - 64, c, MIN (len + 128, (size_t) (guard - s + 64)));
+	    fill (s, len, c);
+	    if (hit)
+	      *hit = c;
+	    if (vec_memchr (s, c, len) != hit)
+	      error ("memchr", "c %#x align %d len %zu pos %zu", c, align, len,
+		     pos);
+	    if (vec_memrchr (s, c, len) != hit)
+	      error ("memrchr", "c %#x align %d len %zu pos %zu", c, align,
+		     len, pos);
+	    if (hit && vec_memchr (s, c, SIZE_MAX) != hit)
+	      error ("memchr", "c %#x align %d pos %zu, n SIZE_MAX", c, align,
+		     pos);
+	    if (hit && pos + 1 < len)
+	      {
+		s[len - 1] = c;
+		if (vec_memrchr (s, c, len) != s + len - 1)
+		  error ("memrchr", "c %#x align %d len %zu, last byte", c,
+			 align, len);
+	      }
+	  }
+}
+
+static int
+sign (int i)
+{
+  return i < 0 ? -1 : i > 0;
+}
+
+static void
+check_memcmp (void)
+{
+  for (int a1 = -1; a1 < 64; a1 += 3)
+    for (int a2 = -1; a2 < 64; a2 += 5)
+      for (size_t len = 0; len <= MAX_LEN; ++len)
+	{
+	  char *x = a1 < 0 ? guard - len : area + a1;
+	  char *y = a2 < 0 ? guard2 - len : area2 + a2;
+
+	  fill (x, len, 0);
+	  memcpy (y, x, len);
+	  /* POS == LEN means no difference. */
+	  for (size_t pos = 0; pos <= len; pos += 1 + pos / 4)
+	    {
+	      int expect = 0;
+
+	      if (pos < len)
+		{
+		  y[pos] ^= 0x81;
+		  expect = (unsigned char) x[pos] < (unsigned char) y[pos]
+			   ? -1 : 1;
+		}
+	      if (sign (vec_memcmp (x, y, len)) != expect
+		  || sign (vec_memcmp (y, x, len)) != -expect)
+		error ("memcmp", "align %d/%d len %zu pos %zu", a1, a2, len,
+		       pos);
+	      if (pos < len)
+		y[pos] ^= 0x81;
+	    }
+	}
+}
+
+static void
+check_strcmp (void)
+{
+  for (int a1 = -1; a1 < 64; a1 += 3)
+    for (int a2 = -1; a2 < 64; a2 += 5)
+      for (size_t len = 0; len <= MAX_LEN; len += 1 + len / 32)
+	for (size_t pos = 0; pos <= len + 1; pos += 1 + pos / 4)
+	  {
+	    char *x = place (area, guard, a1, len);
+	    char *y = place (area2, guard2, a2, len);
+	    int expect = 0;
+
+	    fill (x, len, 0);
+	    x[len] = '\0';
+	    memcpy (y, x, len + 1);
+	    if (pos < len)
+	      {
+		/* Different byte, or the second string ends early. */
+		y[pos] = pos & 1 ? '\0' : (unsigned char) x[pos] ^ 0x81;
+		expect = (unsigned char) x[pos] < (unsigned char) y[pos]
+			 ? -1 : 1;
+	      }
+	    if (sign (vec_strcmp (x, y)) != expect
+		|| sign (vec_strcmp (y, x)) != -expect)
+	      error ("strcmp", "align %d/%d len %zu pos %zu", a1, a2, len, pos);
+	  }
+}
+
+static void
+check_memmove (void)
+{
+  static const size_t lens[] = { 1000, 4096, 5000 };
+  size_t size = guard - area;
+  char *pristine = malloc (size);
+  char *expect = malloc (size);
+  char *base = area + 192;
+
+  fill (pristine, size, 0);
+  memcpy (area, pristine, size);
+
+  for (int shift = -70; shift <= 70; ++shift)
+    for (int align = 0; align < 64; align += 3)
+      for (size_t len = 0; len <= MAX_LEN + 3; ++len)
+	{
+	  size_t l = len > MAX_LEN ? lens[len - MAX_LEN - 1] : len;
+	  char *src = base + align;
+	  char *dst = src + shift;
+
+	  /* Compare and restore a window around both buffers. */
+	  char *lo = MIN (src, dst) - 64;
+	  size_t wlen = l + 2 * 64 + 70;
+
+	  if (lo + wlen > guard)
+	    continue;
+	  memcpy (expect + (lo - area), pristine + (lo - area), wlen);
+	  /* Reference: copy from the pristine contents. */
+	  memcpy (expect + (dst - area), pristine + (src - area), l);
+	  if (vec_memmove (dst, src, l) != dst)
+	    error ("memmove", "wrong return value");
+	  if (memcmp (expect + (lo - area), lo, wlen))
+	    error ("memmove", "shift %d align %d len %zu", shift, align, l);
+	  memcpy (lo, pristine + (lo - area), wlen);
+	}
+  free (pristine);
+  free (expect);
+}
+
+static void
+check_memcpy (void)
+{
+  static const size_t lens[] = { 1000, 4096, 5000 };
+
+  for (int salign = 0; salign < 64; salign += 5)
+    for (int dalign = -1; dalign < 64; ++dalign)
+      for (size_t len = 0; len <= MAX_LEN + 3; ++len)
+	{
+	  size_t l = len > MAX_LEN ? lens[len - MAX_LEN - 1] : len;
+	  char *src = area + salign;
+	  char *dst = dalign < 0 ? guard2 - l : area2 + dalign;
+	  char *lo = MAX (dst - 64, area2);
+	  char *hi = MIN (dst + l + 64, guard2);
+
+	  if (src + l > guard || dst + l > guard2)
+	    continue;
+	  fill (src, l, 0);
+	  memset (lo, 0, hi - lo);
+	  if (vec_memcpy (dst, src, l) != dst)
+	    error ("memcpy", "wrong return value");
+	  if (memcmp (dst, src, l))
+	    error ("memcpy", "salign %d dalign %d len %zu", salign, dalign, l);
+	  for (char *p = lo; p < hi; ++p)
+	    if ((p < dst || p >= dst + l) && *p)
+	      {
+		error ("memcpy", "salign %d dalign %d len %zu: "
+		       "wrote outside at %td", salign, dalign, l, p - dst);
+		break;
+	      }
+	}
+}
+
+static void
+check_memset (void)
+{
+  static const size_t lens[] = { 1000, 4096, 5000 };
+
+  for (int align = -1; align < 64; ++align)
+    for (size_t len = 0; len <= MAX_LEN + 3; ++len)
+      {
+	size_t l = len > MAX_LEN ? lens[len - MAX_LEN - 1] : len;
+	char *s = align < 0 ? guard - l : area + align;
+	int c = chars[len % NCHARS];
+	char *lo = MAX (s - 64, area);
+	char *hi = MIN (s + l + 64, guard);
+
+	memset (lo, 'x', hi - lo);
+	if (vec_memset (s, c, l) != s)
+	  error ("memset", "wrong return value");
+	for (char *p = lo; p < hi; ++p)
+	  if (*p != (p >= s && p < s + l ? (char) c : 'x'))
+	    {
+	      error ("memset", "align %d len %zu c %#x: wrong byte at %td",
+		     align, l, c, p - s);
+	      break;
+	    }
+      }
+}
+
+static void
+check (void)
+{
+  check_strlen ();
+  check_strchr ();
+  check_memchr ();
+  check_memcmp ();
+  check_strcmp ();
+  check_memmove ();
+  check_memcpy ();
+  check_memset ();
+}
+
+/* Check the copy and set functions using their non-temporal stores. */
+static void
+check_nt (void)
+{
+  size_t threshold = __x86_64_nt_threshold;
+
+  __x86_64_nt_threshold = 0;
+  check_memmove ();
+  check_memcpy ();
+  check_memset ();
+  __x86_64_nt_threshold = threshold;
+}
+
+static char *b1, *b2;
+static volatile size_t sink;
+
+/* Run function FUNC of variant VARIANT on SIZE bytes, with the destination
+   of memcpy and memset misaligned by ALIGN, return GB/s. */
+static double
+run (const char *func, int variant, size_t size, int align)
+{
+  size_t loops = (256 << 20) / (size + 64) + 1;
+  double start = now ();
+
+#define RUN(call) \
+  for (size_t l = 0; l < loops; ++l) \
+    sink += (size_t) (call)
+#define CALL(name, ...) \
+  (variant ? vec_##name (__VA_ARGS__) : c_##name (__VA_ARGS__))
+
+  if (!strcmp (func, "strlen"))
+    RUN (CALL (strlen, b1));
+  else if (!strcmp (func, "strchr"))
+    RUN (CALL (strchr, b1, 'x'));
+  else if (!strcmp (func, "rawmemchr"))
+    RUN (CALL (rawmemchr, b1, 0));
+  else if (!strcmp (func, "memchr"))
+    RUN (CALL (memchr, b1, 'x', size));
+  else if (!strcmp (func, "memrchr"))
+    RUN (CALL (memrchr, b1, 'x', size));
+  else if (!strcmp (func, "memcmp"))
+    RUN (CALL (memcmp, b1, b2, size));
+  else if (!strcmp (func, "strcmp"))
+    RUN (CALL (strcmp, b1, b2));
+  else if (!strcmp (func, "memmove"))
+    RUN (CALL (memmove, b2, b1, size));
+  else if (!strcmp (func, "memcpy"))
+    RUN (CALL (memcpy, b2 + align, b1, size));
+  else if (!strcmp (func, "memset"))
+    RUN (CALL (memset, b2 + align, 0, size));
+  return (double) loops * size / (now () - start) / 1e9;
+}
+
+static void
+benchmark (int avx2)
+{
+  static const char *const funcs[] =
+    { "strlen", "strchr", "rawmemchr", "memchr", "memrchr", "memcmp",
+      "strcmp", "memmove", "memcpy", "memset" };
+  static const size_t sizes[] = { 16, 64, 256, 4096, 65536 };
+
+  b1 = malloc (65536 + 64);
+  b2 = malloc (65536 + 64);
+  printf ("GB/s          size");
+  for (unsigned s = 0; s < sizeof sizes / sizeof *sizes; ++s)
+    printf ("  %6zu", sizes[s]);
+  printf ("\n");
+  for (unsigned f = 0; f < sizeof funcs / sizeof *funcs; ++f)
+    for (int variant = 0; variant <= 2; ++variant)
+      {
+	if (variant == 2 && !avx2)
+	  continue;
+	__x86_64_cpu_features = X86_64_CPU_INIT
+				| (variant == 2 ? X86_64_CPU_AVX2 : 0);
+	printf ("%-10s %-5s", funcs[f],
+		variant == 0 ? "C" : variant == 1 ? "SSE2" : "AVX2");
+	for (unsigned s = 0; s < sizeof sizes / sizeof *sizes; ++s)
+	  {
+	    size_t size = sizes[s];
+
+	    fill (b1, size, 'x');
+	    b1[size] = '\0';
+	    memcpy (b2, b1, size + 1);
+	    printf ("  %6.2f", run (funcs[f], variant, size, 0));
+	  }
+	printf ("\n");
+      }
+  free (b1);
+  free (b2);
+}
+
+/* Measure memcpy and memset in each of their size tiers, from small copies
+   up to copies far larger than the last level cache, with aligned and
+   misaligned destinations. */
+static void
+benchmark_tiers (int avx2)
+{
+  static const char *const funcs[] = { "memcpy", "memset" };
+  static const size_t sizes[] =
+    { 24, 48, 100, 200, 4096, 256 << 10, 32 << 20 };
+  size_t max = sizes[sizeof sizes / sizeof *sizes - 1];
+
+  b1 = malloc (max + 64);
+  b2 = malloc (max + 64);
+  memset (b1, 'x', max + 64);
+  memset (b2, 'x', max + 64);
+  printf ("\nnon-temporal threshold %zu\n", __x86_64_nt_threshold);
+  printf ("GB/s           size");
+  for (unsigned s = 0; s < sizeof sizes / sizeof *sizes; ++s)
+    printf ("  %8zu", sizes[s]);
+  printf ("\n");
+  for (unsigned f = 0; f < sizeof funcs / sizeof *funcs; ++f)
+    for (int variant = 0; variant <= 2; ++variant)
+      for (int align = 0; align <= 3; align += 3)
+	{
+	  if (variant == 2 && !avx2)
+	    continue;
+	  __x86_64_cpu_features = X86_64_CPU_INIT
+				  | (variant == 2 ? X86_64_CPU_AVX2 : 0);
+	  printf ("%-7s %-5s +%d", funcs[f],
+		  variant == 0 ? "C" : variant == 1 ? "SSE2" : "AVX2", align);
+	  for (unsigned s = 0; s < sizeof sizes / sizeof *sizes; ++s)
+	    printf ("  %8.2f", run (funcs[f], variant, sizes[s], align));
+	  printf ("\n");
+	}
+
+  /* The largest size again, with and without non-temporal stores,
+     whatever the cache size of this machine. */
+  size_t threshold = __x86_64_nt_threshold;
+
+  for (unsigned f = 0; f < sizeof funcs / sizeof *funcs; ++f)
+    for (int variant = 1; variant <= (avx2 ? 2 : 1); ++variant)
+      {
+	__x86_64_cpu_features = X86_64_CPU_INIT
+				| (variant == 2 ? X86_64_CPU_AVX2 : 0);
+	__x86_64_nt_threshold = SIZE_MAX;
+	double cached = run (funcs[f], variant, max, 0);
+	__x86_64_nt_threshold = 0;
+	double nt = run (funcs[f], variant, max, 0);
+	printf ("%-7s %-5s %zu: %.2f GB/s cached, %.2f GB/s non-temporal\n",
+		funcs[f], variant == 1 ? "SSE2" : "AVX2", max, cached, nt);
+      }
+  __x86_64_nt_threshold = threshold;
+  free (b1);
+  free (b2);
+}
+
+int
+main (int argc, char **argv)
+{
+  int avx2 = __x86_64_cpu_init () & X86_64_CPU_AVX2;
+
+  page = sysconf (_SC_PAGESIZE);
+  area = map_area (&guard);
+  area2 = map_area (&guard2);
+  srand (42);
+
+  mode = "SSE2";
+  __x86_64_cpu_features = X86_64_CPU_INIT;
+  check ();
+  mode = "SSE2 non-temporal";
+  check_nt ();
+  if (avx2)
+    {
+      mode = "AVX2";
+      __x86_64_cpu_features = X86_64_CPU_INIT | X86_64_CPU_AVX2;
+      check ();
+      mode = "AVX2 non-temporal";
+      check_nt ();
+    }
+  else
+    printf ("No AVX2 support, only checked the SSE2 functions\n");
+  if (errors)
+    {
+      fprintf (stderr, "%d errors\n", errors);
+      return 1;
+    }
+  if (argc > 1 && !strcmp (argv[1], "-n"))
+    return 0;
+  benchmark (avx2);
+  benchmark_tiers (avx2);
+  return 0;
+}
@@ -0,0 +1,97 @@
+/* Check that children always get the current environment, even though
+   build_env reuses the environment block of the previous spawn, also with
+   a large environment. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define NVARS	500
+
+static const char *self;
+
+/* Spawn ourselves to check that ENVBLK_CHECK has the value VAL in the
+   child, or isn't set at all if VAL is NULL. */
+static int
+run_child (const char *val)
+{
+  char *argv[] = { (char *) self, "child", (char *) (val ?: ""),
+		   val ? "set" : "unset", NULL };
+  pid_t pid;
+  int status;
+
+  if (posix_spawn (&pid, self, NULL, NULL, argv, environ))
+    {
+      perror ("envblock: posix_spawn");
+      exit (1);
+    }
+  if (waitpid (pid, &status, 0) != pid)
+    {
+      perror ("envblock: waitpid");
+      exit (1);
+    }
+  return WIFEXITED (status) ? WEXITSTATUS (status) : 1;
+}
+
+static void
+check (const char *val)
+{
+  if (run_child (val))
+    {
+      fprintf (stderr, "envblock: child didn't get ENVBLK_CHECK=%s\n",
+	       val ?: "(unset)");
+      exit (1);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  static char put[] = "ENVBLK_CHECK=a";
+  int i;
+
+  if (argc == 4 && !strcmp (argv[1], "child"))
+    {
+      const char *val = getenv ("ENVBLK_CHECK");
+
+      if (!strcmp (argv[3], "unset"))
+	return !!val;
+      return !val || strcmp (val, argv[2]);
+    }
+  self = argv[0];
+
+  check (NULL);
+  putenv (put);
+  check ("a");
+  check ("a");
+  /* putenv strings are part of the environment. */
+  put[13] = 'b';
+  check ("b");
+  setenv ("ENVBLK_CHECK", "c", 1);
+  check ("c");
+  setenv ("ENVBLK_OTHER", "x", 1);
+  check ("c");
+  unsetenv ("ENVBLK_CHECK");
+  check (NULL);
+
+  for (i = 0; i < NVARS; ++i)
+    {
+      char name[32];
+
+      snprintf (name, sizeof name, "ENVBLK_VAR_%d", i);
+      setenv (name, "/usr/local/bin:/usr/bin:/bin", 1);
+    }
+  setenv ("ENVBLK_CHECK", "d", 1);
+  check ("d");
+  check ("d");
+  setenv ("ENVBLK_VAR_0", "/bin", 1);
+  check ("d");
+  setenv ("ENVBLK_CHECK", "e", 1);
+  check ("e");
+  exit (0);
+}
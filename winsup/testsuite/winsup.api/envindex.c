@@ -0,0 +1,98 @@
+/* Check that getenv stays coherent with setenv, putenv, unsetenv and
+   direct changes to environ. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern char **environ;
+
+static void
+check (const char *name, const char *expected)
+{
+  const char *val = getenv (name);
+
+  if (expected ? !val || strcmp (val, expected) : !!val)
+    {
+      fprintf (stderr, "envindex: getenv(\"%s\") returned \"%s\", "
+	       "expected \"%s\"\n", name, val ? val : "(null)",
+	       expected ? expected : "(null)");
+      exit (1);
+    }
+}
+
+static void
+coherency (void)
+{
+  static char put[] = "ENVIDX_PUT=1";
+  static char *myenv[] = { "ENVIDX_OWN=own", "ENVIDX_A=a", NULL };
+  char **saved = environ;
+  int i;
+
+  setenv ("ENVIDX_A", "1", 1);
+  check ("ENVIDX_A", "1");
+  setenv ("ENVIDX_A", "2", 0);
+  check ("ENVIDX_A", "1");
+  setenv ("ENVIDX_A", "longer value", 1);
+  check ("ENVIDX_A", "longer value");
+  putenv (put);
+  check ("ENVIDX_PUT", "1");
+  /* putenv strings are part of the environment. */
+  put[11] = '2';
+  check ("ENVIDX_PUT", "2");
+  unsetenv ("ENVIDX_A");
+  check ("ENVIDX_A", NULL);
+  check ("ENVIDX_PUT", "2");
+  putenv ("ENVIDX_PUT");
+  check ("ENVIDX_PUT", NULL);
+
+  /* Assigning a new array. */
+  environ = myenv;
+  check ("ENVIDX_OWN", "own");
+  check ("ENVIDX_A", "a");
+  check ("PATH", NULL);
+  /* Changing the array behind our back. */
+  myenv[1] = "ENVIDX_B=b";
+  check ("ENVIDX_A", NULL);
+  check ("ENVIDX_B", "b");
+  myenv[1] = NULL;
+  check ("ENVIDX_B", NULL);
+  environ = saved;
+  check ("ENVIDX_OWN", NULL);
+
+  /* Many variables, forcing the index to grow. */
+  for (i = 0; i < 2000; ++i)
+    {
+      char name[32], val[32];
+
+      snprintf (name, sizeof name, "ENVIDX_%d", i);
+      snprintf (val, sizeof val, "%d", i);
+      setenv (name, val, 1);
+    }
+  for (i = 0; i < 2000; ++i)
+    {
+      char name[32], val[32];
+
+      snprintf (name, sizeof name, "ENVIDX_%d", i);
+      snprintf (val, sizeof val, "%d", i);
+      check (name, val);
+      if (i & 1)
+	unsetenv (name);
+    }
+  for (i = 0; i < 2000; ++i)
+    {
+      char name[32], val[32];
+
+      snprintf (name, sizeof name, "ENVIDX_%d", i);
+      snprintf (val, sizeof val, "%d", i);
+      check (name, (i & 1) ? NULL : val);
+      unsetenv (name);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  coherency ();
+  exit (0);
+}
@@ -0,0 +1,175 @@
+/* Stress malloc and free from many threads at once, including blocks freed
+   by a different thread than the one which allocated them and forks while
+   other threads are allocating.  Then do it all again with the
+   malloc_arenas option. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#define NSLOTS	1024
+#define NOPS	100000
+
+/* Blocks handed over from one thread to another. */
+static void *volatile exchange[64];
+
+static volatile int stop;
+
+static void
+fail (const char *what)
+{
+  fprintf (stderr, "mallocstress: %s\n", what);
+  exit (1);
+}
+
+/* Fill the block with a pattern depending on its address. */
+static void
+fill (unsigned char *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; ++i)
+    p[i] = (unsigned char) ((uintptr_t) p + i);
+}
+
+static void
+verify (unsigned char *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; ++i)
+    if (p[i] != (unsigned char) ((uintptr_t) p + i))
+      fail ("block contents changed");
+}
+
+static size_t
+random_size (unsigned *seed)
+{
+  /* Mostly small blocks, some larger ones. */
+  return (rand_r (seed) & 7) ? rand_r (seed) % 256 : rand_r (seed) % 4096;
+}
+
+static void *
+worker (void *arg)
+{
+  unsigned seed = (unsigned) (uintptr_t) arg;
+  unsigned char *slot[NSLOTS] = { NULL };
+  size_t size[NSLOTS];
+  int i, n;
+
+  for (n = 0; !stop && n < NOPS; ++n)
+    {
+      i = rand_r (&seed) % NSLOTS;
+      if (slot[i])
+	{
+	  verify (slot[i], size[i]);
+	  if (rand_r (&seed) % 16)
+	    free (slot[i]);
+	  else
+	    {
+	      /* Swap with another thread, which frees it. */
+	      void *other;
+	      int e = rand_r (&seed) % 64;
+
+	      other = __atomic_exchange_n (&exchange[e], slot[i],
+					   __ATOMIC_ACQ_REL);
+	      free (other);
+	    }
+	  slot[i] = NULL;
+	}
+      else
+	{
+	  size[i] = random_size (&seed);
+	  if (rand_r (&seed) % 8)
+	    slot[i] = malloc (size[i]);
+	  else if ((slot[i] = calloc (1, size[i])))
+	    {
+	      size_t j;
+
+	      for (j = 0; j < size[i]; ++j)
+		if (slot[i][j])
+		  fail ("calloc returned non-zero memory");
+	    }
+	  if (!slot[i])
+	    fail ("out of memory");
+	  fill (slot[i], size[i]);
+	}
+    }
+  for (i = 0; i < NSLOTS; ++i)
+    if (slot[i])
+      {
+	verify (slot[i], size[i]);
+	free (slot[i]);
+      }
+  return NULL;
+}
+
+static void
+stress_fork (void)
+{
+  pthread_t thr[4];
+  int i, status;
+
+  stop = 0;
+  for (i = 0; i < 4; ++i)
+    pthread_create (&thr[i], NULL, worker, (void *) (uintptr_t) (i + 1));
+  for (i = 0; i < 20; ++i)
+    {
+      pid_t pid = fork ();
+
+      if (pid < 0)
+	fail ("fork failed");
+      if (pid == 0)
+	{
+	  stop = 0;
+	  worker ((void *) (uintptr_t) (100 + i));
+	  _exit (0);
+	}
+      if (waitpid (pid, &status, 0) != pid
+	  || !WIFEXITED (status) || WEXITSTATUS (status))
+	fail ("child failed after fork");
+    }
+  stop = 1;
+  for (i = 0; i < 4; ++i)
+    pthread_join (thr[i], NULL);
+}
+
+/* 16 threads allocating and freeing at once. */
+static void
+stress_threads (void)
+{
+  pthread_t thr[16];
+  int i;
+
+  stop = 0;
+  for (i = 0; i < 16; ++i)
+    pthread_create (&thr[i], NULL, worker, (void *) (uintptr_t) (i + 1));
+  for (i = 0; i < 16; ++i)
+    pthread_join (thr[i], NULL);
+}
+
+int
+main (int argc, char **argv)
+{
+  int arenas = argc > 1 && !strcmp (argv[1], "arenas");
+  int e;
+
+  stress_fork ();
+  stress_threads ();
+  for (e = 0; e < 64; ++e)
+    free (exchange[e]);
+  if (!arenas)
+    {
+      char *args[] = { argv[0], "arenas", NULL };
+
+      setenv ("MSYS", "malloc_arenas", 1);
+      setenv ("CYGWIN", "malloc_arenas", 1);
+      execv (argv[0], args);
+      fail ("execv failed");
+    }
+  exit (0);
+}
@@ -0,0 +1,95 @@
+/* Check that converting the usual floating point numbers with printf,
+   scanf and strtod doesn't allocate memory for Bigints once a thread did
+   its first conversion, and that the first one allocates only once.
+   That needs newlib and Cygwin built with -DMPREC_STATS, otherwise only
+   the conversions are checked. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/cygwin.h>
+
+#define NCONV	20000
+
+static const double values[] = {
+  0.1, 1.0 / 3, 3.14159265358979, 2.718281828459045, 100, 1e23, 123456.789,
+  6.02214076e23, 1.602176634e-19, 299792458, 0.30000000000000004, 1e-5
+};
+#define NVALUES	(sizeof values / sizeof values[0])
+
+static void
+fail (const char *what)
+{
+  fprintf (stderr, "mprecpool: %s\n", what);
+  exit (1);
+}
+
+static int have_stats;
+
+static void
+stats (uint64_t *ballocs, uint64_t *mallocs)
+{
+  *ballocs = *mallocs = 0;
+  if (cygwin_internal (CW_MPREC_STATS, ballocs, mallocs) == 0)
+    have_stats = 1;
+  else if (errno != ENOSYS)
+    fail ("CW_MPREC_STATS failed");
+}
+
+/* Print and read back every value, in the formats people use. */
+static void
+convert (int i)
+{
+  double d = values[i % NVALUES] * (1 + i % 1000), e;
+  char buf[64];
+
+  snprintf (buf, sizeof buf, "%.17g", d);
+  if (sscanf (buf, "%lf", &e) != 1 || e != d)
+    fail ("%.17g doesn't read back");
+  snprintf (buf, sizeof buf, "%g %.3f %e", d, d, d);
+  e = strtod (buf, NULL);
+  if (e < d * 0.99999 || e > d * 1.00001)
+    fail ("%g doesn't read back");
+}
+
+static void *
+first_conversion (void *arg)
+{
+  uint64_t ballocs0, mallocs0, ballocs, mallocs;
+  int i;
+
+  stats (&ballocs0, &mallocs0);
+  for (i = 0; i < 1000; ++i)
+    convert (i);
+  stats (&ballocs, &mallocs);
+  if (have_stats && mallocs - mallocs0 > 1)
+    fail ("the first conversions in a thread malloced more than once");
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  uint64_t ballocs0, mallocs0, ballocs, mallocs;
+  pthread_t thr;
+  int i;
+
+  for (i = 0; i < 1000; ++i)
+    convert (i);
+
+  stats (&ballocs0, &mallocs0);
+  for (i = 0; i < NCONV; ++i)
+    convert (i);
+  stats (&ballocs, &mallocs);
+  if (!have_stats)
+    printf ("CW_MPREC_STATS not built in, not counting Bigints\n");
+  else if (mallocs != mallocs0)
+    fail ("converting the usual numbers still mallocs");
+
+  pthread_create (&thr, NULL, first_conversion, NULL);
+  pthread_join (thr, NULL);
+  exit (0);
+}
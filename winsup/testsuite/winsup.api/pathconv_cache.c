@@ -0,0 +1,123 @@
+/* Check that the per-process path_conv cache is used when the same files
+   are stat'ed again, and that it stays coherent with changes made by this
+   and by other processes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/cygwin.h>
+
+#define NFILES	100
+
+static char dir[] = "pcc.XXXXXX";
+
+static void
+fail (const char *what, const char *path)
+{
+  fprintf (stderr, "pathconv_cache: %s: %s: %s\n", what, path,
+	   strerror (errno));
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  char path[64];
+  struct stat st;
+  uint64_t hits0, hits, misses;
+  int i, fd, status;
+  pid_t pid;
+
+  if (!mkdtemp (dir))
+    fail ("mkdtemp", dir);
+  for (i = 0; i < NFILES; ++i)
+    {
+      snprintf (path, sizeof path, "%s/f%05d", dir, i);
+      if ((fd = open (path, O_CREAT | O_WRONLY, 0644)) < 0)
+	fail ("open", path);
+      close (fd);
+    }
+
+  /* Coherency: unlink, rename and create must be visible immediately. */
+  snprintf (path, sizeof path, "%s/f00000", dir);
+  if (stat (path, &st) || stat (path, &st))
+    fail ("stat", path);
+  if (unlink (path))
+    fail ("unlink", path);
+  if (stat (path, &st) == 0 || errno != ENOENT)
+    fail ("stat after unlink", path);
+  if ((fd = open (path, O_CREAT | O_WRONLY, 0644)) < 0)
+    fail ("open", path);
+  close (fd);
+  if (stat (path, &st))
+    fail ("stat after create", path);
+  if (chdir (dir))
+    fail ("chdir", dir);
+  if (stat ("f00001", &st) || stat ("f00001", &st))
+    fail ("stat", "f00001");
+  if (rename ("f00001", "moved"))
+    fail ("rename", "f00001");
+  if (stat ("f00001", &st) == 0 || errno != ENOENT)
+    fail ("stat after rename", "f00001");
+  if (rename ("moved", "f00001"))
+    fail ("rename", "moved");
+
+  /* Another process replacing a file with a directory, or removing it,
+     must be visible immediately, too. */
+  if (stat ("f00002", &st) || stat ("f00002", &st))
+    fail ("stat", "f00002");
+  if ((pid = fork ()) == 0)
+    _exit (unlink ("f00002") || mkdir ("f00002", 0755));
+  if (pid < 0 || waitpid (pid, &status, 0) != pid || status)
+    fail ("child replacing", "f00002");
+  if (stat ("f00002", &st) || !S_ISDIR (st.st_mode))
+    fail ("stat after replace by other process", "f00002");
+  if ((pid = fork ()) == 0)
+    _exit (rmdir ("f00002") != 0);
+  if (pid < 0 || waitpid (pid, &status, 0) != pid || status)
+    fail ("child removing", "f00002");
+  if (stat ("f00002", &st) == 0 || errno != ENOENT)
+    fail ("stat after unlink by other process", "f00002");
+  if ((fd = open ("f00002", O_CREAT | O_WRONLY, 0644)) < 0)
+    fail ("open", "f00002");
+  close (fd);
+  if (chdir (".."))
+    fail ("chdir", "..");
+
+  /* The second pass over the files must be served from the cache, but
+     for the odd slot shared by two of them. */
+  for (i = 0; i < NFILES; ++i)
+    {
+      snprintf (path, sizeof path, "%s/f%05d", dir, i);
+      if (stat (path, &st))
+	fail ("stat", path);
+    }
+  cygwin_internal (CW_PATH_CONV_CACHE_STATS, &hits0, &misses);
+  for (i = 0; i < NFILES; ++i)
+    {
+      snprintf (path, sizeof path, "%s/f%05d", dir, i);
+      if (stat (path, &st))
+	fail ("stat", path);
+    }
+  cygwin_internal (CW_PATH_CONV_CACHE_STATS, &hits, &misses);
+  if (hits - hits0 < NFILES / 2)
+    {
+      fprintf (stderr, "pathconv_cache: %llu cache hits for %d files\n",
+	       (unsigned long long) (hits - hits0), NFILES);
+      exit (1);
+    }
+
+  for (i = 0; i < NFILES; ++i)
+    {
+      snprintf (path, sizeof path, "%s/f%05d", dir, i);
+      unlink (path);
+    }
+  rmdir (dir);
+  exit (0);
+}
@@ -0,0 +1,198 @@
+/* Check that posix_spawn carries out file actions and attributes when it
+   starts the new process directly, that it reports errors to the caller,
+   and that it still works going through vfork, which it does for
+   POSIX_SPAWN_SETSCHEDPARAM. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define OUTFILE	"posixspawn.out"
+
+extern char **environ;
+static char self[4096];
+
+static void
+fail (const char *what, int err)
+{
+  fprintf (stderr, "posixspawn: %s: %s\n", what, strerror (err));
+  exit (1);
+}
+
+/* The child of check_actions: exit with the number of the first check
+   which fails. */
+static int
+child (void)
+{
+  sigset_t mask;
+  struct sigaction sa;
+
+  if (write (1, "hello\n", 6) != 6 || write (4, "world\n", 6) != 6)
+    return 2;
+  if (fcntl (3, F_GETFD) != -1 || fcntl (5, F_GETFD) != -1)
+    return 3;
+  if (fcntl (6, F_GETFD) != 0)
+    return 4;
+  sigprocmask (SIG_SETMASK, NULL, &mask);
+  if (!sigismember (&mask, SIGUSR1) || sigismember (&mask, SIGUSR2))
+    return 5;
+  sigaction (SIGUSR2, NULL, &sa);
+  if (sa.sa_handler != SIG_DFL)
+    return 6;
+  sigaction (SIGHUP, NULL, &sa);
+  if (sa.sa_handler != SIG_IGN)
+    return 7;
+  if (getpgrp () != getpid ())
+    return 8;
+  return 0;
+}
+
+static void
+check_actions (void)
+{
+  posix_spawn_file_actions_t fa;
+  posix_spawnattr_t attr;
+  sigset_t mask;
+  char *argv[] = { self, "child", NULL };
+  char buf[64];
+  pid_t pid;
+  int fd, status, err;
+  ssize_t len;
+
+  /* fd 3 is inherited unless closed, fd 5 is close-on-exec. */
+  if (dup2 (2, 3) != 3 || dup2 (2, 5) != 5 || fcntl (5, F_SETFD, FD_CLOEXEC))
+    fail ("dup2", errno);
+  signal (SIGUSR2, SIG_IGN);
+  signal (SIGHUP, SIG_IGN);
+
+  posix_spawn_file_actions_init (&fa);
+  posix_spawn_file_actions_addopen (&fa, 1, OUTFILE,
+				    O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_adddup2 (&fa, 1, 4);
+  posix_spawn_file_actions_addclose (&fa, 3);
+  posix_spawn_file_actions_adddup2 (&fa, 5, 6);
+  posix_spawnattr_init (&attr);
+  posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETSIGMASK
+				   | POSIX_SPAWN_SETSIGDEF
+				   | POSIX_SPAWN_SETPGROUP);
+  sigemptyset (&mask);
+  sigaddset (&mask, SIGUSR1);
+  posix_spawnattr_setsigmask (&attr, &mask);
+  sigemptyset (&mask);
+  sigaddset (&mask, SIGUSR2);
+  posix_spawnattr_setsigdefault (&attr, &mask);
+  posix_spawnattr_setpgroup (&attr, 0);
+
+  if ((err = posix_spawn (&pid, self, &fa, &attr, argv, environ)))
+    fail ("posix_spawn", err);
+  if (waitpid (pid, &status, 0) != pid)
+    fail ("waitpid", errno);
+  if (!WIFEXITED (status) || WEXITSTATUS (status))
+    {
+      fprintf (stderr, "posixspawn: child failed check %d\n",
+	       WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+      exit (1);
+    }
+
+  /* The parent's fds are untouched. */
+  if (fcntl (3, F_GETFD) != 0 || fcntl (5, F_GETFD) != FD_CLOEXEC
+      || fcntl (4, F_GETFD) != -1 || fcntl (6, F_GETFD) != -1)
+    fail ("parent's fds changed", EINVAL);
+
+  if ((fd = open (OUTFILE, O_RDONLY)) < 0)
+    fail (OUTFILE, errno);
+  len = read (fd, buf, sizeof buf);
+  close (fd);
+  unlink (OUTFILE);
+  if (len != 12 || memcmp (buf, "hello\nworld\n", 12))
+    fail ("child's output", EINVAL);
+
+  posix_spawn_file_actions_destroy (&fa);
+  posix_spawnattr_destroy (&attr);
+  close (3);
+  close (5);
+  signal (SIGUSR2, SIG_DFL);
+  signal (SIGHUP, SIG_DFL);
+}
+
+/* Errors which the vfork implementation only reported as exit code 127 */
+static void
+check_errors (void)
+{
+  posix_spawn_file_actions_t fa;
+  char *argv[] = { self, "exit", NULL };
+  pid_t pid;
+  int err;
+
+  if ((err = posix_spawn (&pid, "/nonexistent/program", NULL, NULL, argv,
+			  environ)) != ENOENT)
+    fail ("spawning a nonexistent program", err);
+
+  posix_spawn_file_actions_init (&fa);
+  posix_spawn_file_actions_addopen (&fa, 0, "/nonexistent/file", O_RDONLY, 0);
+  if ((err = posix_spawn (&pid, self, &fa, NULL, argv, environ)) != ENOENT)
+    fail ("opening a nonexistent file", err);
+  posix_spawn_file_actions_destroy (&fa);
+
+  close (7);
+  posix_spawn_file_actions_init (&fa);
+  posix_spawn_file_actions_adddup2 (&fa, 7, 0);
+  if ((err = posix_spawn (&pid, self, &fa, NULL, argv, environ)) != EBADF)
+    fail ("dup2 of a closed fd", err);
+  posix_spawn_file_actions_destroy (&fa);
+}
+
+/* Spawn ourselves with ATTR, and the child must exit with status 3. */
+static void
+check_spawn (const posix_spawnattr_t *attr)
+{
+  char *argv[] = { self, "exit", "3", NULL };
+  pid_t pid;
+  int err, status;
+
+  if ((err = posix_spawn (&pid, self, NULL, attr, argv, environ)))
+    fail ("posix_spawn", err);
+  if (waitpid (pid, &status, 0) != pid)
+    fail ("waitpid", errno);
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 3)
+    fail ("child's exit status", EINVAL);
+}
+
+int
+main (int argc, char **argv)
+{
+  posix_spawnattr_t attr;
+  struct sched_param param;
+  ssize_t len;
+
+  if (argc > 1 && !strcmp (argv[1], "child"))
+    return child ();
+  if (argc > 1)
+    return argc > 2 ? atoi (argv[2]) : 0;
+
+  if ((len = readlink ("/proc/self/exe", self, sizeof self - 1)) < 0)
+    fail ("/proc/self/exe", errno);
+  self[len] = '\0';
+
+  check_actions ();
+  check_errors ();
+
+  /* Setting the current scheduling parameters makes posix_spawn fall back
+     to vfork, which is fork on Cygwin. */
+  posix_spawnattr_init (&attr);
+  posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETSCHEDPARAM);
+  sched_getparam (0, &param);
+  posix_spawnattr_setschedparam (&attr, &param);
+
+  check_spawn (NULL);
+  check_spawn (&attr);
+  posix_spawnattr_destroy (&attr);
+  exit (0);
+}
@@ -0,0 +1,93 @@
+/* Open and close lots of streams, in a different order than they were
+   opened, and check that fflush (NULL) still finds the ones with pending
+   output.  The streams are fmemopen streams, so they don't need file
+   descriptors. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NSTREAMS	10000
+
+static FILE *fp[NSTREAMS];
+static char buf[NSTREAMS][16];
+
+static void
+fail (const char *what, int i)
+{
+  fprintf (stderr, "stdiofiles: %s, stream %d\n", what, i);
+  exit (1);
+}
+
+static void
+open_streams (int from, int to)
+{
+  int i;
+
+  for (i = from; i < to; ++i)
+    if (!(fp[i] = fmemopen (buf[i], sizeof buf[i], "w")))
+      fail ("fmemopen failed", i);
+}
+
+static void
+close_streams (int from, int to, int step)
+{
+  int i;
+
+  for (i = from; i < to; i += step)
+    if (fp[i])
+      {
+	if (fclose (fp[i]))
+	  fail ("fclose failed", i);
+	fp[i] = NULL;
+      }
+}
+
+/* Write to every 100th stream and check that fflush (NULL) flushes it. */
+static void
+check_flush (int n)
+{
+  int i;
+
+  memset (buf, 0, sizeof buf);
+  for (i = 0; i < n; i += 100)
+    if (fp[i])
+      {
+	rewind (fp[i]);
+	fprintf (fp[i], "%d", i);
+      }
+  fflush (NULL);
+  for (i = 0; i < n; i += 100)
+    if (fp[i] && atoi (buf[i]) != i)
+      fail ("fflush (NULL) missed a stream", i);
+}
+
+int
+main (int argc, char **argv)
+{
+  int i, n;
+
+  for (n = 100; n <= NSTREAMS; n *= 10)
+    {
+      open_streams (0, n);
+      check_flush (n);
+
+      /* Close and reopen them in a different order. */
+      for (i = 0; i < n; ++i)
+	{
+	  int j = (i * 7919) % n;
+
+	  close_streams (j, j + 1, 1);
+	  open_streams (j, j + 1);
+	}
+      check_flush (n);
+      close_streams (0, n, 2);
+      check_flush (n);
+      close_streams (0, n, 1);
+    }
+
+  /* Nothing left open but the standard streams. */
+  if (fflush (NULL))
+    fail ("fflush (NULL) failed", -1);
+  exit (0);
+}
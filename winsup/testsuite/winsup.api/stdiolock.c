@@ -0,0 +1,144 @@
+/* Check char-at-a-time and line-oriented stdio in a single-threaded
+   process, where stdio skips the stream locks, and again after a thread
+   was created.  Then check that lines written by several threads to the
+   same stream, with fputs and fprintf, in binary and text mode, don't
+   get mixed up. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define NCHARS	(64 * 1024)
+#define NLINES	(16 * 1024)
+#define NTHREADS 4
+
+static char path[] = "stdiolock.tmp";
+
+static void
+fail (const char *what)
+{
+  fprintf (stderr, "stdiolock: %s\n", what);
+  unlink (path);
+  exit (1);
+}
+
+static void
+check_single (void)
+{
+  static const char line[] = "The quick brown fox jumps over the lazy dog\n";
+  char buf[128], expect[128];
+  FILE *fp;
+  int i, c;
+
+  if (!(fp = fopen (path, "w+")))
+    fail ("fopen failed");
+  for (i = 0; i < NCHARS; ++i)
+    putc ('a' + i % 26, fp);
+  rewind (fp);
+  for (i = 0; (c = getc (fp)) != EOF; ++i)
+    if (c != 'a' + i % 26)
+      fail ("getc read the wrong char");
+  if (i != NCHARS)
+    fail ("getc read the wrong number of chars");
+
+  rewind (fp);
+  for (i = 0; i < NLINES; ++i)
+    if (i & 1)
+      fprintf (fp, "%d: %s", i, line);
+    else
+      fputs (line, fp);
+  rewind (fp);
+  for (i = 0; fgets (buf, sizeof buf, fp); ++i)
+    {
+      if (i & 1)
+	snprintf (expect, sizeof expect, "%d: %s", i, line);
+      else
+	strcpy (expect, line);
+      if (strcmp (buf, expect))
+	fail ("fgets read the wrong line");
+    }
+  if (i != NLINES)
+    fail ("fgets read the wrong number of lines");
+  fclose (fp);
+}
+
+static void *
+idle (void *arg)
+{
+  return NULL;
+}
+
+static FILE *shared;
+
+static void *
+writer (void *arg)
+{
+  int id = (int) (intptr_t) arg, i;
+
+  for (i = 0; i < NLINES / NTHREADS; ++i)
+    if (i & 1)
+      fprintf (shared, "thread %d line %d %s\n", id, i,
+	       "................................................");
+    else
+      {
+	char buf[128];
+
+	snprintf (buf, sizeof buf, "thread %d line %d %s\n", id, i,
+		  "................................................");
+	fputs (buf, shared);
+      }
+  return NULL;
+}
+
+/* Several threads write lines to one stream, each of them must come out
+   in one piece and in order per thread. */
+static void
+check_threads (const char *mode)
+{
+  pthread_t thr[NTHREADS];
+  int next[NTHREADS] = { 0 };
+  char buf[256];
+  int i, id, n, lines = 0;
+
+  if (!(shared = fopen (path, mode)))
+    fail ("fopen failed");
+  for (i = 0; i < NTHREADS; ++i)
+    pthread_create (&thr[i], NULL, writer, (void *) (intptr_t) i);
+  for (i = 0; i < NTHREADS; ++i)
+    pthread_join (thr[i], NULL);
+  rewind (shared);
+  while (fgets (buf, sizeof buf, shared))
+    {
+      char expect[128];
+
+      if (sscanf (buf, "thread %d line %d ", &id, &n) != 2
+	  || id < 0 || id >= NTHREADS || n != next[id]++)
+	fail ("lines got mixed up");
+      snprintf (expect, sizeof expect, "thread %d line %d %s\n", id, n,
+		"................................................");
+      if (strcmp (buf, expect))
+	fail ("lines got mixed up");
+      ++lines;
+    }
+  if (lines != NLINES / NTHREADS * NTHREADS)
+    fail ("lines got lost");
+  fclose (shared);
+}
+
+int
+main (int argc, char **argv)
+{
+  pthread_t thr;
+
+  check_single ();
+  pthread_create (&thr, NULL, idle, NULL);
+  pthread_join (thr, NULL);
+  check_single ();
+  check_threads ("w+");
+  check_threads ("w+t");
+  unlink (path);
+  exit (0);
+}